@@ -101,6 +101,12 @@ using namespace grk;
 #define TCLAP_NAMESTARTSTRING "-"
 #include "tclap/CmdLine.h"
 #include <chrono>  // for high_resolution_clock
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <atomic>
+#include <vector>
 
 using namespace TCLAP;
 
@@ -212,6 +218,12 @@ static void encode_help_display(void) {
 	fprintf(stdout, "    Input file\n");
 	fprintf(stdout,
 			"    Known extensions are <PBM|PGM|PPM|PNM|PAM|PGX|PNG|BMP|TIF|RAW|RAWL|TGA>\n");
+	fprintf(stdout,
+			"    J2K and JP2 files are transcoded losslessly to HTJ2K, without\n");
+	fprintf(stdout,
+			"    reconstructing pixels: the input must be reversible, and coding\n");
+	fprintf(stdout,
+			"    structure options are taken from the input. See also -Rewrite.\n");
 	fprintf(stdout, "    If used, '-o <file>' must be provided\n");
 	fprintf(stdout, "[-o|-OutputFile] <compressed file>\n");
 	fprintf(stdout, "    Output file (accepted extensions are j2k or jp2).\n");
@@ -267,6 +279,15 @@ static void encode_help_display(void) {
 			"    0: Bisection search for optimal threshold using all code passes in code blocks. (default) (slightly higher PSRN than algorithm 1)\n");
 	fprintf(stdout,
 			"    1: Bisection search for optimal threshold using only feasible truncation points, on convex hull.\n");
+	fprintf(stdout, "[-f|-EarlyTermination]\n");
+	fprintf(stdout,
+			"    Estimate rate control threshold from a sample of code blocks, and skip\n");
+	fprintf(stdout,
+			"    coding passes that can not be included at the requested rates.\n");
+	fprintf(stdout,
+			"    Faster at high compression ratios. Only used with -r, when last layer is not lossless.\n");
+	fprintf(stdout,
+			"    The estimate may be off, so the output may differ from a full encode.\n");
 	fprintf(stdout, "[-n|-Resolutions] <number of resolutions>\n");
 	fprintf(stdout, "    Number of resolutions.\n");
 	fprintf(stdout,
@@ -421,6 +442,31 @@ static void encode_help_display(void) {
 	fprintf(stdout, "    Path to T1 plugin.\n");
 	fprintf(stdout, "[-H|-num_threads] <number of threads>\n");
 	fprintf(stdout, "    Number of threads to use for T1.\n");
+	fprintf(stdout, "[-W|-BatchPipeline] <readers>,<encoders>,<writers>\n");
+	fprintf(stdout,
+			"    Pipelined compress of the images in -ImgDir: number of threads\n");
+	fprintf(stdout,
+			"    reading source images, number of images compressed concurrently,\n");
+	fprintf(stdout,
+			"    and number of threads writing compressed files.\n");
+	fprintf(stdout,
+			"    The -num_threads threads are split evenly between the images\n");
+	fprintf(stdout,
+			"    being compressed.\n");
+	fprintf(stdout, "      Example: -W 2,4,1\n");
+	fprintf(stdout,
+			"[-j|-Rewrite] [L=<layers>][/R=<reduce>][/C=<c0>,<c1>,...][/T=<x0>,<y0>,<x1>,<y1>]\n");
+	fprintf(stdout,
+			"    Rewrite J2K or JP2 input by copying its packets, without decoding\n");
+	fprintf(stdout,
+			"    any code blocks: keep the first <layers> quality layers, discard the\n");
+	fprintf(stdout,
+			"    <reduce> highest resolutions, keep the listed components, and keep\n");
+	fprintf(stdout,
+			"    the tiles in the rectangle [x0,x1) x [y0,y1) of the tile grid.\n");
+	fprintf(stdout,
+			"    Coding structure options are taken from the input.\n");
+	fprintf(stdout, "      Example: -j L=2/R=1/C=0\n");
 	fprintf(stdout, "[-G|-DeviceId] <device ID>\n");
 	fprintf(stdout,
 			"    (GPU) Specify which GPU accelerator to run codec on.\n");
@@ -517,6 +563,8 @@ static bool isDecodedFormatSupported(GRK_SUPPORTED_FILE_FMT format) {
 	case GRK_TGA_FMT:
 	case GRK_PNG_FMT:
 	case GRK_JPG_FMT:
+	case GRK_J2K_FMT:
+	case GRK_JP2_FMT:
 		break;
 	default:
 		return false;
@@ -524,6 +572,63 @@ static bool isDecodedFormatSupported(GRK_SUPPORTED_FILE_FMT format) {
 	return true;
 }
 
+/*
+ Parse rewrite argument of the form
+ [L=<layers>][/R=<reduce>][/C=<c0>,<c1>,...][/T=<x0>,<y0>,<x1>,<y1>]
+ */
+static bool parse_rewrite(const char *arg, grk_rewrite_params *rewrite) {
+	std::stringstream fields(arg);
+	std::string field;
+	while (std::getline(fields, field, '/')) {
+		if (field.size() < 3 || field[1] != '=')
+			return false;
+		const char *value = field.c_str() + 2;
+		switch (field[0]) {
+		case 'L':
+			if (sscanf(value, "%u", &rewrite->numlayers) != 1)
+				return false;
+			break;
+		case 'R':
+			if (sscanf(value, "%u", &rewrite->reduce) != 1)
+				return false;
+			break;
+		case 'C': {
+			std::stringstream comps(value);
+			std::string comp;
+			std::vector<uint32_t> values;
+			while (std::getline(comps, comp, ',')) {
+				uint32_t compno;
+				if (sscanf(comp.c_str(), "%u", &compno) != 1)
+					return false;
+				values.push_back(compno);
+			}
+			if (values.empty())
+				return false;
+			free(rewrite->comps);
+			rewrite->comps = (uint32_t*) malloc(
+					values.size() * sizeof(uint32_t));
+			if (!rewrite->comps)
+				return false;
+			memcpy(rewrite->comps, values.data(),
+					values.size() * sizeof(uint32_t));
+			rewrite->numcomps = (uint32_t) values.size();
+		}
+			break;
+		case 'T':
+			if (sscanf(value, "%u,%u,%u,%u", &rewrite->tile_x0,
+					&rewrite->tile_y0, &rewrite->tile_x1, &rewrite->tile_y1)
+					!= 4 || rewrite->tile_x0 >= rewrite->tile_x1
+					|| rewrite->tile_y0 >= rewrite->tile_y1)
+				return false;
+			break;
+		default:
+			return false;
+		}
+	}
+
+	return true;
+}
+
 class GrokOutput: public StdOutput {
 public:
 	virtual void usage(CmdLineInterface &c) {
@@ -601,6 +706,8 @@ static int parse_cmdline_encoder_ex(int argc, char **argv,
 				"", "string", cmd);
 		ValueArg<uint32_t> numThreadsArg("H", "num_threads",
 				"Number of threads", false, 0, "unsigned integer", cmd);
+		ValueArg<string> batchPipelineArg("W", "BatchPipeline",
+				"Batch pipeline concurrency", false, "", "string", cmd);
 
 		ValueArg<int32_t> deviceIdArg("G", "DeviceId", "Device ID", false, 0,
 				"integer", cmd);
@@ -693,9 +800,16 @@ static int parse_cmdline_encoder_ex(int argc, char **argv,
 		ValueArg<uint32_t> durationArg("J", "Duration", "Duration in seconds",
 				false, 0, "unsigned integer", cmd);
 
+		ValueArg<string> rewriteArg("j", "Rewrite",
+				"Rewrite packets of J2K or JP2 input", false, "", "string",
+				cmd);
+
 		ValueArg<uint32_t> rateControlAlgoArg("A", "RateControlAlgorithm",
 				"Rate control algorithm", false, 0, "unsigned integer", cmd);
 
+		SwitchArg earlyTerminationArg("f", "EarlyTermination",
+				"Early termination of coding passes", cmd);
+
 		SwitchArg verboseArg("v", "verbose", "Verbose", cmd);
 
 		cmd.parse(argc, argv);
@@ -723,9 +837,36 @@ static int parse_cmdline_encoder_ex(int argc, char **argv,
 		if (rateControlAlgoArg.isSet())
 			parameters->rateControlAlgorithm = rateControlAlgoArg.getValue();
 
+		if (earlyTerminationArg.isSet())
+			parameters->earlyTermination = true;
+
 		if (numThreadsArg.isSet())
 			parameters->numThreads = numThreadsArg.getValue();
 
+		if (batchPipelineArg.isSet()) {
+			if (sscanf(batchPipelineArg.getValue().c_str(), "%u,%u,%u",
+					&parameters->batchReaders, &parameters->batchEncoders,
+					&parameters->batchWriters) != 3
+					|| !parameters->batchReaders || !parameters->batchEncoders
+					|| !parameters->batchWriters) {
+				spdlog::error(
+						"-W argument must be in the form <readers>,<encoders>,<writers>,"
+						" with non-zero values");
+				return 1;
+			}
+		}
+
+		if (rewriteArg.isSet()) {
+			if (!parse_rewrite(rewriteArg.getValue().c_str(),
+					&parameters->rewrite)) {
+				spdlog::error(
+						"-j argument must be in the form [L=<layers>][/R=<reduce>]"
+						"[/C=<c0>,<c1>,...][/T=<x0>,<y0>,<x1>,<y1>]");
+				return 1;
+			}
+			parameters->rewrite_on = true;
+		}
+
 		if (deviceIdArg.isSet())
 			parameters->deviceId = deviceIdArg.getValue();
 
@@ -741,7 +882,7 @@ static int parse_cmdline_encoder_ex(int argc, char **argv,
 				spdlog::warn(" Ignoring unknown input file format: %s \n"
 								"Known file formats are *.pnm, *.pgm, "
 								"*.ppm, *.pgx, *png, *.bmp, *.tif, *.jpg,"
-								" *.raw or *.tga",	infile);
+								" *.raw, *.tga, *.j2k or *.jp2",	infile);
 			}
 		}
 
@@ -753,7 +894,7 @@ static int parse_cmdline_encoder_ex(int argc, char **argv,
 				if (!isDecodedFormatSupported(parameters->decod_format)) {
 					spdlog::error(
 							"Unknown input file format: {} \n"
-									"        Known file formats are *.pnm, *.pgm, *.ppm, *.pgx, *png, *.bmp, *.tif, *.jpg, *.raw or *.tga",
+									"        Known file formats are *.pnm, *.pgm, *.ppm, *.pgx, *png, *.bmp, *.tif, *.jpg, *.raw, *.tga, *.j2k or *.jp2",
 							infile);
 					return 1;
 				}
@@ -1718,6 +1859,8 @@ struct CompressInitParams {
 		}
 		if (parameters.raw_cp.comps)
 			free(parameters.raw_cp.comps);
+		if (parameters.rewrite.comps)
+			free(parameters.rewrite.comps);
 		if (img_fol.imgdirpath)
 			free(img_fol.imgdirpath);
 		if (out_fol.imgdirpath)
@@ -1737,6 +1880,9 @@ struct CompressInitParams {
 };
 
 static int plugin_main(int argc, char **argv, CompressInitParams *initParams);
+static uint32_t batch_compress(CompressInitParams *initParams,
+		const std::vector<std::string> &files, uint8_t tcp_mct,
+		uint32_t rateControlAlgorithm);
 
 // returns 0 if failed, 1 if succeeded, 
 // and 2 if file is not suitable for compression
@@ -1812,17 +1958,26 @@ int main(int argc, char **argv) {
 				success = 1;
 				goto cleanup;
 			}
+			bool batch = initParams.parameters.batchEncoders != 0;
+			std::vector<std::string> files;
 			struct dirent *content = nullptr;
 			while ((content = readdir(dir)) != nullptr) {
 				if (strcmp(".", content->d_name) == 0
 						|| strcmp("..", content->d_name) == 0)
 					continue;
+				if (batch) {
+					files.push_back(content->d_name);
+					continue;
+				}
 				auto rc = compress(content->d_name, &initParams, tcp_mct,
 						rateControlAlgorithm);
 				if (rc == 1)
 					num_compressed_files++;
 			}
 			closedir(dir);
+			if (batch)
+				num_compressed_files += batch_compress(&initParams, files,
+						tcp_mct, rateControlAlgorithm);
 		}
 		auto finish = std::chrono::high_resolution_clock::now();
 		std::chrono::duration<double> elapsed = finish - start;
@@ -1843,230 +1998,146 @@ int main(int argc, char **argv) {
 
 grk_img_fol img_fol_plugin, out_fol_plugin;
 
-static bool plugin_compress_callback(
-		grk_plugin_encode_user_callback_info *info) {
-	grk_cparameters *parameters = info->encoder_parameters;
-	bool bSuccess = true;
-	grk_stream *stream = nullptr;
-	grk_codec *codec = nullptr;
-	grk_image *image = info->image;
-	char outfile[3 * GRK_PATH_LEN];
-	char temp_ofname[GRK_PATH_LEN];
-	bool createdImage = false;
-	bool inMemoryCompression = false;
-
-	// get output file
-	outfile[0] = 0;
-	if (info->output_file_name && info->output_file_name[0]) {
-		if (info->outputFileNameIsRelative) {
-			strcpy(temp_ofname, get_file_name((char*) info->output_file_name));
-			if (img_fol_plugin.set_out_format) {
-				sprintf(outfile, "%s%s%s.%s",
-						out_fol_plugin.imgdirpath ?
-								out_fol_plugin.imgdirpath :
-								img_fol_plugin.imgdirpath,
-						grk::get_path_separator(), temp_ofname,
-						img_fol_plugin.out_format);
-			}
-		} else {
-			strcpy(outfile, info->output_file_name);
-		}
-	} else {
-		bSuccess = false;
-		goto cleanup;
+/*
+ Read source image with the reader for its file format.
+ Returns nullptr if the image cannot be read.
+ */
+static grk_image* load_image(grk_cparameters *parameters, const char *infile) {
+	grk_image *image = nullptr;
+	if (parameters->decod_format == GRK_UNK_FMT) {
+		int fmt = get_file_format((char*) infile);
+		if (fmt <= GRK_UNK_FMT)
+			return nullptr;
+		parameters->decod_format = (GRK_SUPPORTED_FILE_FMT) fmt;
+		if (!isDecodedFormatSupported(parameters->decod_format))
+			return nullptr;
 	}
+	/* decode the source image */
+	/* ----------------------- */
 
-	if (!image) {
-		if (parameters->decod_format == GRK_UNK_FMT) {
-			int fmt = get_file_format((char*) info->input_file_name);
-			if (fmt <= GRK_UNK_FMT) {
-				bSuccess = false;
-				goto cleanup;
-			}
-			parameters->decod_format = (GRK_SUPPORTED_FILE_FMT) fmt;
-			if (!isDecodedFormatSupported(parameters->decod_format)) {
-				bSuccess = false;
-				goto cleanup;
-			}
-
-		}
-		/* decode the source image */
-		/* ----------------------- */
-
-		switch (info->encoder_parameters->decod_format) {
-		case GRK_PGX_FMT: {
-			PGXFormat pgx;
-			image = pgx.decode(info->input_file_name, info->encoder_parameters);
-			if (!image) {
-				spdlog::error("Unable to load pgx file");
-				bSuccess = false;
-				goto cleanup;
-			}
+	switch (parameters->decod_format) {
+	case GRK_PGX_FMT: {
+		PGXFormat pgx;
+		image = pgx.decode(infile, parameters);
+		if (!image) {
+			spdlog::error("Unable to load pgx file");
+			return nullptr;
 		}
-			break;
+	}
+		break;
 
-		case GRK_PXM_FMT: {
-			PNMFormat pnm(false);
-			image = pnm.decode(info->input_file_name, info->encoder_parameters);
-			if (!image) {
-				spdlog::error("Unable to load pnm file");
-				bSuccess = false;
-				goto cleanup;
-			}
+	case GRK_PXM_FMT: {
+		PNMFormat pnm(false);
+		image = pnm.decode(infile, parameters);
+		if (!image) {
+			spdlog::error("Unable to load pnm file");
+			return nullptr;
 		}
-			break;
+	}
+		break;
 
-		case GRK_BMP_FMT: {
-			BMPFormat bmp;
-			image = bmp.decode(info->input_file_name, info->encoder_parameters);
-			if (!image) {
-				spdlog::error("Unable to load bmp file");
-				bSuccess = false;
-				goto cleanup;
-			}
+	case GRK_BMP_FMT: {
+		BMPFormat bmp;
+		image = bmp.decode(infile, parameters);
+		if (!image) {
+			spdlog::error("Unable to load bmp file");
+			return nullptr;
 		}
-			break;
+	}
+		break;
 
 #ifdef GROK_HAVE_LIBTIFF
-		case GRK_TIF_FMT: {
-			TIFFFormat tif;
-			image = tif.decode(info->input_file_name, info->encoder_parameters);
-			if (!image) {
-				bSuccess = false;
-				goto cleanup;
-			}
+	case GRK_TIF_FMT: {
+		TIFFFormat tif;
+		image = tif.decode(infile, parameters);
+		if (!image) {
+			return nullptr;
 		}
-			break;
+	}
+		break;
 #endif /* GROK_HAVE_LIBTIFF */
 
-		case GRK_RAW_FMT: {
-			RAWFormat raw(true);
-			image = raw.decode(info->input_file_name, info->encoder_parameters);
-			if (!image) {
-				spdlog::error("Unable to load raw file");
-				bSuccess = false;
-				goto cleanup;
-			}
+	case GRK_RAW_FMT: {
+		RAWFormat raw(true);
+		image = raw.decode(infile, parameters);
+		if (!image) {
+			spdlog::error("Unable to load raw file");
+			return nullptr;
 		}
-			break;
+	}
+		break;
 
-		case GRK_RAWL_FMT: {
-			RAWFormat raw(false);
-			image = raw.decode(info->input_file_name, info->encoder_parameters);
-			if (!image) {
-				spdlog::error("Unable to load raw file");
-				bSuccess = false;
-				goto cleanup;
-			}
+	case GRK_RAWL_FMT: {
+		RAWFormat raw(false);
+		image = raw.decode(infile, parameters);
+		if (!image) {
+			spdlog::error("Unable to load raw file");
+			return nullptr;
 		}
-			break;
+	}
+		break;
 
-		case GRK_TGA_FMT: {
-			TGAFormat tga;
-			image = tga.decode(info->input_file_name, info->encoder_parameters);
-			if (!image) {
-				spdlog::error("Unable to load tga file");
-				bSuccess = false;
-				goto cleanup;
-			}
+	case GRK_TGA_FMT: {
+		TGAFormat tga;
+		image = tga.decode(infile, parameters);
+		if (!image) {
+			spdlog::error("Unable to load tga file");
+			return nullptr;
 		}
-			break;
+	}
+		break;
 
 #ifdef GROK_HAVE_LIBPNG
-		case GRK_PNG_FMT: {
-			PNGFormat png;
-			image = png.decode(info->input_file_name, info->encoder_parameters);
-			if (!image) {
-				spdlog::error("Unable to load png file");
-				bSuccess = false;
-				goto cleanup;
-			}
+	case GRK_PNG_FMT: {
+		PNGFormat png;
+		image = png.decode(infile, parameters);
+		if (!image) {
+			spdlog::error("Unable to load png file");
+			return nullptr;
 		}
-			break;
+	}
+		break;
 #endif /* GROK_HAVE_LIBPNG */
 
 #ifdef GROK_HAVE_LIBJPEG
-		case GRK_JPG_FMT: {
-			JPEGFormat jpeg;
-			image = jpeg.decode(info->input_file_name,
-					info->encoder_parameters);
-			if (!image) {
-				spdlog::error("Unable to load jpeg file");
-				bSuccess = false;
-				goto cleanup;
-			}
-		}
-			break;
-#endif /* GROK_HAVE_LIBPNG */
-		default: {
-			spdlog::error("Unsupported input file format {}",
-					info->encoder_parameters->decod_format);
-			bSuccess = false;
-			goto cleanup;
-		}
-			break;
-		}
-
-		/* Can happen if input file is TIFF or PNG
-		 * and GROK_HAVE_LIBTIF or GROK_HAVE_LIBPNG is undefined
-		 */
+	case GRK_JPG_FMT: {
+		JPEGFormat jpeg;
+		image = jpeg.decode(infile, parameters);
 		if (!image) {
-			spdlog::error("Unable to load file: no image generated.");
-			bSuccess = false;
-			goto cleanup;
+			spdlog::error("Unable to load jpeg file");
+			return nullptr;
 		}
-		createdImage = true;
+	}
+		break;
+#endif /* GROK_HAVE_LIBPNG */
+	default: {
+		spdlog::error("Unsupported input file format {}",
+				parameters->decod_format);
+		return nullptr;
+	}
+		break;
 	}
 
-	if (inMemoryCompression) {
-		auto fp = fopen(info->input_file_name, "rb");
-		if (!fp) {
-			spdlog::error("grk_compress: unable to open file {} for reading",
-					info->input_file_name);
-			bSuccess = false;
-			goto cleanup;
-		}
-
-		auto rc = fseek(fp, 0, SEEK_END);
-		if (rc == -1) {
-			spdlog::error("grk_compress: unable to seek on file {}",
-					info->input_file_name);
-			if (fp)
-				fclose(fp);
-			bSuccess = false;
-			goto cleanup;
-		}
-		auto fileLength = ftell(fp);
-		if (fileLength == -1) {
-			spdlog::error("grk_compress: unable to ftell on file {}",
-					info->input_file_name);
-			if (fp)
-				fclose(fp);
-			bSuccess = false;
-			goto cleanup;
-		}
-		if (fp)
-			fclose(fp);
+	/* Can happen if input file is TIFF or PNG
+	 * and GROK_HAVE_LIBTIF or GROK_HAVE_LIBPNG is undefined
+	 */
+	if (!image)
+		spdlog::error("Unable to load file: no image generated.");
 
-		if (fileLength) {
-			//  option to write to buffer, assuming one knows how large compressed stream will be 
-			uint64_t imageSize = (((uint64_t)(image->x1 - image->x0)
-					* (image->y1 - image->y0) * image->numcomps
-					* ((image->comps[0].prec + 7) / 8)) * 3) / 2;
-			info->compressBufferLen =
-					(size_t) fileLength > imageSize ?
-							(size_t) fileLength : imageSize;
-			info->compressBuffer = new uint8_t[info->compressBufferLen];
-		}
-	}
+	return image;
+}
 
+/*
+ Validate image against compress parameters, and resolve
+ MCT and rate control settings that depend on the image
+ */
+static bool prepare_compress(grk_cparameters *parameters, grk_image *image) {
 	// limit to 16 bit precision
 	for (uint32_t i = 0; i < image->numcomps; ++i) {
 		if (image->comps[i].prec > 16) {
 			spdlog::error("Precision = {} not supported:",
 					image->comps[i].prec);
-			bSuccess = false;
-			goto cleanup;
+			return false;
 		}
 	}
 
@@ -2077,14 +2148,12 @@ static bool plugin_compress_callback(
 		if ((parameters->tcp_mct == 1) && (image->numcomps < 3)) {
 			spdlog::error("RGB->YCC conversion cannot be used:");
 			spdlog::error("Input image has less than 3 components");
-			bSuccess = false;
-			goto cleanup;
+			return false;
 		}
 		if ((parameters->tcp_mct == 2) && (!parameters->mct_data)) {
 			spdlog::error("Custom MCT has been set but no array-based MCT");
 			spdlog::error("has been provided.");
-			bSuccess = false;
-			goto cleanup;
+			return false;
 		}
 	}
 
@@ -2140,19 +2209,16 @@ static bool plugin_compress_callback(
 					msamplespersec, limit);
 	}
 
-	if (info->compressBuffer) {
-		// let stream clean up compress buffer
-		stream = grk_stream_create_mem_stream(info->compressBuffer,
-				info->compressBufferLen, true, false);
-	} else {
-		stream = grk_stream_create_file_stream(outfile, 32 * 1024 * 1024,
-				false);
-	}
-	if (!stream) {
-		spdlog::error("failed to create stream");
-		bSuccess = false;
-		goto cleanup;
-	}
+	return true;
+}
+
+/*
+ Compress image to stream
+ */
+static bool compress_image(grk_cparameters *parameters, grk_image *image,
+		grk_stream *stream, grk_plugin_tile *tile) {
+	grk_codec *codec = nullptr;
+	bool bSuccess = true;
 
 	switch (parameters->cod_format) {
 	case GRK_J2K_FMT: /* JPEG 2000 code stream */
@@ -2164,8 +2230,7 @@ static bool plugin_compress_callback(
 		codec = grk_create_compress(GRK_CODEC_JP2, stream);
 		break;
 	default:
-		bSuccess = false;
-		goto cleanup;
+		return false;
 	}
 
 	/* catch events using our callbacks and give a local context */
@@ -2189,7 +2254,7 @@ static bool plugin_compress_callback(
 		goto cleanup;
 	}
 
-	bSuccess = grk_compress_with_plugin(codec, info->tile);
+	bSuccess = grk_compress_with_plugin(codec, tile);
 	if (!bSuccess) {
 		spdlog::error("failed to compress image: grk_compress");
 		bSuccess = false;
@@ -2202,28 +2267,198 @@ static bool plugin_compress_callback(
 		bSuccess = false;
 		goto cleanup;
 	}
-	if (info->compressBuffer) {
-		auto fp = fopen(outfile, "wb");
-		if (!fp) {
-			spdlog::error("Buffer compress: failed to open file {} for writing",
-					outfile);
-		} else {
-			auto len = grk_stream_get_write_mem_stream_length(stream);
-			size_t written = fwrite(info->compressBuffer, 1, len, fp);
-			if (written != len) {
-				spdlog::error(
-						"Buffer compress: only {} bytes written out of {} total",
-						len, written);
-				bSuccess = false;
+	cleanup: grk_destroy_codec(codec);
+
+	return bSuccess;
+}
+
+/*
+ Write contents of chunked memory stream to file
+ */
+static bool write_chunked_stream(grk_stream *stream, const char *outfile) {
+	auto fp = fopen(outfile, "wb");
+	if (!fp) {
+		spdlog::error("Buffer compress: failed to open file {} for writing",
+				outfile);
+		return false;
+	}
+	bool bSuccess = true;
+	auto len = grk_stream_get_write_mem_stream_length(stream);
+	auto numChunks = grk_stream_get_chunked_mem_stream_chunks(stream,
+			nullptr, 0);
+	auto chunks = new grk_stream_chunk[numChunks];
+	grk_stream_get_chunked_mem_stream_chunks(stream, chunks, numChunks);
+	size_t written = 0;
+	for (size_t i = 0; i < numChunks; ++i)
+		written += fwrite(chunks[i].data, 1, chunks[i].len, fp);
+	delete[] chunks;
+	if (written != len) {
+		spdlog::error(
+				"Buffer compress: only {} bytes written out of {} total",
+				written, len);
+		bSuccess = false;
+	}
+	if (!grk::safe_fclose(fp))
+		bSuccess = false;
+
+	return bSuccess;
+}
+
+/*
+ JPEG 2000 input files are transcoded, rather than loaded as images
+ */
+static bool is_transcode_input(grk_cparameters *parameters,
+		const char *infile) {
+	if (parameters->decod_format == GRK_UNK_FMT) {
+		int fmt = get_file_format((char*) infile);
+		if (fmt == GRK_J2K_FMT || fmt == GRK_JP2_FMT)
+			parameters->decod_format = (GRK_SUPPORTED_FILE_FMT) fmt;
+	}
+	return parameters->decod_format == GRK_J2K_FMT
+			|| parameters->decod_format == GRK_JP2_FMT;
+}
+
+/*
+ Transcode JPEG 2000 input file to HTJ2K, or rewrite its packets,
+ without reconstructing pixels
+ */
+static bool transcode_image(grk_cparameters *parameters, const char *infile,
+		const char *outfile) {
+	grk_stream *src_stream = nullptr;
+	grk_stream *stream = nullptr;
+	grk_codec *src_codec = nullptr;
+	grk_codec *codec = nullptr;
+	grk_image *image = nullptr;
+	grk_dparameters dparameters;
+	grk_header_info header_info;
+	bool bSuccess = false;
+
+	src_stream = grk_stream_create_mapped_file_read_stream(infile);
+	if (!src_stream) {
+		spdlog::error("failed to create the stream from the file {}", infile);
+		goto cleanup;
+	}
+	src_codec = grk_create_decompress(
+			parameters->decod_format == GRK_JP2_FMT ?
+					GRK_CODEC_JP2 : GRK_CODEC_J2K, src_stream);
+	if (!src_codec)
+		goto cleanup;
+
+	/* catch events using our callbacks and give a local context */
+	if (parameters->verbose) {
+		grk_set_info_handler(info_callback, nullptr);
+		grk_set_warning_handler(warning_callback, nullptr);
+	}
+	grk_set_error_handler(error_callback, nullptr);
+
+	grk_set_default_decompress_params(&dparameters);
+	if (!grk_init_decompress(src_codec, &dparameters)) {
+		spdlog::error("failed to transcode image: grk_init_decompress");
+		goto cleanup;
+	}
+	memset(&header_info, 0, sizeof(header_info));
+	if (!grk_read_header(src_codec, &header_info, &image)) {
+		spdlog::error("failed to transcode image: grk_read_header");
+		goto cleanup;
+	}
+
+	stream = grk_stream_create_file_stream(outfile, 32 * 1024 * 1024, false);
+	if (!stream) {
+		spdlog::error("failed to create stream");
+		goto cleanup;
+	}
+	codec = grk_create_compress(
+			parameters->cod_format == GRK_JP2_FMT ?
+					GRK_CODEC_JP2 : GRK_CODEC_J2K, stream);
+	if (!codec)
+		goto cleanup;
+	if (parameters->rewrite_on) {
+		bSuccess = grk_rewrite(src_codec, codec, parameters, image);
+		if (!bSuccess)
+			spdlog::error("failed to rewrite image: grk_rewrite");
+	} else {
+		bSuccess = grk_transcode(src_codec, codec, parameters, image);
+		if (!bSuccess)
+			spdlog::error("failed to transcode image: grk_transcode");
+	}
+	cleanup: grk_destroy_codec(codec);
+	grk_destroy_codec(src_codec);
+	if (stream)
+		grk_stream_destroy(stream);
+	if (src_stream)
+		grk_stream_destroy(src_stream);
+	grk_image_destroy(image);
+
+	return bSuccess;
+}
+
+static bool plugin_compress_callback(
+		grk_plugin_encode_user_callback_info *info) {
+	grk_cparameters *parameters = info->encoder_parameters;
+	bool bSuccess = true;
+	grk_stream *stream = nullptr;
+	grk_image *image = info->image;
+	char outfile[3 * GRK_PATH_LEN];
+	char temp_ofname[GRK_PATH_LEN];
+	bool createdImage = false;
+	bool inMemoryCompression = false;
+
+	// get output file
+	outfile[0] = 0;
+	if (info->output_file_name && info->output_file_name[0]) {
+		if (info->outputFileNameIsRelative) {
+			strcpy(temp_ofname, get_file_name((char*) info->output_file_name));
+			if (img_fol_plugin.set_out_format) {
+				sprintf(outfile, "%s%s%s.%s",
+						out_fol_plugin.imgdirpath ?
+								out_fol_plugin.imgdirpath :
+								img_fol_plugin.imgdirpath,
+						grk::get_path_separator(), temp_ofname,
+						img_fol_plugin.out_format);
 			}
-			if (fp)
-				fclose(fp);
+		} else {
+			strcpy(outfile, info->output_file_name);
 		}
+	} else {
+		bSuccess = false;
+		goto cleanup;
+	}
+
+	if (!image && is_transcode_input(parameters, info->input_file_name)) {
+		bSuccess = transcode_image(parameters, info->input_file_name,
+				outfile);
+		goto cleanup;
+	}
+	if (!image) {
+		image = load_image(parameters, info->input_file_name);
+		if (!image) {
+			bSuccess = false;
+			goto cleanup;
+		}
+		createdImage = true;
+	}
+	if (!prepare_compress(parameters, image)) {
+		bSuccess = false;
+		goto cleanup;
+	}
+
+	if (inMemoryCompression) {
+		// growable memory stream: no need to know compressed size in advance
+		stream = grk_stream_create_chunked_mem_stream(0);
+	} else {
+		stream = grk_stream_create_file_stream(outfile, 32 * 1024 * 1024,
+				false);
+	}
+	if (!stream) {
+		spdlog::error("failed to create stream");
+		bSuccess = false;
+		goto cleanup;
 	}
+	bSuccess = compress_image(parameters, image, stream, info->tile);
+	if (bSuccess && inMemoryCompression)
+		bSuccess = write_chunked_stream(stream, outfile);
 	cleanup: if (stream)
 		grk_stream_destroy(stream);
-	if (codec)
-		grk_destroy_codec(codec);
 	if (createdImage)
 		grk_image_destroy(image);
 	if (!bSuccess) {
@@ -2233,6 +2468,294 @@ static bool plugin_compress_callback(
 	}
 	return bSuccess;
 }
+/*
+ Bounded queue connecting two stages of the batch compress pipeline.
+ push blocks while the queue is full, and pop blocks while the queue
+ is empty; pop returns false once all producers are done and the queue
+ has been drained.
+ */
+template<typename T> class BatchQueue {
+public:
+	BatchQueue(size_t capacity, uint32_t numProducers) :
+			m_capacity(capacity ? capacity : 1), m_numProducers(numProducers) {
+	}
+	void push(T item) {
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_notFull.wait(lock, [this] {
+			return m_queue.size() < m_capacity;
+		});
+		m_queue.push_back(item);
+		m_notEmpty.notify_one();
+	}
+	bool pop(T *item) {
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_notEmpty.wait(lock, [this] {
+			return !m_queue.empty() || !m_numProducers;
+		});
+		if (m_queue.empty())
+			return false;
+		*item = m_queue.front();
+		m_queue.pop_front();
+		m_notFull.notify_one();
+		return true;
+	}
+	void producer_done(void) {
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_numProducers--;
+		m_notEmpty.notify_all();
+	}
+private:
+	size_t m_capacity;
+	uint32_t m_numProducers;
+	std::deque<T> m_queue;
+	std::mutex m_mutex;
+	std::condition_variable m_notFull;
+	std::condition_variable m_notEmpty;
+};
+
+/*
+ Pipelined batch compress of an image directory
+
+ 1. reader threads load source images with the image format readers
+ 2. encoder threads compress images to chunked memory streams; the library
+ thread pool supplies intra-image parallelism, and each image's compressor
+ runs at most threadsPerEncoder pool jobs at once, so the images in flight
+ split the pool between them
+ 3. writer threads write compressed streams to disk
+
+ Stages are connected by bounded queues, so at most a few images per stage
+ are held in memory. Busy time is accumulated per stage, to show which
+ stage limits throughput.
+ */
+class BatchCompressor {
+public:
+	BatchCompressor(CompressInitParams *initParams, uint8_t tcp_mct,
+			uint32_t rateControlAlgorithm, uint32_t threadsPerEncoder) :
+			m_initParams(initParams), m_tcp_mct(tcp_mct), m_rateControlAlgorithm(
+					rateControlAlgorithm), m_threadsPerEncoder(threadsPerEncoder), m_files(
+					nullptr), m_next(0), m_numCompressed(0), m_numFailed(0) {
+		auto params = &initParams->parameters;
+		m_stages[0] = { "read", params->batchReaders, 0 };
+		m_stages[1] = { "encode", params->batchEncoders, 0 };
+		m_stages[2] = { "write", params->batchWriters, 0 };
+	}
+	// returns number of images successfully compressed and written
+	uint32_t compress(const std::vector<std::string> &files) {
+		m_files = &files;
+		m_next = 0;
+		m_numCompressed = 0;
+		m_numFailed = 0;
+		for (auto &stage : m_stages)
+			stage.busy = 0;
+		auto numEncoders = m_stages[1].numThreads;
+		BatchQueue<Job*> encodeQueue(numEncoders, m_stages[0].numThreads);
+		BatchQueue<Job*> writeQueue(numEncoders, numEncoders);
+		m_encodeQueue = &encodeQueue;
+		m_writeQueue = &writeQueue;
+
+		auto start = std::chrono::high_resolution_clock::now();
+		std::vector<std::thread> threads;
+		for (uint32_t i = 0; i < m_stages[0].numThreads; ++i)
+			threads.emplace_back(&BatchCompressor::read_worker, this);
+		for (uint32_t i = 0; i < m_stages[1].numThreads; ++i)
+			threads.emplace_back(&BatchCompressor::encode_worker, this);
+		for (uint32_t i = 0; i < m_stages[2].numThreads; ++i)
+			threads.emplace_back(&BatchCompressor::write_worker, this);
+		for (auto &t : threads)
+			t.join();
+		std::chrono::duration<double> elapsed =
+				std::chrono::high_resolution_clock::now() - start;
+
+		if (m_numCompressed) {
+			spdlog::info("batch compress: {} images in {} s, {} images/s",
+					(uint32_t) m_numCompressed, elapsed.count(),
+					(double) m_numCompressed / elapsed.count());
+			for (auto &stage : m_stages) {
+				double busy = (double) stage.busy / 1e6;
+				spdlog::info(
+						"  {:6} stage: {} threads, busy {} s, utilization {}%",
+						stage.name, stage.numThreads, busy,
+						100.0 * busy / (elapsed.count() * stage.numThreads));
+			}
+		}
+		if (m_numFailed)
+			spdlog::error("batch compress: {} images failed",
+					(uint32_t) m_numFailed);
+
+		return m_numCompressed;
+	}
+
+private:
+	struct Job {
+		Job(const grk_cparameters *params) :
+				parameters(*params), image(nullptr), stream(nullptr) {
+		}
+		~Job() {
+			if (stream)
+				grk_stream_destroy(stream);
+			if (image)
+				grk_image_destroy(image);
+		}
+		// get_next_file and image readers modify the parameters,
+		// so each job owns a copy
+		grk_cparameters parameters;
+		grk_image *image;
+		grk_stream *stream;
+	};
+	struct Stage {
+		const char *name;
+		uint32_t numThreads;
+		std::atomic<uint64_t> busy; // microseconds
+		Stage& operator=(const Stage &rhs) {
+			name = rhs.name;
+			numThreads = rhs.numThreads;
+			busy = rhs.busy.load();
+			return *this;
+		}
+	};
+	class BusyTimer {
+	public:
+		BusyTimer(Stage *stage) :
+				m_stage(stage), m_start(
+						std::chrono::high_resolution_clock::now()) {
+		}
+		~BusyTimer() {
+			m_stage->busy += (uint64_t) std::chrono::duration_cast<
+					std::chrono::microseconds>(
+					std::chrono::high_resolution_clock::now() - m_start).count();
+		}
+	private:
+		Stage *m_stage;
+		std::chrono::time_point<std::chrono::high_resolution_clock> m_start;
+	};
+	void fail(Job *job) {
+		m_numFailed++;
+		if (job->parameters.outfile[0])
+			remove(actual_path(job->parameters.outfile));
+		delete job;
+	}
+	void read_worker(void) {
+		while (true) {
+			size_t index = m_next++;
+			if (index >= m_files->size())
+				break;
+			auto job = new Job(&m_initParams->parameters);
+			job->parameters.numThreads = m_threadsPerEncoder;
+			job->parameters.tcp_mct = m_tcp_mct;
+			job->parameters.rateControlAlgorithm = m_rateControlAlgorithm;
+			if (get_next_file((*m_files)[index], &m_initParams->img_fol,
+					m_initParams->out_fol.set_imgdir ?
+							&m_initParams->out_fol : &m_initParams->img_fol,
+					&job->parameters)) {
+				// not a supported image file
+				delete job;
+				continue;
+			}
+			{
+				BusyTimer timer(m_stages + 0);
+				job->image = load_image(&job->parameters,
+						job->parameters.infile);
+			}
+			if (!job->image || !prepare_compress(&job->parameters, job->image)) {
+				fail(job);
+				continue;
+			}
+			m_encodeQueue->push(job);
+		}
+		m_encodeQueue->producer_done();
+	}
+	void encode_worker(void) {
+		Job *job = nullptr;
+		while (m_encodeQueue->pop(&job)) {
+			bool rc = false;
+			{
+				BusyTimer timer(m_stages + 1);
+				job->stream = grk_stream_create_chunked_mem_stream(0);
+				if (job->stream)
+					rc = compress_image(&job->parameters, job->image,
+							job->stream, nullptr);
+				// release source image before queueing for write
+				grk_image_destroy(job->image);
+				job->image = nullptr;
+			}
+			if (!rc) {
+				fail(job);
+				continue;
+			}
+			m_writeQueue->push(job);
+		}
+		m_writeQueue->producer_done();
+	}
+	void write_worker(void) {
+		Job *job = nullptr;
+		while (m_writeQueue->pop(&job)) {
+			bool rc = false;
+			{
+				BusyTimer timer(m_stages + 2);
+				rc = write_chunked_stream(job->stream, job->parameters.outfile);
+			}
+			if (!rc) {
+				fail(job);
+				continue;
+			}
+			m_numCompressed++;
+			delete job;
+		}
+	}
+
+	CompressInitParams *m_initParams;
+	uint8_t m_tcp_mct;
+	uint32_t m_rateControlAlgorithm;
+	uint32_t m_threadsPerEncoder;
+	const std::vector<std::string> *m_files;
+	std::atomic<size_t> m_next;
+	BatchQueue<Job*> *m_encodeQueue;
+	BatchQueue<Job*> *m_writeQueue;
+	Stage m_stages[3];
+	std::atomic<uint32_t> m_numCompressed;
+	std::atomic<uint32_t> m_numFailed;
+};
+
+/*
+ Thread budget of pipelined batch compress: -num_threads, or the number
+ of hardware threads
+ */
+static uint32_t batch_num_threads(const grk_cparameters *parameters) {
+	uint32_t numThreads =
+			parameters->numThreads ?
+					parameters->numThreads : std::thread::hardware_concurrency();
+
+	return numThreads ? numThreads : 1;
+}
+
+/*
+ Number of images encoded concurrently by pipelined batch compress:
+ the encoder count of -BatchPipeline, capped at the thread budget.
+ Reader and writer threads are I/O bound and are not counted.
+ */
+static uint32_t batch_num_encoders(const grk_cparameters *parameters) {
+	return std::min<uint32_t>(parameters->batchEncoders,
+			batch_num_threads(parameters));
+}
+
+/*
+ Per image thread budget of pipelined batch compress: the library thread
+ pool keeps all -num_threads threads, and each image's compressor is
+ limited to an equal share of them.
+ */
+static uint32_t batch_threads_per_encoder(const grk_cparameters *parameters) {
+	return std::max<uint32_t>(1,
+			batch_num_threads(parameters) / batch_num_encoders(parameters));
+}
+
+static uint32_t batch_compress(CompressInitParams *initParams,
+		const std::vector<std::string> &files, uint8_t tcp_mct,
+		uint32_t rateControlAlgorithm) {
+	BatchCompressor compressor(initParams, tcp_mct, rateControlAlgorithm,
+			batch_threads_per_encoder(&initParams->parameters));
+
+	return compressor.compress(files);
+}
 
 static int plugin_main(int argc, char **argv, CompressInitParams *initParams) {
 	if (!initParams)
@@ -2243,6 +2766,7 @@ static int plugin_main(int argc, char **argv, CompressInitParams *initParams) {
 	uint32_t num_images, imageno;
 	bool isBatch = false;
 	uint32_t state= 0;
+	uint32_t numPoolThreads = 0;
 
 	/* set encoding parameters to default values */
 	grk_set_default_compress_params(&initParams->parameters);
@@ -2269,9 +2793,17 @@ static int plugin_main(int argc, char **argv, CompressInitParams *initParams) {
 
 	initParams->initialized = true;
 
+	numPoolThreads = initParams->parameters.numThreads;
+	if (initParams->img_fol.set_imgdir && initParams->parameters.batchEncoders) {
+		initParams->parameters.batchEncoders = batch_num_encoders(
+				&initParams->parameters);
+		spdlog::info("batch compress: {} images in flight, {} threads per image",
+				initParams->parameters.batchEncoders,
+				batch_threads_per_encoder(&initParams->parameters));
+	}
+
 	// loads plugin but does not actually create codec
-	if (!grk_initialize(initParams->plugin_path,
-			initParams->parameters.numThreads)) {
+	if (!grk_initialize(initParams->plugin_path, numPoolThreads)) {
 		success = 1;
 		goto cleanup;
 	}
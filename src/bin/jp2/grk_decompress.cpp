@@ -100,6 +100,12 @@ using namespace grk;
 #define TCLAP_NAMESTARTSTRING "-"
 #include "tclap/CmdLine.h"
 #include <chrono>  // for high_resolution_clock
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <atomic>
+#include <vector>
 
 using namespace TCLAP;
 
@@ -206,6 +212,10 @@ static void decode_help_display(void) {
 			"    Path to T1 plugin.\n");
 	fprintf(stdout, "  [-H | -num_threads] <number of threads>\n"
 			"    Number of threads used by T1 decompress.\n");
+	fprintf(stdout, "  [-J | -BatchJobs] <number of images>\n"
+			"    Number of images decompressed concurrently when -ImgDir is used,\n"
+			"    at most the number of threads. The -num_threads threads are split\n"
+			"    evenly between the images in flight.\n");
 	fprintf(stdout,	"  [-c|-Compression] <compression method>\n"
 					"    Compress output image data. Currently, this option is only applicable when output "
 					"    format is set to TIF. Possible values are \n"
@@ -227,7 +237,18 @@ static void decode_help_display(void) {
 					"  [-l | -Layer] <number of quality layers to decompress>\n"
 					"    Set the maximum number of quality layers to decompress. If there are\n"
 					"    fewer quality layers than the specified number, all the quality layers\n"
-					"    are decoded.\n");
+					"    are decoded.\n"
+					"  [-b | -MaxBytes] <number of bytes>\n"
+					"    Decompress the image from at most this many bytes of packet data.\n"
+					"    Each tile gets a share of the budget in proportion to its compressed\n"
+					"    size, and its packets are decoded in progression order until the\n"
+					"    first packet that does not fit in its share.\n"
+					"  [-T | -MaxTileBytes] <number of bytes>\n"
+					"    Decompress each tile from at most this many bytes of packet data.\n"
+					"  [-P | -fast-preview]\n"
+					"    Run the inverse 9/7 wavelet transform of components of 8 bits\n"
+					"    precision or less in 16 bit fixed point: faster, but slightly less\n"
+					"    accurate. Only applies when whole tiles are decompressed.\n");
 	fprintf(stdout,
 			"  [-p | -Precision] <comp 0 precision>[C|S][,<comp 1 precision>[C|S][,...]]\n"
 					"    OPTIONAL\n"
@@ -488,6 +509,9 @@ int parse_cmdline_decoder(int argc, char **argv,
 				"", "string", cmd);
 		ValueArg<uint32_t> numThreadsArg("H", "num_threads",
 				"Number of threads", false, 0, "unsigned integer", cmd);
+		ValueArg<uint32_t> batchJobsArg("J", "BatchJobs",
+				"Number of images decompressed concurrently", false, 0,
+				"unsigned integer", cmd);
 		ValueArg<string> inputFileArg("i", "InputFile", "Input file", false, "",
 				"string", cmd);
 		ValueArg<string> outputFileArg("o", "OutputFile", "Output file", false,
@@ -496,6 +520,11 @@ int parse_cmdline_decoder(int argc, char **argv,
 				0, "unsigned integer", cmd);
 		ValueArg<uint32_t> layerArg("l", "Layer", "Layer", false, 0,
 				"unsigned integer", cmd);
+		ValueArg<uint64_t> maxBytesArg("b", "MaxBytes", "Maximum bytes", false,
+				0, "unsigned integer", cmd);
+		ValueArg<uint64_t> maxTileBytesArg("T", "MaxTileBytes",
+				"Maximum bytes per tile", false, 0, "unsigned integer", cmd);
+		SwitchArg fastPreviewArg("P", "fast-preview", "Fast preview", cmd);
 		ValueArg<uint32_t> tileArg("t", "TileIndex", "Input tile index", false,
 				0, "unsigned integer", cmd);
 		ValueArg<string> precisionArg("p", "Precision", "Force precision",
@@ -704,6 +733,15 @@ int parse_cmdline_decoder(int argc, char **argv,
 		if (layerArg.isSet()) {
 			parameters->core.cp_layer = layerArg.getValue();
 		}
+		if (maxBytesArg.isSet()) {
+			parameters->core.cp_max_bytes = maxBytesArg.getValue();
+		}
+		if (maxTileBytesArg.isSet()) {
+			parameters->core.cp_max_tile_bytes = maxTileBytesArg.getValue();
+		}
+		if (fastPreviewArg.isSet()) {
+			parameters->core.cp_fast_preview = true;
+		}
 		if (tileArg.isSet()) {
 			parameters->tile_index = (uint16_t) tileArg.getValue();
 			parameters->nb_tile_to_decode = 1;
@@ -715,6 +753,9 @@ int parse_cmdline_decoder(int argc, char **argv,
 		if (numThreadsArg.isSet()) {
 			parameters->numThreads = numThreadsArg.getValue();
 		}
+		if (batchJobsArg.isSet()) {
+			parameters->numBatchJobs = batchJobsArg.getValue();
+		}
 
 		if (decodeRegionArg.isSet()) {
 			size_t size_optarg = (size_t) strlen(
@@ -788,6 +829,8 @@ int parse_cmdline_decoder(int argc, char **argv,
 			return 1;
 		}
 	} else {
+		if (parameters->numBatchJobs > 1)
+			spdlog::warn("option -BatchJobs is ignored when -ImgDir is not used.");
 		if (parameters->decod_format == GRK_UNK_FMT) {
 			if ((parameters->infile[0] == 0) || (parameters->outfile[0] == 0)) {
 				spdlog::error("Required parameters are missing\n"
@@ -1144,6 +1187,167 @@ int decompress(const char *fileName, DecompressInitParams *initParams) {
 	return 1;
 }
 
+/*
+ Batch decompress of an image directory
+
+ Up to numJobs images are decompressed concurrently, each one on its own
+ worker thread, while the library thread pool supplies the intra-image
+ parallelism (T1, DWT, MCT). Each image's decompressor runs at most
+ threadsPerJob pool jobs at once, so the images in flight split the pool
+ between them instead of competing for all of it. Decompressed images are
+ queued for a set of writer threads, so colour conversion and encoding of
+ the output files overlap with decompression of the following images.
+ Workers block when the write queue is full, which bounds the number of
+ decompressed images held in memory.
+ */
+class BatchDecompressor {
+public:
+	BatchDecompressor(DecompressInitParams *initParams, uint32_t numJobs,
+			uint32_t threadsPerJob) :
+			m_initParams(initParams), m_numJobs(numJobs ? numJobs : 1), m_threadsPerJob(
+					threadsPerJob), m_next(0), m_numDecoding(0), m_numDecompressed(
+					0), m_numFailed(0) {
+	}
+	// returns number of images successfully decompressed and written
+	uint32_t decompress(const std::vector<std::string> &files) {
+		m_files = &files;
+		m_next = 0;
+		m_numDecoding = (uint32_t) std::min<size_t>(m_numJobs, files.size());
+		m_numDecompressed = 0;
+		m_numFailed = 0;
+		uint32_t numWriters = std::max<uint32_t>(1, m_numDecoding / 2);
+		std::vector<std::thread> threads;
+		for (uint32_t i = 0; i < m_numDecoding; ++i)
+			threads.emplace_back(&BatchDecompressor::decode_worker, this);
+		for (uint32_t i = 0; i < numWriters; ++i)
+			threads.emplace_back(&BatchDecompressor::write_worker, this);
+		for (auto &t : threads)
+			t.join();
+
+		return m_numDecompressed;
+	}
+	uint32_t num_failed(void) const {
+		return m_numFailed;
+	}
+private:
+	struct Job {
+		Job(const grk_decompress_parameters *params) :
+				parameters(*params) {
+			memset(&info, 0, sizeof(grk_plugin_decode_callback_info));
+			info.decod_format = GRK_UNK_FMT;
+			info.cod_format = GRK_UNK_FMT;
+			info.decode_flags = GRK_DECODE_ALL;
+			info.decoder_parameters = &parameters;
+		}
+		~Job() {
+			grk_image_destroy(info.image);
+		}
+		// get_next_file modifies the file names and formats,
+		// so each job owns a copy of the parameters
+		grk_decompress_parameters parameters;
+		grk_plugin_decode_callback_info info;
+	};
+	void decode_worker(void) {
+		while (true) {
+			size_t index = m_next++;
+			if (index >= m_files->size())
+				break;
+			auto job = new Job(&m_initParams->parameters);
+			job->parameters.core.numThreads = m_threadsPerJob;
+			if (get_next_file((*m_files)[index], &m_initParams->img_fol,
+					m_initParams->out_fol.set_imgdir ?
+							&m_initParams->out_fol : &m_initParams->img_fol,
+					&job->parameters)) {
+				// not a JPEG 2000 file
+				delete job;
+				continue;
+			}
+			if (pre_decode(&job->info)) {
+				m_numFailed++;
+				delete job;
+				continue;
+			}
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_notFull.wait(lock, [this] {
+				return m_queue.size() < m_numJobs;
+			});
+			m_queue.push_back(job);
+			m_notEmpty.notify_one();
+		}
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_numDecoding--;
+		m_notEmpty.notify_all();
+	}
+	void write_worker(void) {
+		while (true) {
+			Job *job = nullptr;
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				m_notEmpty.wait(lock, [this] {
+					return !m_queue.empty() || !m_numDecoding;
+				});
+				if (m_queue.empty())
+					break;
+				job = m_queue.front();
+				m_queue.pop_front();
+				m_notFull.notify_one();
+			}
+			if (post_decode(&job->info))
+				m_numFailed++;
+			else
+				m_numDecompressed++;
+			delete job;
+		}
+	}
+
+	DecompressInitParams *m_initParams;
+	uint32_t m_numJobs;
+	uint32_t m_threadsPerJob;
+	const std::vector<std::string> *m_files;
+	std::atomic<size_t> m_next;
+
+	std::mutex m_mutex;
+	std::condition_variable m_notFull;
+	std::condition_variable m_notEmpty;
+	std::deque<Job*> m_queue;
+	uint32_t m_numDecoding;
+
+	std::atomic<uint32_t> m_numDecompressed;
+	std::atomic<uint32_t> m_numFailed;
+};
+
+/*
+ Thread budget of batch mode: -num_threads, or the number of hardware threads
+ */
+static uint32_t batch_num_threads(const grk_decompress_parameters *parameters) {
+	uint32_t numThreads =
+			parameters->numThreads ?
+					parameters->numThreads : std::thread::hardware_concurrency();
+
+	return numThreads ? numThreads : 1;
+}
+
+/*
+ Number of images decompressed concurrently in batch mode: -BatchJobs,
+ capped at the thread budget.
+ */
+static uint32_t batch_num_jobs(const grk_decompress_parameters *parameters) {
+	return std::min<uint32_t>(
+			parameters->numBatchJobs ? parameters->numBatchJobs : 1,
+			batch_num_threads(parameters));
+}
+
+/*
+ Per image thread budget in batch mode: the library thread pool keeps all
+ -num_threads threads, and each image's decompressor is limited to an
+ equal share of them.
+ */
+static uint32_t batch_threads_per_job(
+		const grk_decompress_parameters *parameters) {
+	return std::max<uint32_t>(1,
+			batch_num_threads(parameters) / batch_num_jobs(parameters));
+}
+
 int main(int argc, char **argv) {
 	int rc = EXIT_SUCCESS;
 	uint32_t num_decompressed_images = 0;
@@ -1180,15 +1384,29 @@ int main(int argc, char **argv) {
 					rc = EXIT_FAILURE;
 					goto cleanup;
 				}
+				bool batch = initParams.parameters.numBatchJobs > 1;
+				std::vector<std::string> files;
 				struct dirent *content = nullptr;
 				while ((content = readdir(dir)) != nullptr) {
 					if (strcmp(".", content->d_name) == 0
 							|| strcmp("..", content->d_name) == 0)
 						continue;
-					if (decompress(content->d_name, &initParams) == 1)
+					if (batch)
+						files.push_back(content->d_name);
+					else if (decompress(content->d_name, &initParams) == 1)
 						num_decompressed_images++;
 				}
 				closedir(dir);
+				if (batch) {
+					BatchDecompressor batchDecompressor(&initParams,
+							batch_num_jobs(&initParams.parameters),
+							batch_threads_per_job(&initParams.parameters));
+					num_decompressed_images += batchDecompressor.decompress(
+							files);
+					if (batchDecompressor.num_failed())
+						spdlog::error("batch decompress: {} images failed",
+								batchDecompressor.num_failed());
+				}
 			}
 		}
 		auto finish = std::chrono::high_resolution_clock::now();
@@ -1197,6 +1415,10 @@ int main(int argc, char **argv) {
 			spdlog::info("decompress time: {} ms",
 					(elapsed.count() * 1000)
 							/ (double) num_decompressed_images);
+			if (initParams.img_fol.set_imgdir)
+				spdlog::info("decompressed {} images at {} images/s",
+						num_decompressed_images,
+						(double) num_decompressed_images / elapsed.count());
 		}
 	} catch (std::bad_alloc &ba) {
 		spdlog::error("Out of memory. Exiting.");
@@ -1213,6 +1435,7 @@ int plugin_main(int argc, char **argv, DecompressInitParams *initParams) {
 	grk_dircnt *dirptr = nullptr;
 	int32_t success = 0;
 	uint32_t num_decompressed_images = 0;
+	uint32_t numPoolThreads = 0;
 	bool isBatch = false;
 	std::chrono::time_point<std::chrono::high_resolution_clock> start, finish;
 	std::chrono::duration<double> elapsed;
@@ -1242,9 +1465,15 @@ int plugin_main(int argc, char **argv, DecompressInitParams *initParams) {
 #endif
 	initParams->initialized = true;
 
+	numPoolThreads = initParams->parameters.numThreads;
+	if (initParams->img_fol.set_imgdir
+			&& initParams->parameters.numBatchJobs > 1)
+		spdlog::info("batch decompress: {} images in flight, {} threads per image",
+				batch_num_jobs(&initParams->parameters),
+				batch_threads_per_job(&initParams->parameters));
+
 	// loads plugin but does not actually create codec
-	if (!grk_initialize(initParams->plugin_path,
-			initParams->parameters.numThreads)) {
+	if (!grk_initialize(initParams->plugin_path, numPoolThreads)) {
 		success = 1;
 		goto cleanup;
 	}
@@ -205,7 +205,7 @@ private:
     /**
      * Prevent accidental copying
      */
-    MultiArg<T>(const MultiArg<T> &rhs);
+    MultiArg(const MultiArg<T> &rhs);
     MultiArg<T> &operator=(const MultiArg<T> &rhs);
 };
 
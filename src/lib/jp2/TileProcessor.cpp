@@ -71,7 +71,7 @@ TileProcessor::TileProcessor(bool isDecoder) :
 				false), m_nb_tile_parts_correction(false), tile_part_data_length(0),
 				cur_totnum_tp(0), cur_pino(0), tile(nullptr), image(
 				nullptr), current_plugin_tile(nullptr), whole_tile_decoding(
-				true), m_marker_scratch(nullptr), m_marker_scratch_size(0), plt_markers(
+				true), m_transcode(false), m_packets(nullptr), m_max_bytes(UINT64_MAX), m_marker_scratch(nullptr), m_marker_scratch_size(0), plt_markers(
 				nullptr), m_cp(nullptr), m_tcp(nullptr), m_tileno(0) {
 	if (isDecoder) {
 		m_marker_scratch = (uint8_t*) grk_calloc(1, default_header_size);
@@ -955,14 +955,15 @@ bool TileProcessor::compress_tile_part(uint16_t tile_no, BufferedStream *stream,
 		bool debugEncode = state & GRK_PLUGIN_STATE_DEBUG;
 		bool debugMCT = (state & GRK_PLUGIN_STATE_MCT_ONLY) ? true : false;
 
-		if (!current_plugin_tile || debugEncode) {
-			if (!debugEncode) {
+		// when rewriting packets, there is nothing to code
+		if ((!current_plugin_tile || debugEncode) && !m_packets) {
+			if (!debugEncode && !m_transcode) {
 				if (!dc_level_shift_encode())
 					return false;
 				if (!mct_encode())
 					return false;
 			}
-			if (!debugEncode || debugMCT) {
+			if ((!debugEncode || debugMCT) && !m_transcode) {
 				if (!dwt_encode())
 					return false;
 			}
@@ -972,13 +973,21 @@ bool TileProcessor::compress_tile_part(uint16_t tile_no, BufferedStream *stream,
 		// 1. create PLT marker if required
 		delete plt_markers;
 		if (m_cp->m_coding_params.m_enc.writePLT){
-			if (!needs_rate_control())
+			if (m_packets || !needs_rate_control())
 				plt_markers = new PacketLengthMarkers(stream);
 			else
 				GROK_WARN("PLT marker generation disabled due to rate control.");
 		}
 		// 2. rate control
-		if (!rate_allocate(p_cstr_info))
+		if (m_packets) {
+			if (plt_markers) {
+				auto t2 = new T2(this);
+				bool rc = t2->rewrite_packets_simulate(m_tileno, plt_markers);
+				delete t2;
+				if (!rc)
+					return false;
+			}
+		} else if (!rate_allocate(p_cstr_info))
 			return false;
 		m_packetTracker.clear();
 	}
@@ -1082,10 +1091,12 @@ bool TileProcessor::decompress_tile(ChunkBuffer *src_buf, uint16_t tile_no) {
 
 	bool doT2 = !current_plugin_tile
 			|| (current_plugin_tile->decode_flags & GRK_DECODE_T2);
-	bool doT1 = !current_plugin_tile
-			|| (current_plugin_tile->decode_flags & GRK_DECODE_T1);
-	bool doPostT1 = !current_plugin_tile
-			|| (current_plugin_tile->decode_flags & GRK_DECODE_POST_T1);
+	bool doT1 = (!current_plugin_tile
+			|| (current_plugin_tile->decode_flags & GRK_DECODE_T1))
+			&& !m_packets;
+	bool doPostT1 = (!current_plugin_tile
+			|| (current_plugin_tile->decode_flags & GRK_DECODE_POST_T1))
+			&& !m_transcode && !m_packets;
 
 	if (doT2) {
 		uint64_t l_data_read = 0;
@@ -1096,6 +1107,10 @@ bool TileProcessor::decompress_tile(ChunkBuffer *src_buf, uint16_t tile_no) {
 		decode_synch_plugin_with_host(this);
 	}
 
+	// the inverse wavelet transform of the first three components is deferred
+	// until all of them are decoded, and then fused with the inverse MCT
+	// and DC level shift
+	bool fuse_dwt = doT1 && doPostT1 && is_mct_fused_with_dwt();
 	if (doT1) {
 		for (uint32_t compno = 0; compno < tile->numcomps; ++compno) {
 			auto tilec = tile->comps + compno;
@@ -1119,6 +1134,8 @@ bool TileProcessor::decompress_tile(ChunkBuffer *src_buf, uint16_t tile_no) {
 					(uint16_t) m_tcp->tccps->cblkh, &blocks))
 				return false;
 
+			if (fuse_dwt && compno < 3)
+				continue;
 			if (doPostT1)
 				if (!Wavelet::decompress(this, tilec,
 						img_comp->resno_decoded + 1, tccp->qmfbid))
@@ -1128,15 +1145,38 @@ bool TileProcessor::decompress_tile(ChunkBuffer *src_buf, uint16_t tile_no) {
 		}
 	}
 
-	if (doPostT1) {
-		if (!mct_decode())
-			return false;
-		if (!dc_level_shift_decode())
+	if (fuse_dwt) {
+		DcShiftParams params[3];
+		for (uint32_t compno = 0; compno < 3; ++compno)
+			params[compno] = dc_shift_params(compno);
+		if (!Wavelet::decompress_mct(tile->comps,
+				image->comps->resno_decoded + 1, m_tcp->tccps->qmfbid, params))
 			return false;
+		for (uint32_t compno = 0; compno < 3; ++compno)
+			tile->comps[compno].release_mem();
+
+		return dc_level_shift_decode(3);
 	}
+	if (doPostT1)
+		return mct_dc_level_shift_decode();
+
 	return true;
 }
 
+bool TileProcessor::reconstruct_tile(uint16_t tile_no) {
+	m_tcp = m_cp->tcps + tile_no;
+	for (uint32_t compno = 0; compno < tile->numcomps; ++compno) {
+		auto tilec = tile->comps + compno;
+		auto img_comp = image->comps + compno;
+		img_comp->resno_decoded = tilec->minimum_num_resolutions - 1;
+		if (!Wavelet::decompress(this, tilec, img_comp->resno_decoded + 1,
+				m_tcp->tccps[compno].qmfbid))
+			return false;
+	}
+
+	return mct_dc_level_shift_decode();
+}
+
 /*
  For each component, copy decoded resolutions from the tile data buffer
  into tile_compositing_buff.
@@ -1222,6 +1262,23 @@ void TileProcessor::copy_image_to_tile() {
 	}
 }
 
+void TileProcessor::copy_strip_to_tile(int32_t **strip, uint32_t strip_y0,
+		uint32_t strip_width) {
+	for (uint32_t i = 0; i < image->numcomps; ++i) {
+		auto tilec = tile->comps + i;
+		uint32_t width = tilec->width();
+		uint32_t height = tilec->height();
+		auto src_ptr = strip[i] + (uint64_t) (tilec->y0 - strip_y0) * strip_width
+				+ (tilec->x0 - image->x0);
+		auto dest_ptr = tilec->buf->data;
+
+		for (uint32_t j = 0; j < height; ++j) {
+			memcpy(dest_ptr, src_ptr, width * sizeof(int32_t));
+			src_ptr += strip_width;
+			dest_ptr += width;
+		}
+	}
+}
 
 bool TileProcessor::read_marker(BufferedStream *stream, uint16_t *val){
 	if (stream->read(m_marker_scratch, 2) != 2) {
@@ -1318,17 +1375,95 @@ bool TileProcessor::mct_decode() {
 	return true;
 }
 
-bool TileProcessor::dc_level_shift_decode() {
-	uint32_t compno = 0;
-	for (compno = 0; compno < tile->numcomps; compno++) {
-		int32_t min = INT32_MAX, max = INT32_MIN;
+DcShiftParams TileProcessor::dc_shift_params(uint32_t compno) {
+	auto img_comp = image->comps + compno;
+	DcShiftParams params;
+
+	params.shift = m_tcp->tccps[compno].m_dc_level_shift;
+	if (img_comp->sgnd) {
+		params.min = -(1 << (img_comp->prec - 1));
+		params.max = (1 << (img_comp->prec - 1)) - 1;
+	} else {
+		params.min = 0;
+		params.max = (1 << img_comp->prec) - 1;
+	}
+
+	return params;
+}
+
+bool TileProcessor::is_mct_fused(void) {
+	if (m_tcp->mct != 1 || tile->numcomps < 3)
+		return false;
+	auto area = tile->comps->buf->reduced_region_dim.area();
+	for (uint32_t compno = 1; compno < 3; ++compno) {
+		if (tile->comps[compno].buf->reduced_region_dim.area() != area
+				|| m_tcp->tccps[compno].qmfbid != m_tcp->tccps->qmfbid)
+			return false;
+	}
+
+	return m_tcp->tccps->qmfbid <= 1;
+}
+
+bool TileProcessor::is_mct_fused_with_dwt(void) {
+	if (!is_mct_fused())
+		return false;
+	auto tilec = tile->comps;
+	uint32_t numres = image->comps->resno_decoded + 1;
+	if (!Wavelet::decompress_by_lines(this, tilec, numres, 3))
+		return false;
+	for (uint32_t compno = 0; compno < 3; ++compno) {
+		if (m_tcp->tccps->qmfbid == 0
+				&& Wavelet::decompress_fixed_97(this, tile->comps + compno))
+			return false;
+	}
+	for (uint32_t compno = 1; compno < 3; ++compno) {
+		auto comp = tile->comps + compno;
+		if (comp->x0 != tilec->x0 || comp->y0 != tilec->y0
+				|| comp->x1 != tilec->x1 || comp->y1 != tilec->y1
+				|| comp->numresolutions != tilec->numresolutions
+				|| comp->minimum_num_resolutions
+						!= tilec->minimum_num_resolutions
+				|| image->comps[compno].resno_decoded + 1 != numres)
+			return false;
+	}
+
+	return true;
+}
+
+bool TileProcessor::mct_dc_level_shift_decode() {
+	if (!is_mct_fused()) {
+		if (!mct_decode())
+			return false;
+
+		return dc_level_shift_decode();
+	}
+	DcShiftParams params[3];
+	for (uint32_t compno = 0; compno < 3; ++compno)
+		params[compno] = dc_shift_params(compno);
+	uint64_t samples = tile->comps->buf->reduced_region_dim.area();
+	if (m_tcp->tccps->qmfbid == 1) {
+		mct::decode_rev_shift(tile->comps[0].buf->get_ptr(0, 0, 0, 0),
+				tile->comps[1].buf->get_ptr(0, 0, 0, 0),
+				tile->comps[2].buf->get_ptr(0, 0, 0, 0), samples, params);
+	} else {
+		mct::decode_irrev_shift(
+				(float*) tile->comps[0].buf->get_ptr(0, 0, 0, 0),
+				(float*) tile->comps[1].buf->get_ptr(0, 0, 0, 0),
+				(float*) tile->comps[2].buf->get_ptr(0, 0, 0, 0), samples,
+				params);
+	}
+
+	return dc_level_shift_decode(3);
+}
+
+bool TileProcessor::dc_level_shift_decode(uint32_t first_compno) {
+	for (uint32_t compno = first_compno; compno < tile->numcomps; compno++) {
 		uint32_t x0;
 		uint32_t y0;
 		uint32_t x1;
 		uint32_t y1;
 		auto tile_comp = tile->comps + compno;
 		auto tccp = m_tcp->tccps + compno;
-		auto img_comp = image->comps + compno;
 		uint32_t stride = 0;
 		auto current_ptr = tile_comp->buf->get_ptr(0, 0, 0, 0);
 
@@ -1340,13 +1475,8 @@ bool TileProcessor::dc_level_shift_decode() {
 		assert(x1 >= x0);
 		assert(tile_comp->width() >= (x1 - x0));
 
-		if (img_comp->sgnd) {
-			min = -(1 << (img_comp->prec - 1));
-			max = (1 << (img_comp->prec - 1)) - 1;
-		} else {
-			min = 0;
-			max = (1 << img_comp->prec) - 1;
-		}
+		auto params = dc_shift_params(compno);
+		int32_t min = params.min, max = params.max;
 
 		if (tccp->qmfbid == 1) {
 			for (uint32_t j = y0; j < y1; ++j) {
@@ -1495,10 +1625,18 @@ bool TileProcessor::t1_encode() {
 		mct_norms = (const double*) (tcp->mct_norms);
 	}
 
+	// with early termination, T1 does not code passes
+	// that can not fit into the final layer
+	auto enc_params = &m_cp->m_coding_params.m_enc;
+	double maxBytes = 0;
+	if (enc_params->earlyTermination && !enc_params->m_fixed_quality
+			&& layer_needs_rate_control(tcp->numlayers - 1))
+		maxBytes = tcp->rates[tcp->numlayers - 1];
+
 	auto t1_wrap = std::unique_ptr<Tier1>(new Tier1());
 
 	return t1_wrap->encodeCodeblocks(tcp, tile, mct_norms, mct_numcomps,
-			needs_rate_control());
+			needs_rate_control(), maxBytes);
 }
 
 bool TileProcessor::t2_encode(BufferedStream *stream, uint32_t *all_packet_bytes_written,
@@ -292,6 +292,7 @@ struct grk_tcd_resolution {
 };
 
 struct TileComponent;
+struct TilePackets;
 
 // tile
 struct grk_tcd_tile {
@@ -392,6 +393,15 @@ struct TileProcessor {
 	 */
 	bool decompress_tile(ChunkBuffer *src_buf, uint16_t tileno);
 
+	/**
+	 Reconstruct a tile from the code block coefficients stored in its
+	 tile components: inverse DWT of all resolutions, followed by
+	 inverse MCT and DC level shift
+	 @param tileno Number that identifies the tile
+	 @return true if successful
+	 */
+	bool reconstruct_tile(uint16_t tileno);
+
 	/**
 	 * Copies tile data from the system onto the given memory block.
 	 */
@@ -414,6 +424,13 @@ struct TileProcessor {
 
 	void copy_image_to_tile();
 
+	/**
+	 * Copies tile data from strip buffers, one per component.
+	 * Strip rows begin at canvas row strip_y0 and image column x0.
+	 */
+	void copy_strip_to_tile(int32_t **strip, uint32_t strip_y0,
+			uint32_t strip_width);
+
 	bool read_marker(BufferedStream *stream, uint16_t *val);
 
 	/** index of the tile to decompress (used in get_tile);
@@ -454,6 +471,19 @@ struct TileProcessor {
     /** Only valid for decoding. Whether the whole tile is decoded, or just the region in win_x0/win_y0/win_x1/win_y1 */
     bool   whole_tile_decoding;
 
+	/** Transcoding: decompression stops after T1, leaving wavelet coefficients
+	 *  in the tile buffer, and compression starts at T1 from these coefficients */
+	bool m_transcode;
+
+	/** Packet rewriting: decompression stops after T2, which copies the
+	 *  selected packets, and compression writes these packets unchanged.
+	 *  Not owned by the tile processor */
+	TilePackets *m_packets;
+
+	/** Byte budget: maximum number of bytes of packets that T2 decodes
+	 *  in the current tile, or UINT64_MAX if there is no limit */
+	uint64_t m_max_bytes;
+
 	uint8_t *m_marker_scratch;
 	uint16_t m_marker_scratch_size;
 
@@ -477,7 +507,20 @@ private:
 
 	 bool mct_decode();
 
-	 bool dc_level_shift_decode();
+	 /* DC level shift and clamp of component compno */
+	 DcShiftParams dc_shift_params(uint32_t compno);
+
+	 /* true if the inverse MCT of the first three components
+	  * can be fused with their DC level shift */
+	 bool is_mct_fused(void);
+
+	 /* true if, in addition, the fused MCT and DC level shift can be applied
+	  * to the rows of the line-based inverse wavelet transform */
+	 bool is_mct_fused_with_dwt(void);
+
+	 bool mct_dc_level_shift_decode();
+
+	 bool dc_level_shift_decode(uint32_t first_compno = 0);
 
 	 bool dc_level_shift_encode();
 
@@ -265,17 +265,6 @@ static bool j2k_read_unk(CodeStream *codeStream, BufferedStream *stream,
 static bool j2k_check_poc_val(const  grk_poc  *p_pocs, uint32_t nb_pocs,
 		uint32_t nb_resolutions, uint32_t numcomps, uint32_t numlayers);
 
-/**
- * Gets the number of tile parts used for the given change of progression (if any) and the given tile.
- *
- * @param               cp                      the coding parameters.
- * @param               pino            the offset of the given poc (i.e. its position in the coding parameter).
- * @param               tileno          the given tile.
- *
- * @return              the number of tile parts.
- */
-static uint8_t j2k_get_num_tp(CodingParams *cp, uint32_t pino, uint16_t tileno);
-
 /**
  * Calculates the total number of tile parts needed by the encoder to
  * compress such an image. If not enough memory is available, then the function return false.
@@ -393,6 +382,12 @@ void j2k_destroy(CodeStream *codeStream) {
 	delete codeStream->m_specific_param.m_decoder.m_default_tcp;
 	codeStream->m_specific_param.m_decoder.m_default_tcp = nullptr;
 
+	delete codeStream->m_strip_compressor;
+	codeStream->m_strip_compressor = nullptr;
+
+	delete codeStream->m_incremental_decompressor;
+	codeStream->m_incremental_decompressor = nullptr;
+
 	delete codeStream->m_tileProcessor;
 	codeStream->m_cp.destroy();
 	memset(&(codeStream->m_cp), 0, sizeof(CodingParams));
@@ -564,6 +559,8 @@ static bool j2k_read_header_procedure(CodeStream *codeStream,
 	/* Position of the last element if the main header */
 	if (codeStream->cstr_index)
 		codeStream->cstr_index->main_head_end = (uint32_t) stream->tell() - 2;
+	codeStream->m_specific_param.m_decoder.m_tile_data_len =
+			stream->get_number_byte_left();
 	/* Next step: read a tile-part header */
 	codeStream->m_specific_param.m_decoder.m_state = J2K_DEC_STATE_TPH_SOT;
 
@@ -695,6 +692,11 @@ void j2k_init_decompressor(void *j2k_void, grk_dparameters *parameters) {
 	if (j2k && parameters) {
 		j2k->m_cp.m_coding_params.m_dec.m_layer = parameters->cp_layer;
 		j2k->m_cp.m_coding_params.m_dec.m_reduce = parameters->cp_reduce;
+		j2k->m_cp.m_coding_params.m_dec.m_max_bytes = parameters->cp_max_bytes;
+		j2k->m_cp.m_coding_params.m_dec.m_max_tile_bytes =
+				parameters->cp_max_tile_bytes;
+		j2k->m_cp.m_coding_params.m_dec.m_fast_preview =
+				parameters->cp_fast_preview;
 	}
 }
 
@@ -815,6 +817,79 @@ static bool j2k_need_nb_tile_parts_correction(CodeStream *codeStream,
 	return stream->seek(stream_pos_backup);
 }
 
+/*
+ QCD marker quantization step size sanity check, for current tile
+ see page 553 of Taubman and Marcellin for more details on this check
+ */
+static bool j2k_check_quantization_step_sizes(CodeStream *codeStream) {
+	auto tcp = codeStream->get_current_decode_tcp();
+	if (tcp->main_qcd_qntsty != J2K_CCP_QNTSTY_SIQNT) {
+		auto numComps = codeStream->m_private_image->numcomps;
+		//1. Check main QCD
+		uint32_t maxTileDecompositions = 0;
+		for (uint32_t k = 0; k < numComps; ++k) {
+			auto tccp = tcp->tccps + k;
+			if (tccp->numresolutions == 0)
+				continue;
+			// only consider number of resolutions from a component
+			// whose scope is covered by main QCD;
+			// ignore components that are out of scope
+			// i.e. under main QCC scope, or tile QCD/QCC scope
+			if (tccp->fromQCC || tccp->fromTileHeader)
+				continue;
+			auto decomps = tccp->numresolutions - 1;
+			if (maxTileDecompositions < decomps)
+				maxTileDecompositions = decomps;
+		}
+		if ((tcp->main_qcd_numStepSizes < 3 * maxTileDecompositions + 1)) {
+			GROK_ERROR("From Main QCD marker, "
+					"number of step sizes (%d) is less than "
+					"3* (tile decompositions) + 1, "
+					"where tile decompositions = %d ",
+					tcp->main_qcd_numStepSizes, maxTileDecompositions);
+			return false;
+		}
+
+		//2. Check Tile QCD
+		TileComponentCodingParams *qcd_comp = nullptr;
+		for (uint32_t k = 0; k < numComps; ++k) {
+			auto tccp = tcp->tccps + k;
+			if (tccp->fromTileHeader && !tccp->fromQCC) {
+				qcd_comp = tccp;
+				break;
+			}
+		}
+		if (qcd_comp && (qcd_comp->qntsty != J2K_CCP_QNTSTY_SIQNT)) {
+			uint32_t maxTileDecompositions = 0;
+			for (uint32_t k = 0; k < numComps; ++k) {
+				auto tccp = tcp->tccps + k;
+				if (tccp->numresolutions == 0)
+					continue;
+				// only consider number of resolutions from a component
+				// whose scope is covered by Tile QCD;
+				// ignore components that are out of scope
+				// i.e. under Tile QCC scope
+				if (tccp->fromQCC && tccp->fromTileHeader)
+					continue;
+				auto decomps = tccp->numresolutions - 1;
+				if (maxTileDecompositions < decomps)
+					maxTileDecompositions = decomps;
+			}
+			if ((qcd_comp->numStepSizes < 3 * maxTileDecompositions + 1)) {
+				GROK_ERROR("From Tile QCD marker, "
+						"number of step sizes (%d) is less than"
+						" 3* (tile decompositions) + 1, "
+						"where tile decompositions = %d ",
+						qcd_comp->numStepSizes, maxTileDecompositions);
+
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
 bool j2k_read_tile_header(CodeStream *codeStream, uint16_t *tile_index,
 		uint64_t *uncompressed_tile_size, uint32_t *p_tile_x0,
 		uint32_t *p_tile_y0, uint32_t *p_tile_x1, uint32_t *p_tile_y1,
@@ -1011,72 +1086,9 @@ bool j2k_read_tile_header(CodeStream *codeStream, uint16_t *tile_index,
 				return false;
 		}
 	}
-	// do QCD marker quantization step size sanity check
-	// see page 553 of Taubman and Marcellin for more details on this check
-	auto tcp = codeStream->get_current_decode_tcp();
-	if (tcp->main_qcd_qntsty != J2K_CCP_QNTSTY_SIQNT) {
-		auto numComps = codeStream->m_private_image->numcomps;
-		//1. Check main QCD
-		uint32_t maxTileDecompositions = 0;
-		for (uint32_t k = 0; k < numComps; ++k) {
-			auto tccp = tcp->tccps + k;
-			if (tccp->numresolutions == 0)
-				continue;
-			// only consider number of resolutions from a component
-			// whose scope is covered by main QCD;
-			// ignore components that are out of scope
-			// i.e. under main QCC scope, or tile QCD/QCC scope
-			if (tccp->fromQCC || tccp->fromTileHeader)
-				continue;
-			auto decomps = tccp->numresolutions - 1;
-			if (maxTileDecompositions < decomps)
-				maxTileDecompositions = decomps;
-		}
-		if ((tcp->main_qcd_numStepSizes < 3 * maxTileDecompositions + 1)) {
-			GROK_ERROR("From Main QCD marker, "
-					"number of step sizes (%d) is less than "
-					"3* (tile decompositions) + 1, "
-					"where tile decompositions = %d ",
-					tcp->main_qcd_numStepSizes, maxTileDecompositions);
-			return false;
-		}
-
-		//2. Check Tile QCD
-		TileComponentCodingParams *qcd_comp = nullptr;
-		for (uint32_t k = 0; k < numComps; ++k) {
-			auto tccp = tcp->tccps + k;
-			if (tccp->fromTileHeader && !tccp->fromQCC) {
-				qcd_comp = tccp;
-				break;
-			}
-		}
-		if (qcd_comp && (qcd_comp->qntsty != J2K_CCP_QNTSTY_SIQNT)) {
-			uint32_t maxTileDecompositions = 0;
-			for (uint32_t k = 0; k < numComps; ++k) {
-				auto tccp = tcp->tccps + k;
-				if (tccp->numresolutions == 0)
-					continue;
-				// only consider number of resolutions from a component
-				// whose scope is covered by Tile QCD;
-				// ignore components that are out of scope
-				// i.e. under Tile QCC scope
-				if (tccp->fromQCC && tccp->fromTileHeader)
-					continue;
-				auto decomps = tccp->numresolutions - 1;
-				if (maxTileDecompositions < decomps)
-					maxTileDecompositions = decomps;
-			}
-			if ((qcd_comp->numStepSizes < 3 * maxTileDecompositions + 1)) {
-				GROK_ERROR("From Tile QCD marker, "
-						"number of step sizes (%d) is less than"
-						" 3* (tile decompositions) + 1, "
-						"where tile decompositions = %d ",
-						qcd_comp->numStepSizes, maxTileDecompositions);
+	if (!j2k_check_quantization_step_sizes(codeStream))
+		return false;
 
-				return false;
-			}
-		}
-	}
 	/* Current marker is the EOC marker ?*/
 	if (current_marker == J2K_MS_EOC) {
 		if (decoder->m_state != J2K_DEC_STATE_EOC) {
@@ -1089,7 +1101,7 @@ bool j2k_read_tile_header(CodeStream *codeStream, uint16_t *tile_index,
 		uint32_t nb_tiles = codeStream->m_cp.t_grid_height
 				* codeStream->m_cp.t_grid_width;
 
-		tcp = codeStream->m_cp.tcps + tileProcessor->m_current_tile_index;
+		auto tcp = codeStream->m_cp.tcps + tileProcessor->m_current_tile_index;
 		while ((tileProcessor->m_current_tile_index < nb_tiles)
 				&& (!tcp->m_tile_data)) {
 			++tileProcessor->m_current_tile_index;
@@ -1125,6 +1137,87 @@ bool j2k_read_tile_header(CodeStream *codeStream, uint16_t *tile_index,
 	return true;
 }
 
+bool j2k_read_tile_part_header(CodeStream *codeStream, uint8_t *header,
+		uint32_t header_len) {
+	auto tileProcessor = codeStream->m_tileProcessor;
+	auto decoder = &codeStream->m_specific_param.m_decoder;
+
+	// packet lengths are not used when decompressing incrementally
+	delete tileProcessor->plt_markers;
+	tileProcessor->plt_markers = nullptr;
+
+	decoder->m_state = J2K_DEC_STATE_TPH_SOT;
+	uint32_t offset = 0;
+	while (offset + 2 <= header_len) {
+		uint16_t current_marker = 0;
+		grk_read<uint16_t>(header + offset, &current_marker, 2);
+		offset += 2;
+		if (current_marker == J2K_MS_SOD)
+			return j2k_check_quantization_step_sizes(codeStream);
+		if (offset + 2 > header_len)
+			break;
+		uint16_t marker_size = 0;
+		grk_read<uint16_t>(header + offset, &marker_size, 2);
+		if (marker_size < 2 || offset + marker_size > header_len) {
+			GROK_ERROR("Inconsistent marker size");
+			return false;
+		}
+		auto marker_handler = j2k_get_marker_handler(current_marker);
+		if (!(decoder->m_state & marker_handler->states)) {
+			GROK_ERROR("Marker is not compliant with its position");
+			return false;
+		}
+		if (!marker_handler->handler) {
+			GROK_WARN("Unknown marker 0x%02x detected.", current_marker);
+		} else if (!(*(marker_handler->handler))(codeStream,
+				header + offset + 2, (uint16_t) (marker_size - 2))) {
+			GROK_ERROR("Fail to read the current marker segment (%#x)",
+					current_marker);
+			return false;
+		}
+		offset += marker_size;
+	}
+	GROK_ERROR("Tile-part header is missing SOD marker");
+
+	return false;
+}
+
+bool j2k_decompress_incremental(CodeStream *codeStream, BufferedStream *stream,
+		grk_image *image, bool *complete) {
+	if (!codeStream->m_incremental_decompressor) {
+		codeStream->m_incremental_decompressor = new IncrementalDecompressor(
+				codeStream, stream);
+		if (!codeStream->m_incremental_decompressor->init(image)) {
+			delete codeStream->m_incremental_decompressor;
+			codeStream->m_incremental_decompressor = nullptr;
+			return false;
+		}
+	}
+
+	return codeStream->m_incremental_decompressor->decompress(image, complete);
+}
+
+/*
+ Byte budget of a tile with tile_data_len bytes of compressed data:
+ its share of the global budget, in proportion to its compressed size,
+ capped by the per-tile budget
+ */
+static uint64_t j2k_tile_byte_budget(CodeStream *codeStream,
+		uint64_t tile_data_len) {
+	auto dec = &codeStream->m_cp.m_coding_params.m_dec;
+	uint64_t budget = dec->m_max_tile_bytes ? dec->m_max_tile_bytes : UINT64_MAX;
+	if (dec->m_max_bytes) {
+		uint64_t share = dec->m_max_bytes;
+		uint64_t total = codeStream->m_specific_param.m_decoder.m_tile_data_len;
+		if (total > tile_data_len)
+			share = (uint64_t) ((double) dec->m_max_bytes
+					* (double) tile_data_len / (double) total);
+		budget = std::min<uint64_t>(budget, share);
+	}
+
+	return budget;
+}
+
 bool j2k_decompress_tile(CodeStream *codeStream, uint16_t tile_index,
 		uint8_t *tile_compositing_buff, uint64_t tile_compositing_buff_len,
 		BufferedStream *stream) {
@@ -1152,6 +1245,8 @@ bool j2k_decompress_tile(CodeStream *codeStream, uint16_t tile_index,
 		return false;
 	}
 
+	tileProcessor->m_max_bytes = j2k_tile_byte_budget(codeStream,
+			tcp->m_tile_data->data_len);
 	if (!tileProcessor->decompress_tile(tcp->m_tile_data, tile_index)) {
 		tcp->destroy();
 		decoder->m_state |= J2K_DEC_STATE_ERR;
@@ -1165,14 +1260,16 @@ bool j2k_decompress_tile(CodeStream *codeStream, uint16_t tile_index,
 
 		/* if tile_compositing_buff is not null, copy decoded resolutions from tile data
 		 * into tile_compositing_buff. Otherwise, simply copy tile data pointer
-		 * to output image
+		 * to output image. When transcoding, wavelet coefficients are left in
+		 * the tile buffer for the compressor, and when rewriting packets,
+		 * there is nothing to transfer.
 		 */
 		if (tile_compositing_buff) {
 			if (!tileProcessor->composite_tile(tile_compositing_buff,
 					tile_compositing_buff_len)) {
 				return false;
 			}
-		} else {
+		} else if (!tileProcessor->m_transcode && !tileProcessor->m_packets) {
 			/* transfer data from tile component to output image */
 			uint32_t compno = 0;
 			for (compno = 0; compno < codeStream->m_output_image->numcomps;
@@ -1823,6 +1920,7 @@ bool j2k_init_compress(CodeStream *codeStream, grk_cparameters *parameters,
 	cp->m_coding_params.m_enc.writeTLM = parameters->writeTLM;
 	cp->m_coding_params.m_enc.rateControlAlgorithm =
 			parameters->rateControlAlgorithm;
+	cp->m_coding_params.m_enc.earlyTermination = parameters->earlyTermination;
 
 	/* tiles */
 	cp->t_width = parameters->t_width;
@@ -2178,6 +2276,11 @@ bool j2k_compress(CodeStream *codeStream, grk_plugin_tile *tile,
 }
 
 bool j2k_end_compress(CodeStream *codeStream, BufferedStream *stream) {
+	/* wait for last tile row of strip compression */
+	if (codeStream->m_strip_compressor
+			&& !codeStream->m_strip_compressor->finish())
+		return false;
+
 	/* customization of the encoding */
 	if (!j2k_init_end_compress(codeStream)) {
 		return false;
@@ -2739,6 +2842,836 @@ bool j2k_compress_tile(CodeStream *codeStream, uint16_t tile_index, uint8_t *p_d
 	return true;
 }
 
+bool j2k_compress_strip(CodeStream *codeStream, const uint8_t *p_data,
+		uint32_t num_rows, uint32_t sample_size, BufferedStream *stream) {
+	if (!codeStream->m_strip_compressor) {
+		codeStream->m_strip_compressor = new StripCompressor(codeStream,
+				stream);
+		if (!codeStream->m_strip_compressor->init()) {
+			delete codeStream->m_strip_compressor;
+			codeStream->m_strip_compressor = nullptr;
+			return false;
+		}
+	}
+
+	return codeStream->m_strip_compressor->push(p_data, num_rows, sample_size);
+}
+
+bool j2k_compress_tile_from_strip(CodeStream *codeStream, uint16_t tile_index,
+		int32_t **strip, uint32_t strip_y0, uint32_t strip_width,
+		BufferedStream *stream) {
+	if (!j2k_pre_write_tile(codeStream, tile_index)) {
+		GROK_ERROR("Error while j2k_pre_write_tile with tile index = %d",
+				tile_index);
+		return false;
+	}
+	for (uint32_t j = 0; j < codeStream->m_tileProcessor->image->numcomps; ++j) {
+		auto tilec = codeStream->m_tileProcessor->tile->comps + j;
+		if (!tilec->buf->alloc_component_data_encode()) {
+			GROK_ERROR("Error allocating tile component data.");
+			return false;
+		}
+	}
+	codeStream->m_tileProcessor->copy_strip_to_tile(strip, strip_y0,
+			strip_width);
+	if (!j2k_post_write_tile(codeStream, stream)) {
+		GROK_ERROR("Error while j2k_post_write_tile with tile index = %d",
+				tile_index);
+		return false;
+	}
+
+	return true;
+}
+
+/*
+ Wavelet coefficients can be passed from source to destination tile
+ unchanged if both tiles share the reversible wavelet, resolutions,
+ code block and precinct partitions, and quantization
+ */
+static bool j2k_transcode_compatible(TileCodingParams *src,
+		TileCodingParams *dest, uint32_t numcomps) {
+	if (src->prg != dest->prg || src->mct != dest->mct
+			|| src->csty != dest->csty || src->POC != dest->POC
+			|| src->numpocs != dest->numpocs)
+		return false;
+	for (uint32_t i = 0; src->POC && i <= src->numpocs; ++i) {
+		auto src_poc = src->pocs + i;
+		auto dest_poc = dest->pocs + i;
+		if (src_poc->resno0 != dest_poc->resno0
+				|| src_poc->compno0 != dest_poc->compno0
+				|| src_poc->resno1 != dest_poc->resno1
+				|| src_poc->compno1 != dest_poc->compno1
+				|| src_poc->prg != dest_poc->prg1)
+			return false;
+	}
+	for (uint32_t compno = 0; compno < numcomps; ++compno) {
+		auto src_tccp = src->tccps + compno;
+		auto dest_tccp = dest->tccps + compno;
+		if (src_tccp->qmfbid != 1 || src_tccp->roishift
+				|| src_tccp->qmfbid != dest_tccp->qmfbid
+				|| src_tccp->numresolutions != dest_tccp->numresolutions
+				|| src_tccp->cblkw != dest_tccp->cblkw
+				|| src_tccp->cblkh != dest_tccp->cblkh
+				|| src_tccp->csty != dest_tccp->csty
+				|| src_tccp->numgbits != dest_tccp->numgbits)
+			return false;
+		for (uint32_t resno = 0; resno < src_tccp->numresolutions; ++resno) {
+			if (src_tccp->prcw[resno] != dest_tccp->prcw[resno]
+					|| src_tccp->prch[resno] != dest_tccp->prch[resno])
+				return false;
+		}
+		uint32_t numbands = 3 * src_tccp->numresolutions - 2;
+		for (uint32_t bandno = 0; bandno < numbands; ++bandno) {
+			if (src_tccp->stepsizes[bandno].expn
+					!= dest_tccp->stepsizes[bandno].expn)
+				return false;
+		}
+	}
+
+	return true;
+}
+
+/*
+ Compress parameters can only describe a single coding style
+ for all components
+ */
+static bool j2k_uniform_coding_style(TileCodingParams *tcp,
+		uint32_t numcomps) {
+	auto tccp = tcp->tccps;
+	for (uint32_t compno = 1; compno < numcomps; ++compno) {
+		auto comp_tccp = tcp->tccps + compno;
+		if (comp_tccp->numresolutions != tccp->numresolutions
+				|| comp_tccp->cblkw != tccp->cblkw
+				|| comp_tccp->cblkh != tccp->cblkh
+				|| comp_tccp->csty != tccp->csty
+				|| comp_tccp->cblk_sty != tccp->cblk_sty
+				|| comp_tccp->qmfbid != tccp->qmfbid)
+			return false;
+		for (uint32_t resno = 0; resno < tccp->numresolutions; ++resno) {
+			if (comp_tccp->prcw[resno] != tccp->prcw[resno]
+					|| comp_tccp->prch[resno] != tccp->prch[resno])
+				return false;
+		}
+	}
+
+	return true;
+}
+
+bool j2k_init_transcode(CodeStream *src, grk_cparameters *parameters) {
+	auto cp = &src->m_cp;
+	auto image = src->m_private_image;
+	auto tcp = src->m_specific_param.m_decoder.m_default_tcp;
+	if (!image || !tcp || !tcp->tccps) {
+		GROK_ERROR("Transcode: source header has not been read");
+		return false;
+	}
+	if (cp->m_coding_params.m_dec.m_reduce
+			|| cp->m_coding_params.m_dec.m_layer) {
+		GROK_ERROR("Transcode: source must be decompressed at full"
+				" resolution with all layers");
+		return false;
+	}
+	if (tcp->mct == 2) {
+		GROK_ERROR("Transcode: custom multiple component transform"
+				" is not supported");
+		return false;
+	}
+	if (tcp->POC && cp->t_grid_width * cp->t_grid_height > 1) {
+		GROK_ERROR("Transcode: progression order changes are only"
+				" supported for single tile images");
+		return false;
+	}
+	auto tccp = tcp->tccps;
+	for (uint32_t compno = 0; compno < image->numcomps; ++compno) {
+		auto comp_tccp = tcp->tccps + compno;
+		if (comp_tccp->qmfbid != 1) {
+			GROK_ERROR("Transcode: only reversible code streams"
+					" are supported");
+			return false;
+		}
+		if (comp_tccp->roishift) {
+			GROK_ERROR("Transcode: region of interest is not supported");
+			return false;
+		}
+	}
+	if (!j2k_uniform_coding_style(tcp, image->numcomps)) {
+		GROK_ERROR("Transcode: coding style must be the same"
+				" for all components");
+		return false;
+	}
+
+	// tile layout
+	parameters->tile_size_on = true;
+	parameters->tx0 = cp->tx0;
+	parameters->ty0 = cp->ty0;
+	parameters->t_width = cp->t_width;
+	parameters->t_height = cp->t_height;
+
+	// wavelet, code block and precinct partitions
+	parameters->irreversible = false;
+	parameters->numresolution = tccp->numresolutions;
+	parameters->cblockw_init = 1U << tccp->cblkw;
+	parameters->cblockh_init = 1U << tccp->cblkh;
+	parameters->csty = (uint8_t) tcp->csty;
+	parameters->res_spec = 0;
+	if (tccp->csty & J2K_CCP_CSTY_PRT) {
+		parameters->res_spec = tccp->numresolutions;
+		for (uint32_t p = 0; p < tccp->numresolutions; ++p) {
+			uint32_t resno = tccp->numresolutions - 1 - p;
+			parameters->prcw_init[p] = 1U << tccp->prcw[resno];
+			parameters->prch_init[p] = 1U << tccp->prch[resno];
+		}
+	}
+
+	// progression order
+	parameters->prog_order = tcp->prg;
+	parameters->numpocs = 0;
+	if (tcp->POC) {
+		for (uint32_t i = 0; i <= tcp->numpocs; ++i) {
+			auto src_poc = tcp->pocs + i;
+			auto poc = parameters->POC + i;
+			memset(poc, 0, sizeof(grk_poc));
+			poc->tile = 1;
+			poc->resno0 = src_poc->resno0;
+			poc->compno0 = src_poc->compno0;
+			poc->layno1 = 1;
+			poc->resno1 = src_poc->resno1;
+			poc->compno1 = src_poc->compno1;
+			poc->prg1 = src_poc->prg;
+		}
+		parameters->numpocs = tcp->numpocs + 1;
+	}
+
+	// single lossless layer, coded with the HT block coder
+	parameters->tcp_numlayers = 1;
+	parameters->tcp_rates[0] = 0;
+	parameters->cp_disto_alloc = true;
+	parameters->cp_fixed_quality = false;
+	parameters->max_cs_size = 0;
+	parameters->max_comp_size = 0;
+	parameters->isHT = true;
+	parameters->cblk_sty = GRK_CBLKSTY_HT;
+	parameters->roi_compno = -1;
+	parameters->roi_shift = 0;
+	parameters->tcp_mct = (uint8_t) tcp->mct;
+	parameters->mct_data = nullptr;
+	parameters->rsiz = GRK_PROFILE_NONE;
+
+	return true;
+}
+
+bool j2k_init_transcode_compress(CodeStream *src, CodeStream *codeStream) {
+	auto src_tcp = src->m_specific_param.m_decoder.m_default_tcp;
+	auto image = codeStream->m_private_image;
+	auto cp = &codeStream->m_cp;
+	uint32_t nb_tiles = cp->t_grid_width * cp->t_grid_height;
+	if (nb_tiles != src->m_cp.t_grid_width * src->m_cp.t_grid_height
+			|| image->numcomps != src->m_private_image->numcomps) {
+		GROK_ERROR("Transcode: tile layout does not match source");
+		return false;
+	}
+	for (uint32_t tileno = 0; tileno < nb_tiles; ++tileno) {
+		auto tcp = cp->tcps + tileno;
+		for (uint32_t compno = 0; compno < image->numcomps; ++compno) {
+			auto tccp = tcp->tccps + compno;
+			auto src_tccp = src_tcp->tccps + compno;
+			tccp->qntsty = src_tccp->qntsty;
+			tccp->numgbits = src_tccp->numgbits;
+			memcpy(tccp->stepsizes, src_tccp->stepsizes,
+					GRK_J2K_MAXBANDS * sizeof(grk_stepsize));
+		}
+		tcp->qcd.generate(tcp->tccps->numgbits,
+				tcp->tccps->numresolutions - 1, true, image->comps[0].prec,
+				tcp->mct > 0, image->comps[0].sgnd);
+		tcp->qcd.push(tcp->tccps->stepsizes, true);
+		if (!j2k_transcode_compatible(src_tcp, tcp, image->numcomps)) {
+			GROK_ERROR("Transcode: coding parameters do not match source");
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool j2k_transcode(CodeStream *src, BufferedStream *src_stream,
+		CodeStream *codeStream, BufferedStream *stream) {
+	auto src_tileProcessor = src->m_tileProcessor;
+	auto tileProcessor = codeStream->m_tileProcessor;
+	auto numcomps = codeStream->m_private_image->numcomps;
+	uint32_t nb_tiles = codeStream->m_cp.t_grid_width
+			* codeStream->m_cp.t_grid_height;
+
+	// decompress full tiles
+	grk_image_destroy(src->m_output_image);
+	src->m_output_image = grk_image_create0();
+	if (!src->m_output_image)
+		return false;
+	grk_copy_image_header(src->m_private_image, src->m_output_image);
+
+	src_tileProcessor->m_transcode = true;
+	tileProcessor->m_transcode = true;
+	for (uint32_t tileno = 0; tileno < nb_tiles; ++tileno) {
+		uint16_t tile_index = 0;
+		uint64_t tile_data_len = 0;
+		uint32_t tile_x0, tile_y0, tile_x1, tile_y1, nb_comps;
+		bool go_on = true;
+
+		if (!j2k_read_tile_header(src, &tile_index, &tile_data_len, &tile_x0,
+				&tile_y0, &tile_x1, &tile_y1, &nb_comps, &go_on, src_stream))
+			return false;
+		if (!go_on)
+			break;
+		if (tile_index != tileProcessor->m_current_tile_index) {
+			GROK_ERROR("Transcode: tile %d is out of sequence."
+					" Tiles must be stored in order", tile_index);
+			return false;
+		}
+		if (!j2k_transcode_compatible(src->m_cp.tcps + tile_index,
+				codeStream->m_cp.tcps + tile_index, numcomps)) {
+			GROK_ERROR("Transcode: coding parameters of tile %d"
+					" differ from main header", tile_index);
+			return false;
+		}
+		try {
+			if (!j2k_decompress_tile(src, tile_index, nullptr, 0,
+					src_stream)) {
+				GROK_ERROR("Failed to decompress tile %d/%d", tile_index + 1,
+						nb_tiles);
+				return false;
+			}
+		} catch (DecodeUnknownMarkerAtEndOfTileException &e) {
+			if (tileno < nb_tiles - 1) {
+				GROK_ERROR("Stream too short, expected SOT");
+				return false;
+			}
+		}
+		if (!j2k_pre_write_tile(codeStream, tile_index)) {
+			GROK_ERROR("Error while j2k_pre_write_tile with tile index = %d",
+					tile_index);
+			return false;
+		}
+		// hand coefficients over from source tile to destination tile
+		for (uint32_t compno = 0; compno < numcomps; ++compno) {
+			auto src_buf = src_tileProcessor->tile->comps[compno].buf;
+			auto buf = tileProcessor->tile->comps[compno].buf;
+			if (!src_buf->data || !src_buf->owns_data
+					|| src_buf->reduced_region_dim.width()
+							!= buf->reduced_region_dim.width()
+					|| src_buf->reduced_region_dim.height()
+							!= buf->reduced_region_dim.height()) {
+				GROK_ERROR("Transcode: tile component %d does not match"
+						" source", compno);
+				return false;
+			}
+			if (buf->data && buf->owns_data)
+				grk_aligned_free(buf->data);
+			buf->data = src_buf->data;
+			buf->data_size = src_buf->data_size;
+			buf->owns_data = true;
+			src_buf->data = nullptr;
+			src_buf->data_size = 0;
+			src_buf->owns_data = false;
+		}
+		if (!j2k_post_write_tile(codeStream, stream)) {
+			GROK_ERROR("Error while j2k_post_write_tile with tile index = %d",
+					tile_index);
+			return false;
+		}
+	}
+	if (tileProcessor->m_current_tile_index != nb_tiles) {
+		GROK_ERROR("Transcode: only %d out of %d tiles were found in source",
+				tileProcessor->m_current_tile_index, nb_tiles);
+		return false;
+	}
+
+	return true;
+}
+
+/*
+ Get source component of each destination component, in increasing order
+ */
+static bool j2k_rewrite_components(const grk_rewrite_params *rewrite,
+		uint32_t numcomps, std::vector<uint32_t> *comps) {
+	comps->clear();
+	if (!rewrite->numcomps) {
+		for (uint32_t compno = 0; compno < numcomps; ++compno)
+			comps->push_back(compno);
+		return true;
+	}
+	if (!rewrite->comps) {
+		GROK_ERROR("Rewrite: missing list of components");
+		return false;
+	}
+	for (uint32_t i = 0; i < rewrite->numcomps; ++i) {
+		uint32_t compno = rewrite->comps[i];
+		if (compno >= numcomps) {
+			GROK_ERROR("Rewrite: component %d does not exist", compno);
+			return false;
+		}
+		if (i && compno <= comps->back()) {
+			GROK_ERROR("Rewrite: components must be listed in increasing order");
+			return false;
+		}
+		comps->push_back(compno);
+	}
+
+	return true;
+}
+
+/*
+ Multiple component transform is kept if its three components are kept
+ */
+static bool j2k_rewrite_keeps_mct(const std::vector<uint32_t> &comps) {
+	return comps.size() >= 3 && comps[0] == 0 && comps[1] == 1
+			&& comps[2] == 2;
+}
+
+/*
+ Get rectangle of tile grid to keep
+ */
+static bool j2k_rewrite_tiles(const grk_rewrite_params *rewrite,
+		CodingParams *cp, uint32_t *tile_x0, uint32_t *tile_y0,
+		uint32_t *tile_x1, uint32_t *tile_y1) {
+	*tile_x0 = 0;
+	*tile_y0 = 0;
+	*tile_x1 = cp->t_grid_width;
+	*tile_y1 = cp->t_grid_height;
+	if (rewrite->tile_x1 && rewrite->tile_y1) {
+		if (rewrite->tile_x0 >= rewrite->tile_x1
+				|| rewrite->tile_y0 >= rewrite->tile_y1
+				|| rewrite->tile_x1 > cp->t_grid_width
+				|| rewrite->tile_y1 > cp->t_grid_height) {
+			GROK_ERROR("Rewrite: invalid tile rectangle (%d,%d,%d,%d)"
+					" for %d x %d tile grid", rewrite->tile_x0,
+					rewrite->tile_y0, rewrite->tile_x1, rewrite->tile_y1,
+					cp->t_grid_width, cp->t_grid_height);
+			return false;
+		}
+		*tile_x0 = rewrite->tile_x0;
+		*tile_y0 = rewrite->tile_y0;
+		*tile_x1 = rewrite->tile_x1;
+		*tile_y1 = rewrite->tile_y1;
+	}
+
+	return true;
+}
+
+/*
+ Packets can be copied unchanged from source tile to destination tile
+ if both tiles share progression order and packet markers, and if each
+ kept component shares wavelet, code block and precinct partitions,
+ block coding style and quantization over the kept resolutions
+ */
+static bool j2k_rewrite_compatible(TileCodingParams *src,
+		TileCodingParams *dest, uint32_t reduce,
+		const std::vector<uint32_t> &comps) {
+	bool mct = src->mct && j2k_rewrite_keeps_mct(comps);
+	if (src->prg != dest->prg || src->csty != dest->csty
+			|| (dest->mct != 0) != mct || src->ppt)
+		return false;
+	for (uint32_t compno = 0; compno < comps.size(); ++compno) {
+		auto src_tccp = src->tccps + comps[compno];
+		auto dest_tccp = dest->tccps + compno;
+		if (src_tccp->numresolutions != dest_tccp->numresolutions + reduce
+				|| src_tccp->qmfbid != dest_tccp->qmfbid
+				|| src_tccp->cblkw != dest_tccp->cblkw
+				|| src_tccp->cblkh != dest_tccp->cblkh
+				|| src_tccp->csty != dest_tccp->csty
+				|| src_tccp->cblk_sty != dest_tccp->cblk_sty
+				|| src_tccp->qntsty != dest_tccp->qntsty
+				|| src_tccp->numgbits != dest_tccp->numgbits
+				|| src_tccp->roishift != dest_tccp->roishift)
+			return false;
+		for (uint32_t resno = 0; resno < dest_tccp->numresolutions;
+				++resno) {
+			if (src_tccp->prcw[resno] != dest_tccp->prcw[resno]
+					|| src_tccp->prch[resno] != dest_tccp->prch[resno])
+				return false;
+		}
+		uint32_t numbands =
+				(src_tccp->qntsty == J2K_CCP_QNTSTY_SIQNT) ?
+						1 : 3 * dest_tccp->numresolutions - 2;
+		for (uint32_t bandno = 0; bandno < numbands; ++bandno) {
+			if (src_tccp->stepsizes[bandno].expn
+					!= dest_tccp->stepsizes[bandno].expn
+					|| src_tccp->stepsizes[bandno].mant
+							!= dest_tccp->stepsizes[bandno].mant)
+				return false;
+		}
+	}
+
+	return true;
+}
+
+grk_image* j2k_init_rewrite(CodeStream *src, grk_cparameters *parameters,
+		grk_image *image) {
+	auto cp = &src->m_cp;
+	auto tcp = src->m_specific_param.m_decoder.m_default_tcp;
+	auto rewrite = &parameters->rewrite;
+	if (!image || !tcp || !tcp->tccps) {
+		GROK_ERROR("Rewrite: source header has not been read");
+		return nullptr;
+	}
+	if (cp->m_coding_params.m_dec.m_reduce
+			|| cp->m_coding_params.m_dec.m_layer) {
+		GROK_ERROR("Rewrite: layers and resolutions must be selected"
+				" with rewrite parameters");
+		return nullptr;
+	}
+	if (cp->ppm || tcp->ppt) {
+		GROK_ERROR("Rewrite: packed packet headers are not supported");
+		return nullptr;
+	}
+	if (tcp->mct == 2) {
+		GROK_ERROR("Rewrite: custom multiple component transform"
+				" is not supported");
+		return nullptr;
+	}
+	if (!j2k_uniform_coding_style(tcp, image->numcomps)) {
+		GROK_ERROR("Rewrite: coding style must be the same"
+				" for all components");
+		return nullptr;
+	}
+	auto tccp = tcp->tccps;
+	if (rewrite->reduce >= tccp->numresolutions) {
+		GROK_ERROR("Rewrite: cannot discard %d resolutions out of %d",
+				rewrite->reduce, tccp->numresolutions);
+		return nullptr;
+	}
+	std::vector<uint32_t> comps;
+	if (!j2k_rewrite_components(rewrite, image->numcomps, &comps))
+		return nullptr;
+	if (tcp->mct && !j2k_rewrite_keeps_mct(comps) && comps[0] < 3) {
+		GROK_ERROR("Rewrite: the three components of the multiple"
+				" component transform must all be kept, or all be dropped");
+		return nullptr;
+	}
+	uint32_t tile_x0, tile_y0, tile_x1, tile_y1;
+	if (!j2k_rewrite_tiles(rewrite, cp, &tile_x0, &tile_y0, &tile_x1,
+			&tile_y1))
+		return nullptr;
+
+	// Canvas of kept tiles, at reduced resolution. Tiles keep their
+	// boundaries, so precinct and code block partitions are unchanged.
+	uint32_t reduce = rewrite->reduce;
+	uint64_t grid_x0 = cp->tx0 + (uint64_t) tile_x0 * cp->t_width;
+	uint64_t grid_y0 = cp->ty0 + (uint64_t) tile_y0 * cp->t_height;
+	uint64_t x0 = std::max<uint64_t>(image->x0, grid_x0);
+	uint64_t y0 = std::max<uint64_t>(image->y0, grid_y0);
+	uint64_t x1 = std::min<uint64_t>(image->x1,
+			cp->tx0 + (uint64_t) tile_x1 * cp->t_width);
+	uint64_t y1 = std::min<uint64_t>(image->y1,
+			cp->ty0 + (uint64_t) tile_y1 * cp->t_height);
+	parameters->tile_size_on = true;
+	parameters->tx0 = uint64_ceildivpow2(grid_x0, reduce);
+	parameters->ty0 = uint64_ceildivpow2(grid_y0, reduce);
+	uint32_t reduced_x1 = uint64_ceildivpow2(x1, reduce);
+	uint32_t reduced_y1 = uint64_ceildivpow2(y1, reduce);
+	uint32_t mask = (1U << reduce) - 1;
+	if (tile_x1 - tile_x0 == 1) {
+		parameters->t_width = reduced_x1 - parameters->tx0;
+	} else if (cp->t_width & mask) {
+		GROK_ERROR("Rewrite: tile width %d is not divisible by %d",
+				cp->t_width, 1U << reduce);
+		return nullptr;
+	} else {
+		parameters->t_width = cp->t_width >> reduce;
+	}
+	if (tile_y1 - tile_y0 == 1) {
+		parameters->t_height = reduced_y1 - parameters->ty0;
+	} else if (cp->t_height & mask) {
+		GROK_ERROR("Rewrite: tile height %d is not divisible by %d",
+				cp->t_height, 1U << reduce);
+		return nullptr;
+	} else {
+		parameters->t_height = cp->t_height >> reduce;
+	}
+
+	// image header
+	auto rewrite_image = grk_image_create0();
+	if (!rewrite_image)
+		return nullptr;
+	grk_copy_image_header(image, rewrite_image);
+	rewrite_image->x0 = uint64_ceildivpow2(x0, reduce);
+	rewrite_image->y0 = uint64_ceildivpow2(y0, reduce);
+	rewrite_image->x1 = reduced_x1;
+	rewrite_image->y1 = reduced_y1;
+	rewrite_image->numcomps = (uint32_t) comps.size();
+	for (uint32_t compno = 0; compno < rewrite_image->numcomps; ++compno) {
+		auto comp = rewrite_image->comps + compno;
+		*comp = image->comps[comps[compno]];
+		comp->data = nullptr;
+		comp->owns_data = false;
+		comp->resno_decoded = 0;
+		comp->x0 = ceildiv<uint32_t>(rewrite_image->x0, comp->dx);
+		comp->y0 = ceildiv<uint32_t>(rewrite_image->y0, comp->dy);
+		comp->w = ceildiv<uint32_t>(rewrite_image->x1, comp->dx) - comp->x0;
+		comp->h = ceildiv<uint32_t>(rewrite_image->y1, comp->dy) - comp->y0;
+	}
+	// colour space no longer applies once colour channels are dropped
+	uint32_t num_colour = std::min<uint32_t>(image->numcomps, 3);
+	bool keep_colour = comps.size() >= num_colour;
+	for (uint32_t compno = 0; keep_colour && compno < num_colour; ++compno)
+		keep_colour = comps[compno] == compno;
+	if (!keep_colour) {
+		rewrite_image->color_space =
+				comps.size() == 1 ? GRK_CLRSPC_GRAY : GRK_CLRSPC_UNKNOWN;
+		grk_buffer_delete(rewrite_image->icc_profile_buf);
+		rewrite_image->icc_profile_buf = nullptr;
+		rewrite_image->icc_profile_len = 0;
+	}
+
+	// wavelet, code block and precinct partitions of kept resolutions
+	uint32_t numresolutions = tccp->numresolutions - reduce;
+	parameters->irreversible = tccp->qmfbid == 0;
+	parameters->numresolution = numresolutions;
+	parameters->cblockw_init = 1U << tccp->cblkw;
+	parameters->cblockh_init = 1U << tccp->cblkh;
+	parameters->csty = (uint8_t) tcp->csty;
+	parameters->res_spec = 0;
+	if (tccp->csty & J2K_CCP_CSTY_PRT) {
+		parameters->res_spec = numresolutions;
+		for (uint32_t p = 0; p < numresolutions; ++p) {
+			uint32_t resno = numresolutions - 1 - p;
+			parameters->prcw_init[p] = 1U << tccp->prcw[resno];
+			parameters->prch_init[p] = 1U << tccp->prch[resno];
+		}
+	}
+
+	// Progression order changes are not kept: packets are looked up
+	// by layer, resolution, component and precinct, so any
+	// progression order produces a valid code stream.
+	parameters->prog_order = tcp->prg;
+	parameters->numpocs = 0;
+
+	// kept layers, with block coding style of source
+	parameters->tcp_numlayers =
+			rewrite->numlayers ?
+					std::min<uint32_t>(rewrite->numlayers, tcp->numlayers) :
+					tcp->numlayers;
+	for (uint32_t layno = 0; layno < parameters->tcp_numlayers; ++layno)
+		parameters->tcp_rates[layno] = 0;
+	parameters->cp_disto_alloc = false;
+	parameters->cp_fixed_quality = false;
+	parameters->max_cs_size = 0;
+	parameters->max_comp_size = 0;
+	parameters->cblk_sty = tccp->cblk_sty;
+	parameters->isHT = (tccp->cblk_sty & GRK_CBLKSTY_HT) != 0;
+	parameters->roi_compno = -1;
+	parameters->roi_shift = 0;
+	parameters->tcp_mct =
+			(uint8_t) (j2k_rewrite_keeps_mct(comps) ? tcp->mct : 0);
+	parameters->mct_data = nullptr;
+	parameters->rsiz = GRK_PROFILE_NONE;
+
+	return rewrite_image;
+}
+
+bool j2k_init_rewrite_compress(CodeStream *src, CodeStream *codeStream,
+		grk_cparameters *parameters) {
+	auto src_tcp = src->m_specific_param.m_decoder.m_default_tcp;
+	auto image = codeStream->m_private_image;
+	auto cp = &codeStream->m_cp;
+	uint32_t nb_tiles = cp->t_grid_width * cp->t_grid_height;
+	std::vector<uint32_t> comps;
+	if (!j2k_rewrite_components(&parameters->rewrite,
+			src->m_private_image->numcomps, &comps))
+		return false;
+	uint32_t tile_x0, tile_y0, tile_x1, tile_y1;
+	if (!j2k_rewrite_tiles(&parameters->rewrite, &src->m_cp, &tile_x0,
+			&tile_y0, &tile_x1, &tile_y1))
+		return false;
+	if (cp->t_grid_width != tile_x1 - tile_x0
+			|| cp->t_grid_height != tile_y1 - tile_y0
+			|| image->numcomps != comps.size()) {
+		GROK_ERROR("Rewrite: tile layout does not match source");
+		return false;
+	}
+	for (uint32_t tileno = 0; tileno < nb_tiles; ++tileno) {
+		auto tcp = cp->tcps + tileno;
+		for (uint32_t compno = 0; compno < image->numcomps; ++compno) {
+			auto tccp = tcp->tccps + compno;
+			auto src_tccp = src_tcp->tccps + comps[compno];
+			tccp->qntsty = src_tccp->qntsty;
+			tccp->numgbits = src_tccp->numgbits;
+			tccp->roishift = src_tccp->roishift;
+			memcpy(tccp->stepsizes, src_tccp->stepsizes,
+					GRK_J2K_MAXBANDS * sizeof(grk_stepsize));
+		}
+		bool reversible = tcp->tccps->qmfbid == 1;
+		tcp->qcd.generate(tcp->tccps->numgbits,
+				tcp->tccps->numresolutions - 1, reversible,
+				image->comps[0].prec, tcp->mct > 0, image->comps[0].sgnd);
+		tcp->qcd.push(tcp->tccps->stepsizes, reversible);
+		if (!j2k_rewrite_compatible(src_tcp, tcp, parameters->rewrite.reduce,
+				comps)) {
+			GROK_ERROR("Rewrite: coding parameters do not match source");
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/*
+ Tile, resolution and precinct geometry of kept resolutions
+ must be the same in source and destination tiles
+ */
+static bool j2k_rewrite_same_geometry(TileProcessor *src,
+		TileProcessor *dest, const std::vector<uint32_t> &comps) {
+	for (uint32_t compno = 0; compno < comps.size(); ++compno) {
+		auto src_tilec = src->tile->comps + comps[compno];
+		auto tilec = dest->tile->comps + compno;
+		for (uint32_t resno = 0; resno < tilec->numresolutions; ++resno) {
+			auto src_res = src_tilec->resolutions + resno;
+			auto res = tilec->resolutions + resno;
+			if (src_res->x0 != res->x0 || src_res->y0 != res->y0
+					|| src_res->x1 != res->x1 || src_res->y1 != res->y1
+					|| src_res->pw != res->pw || src_res->ph != res->ph)
+				return false;
+		}
+	}
+
+	return true;
+}
+
+static bool j2k_rewrite_tile_packets(CodeStream *src,
+		BufferedStream *src_stream, CodeStream *codeStream,
+		BufferedStream *stream, const grk_rewrite_params *rewrite,
+		const std::vector<uint32_t> &comps, uint32_t tile_x0,
+		uint32_t tile_y0) {
+	auto src_tileProcessor = src->m_tileProcessor;
+	auto tileProcessor = codeStream->m_tileProcessor;
+	auto packets = tileProcessor->m_packets;
+	uint32_t grid_width = codeStream->m_cp.t_grid_width;
+	uint32_t nb_tiles = grid_width * codeStream->m_cp.t_grid_height;
+	bool truncated = false;
+
+	for (uint32_t tileno = 0; tileno < nb_tiles; ++tileno) {
+		auto dest_tile_index = (uint16_t) tileProcessor->m_current_tile_index;
+		packets->clear();
+		uint16_t tile_index = 0;
+		// tiles missing from a truncated source only have empty packets
+		if (!truncated) {
+			uint64_t tile_data_len = 0;
+			uint32_t x0, y0, x1, y1, nb_comps;
+			bool go_on = true;
+
+			if (!j2k_read_tile_header(src, &tile_index, &tile_data_len, &x0,
+					&y0, &x1, &y1, &nb_comps, &go_on, src_stream))
+				return false;
+			if (!go_on) {
+				GROK_WARN("Rewrite: source is truncated after %d out of %d tiles",
+						tileno, nb_tiles);
+				truncated = true;
+			}
+		}
+		if (!truncated) {
+			uint32_t tile_x = tile_index % src->m_cp.t_grid_width - tile_x0;
+			uint32_t tile_y = tile_index / src->m_cp.t_grid_width - tile_y0;
+			if (tile_x + tile_y * grid_width != dest_tile_index) {
+				GROK_ERROR("Rewrite: tile %d is out of sequence."
+						" Tiles must be stored in order", tile_index);
+				return false;
+			}
+			if (!j2k_rewrite_compatible(src->m_cp.tcps + tile_index,
+					codeStream->m_cp.tcps + dest_tile_index, rewrite->reduce,
+					comps)) {
+				GROK_ERROR("Rewrite: coding parameters of tile %d"
+						" differ from main header", tile_index);
+				return false;
+			}
+			try {
+				if (!j2k_decompress_tile(src, tile_index, nullptr, 0,
+						src_stream)) {
+					GROK_ERROR("Failed to read packets of tile %d",
+							tile_index);
+					return false;
+				}
+			} catch (DecodeUnknownMarkerAtEndOfTileException &e) {
+				if (tileno < nb_tiles - 1) {
+					GROK_ERROR("Stream too short, expected SOT");
+					return false;
+				}
+			}
+		}
+		if (!j2k_pre_write_tile(codeStream, dest_tile_index)) {
+			GROK_ERROR("Error while j2k_pre_write_tile with tile index = %d",
+					dest_tile_index);
+			return false;
+		}
+		if (!truncated
+				&& !j2k_rewrite_same_geometry(src_tileProcessor, tileProcessor,
+						comps)) {
+			GROK_ERROR("Rewrite: geometry of tile %d does not match source",
+					dest_tile_index);
+			return false;
+		}
+		if (!j2k_post_write_tile(codeStream, stream)) {
+			GROK_ERROR("Error while j2k_post_write_tile with tile index = %d",
+					dest_tile_index);
+			return false;
+		}
+		if (!truncated && tileno < nb_tiles - 1
+				&& src_stream->get_number_byte_left() == 0
+				&& src->m_specific_param.m_decoder.m_state
+						== J2K_DEC_STATE_NO_EOC) {
+			GROK_WARN("Rewrite: source is truncated after %d out of %d tiles",
+					tileno + 1, nb_tiles);
+			truncated = true;
+		}
+	}
+	if (tileProcessor->m_current_tile_index != nb_tiles) {
+		GROK_ERROR("Rewrite: only %d out of %d tiles were found in source",
+				tileProcessor->m_current_tile_index, nb_tiles);
+		return false;
+	}
+
+	return true;
+}
+
+bool j2k_rewrite(CodeStream *src, BufferedStream *src_stream,
+		CodeStream *codeStream, BufferedStream *stream,
+		grk_cparameters *parameters) {
+	auto rewrite = &parameters->rewrite;
+	auto decoder = &src->m_specific_param.m_decoder;
+	std::vector<uint32_t> comps;
+	if (!j2k_rewrite_components(rewrite, src->m_private_image->numcomps,
+			&comps))
+		return false;
+	uint32_t tile_x0, tile_y0, tile_x1, tile_y1;
+	if (!j2k_rewrite_tiles(rewrite, &src->m_cp, &tile_x0, &tile_y0, &tile_x1,
+			&tile_y1))
+		return false;
+
+	// only read tiles that are kept
+	decoder->m_start_tile_x_index = tile_x0;
+	decoder->m_start_tile_y_index = tile_y0;
+	decoder->m_end_tile_x_index = tile_x1;
+	decoder->m_end_tile_y_index = tile_y1;
+
+	grk_image_destroy(src->m_output_image);
+	src->m_output_image = grk_image_create0();
+	if (!src->m_output_image)
+		return false;
+	grk_copy_image_header(src->m_private_image, src->m_output_image);
+
+	std::vector<uint32_t> comp_map(src->m_private_image->numcomps,
+			tile_packets_no_component);
+	for (uint32_t compno = 0; compno < comps.size(); ++compno)
+		comp_map[comps[compno]] = compno;
+	auto tcp = codeStream->m_cp.tcps;
+	TilePackets packets(tcp->numlayers, tcp->tccps->numresolutions, comp_map);
+	src->m_tileProcessor->m_packets = &packets;
+	codeStream->m_tileProcessor->m_packets = &packets;
+	bool rc = j2k_rewrite_tile_packets(src, src_stream, codeStream, stream, rewrite,
+			comps, tile_x0, tile_y0);
+	src->m_tileProcessor->m_packets = nullptr;
+	codeStream->m_tileProcessor->m_packets = nullptr;
+
+	return rc;
+}
+
 /* FIXME DOC*/
 static bool j2k_copy_default_tcp_and_create_tcd(CodeStream *codeStream,
 		BufferedStream *stream) {
@@ -2983,7 +3916,7 @@ char* j2k_convert_progression_order(GRK_PROG_ORDER prg_order) {
 	return po->str_prog;
 }
 
-static uint8_t j2k_get_num_tp(CodingParams *cp, uint32_t pino,
+uint8_t j2k_get_num_tp(CodingParams *cp, uint32_t pino,
 		uint16_t tileno) {
 	const char *prog = nullptr;
 	uint64_t num_tp = 1;
@@ -154,6 +154,8 @@ enum J2K_STATUS {
 
 typedef bool (*j2k_procedure)(CodeStream *j2k, BufferedStream*);
 struct TileProcessor;
+struct StripCompressor;
+struct IncrementalDecompressor;
 
 struct CodeStream {
 
@@ -187,6 +189,12 @@ struct CodeStream {
 	/** current TileProcessor **/
 	TileProcessor *m_tileProcessor;
 
+	/** strip compressor (created on first strip pushed) **/
+	StripCompressor *m_strip_compressor;
+
+	/** incremental decompressor (created on first incremental decompress) **/
+	IncrementalDecompressor *m_incremental_decompressor;
+
 };
 
 /** @name Exported functions */
@@ -216,6 +224,17 @@ bool j2k_init_compress(CodeStream *codeStream,  grk_cparameters  *parameters,
  */
 char* j2k_convert_progression_order(GRK_PROG_ORDER prg_order);
 
+/**
+ * Gets the number of tile parts used for the given change of progression (if any) and the given tile.
+ *
+ * @param               cp                      the coding parameters.
+ * @param               pino            the offset of the given poc (i.e. its position in the coding parameter).
+ * @param               tileno          the given tile.
+ *
+ * @return              the number of tile parts.
+ */
+uint8_t j2k_get_num_tp(CodingParams *cp, uint32_t pino, uint16_t tileno);
+
 /* ----------------------------------------------------------------------- */
 /*@}*/
 
@@ -277,6 +296,34 @@ bool j2k_read_tile_header(CodeStream *codeStream, uint16_t *tile_index,
 		uint32_t *p_tile_x1, uint32_t *p_tile_y1, uint32_t *p_nb_comps,
 		bool *p_go_on, BufferedStream *stream);
 
+/**
+ * Reads a complete tile-part header, from the SOT marker up to and
+ * including the SOD marker, stored in a memory buffer.
+ *
+ * @param	codeStream		JPEG 2000 code stream
+ * @param	header			tile-part header
+ * @param	header_len		length of tile-part header
+ * @return	true if the header was successfully read
+ */
+bool j2k_read_tile_part_header(CodeStream *codeStream, uint8_t *header,
+		uint32_t header_len);
+
+/**
+ * Decompresses the part of the code stream that has been received so far.
+ * Packets that become complete are decoded, and only the code blocks that
+ * they contribute to are passed to T1 again, before the affected tiles
+ * are reconstructed into the image.
+ *
+ * @param	codeStream		JPEG 2000 code stream
+ * @param	stream			the stream to read data from
+ * @param	image			image to store the decompressed tiles
+ * @param	complete		set to true once the whole code stream
+ * 							has been decompressed
+ * @return	true if successful
+ */
+bool j2k_decompress_incremental(CodeStream *codeStream, BufferedStream *stream,
+		grk_image *image, bool *complete);
+
 /**
  * Set the given area to be decoded. This function should be called
  * right after grk_read_header and before any tile header reading.
@@ -327,6 +374,111 @@ bool j2k_get_tile(CodeStream *codeStream, BufferedStream *stream, grk_image *p_i
 bool j2k_compress_tile(CodeStream *codeStream, uint16_t tile_index, uint8_t *p_data,
 		uint64_t uncompressed_data_size, BufferedStream *stream);
 
+/**
+ * Compresses a strip of image rows. Tile rows are compressed as soon
+ * as all of their rows have been received.
+ *
+ * @param	codeStream		JPEG 2000 code stream
+ * @param	p_data			planar strip data
+ * @param	num_rows		number of rows in strip
+ * @param	sample_size		size in bytes of each sample (1, 2 or 4)
+ * @param	stream			the stream to write data to.
+ */
+bool j2k_compress_strip(CodeStream *codeStream, const uint8_t *p_data,
+		uint32_t num_rows, uint32_t sample_size, BufferedStream *stream);
+
+/**
+ * Compresses a tile whose rows are stored in a strip buffer
+ *
+ * @param	codeStream		JPEG 2000 code stream
+ * @param	tile_index		index of tile
+ * @param	strip			strip buffer for each component
+ * @param	strip_y0		canvas y coordinate of first row of strip
+ * @param	strip_width		width of strip
+ * @param	stream			the stream to write data to.
+ */
+bool j2k_compress_tile_from_strip(CodeStream *codeStream, uint16_t tile_index,
+		int32_t **strip, uint32_t strip_y0, uint32_t strip_width,
+		BufferedStream *stream);
+
+/**
+ * Sets up compress parameters for transcoding a code stream to HTJ2K:
+ * tile layout, wavelet, code block and precinct partitions and progression
+ * order are taken from the main header of the source code stream.
+ *
+ * @param	src				source code stream, with main header read
+ * @param	parameters		compress parameters
+ * @return true if the source code stream can be transcoded
+ */
+bool j2k_init_transcode(CodeStream *src, grk_cparameters *parameters);
+
+/**
+ * Copies quantization of source code stream to the compressor, and checks
+ * that both coding structures match. Must be called after j2k_init_compress
+ * and before j2k_start_compress.
+ *
+ * @param	src				source code stream
+ * @param	codeStream		JPEG 2000 code stream being compressed
+ * @return true if successful
+ */
+bool j2k_init_transcode_compress(CodeStream *src, CodeStream *codeStream);
+
+/**
+ * Transcodes all tiles of source code stream: code blocks are decompressed
+ * to wavelet coefficients, which are then compressed with the HT block coder.
+ *
+ * @param	src				source code stream
+ * @param	src_stream		the stream to read source data from.
+ * @param	codeStream		JPEG 2000 code stream being compressed
+ * @param	stream			the stream to write data to.
+ * @return true if successful
+ */
+bool j2k_transcode(CodeStream *src, BufferedStream *src_stream,
+		CodeStream *codeStream, BufferedStream *stream);
+
+/**
+ * Sets up compress parameters for rewriting the packets of a code stream:
+ * coding structure is taken from the main header of the source code stream,
+ * with the layers, resolutions, components and tiles selected by
+ * parameters->rewrite.
+ *
+ * @param	src				source code stream, with main header read
+ * @param	parameters		compress parameters
+ * @param	image			source image header
+ * @return header of rewritten image, or nullptr if the source code stream
+ * cannot be rewritten. Caller must destroy image.
+ */
+grk_image* j2k_init_rewrite(CodeStream *src, grk_cparameters *parameters,
+		grk_image *image);
+
+/**
+ * Copies quantization of source code stream to the compressor, and checks
+ * that packets of source code stream can be copied unchanged.
+ * Must be called after j2k_init_compress and before j2k_start_compress.
+ *
+ * @param	src				source code stream
+ * @param	codeStream		JPEG 2000 code stream being compressed
+ * @param	parameters		compress parameters
+ * @return true if successful
+ */
+bool j2k_init_rewrite_compress(CodeStream *src, CodeStream *codeStream,
+		grk_cparameters *parameters);
+
+/**
+ * Rewrites selected tiles of source code stream: packets of kept layers,
+ * resolutions and components are copied without decoding any code blocks.
+ *
+ * @param	src				source code stream
+ * @param	src_stream		the stream to read source data from.
+ * @param	codeStream		JPEG 2000 code stream being compressed
+ * @param	stream			the stream to write data to.
+ * @param	parameters		compress parameters
+ * @return true if successful
+ */
+bool j2k_rewrite(CodeStream *src, BufferedStream *src_stream,
+		CodeStream *codeStream, BufferedStream *stream,
+		grk_cparameters *parameters);
+
 /**
  * Encodes an image into a JPEG 2000 code stream
  */
@@ -259,6 +259,8 @@ struct EncodingParams {
 	bool writeTLM;
 	/* rate control algorithm */
 	uint32_t rateControlAlgorithm;
+	/* skip coding passes that rate control will discard */
+	bool earlyTermination;
 };
 
 struct DecodingParams {
@@ -266,6 +268,12 @@ struct DecodingParams {
 	uint32_t m_reduce;
 	/** if != 0, then only the first "layer" layers are decoded; if == 0 or not used, all the quality layers are decoded */
 	uint32_t m_layer;
+	/** if != 0, maximum number of bytes of compressed data to decode, shared among tiles */
+	uint64_t m_max_bytes;
+	/** if != 0, maximum number of bytes of compressed data to decode in each tile */
+	uint64_t m_max_tile_bytes;
+	/** if true, the inverse 9-7 transform of components of 8 bits precision or less runs in 16 bit fixed point */
+	bool m_fast_preview;
 };
 
 /**
@@ -366,6 +374,9 @@ struct DecoderState {
 	bool ready_to_decode_tile_part_data;
 	bool m_discard_tiles;
 	bool m_skip_data;
+	// number of bytes following the main header, or 0 if unknown:
+	// used to share byte budget among tiles
+	uint64_t m_tile_data_len;
 
 };
 
@@ -3065,6 +3065,18 @@ bool jp2_compress_tile(FileFormat *fileFormat, uint16_t tile_index, uint8_t *p_d
 	return j2k_compress_tile(fileFormat->j2k, tile_index, p_data, uncompressed_data_size, stream);
 }
 
+bool jp2_compress_strip(FileFormat *fileFormat, const uint8_t *p_data,
+		uint32_t num_rows, uint32_t sample_size, BufferedStream *stream) {
+	return j2k_compress_strip(fileFormat->j2k, p_data, num_rows, sample_size,
+			stream);
+}
+
+bool jp2_decompress_incremental(FileFormat *fileFormat, BufferedStream *stream,
+		grk_image *p_image, bool *complete) {
+	return j2k_decompress_incremental(fileFormat->j2k, stream, p_image,
+			complete);
+}
+
 bool jp2_decompress_tile(FileFormat *fileFormat, uint16_t tile_index, uint8_t *p_data,
 		uint64_t data_size, BufferedStream *stream) {
 	bool rc = false;
@@ -298,6 +298,18 @@ bool jp2_compress(FileFormat *fileFormat, grk_plugin_tile *tile, BufferedStream
 bool jp2_compress_tile(FileFormat *fileFormat, uint16_t tile_index, uint8_t *p_data,
 		uint64_t uncompressed_data_size, BufferedStream *stream);
 
+/**
+ * Compress strip of image rows
+ *
+ * @param  fileFormat    JPEG 2000 code stream
+ * @param p_data        planar strip data
+ * @param num_rows      number of rows in strip
+ * @param sample_size   size in bytes of each sample (1, 2 or 4)
+ * @param  stream      the stream to write data to.
+ */
+bool jp2_compress_strip(FileFormat *fileFormat, const uint8_t *p_data,
+		uint32_t num_rows, uint32_t sample_size, BufferedStream *stream);
+
 /**
  * Ends the compression procedures and possibly add data to be read after the
  * code stream.
@@ -328,6 +340,20 @@ void jp2_init_decompress(void *fileFormat,  grk_dparameters  *parameters);
 bool jp2_decompress(FileFormat *fileFormat, grk_plugin_tile *tile, BufferedStream *stream,
 		grk_image *p_image);
 
+/**
+ * Decompress the part of a JPEG 2000 file stream that has been received so far.
+ * Colour boxes (palette, component definition) are not applied to the image.
+ *
+ * @param fileFormat JP2 decompressor handle
+ * @param stream  stream
+ * @param p_image image
+ * @param complete set to true once the whole code stream has been decompressed
+ *
+ * @return true if successful
+ */
+bool jp2_decompress_incremental(FileFormat *fileFormat, BufferedStream *stream,
+		grk_image *p_image, bool *complete);
+
 /**
  * Ends the decompression procedures and possibly add data to be read after the
  * code stream.
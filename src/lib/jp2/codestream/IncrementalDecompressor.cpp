@@ -0,0 +1,388 @@
+/*
+ *    Copyright (C) 2016-2020 Grok Image Compression Inc.
+ *
+ *    This source code is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This source code is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include "grok_includes.h"
+#include "Tier1.h"
+
+namespace grk {
+
+IncrementalDecompressor::IncrementalDecompressor(CodeStream *codeStream,
+		BufferedStream *stream) :
+		m_codeStream(codeStream), m_stream(stream), m_t2(nullptr), m_pos(0), m_eoc(
+				false), m_tile_part_remaining(0), m_tile_part_skip(false), m_tile_part_dest(
+				nullptr), m_tile_active(false), m_pi(nullptr), m_num_pocs(0), m_pino(
+				0), m_packet_pending(false), m_packet_offset(0) {
+}
+
+IncrementalDecompressor::~IncrementalDecompressor() {
+	if (m_pi)
+		pi_destroy(m_pi, m_num_pocs);
+	delete m_t2;
+}
+
+bool IncrementalDecompressor::init(grk_image *image) {
+	auto decoder = &m_codeStream->m_specific_param.m_decoder;
+	auto tileProcessor = m_codeStream->m_tileProcessor;
+	if (!tileProcessor || decoder->m_state != J2K_DEC_STATE_TPH_SOT) {
+		GROK_ERROR(
+				"Incremental decompression must start right after the main header");
+		return false;
+	}
+	if (!tileProcessor->whole_tile_decoding) {
+		GROK_ERROR(
+				"Incremental decompression does not support decompress areas");
+		return false;
+	}
+	if (tileProcessor->current_plugin_tile) {
+		GROK_ERROR("Incremental decompression does not support plugins");
+		return false;
+	}
+	if (m_codeStream->m_cp.t_grid_width * m_codeStream->m_cp.t_grid_height
+			!= 1) {
+		GROK_ERROR(
+				"Incremental decompression only supports images with a single tile");
+		return false;
+	}
+	// stream is positioned just after SOT marker id of first tile-part
+	m_pos = m_stream->tell() - 2;
+
+	if (!m_codeStream->m_output_image) {
+		m_codeStream->m_output_image = grk_image_create0();
+		if (!m_codeStream->m_output_image)
+			return false;
+		grk_copy_image_header(image, m_codeStream->m_output_image);
+	}
+	m_t2 = new T2(tileProcessor);
+
+	return true;
+}
+
+bool IncrementalDecompressor::decompress(grk_image *image, bool *complete) {
+	*complete = false;
+	if (!read_available())
+		return false;
+
+	auto cp = &m_codeStream->m_cp;
+	auto tcp = cp->tcps;
+	bool tile_complete = m_eoc
+			|| (tcp->m_nb_tile_parts
+					&& m_tile.num_tile_parts == tcp->m_nb_tile_parts
+					&& !m_tile_part_remaining);
+	// packet headers stored in PPM/PPT markers are only read
+	// once all of their markers have been received
+	bool headers_complete = !(cp->ppm && !m_eoc)
+			&& !(tcp->ppt && !tile_complete);
+	if (m_tile.dirty && headers_complete) {
+		if (!decompress_tile(tile_complete, image))
+			return false;
+		m_tile.dirty = false;
+	}
+	*complete = m_eoc;
+
+	return true;
+}
+
+bool IncrementalDecompressor::read_header_bytes(size_t len) {
+	if (m_header.size() >= len)
+		return true;
+	if (m_stream->m_user_data_length < m_pos + len)
+		return false;
+	size_t offset = m_header.size();
+	m_header.resize(len);
+	if (!m_stream->seek(m_pos + offset)
+			|| m_stream->read(m_header.data() + offset, len - offset)
+					!= len - offset) {
+		m_header.resize(offset);
+		return false;
+	}
+
+	return true;
+}
+
+bool IncrementalDecompressor::read_tile_part_header(bool *done) {
+	*done = false;
+	if (!read_header_bytes(2))
+		return true;
+	uint32_t marker = 0;
+	grk_read<uint32_t>(m_header.data(), &marker, 2);
+	if (marker == J2K_MS_EOC) {
+		m_pos += 2;
+		m_header.clear();
+		m_eoc = true;
+		m_codeStream->m_specific_param.m_decoder.m_state = J2K_DEC_STATE_EOC;
+		// tile that was decompressed without knowing that its data
+		// was complete must be decompressed again
+		if (m_tile.seen)
+			m_tile.dirty = true;
+		*done = true;
+		return true;
+	}
+	if (marker != J2K_MS_SOT) {
+		GROK_ERROR("Expected SOT or EOC marker, but found marker 0x%x",
+				marker);
+		return false;
+	}
+	if (!read_header_bytes(sot_marker_segment_len))
+		return true;
+	uint32_t psot = 0;
+	grk_read<uint32_t>(m_header.data() + 6, &psot, 4);
+	if (psot == 0) {
+		GROK_ERROR("Incremental decompression requires tile-part lengths "
+				"(Psot must not be zero)");
+		return false;
+	}
+
+	// find SOD marker
+	size_t header_len = sot_marker_segment_len;
+	while (true) {
+		if (!read_header_bytes(header_len + 2))
+			return true;
+		grk_read<uint32_t>(m_header.data() + header_len, &marker, 2);
+		if (marker == J2K_MS_SOD) {
+			header_len += 2;
+			break;
+		}
+		if (!read_header_bytes(header_len + 4))
+			return true;
+		uint32_t marker_size = 0;
+		grk_read<uint32_t>(m_header.data() + header_len + 2, &marker_size,
+				2);
+		header_len += 2 + marker_size;
+		if (marker_size < 2 || header_len > psot) {
+			GROK_ERROR("Inconsistent marker size in tile-part header");
+			return false;
+		}
+	}
+	if (header_len > psot) {
+		GROK_ERROR("Tile-part header is longer than tile-part");
+		return false;
+	}
+	if (!j2k_read_tile_part_header(m_codeStream, m_header.data(),
+			(uint32_t) header_len))
+		return false;
+	m_pos += header_len;
+	m_header.clear();
+
+	m_tile_part_remaining = psot - header_len;
+	m_tile_part_skip = m_codeStream->m_specific_param.m_decoder.m_skip_data;
+	m_tile_part_dest = nullptr;
+	if (!m_tile_part_skip) {
+		m_tile.seen = true;
+		m_tile.num_tile_parts++;
+		m_tile.dirty = true;
+		auto tcp = m_codeStream->m_cp.tcps;
+		if (!tcp->m_tile_data)
+			tcp->m_tile_data = new ChunkBuffer();
+		// chunk is allocated ahead of time, so that pointers into
+		// tile data remain valid while the chunk is filled
+		if (m_tile_part_remaining) {
+			m_tile_part_dest = new uint8_t[m_tile_part_remaining];
+			tcp->m_tile_data->add_chunk(m_tile_part_dest, 0, true);
+		}
+	}
+	*done = true;
+
+	return true;
+}
+
+bool IncrementalDecompressor::read_available(void) {
+	while (!m_eoc) {
+		if (m_tile_part_remaining) {
+			uint64_t available =
+					m_stream->m_user_data_length > m_pos ?
+							m_stream->m_user_data_length - m_pos : 0;
+			if (!available)
+				return true;
+			size_t len = (size_t) std::min<uint64_t>(available,
+					m_tile_part_remaining);
+			if (!m_tile_part_skip) {
+				if (!m_stream->seek(m_pos)
+						|| m_stream->read(m_tile_part_dest, len) != len) {
+					GROK_ERROR("Failed to read tile-part data");
+					return false;
+				}
+				auto tcp = m_codeStream->m_cp.tcps;
+				tcp->m_tile_data->extend_last_chunk(len);
+				m_tile_part_dest += len;
+				m_tile.dirty = true;
+			}
+			m_pos += len;
+			m_tile_part_remaining -= len;
+			continue;
+		}
+		bool done = false;
+		if (!read_tile_part_header(&done))
+			return false;
+		if (!done)
+			return true;
+	}
+	return true;
+}
+
+bool IncrementalDecompressor::activate_tile(void) {
+	auto tileProcessor = m_codeStream->m_tileProcessor;
+	auto cp = &m_codeStream->m_cp;
+	auto tcp = cp->tcps;
+
+	if (tcp->ppt && !tcp->ppt_buffer && !j2k_merge_ppt(tcp)) {
+		GROK_ERROR("Failed to merge PPT data");
+		return false;
+	}
+	if (!tileProcessor->init_tile(0, m_codeStream->m_output_image, false)) {
+		GROK_ERROR("Cannot decompress tile 0");
+		return false;
+	}
+	m_pi = pi_create_decode(tileProcessor->image, cp, 0);
+	if (!m_pi)
+		return false;
+	m_num_pocs = tcp->numpocs + 1;
+	m_tile_active = true;
+
+	return true;
+}
+
+bool IncrementalDecompressor::decode_packets(bool truncated) {
+	auto tileProcessor = m_codeStream->m_tileProcessor;
+	auto tcp = m_codeStream->m_cp.tcps;
+	auto src_buf = tcp->m_tile_data;
+	if (!src_buf || !src_buf->data_len)
+		return true;
+	if (!src_buf->seek(m_packet_offset))
+		return false;
+	while (m_pino < m_num_pocs) {
+		auto current_pi = m_pi + m_pino;
+		if (current_pi->poc.prg == GRK_PROG_UNKNOWN) {
+			GROK_ERROR("decode_packets: Unknown progression order");
+			return false;
+		}
+		if (!m_packet_pending) {
+			if (!pi_next(current_pi)) {
+				++m_pino;
+				continue;
+			}
+			m_packet_pending = true;
+		}
+		auto tilec = tileProcessor->tile->comps + current_pi->compno;
+		bool skip = current_pi->layno >= tcp->num_layers_to_decode
+				|| current_pi->resno >= tilec->minimum_num_resolutions;
+		bool decoded = false;
+		uint64_t max_length =
+				truncated ?
+						src_buf->data_len - src_buf->get_global_offset() :
+						UINT64_MAX;
+		if (!m_t2->decode_packet_if_complete(tcp, current_pi, src_buf, skip,
+				max_length, &decoded))
+			return false;
+		if (!decoded)
+			break;
+		m_packet_pending = false;
+		m_packet_offset = src_buf->get_global_offset();
+	}
+
+	return true;
+}
+
+bool IncrementalDecompressor::decode_codeblocks(bool *changed) {
+	auto tileProcessor = m_codeStream->m_tileProcessor;
+	auto tcp = m_codeStream->m_cp.tcps;
+	auto tile = tileProcessor->tile;
+	auto state = &m_tile;
+
+	*changed = false;
+	state->coefficients.resize(tile->numcomps);
+	size_t block_index = 0;
+	for (uint32_t compno = 0; compno < tile->numcomps; ++compno) {
+		auto tilec = tile->comps + compno;
+		std::vector<decodeBlockInfo*> blocks;
+		auto t1_wrap = std::unique_ptr<Tier1>(new Tier1());
+		if (!t1_wrap->prepareDecodeCodeblocks(tilec, tcp->tccps + compno,
+				&blocks))
+			return false;
+
+		// restore coefficients of code blocks decoded previously
+		auto data = tilec->buf->data;
+		uint64_t area = tilec->buf->reduced_region_dim.area();
+		auto &coefficients = state->coefficients[compno];
+		if (data) {
+			if (coefficients.size() == area)
+				memcpy(data, coefficients.data(), area * sizeof(int32_t));
+			else
+				memset(data, 0, area * sizeof(int32_t));
+		}
+
+		std::vector<decodeBlockInfo*> changed_blocks;
+		if (state->blocks.size() < block_index + blocks.size())
+			state->blocks.resize(block_index + blocks.size(), BlockState { 0,
+					0 });
+		for (auto block : blocks) {
+			auto cblk = block->cblk;
+			BlockState current { 0, cblk->seg_buffers.get_len() };
+			for (uint32_t segno = 0; segno < cblk->numSegments; ++segno)
+				current.num_passes += cblk->segs[segno].numpasses;
+			auto previous = &state->blocks[block_index++];
+			if (current == *previous) {
+				delete block;
+				continue;
+			}
+			*previous = current;
+			changed_blocks.push_back(block);
+		}
+		if (changed_blocks.empty())
+			continue;
+		*changed = true;
+		// !!! assume that code block dimensions do not change over components
+		if (!t1_wrap->decodeCodeblocks(tcp, (uint16_t) tcp->tccps->cblkw,
+				(uint16_t) tcp->tccps->cblkh, &changed_blocks))
+			return false;
+		if (data)
+			coefficients.assign(data, data + area);
+	}
+
+	return true;
+}
+
+bool IncrementalDecompressor::reconstruct(grk_image *image) {
+	auto tileProcessor = m_codeStream->m_tileProcessor;
+	// tile data buffer is overwritten by inverse transforms, so
+	// coefficients are restored from saved copy on next update
+	if (!tileProcessor->reconstruct_tile(0))
+		return false;
+	uint64_t len = tileProcessor->get_uncompressed_tile_size(true);
+	if (m_composite.size() < len)
+		m_composite.resize(len);
+	if (!tileProcessor->composite_tile(m_composite.data(), len))
+		return false;
+
+	return tileProcessor->copy_decompressed_tile_to_output_image(
+			m_composite.data(), image, true);
+}
+
+bool IncrementalDecompressor::decompress_tile(bool complete,
+		grk_image *image) {
+	if (!m_tile_active && !activate_tile())
+		return false;
+	if (!decode_packets(!complete))
+		return false;
+	bool changed = false;
+	if (!decode_codeblocks(&changed))
+		return false;
+
+	return !changed || reconstruct(image);
+}
+
+}
@@ -0,0 +1,133 @@
+/*
+ *    Copyright (C) 2016-2020 Grok Image Compression Inc.
+ *
+ *    This source code is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This source code is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#pragma once
+#include <vector>
+
+namespace grk {
+
+struct T2;
+struct PacketIter;
+
+/*  IncrementalDecompressor
+
+ Decompress a code stream that is still being received, for example over
+ a network connection. Each call decodes whatever has arrived since the
+ previous call, and updates the output image.
+
+ Tile-part data is appended to the tile's chunk buffer as it arrives.
+ Packets are decoded as soon as all of their bytes are available: the
+ packet iterator and the T2 state of the tile's precincts are kept between
+ calls, and a partially received packet is rolled back and re-read on the
+ next call. Only code blocks which received new passes are passed to T1
+ again; the other code blocks keep their coefficients from a saved copy
+ of the tile's coefficient plane. If the tile changed, it is then
+ reconstructed (inverse DWT, MCT and DC shift) and copied into the output
+ image.
+
+ The tile processor holds the T2 state of a single tile, so only single-tile
+ images are supported: this keeps one tile's worth of saved coefficients,
+ and packets are never parsed twice.
+
+ Requirements: the image must have a single tile, the main header must be
+ complete before decompression starts, every tile-part must signal its
+ length (Psot != 0), and the whole image must be decompressed (no decompress
+ area).
+
+ */
+struct IncrementalDecompressor {
+	IncrementalDecompressor(CodeStream *codeStream, BufferedStream *stream);
+	~IncrementalDecompressor();
+
+	/*
+	 Check that code stream can be decompressed incrementally
+	 */
+	bool init(grk_image *image);
+
+	/*
+	 Read newly available data, and decompress the tiles that it affects.
+	 complete is set to true once the EOC marker has been read and all
+	 tiles have been decompressed.
+	 */
+	bool decompress(grk_image *image, bool *complete);
+
+private:
+	/* State of a code block, used to detect code blocks that need
+	 to be decoded again */
+	struct BlockState {
+		bool operator==(const BlockState &rhs) const {
+			return num_passes == rhs.num_passes && data_len == rhs.data_len;
+		}
+		uint32_t num_passes;
+		size_t data_len;
+	};
+
+	/* State of a tile */
+	struct TileState {
+		TileState() :
+				seen(false), dirty(false), num_tile_parts(0) {
+		}
+		bool seen;
+		// new data has arrived since tile was last decompressed
+		bool dirty;
+		uint32_t num_tile_parts;
+		// coefficients of each component, after T1
+		std::vector<std::vector<int32_t> > coefficients;
+		std::vector<BlockState> blocks;
+	};
+
+	bool read_available(void);
+	bool read_tile_part_header(bool *done);
+	bool read_header_bytes(size_t len);
+	bool decompress_tile(bool complete, grk_image *image);
+	bool activate_tile(void);
+	bool decode_packets(bool truncated);
+	bool decode_codeblocks(bool *changed);
+	bool reconstruct(grk_image *image);
+
+	CodeStream *m_codeStream;
+	BufferedStream *m_stream;
+	T2 *m_t2;
+
+	// stream offset of next byte of code stream to be read
+	uint64_t m_pos;
+	// true once EOC marker has been read
+	bool m_eoc;
+	// header of tile-part being received
+	std::vector<uint8_t> m_header;
+
+	// tile-part data still to be received
+	uint64_t m_tile_part_remaining;
+	bool m_tile_part_skip;
+	uint8_t *m_tile_part_dest;
+
+	TileState m_tile;
+	// true once tile has been initialized in tile processor
+	bool m_tile_active;
+	PacketIter *m_pi;
+	uint32_t m_num_pocs;
+	uint32_t m_pino;
+	// true if m_pi points to a packet that has not been decoded yet
+	bool m_packet_pending;
+	// offset of next packet in tile data
+	size_t m_packet_offset;
+
+	std::vector<uint8_t> m_composite;
+};
+
+}
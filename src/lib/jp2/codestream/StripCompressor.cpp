@@ -0,0 +1,203 @@
+/*
+ *    Copyright (C) 2016-2020 Grok Image Compression Inc.
+ *
+ *    This source code is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This source code is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "grok_includes.h"
+
+namespace grk {
+
+template<typename T> void copy_strip_rows(const uint8_t *src, int32_t *dest,
+		uint64_t num_samples) {
+	auto src_ptr = (const T*) src;
+	for (uint64_t i = 0; i < num_samples; ++i)
+		dest[i] = src_ptr[i];
+}
+
+StripCompressor::StripCompressor(CodeStream *codeStream,
+		BufferedStream *stream) :
+		m_codeStream(codeStream), m_stream(stream), m_numcomps(0), m_width(0), m_strips {
+				nullptr, nullptr }, m_active_strip(0), m_tile_row(0), m_strip_y0(
+				0), m_strip_y1(0), m_strip_rows(0) {
+}
+
+StripCompressor::~StripCompressor() {
+	if (m_pending.valid())
+		m_pending.wait();
+	for (uint32_t i = 0; i < 2; ++i) {
+		if (!m_strips[i])
+			continue;
+		for (uint32_t compno = 0; compno < m_numcomps; ++compno)
+			grk_aligned_free(m_strips[i][compno]);
+		delete[] m_strips[i];
+	}
+}
+
+bool StripCompressor::init(void) {
+	auto image = m_codeStream->m_private_image;
+	auto cp = &m_codeStream->m_cp;
+
+	for (uint32_t compno = 0; compno < image->numcomps; ++compno) {
+		auto comp = image->comps + compno;
+		if (comp->dx != 1 || comp->dy != 1) {
+			GROK_ERROR(
+					"Strip compression does not support sub-sampled components");
+			return false;
+		}
+		if (comp->prec > 16) {
+			GROK_ERROR("Strip compression: precision %d not supported",
+					comp->prec);
+			return false;
+		}
+	}
+	if (m_codeStream->m_tileProcessor->m_current_tile_index != 0) {
+		GROK_ERROR("Strip compression cannot be mixed with tile compression");
+		return false;
+	}
+	m_numcomps = image->numcomps;
+	m_width = image->x1 - image->x0;
+	m_strip_y0 = image->y0;
+	m_strip_y1 = std::min<uint32_t>(cp->ty0 + cp->t_height, image->y1);
+
+	uint64_t strip_len = (uint64_t) m_width * cp->t_height;
+	for (uint32_t i = 0; i < 2; ++i) {
+		m_strips[i] = new int32_t*[m_numcomps]();
+		for (uint32_t compno = 0; compno < m_numcomps; ++compno) {
+			m_strips[i][compno] = (int32_t*) grk_aligned_malloc(
+					strip_len * sizeof(int32_t));
+			if (!m_strips[i][compno]) {
+				GROK_ERROR("Strip compression: failed to allocate strip buffer");
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+bool StripCompressor::push(const uint8_t *data, uint32_t num_rows,
+		uint32_t sample_size) {
+	if (!data || !num_rows)
+		return false;
+	if (sample_size != 1 && sample_size != 2 && sample_size != 4) {
+		GROK_ERROR("Strip compression: invalid sample size %d", sample_size);
+		return false;
+	}
+	auto image = m_codeStream->m_private_image;
+	if (m_strip_y0 + m_strip_rows + num_rows > image->y1
+			|| m_strip_y0 + m_strip_rows + num_rows < m_strip_y0) {
+		GROK_ERROR("Strip compression: rows pushed exceed image height");
+		return false;
+	}
+	uint64_t plane_len = (uint64_t) num_rows * m_width * sample_size;
+	uint32_t rows_pushed = 0;
+	while (rows_pushed < num_rows) {
+		uint32_t rows = std::min<uint32_t>(num_rows - rows_pushed,
+				m_strip_y1 - m_strip_y0 - m_strip_rows);
+		uint64_t num_samples = (uint64_t) rows * m_width;
+		for (uint32_t compno = 0; compno < m_numcomps; ++compno) {
+			auto src = data + compno * plane_len
+					+ (uint64_t) rows_pushed * m_width * sample_size;
+			auto dest = m_strips[m_active_strip][compno]
+					+ (uint64_t) m_strip_rows * m_width;
+			bool sgnd = image->comps[compno].sgnd;
+			switch (sample_size) {
+			case 1:
+				if (sgnd)
+					copy_strip_rows<int8_t>(src, dest, num_samples);
+				else
+					copy_strip_rows<uint8_t>(src, dest, num_samples);
+				break;
+			case 2:
+				if (sgnd)
+					copy_strip_rows<int16_t>(src, dest, num_samples);
+				else
+					copy_strip_rows<uint16_t>(src, dest, num_samples);
+				break;
+			case 4:
+				memcpy(dest, src, num_samples * sizeof(int32_t));
+				break;
+			}
+		}
+		rows_pushed += rows;
+		m_strip_rows += rows;
+
+		// tile row is complete: compress it in the background
+		if (m_strip_y0 + m_strip_rows == m_strip_y1) {
+			if (!wait())
+				return false;
+			auto strip = m_strips[m_active_strip];
+			auto tile_row = m_tile_row;
+			auto strip_y0 = m_strip_y0;
+			m_pending = std::async(std::launch::async,
+					[this, strip, tile_row, strip_y0] {
+						return compress_tile_row(strip, tile_row, strip_y0);
+					});
+			m_active_strip ^= 1;
+			next_tile_row();
+		}
+	}
+
+	return true;
+}
+
+void StripCompressor::next_tile_row(void) {
+	auto cp = &m_codeStream->m_cp;
+	auto image = m_codeStream->m_private_image;
+
+	m_tile_row++;
+	m_strip_y0 = m_strip_y1;
+	m_strip_y1 = std::min<uint32_t>(
+			uint_adds(cp->ty0 + m_tile_row * cp->t_height, cp->t_height),
+			image->y1);
+	m_strip_rows = 0;
+}
+
+bool StripCompressor::compress_tile_row(int32_t **strip, uint32_t tile_row,
+		uint32_t strip_y0) {
+	auto cp = &m_codeStream->m_cp;
+	for (uint32_t tile_col = 0; tile_col < cp->t_grid_width; ++tile_col) {
+		auto tile_index = (uint16_t) (tile_row * cp->t_grid_width + tile_col);
+		if (!j2k_compress_tile_from_strip(m_codeStream, tile_index, strip,
+				strip_y0, m_width, m_stream))
+			return false;
+	}
+
+	return true;
+}
+
+bool StripCompressor::wait(void) {
+	if (!m_pending.valid())
+		return true;
+
+	return m_pending.get();
+}
+
+bool StripCompressor::finish(void) {
+	if (!wait())
+		return false;
+	if (m_strip_y0 < m_codeStream->m_private_image->y1) {
+		GROK_ERROR(
+				"Strip compression: only %d out of %d image rows were pushed",
+				m_strip_y0 + m_strip_rows - m_codeStream->m_private_image->y0,
+				m_codeStream->m_private_image->y1
+						- m_codeStream->m_private_image->y0);
+		return false;
+	}
+
+	return true;
+}
+
+}
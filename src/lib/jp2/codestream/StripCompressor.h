@@ -0,0 +1,82 @@
+/*
+ *    Copyright (C) 2016-2020 Grok Image Compression Inc.
+ *
+ *    This source code is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This source code is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#pragma once
+#include <future>
+
+namespace grk {
+
+/*  StripCompressor
+
+ Compress an image which is pushed to the compressor as a sequence of
+ horizontal strips, from top to bottom.
+
+ Rows are buffered until a full row of tiles is available; the tile row
+ is then compressed in the background while the caller pushes the rows
+ for the next tile row. At most two tile rows are held in memory, so peak
+ memory is bounded by 2 x tile height x image width x number of components,
+ independent of image height.
+
+ */
+struct StripCompressor {
+	StripCompressor(CodeStream *codeStream, BufferedStream *stream);
+	~StripCompressor();
+
+	/*
+	 Validate image and allocate strip buffers
+	 */
+	bool init(void);
+
+	/*
+	 Push num_rows rows of planar data. Each sample is stored in sample_size
+	 bytes (1, 2 or 4), with signedness given by the image component.
+	 */
+	bool push(const uint8_t *data, uint32_t num_rows, uint32_t sample_size);
+
+	/*
+	 Wait for last tile row to be compressed. Returns false if
+	 compression failed, or if not all image rows were pushed.
+	 */
+	bool finish(void);
+
+private:
+	bool compress_tile_row(int32_t **strip, uint32_t tile_row,
+			uint32_t strip_y0);
+	bool wait(void);
+	void next_tile_row(void);
+
+	CodeStream *m_codeStream;
+	BufferedStream *m_stream;
+	uint32_t m_numcomps;
+	uint32_t m_width;
+
+	// strip buffers: one is filled by caller while the other is compressed
+	int32_t **m_strips[2];
+	uint32_t m_active_strip;
+
+	uint32_t m_tile_row;
+	// canvas coordinates of rows belonging to current tile row
+	uint32_t m_strip_y0;
+	uint32_t m_strip_y1;
+	// number of rows already pushed for current tile row
+	uint32_t m_strip_rows;
+
+	std::future<bool> m_pending;
+};
+
+}
@@ -217,6 +217,15 @@ void TagTree::reset() {
 	}
 }
 
+void TagTree::save_state(std::vector<TagTreeNode> *state) const {
+	state->assign(nodes, nodes + numnodes);
+}
+
+void TagTree::restore_state(const std::vector<TagTreeNode> &state) {
+	assert(state.size() == numnodes);
+	std::copy(state.begin(), state.end(), nodes);
+}
+
 void TagTree::setvalue(uint64_t leafno, int64_t value) {
 	TagTreeNode *node;
 	node = &nodes[leafno];
@@ -106,6 +106,19 @@ public:
 	 Reset a tag tree (set all leaves to 0)
 	 */
 	void reset();
+
+	/**
+	 Copy the state of all nodes, so that it can be restored
+	 after a partial decode
+	 @param state vector to store node state
+	 */
+	void save_state(std::vector<TagTreeNode> *state) const;
+
+	/**
+	 Restore state of all nodes, previously stored with save_state
+	 @param state stored node state
+	 */
+	void restore_state(const std::vector<TagTreeNode> &state);
 	/**
 	 Set the value of a leaf of a tag tree
 	 @param leafno Number that identifies the leaf to modify
@@ -111,6 +111,10 @@ struct grk_codec_private {
 					grk_image *p_image,
 					uint16_t tile_index);
 
+			/** Incremental decoding function */
+			bool (*decompress_incremental)(void *p_codec, BufferedStream *p_cio,
+					grk_image *p_image, bool *complete);
+
 		} m_decompression;
 
 		/**
@@ -125,6 +129,10 @@ struct grk_codec_private {
 			bool (*write_tile)(void *p_codec, uint16_t tile_index,
 					uint8_t *p_data, uint64_t data_size, BufferedStream *p_cio);
 
+			bool (*write_strip)(void *p_codec, const uint8_t *p_data,
+					uint32_t num_rows, uint32_t sample_size,
+					BufferedStream *p_cio);
+
 			bool (*end_compress)(void *p_codec, BufferedStream *p_cio);
 
 			void (*destroy)(void *p_codec);
@@ -142,14 +150,38 @@ struct grk_codec_private {
 			FILE *output_stream);
 	 grk_codestream_info_v2  *  (*get_codec_info)(void *p_codec);
 	 grk_codestream_index  *  (*grk_get_codec_index)(void *p_codec);
+	/** JPEG 2000 code stream of codec */
+	CodeStream* (*get_code_stream)(void *p_codec);
+	/** maximum number of concurrent thread pool jobs (0: no limit) */
+	uint32_t m_num_jobs;
+};
+
+/**
+ * Apply the job limit of a codec to the calling thread, for the duration of a call
+ */
+struct CodecJobLimit {
+	CodecJobLimit(const grk_codec_private *codec) :
+			m_prev(ThreadPool::job_limit) {
+		ThreadPool::job_limit = codec->m_num_jobs;
+	}
+	~CodecJobLimit() {
+		ThreadPool::job_limit = m_prev;
+	}
+	uint32_t m_prev;
 };
 
-ThreadPool* ThreadPool::singleton = nullptr;
-std::mutex ThreadPool::singleton_mutex;
+static CodeStream* j2k_get_code_stream(void *p_codec) {
+	return (CodeStream*) p_codec;
+}
+static CodeStream* jp2_get_code_stream(void *p_codec) {
+	return ((FileFormat*) p_codec)->j2k;
+}
 
 static bool is_plugin_initialized = false;
 bool GRK_CALLCONV grk_initialize(const char *plugin_path, uint32_t numthreads) {
 	ThreadPool::instance(numthreads);
+	// choose SIMD kernels for this CPU
+	simd_kernels();
 	if (!is_plugin_initialized) {
 		grk_plugin_load_info info;
 		info.plugin_path = plugin_path;
@@ -253,6 +285,7 @@ const char* GRK_CALLCONV grk_version(void) {
 	switch (p_format) {
 	case GRK_CODEC_J2K:
 		l_codec->grk_dump_codec = (void (*)(void*, int32_t, FILE*)) j2k_dump;
+		l_codec->get_code_stream = j2k_get_code_stream;
 
 		l_codec->get_codec_info =
 				( grk_codestream_info_v2  *  (*)(void*)) j2k_get_cstr_info;
@@ -289,6 +322,9 @@ const char* GRK_CALLCONV grk_version(void) {
 		l_codec->m_codec_data.m_decompression.get_decoded_tile = (bool (*)(
 				void *p_codec, BufferedStream *p_cio, grk_image *p_image, uint16_t tile_index)) j2k_get_tile;
 
+		l_codec->m_codec_data.m_decompression.decompress_incremental = (bool (*)(
+				void*, BufferedStream*, grk_image*, bool*)) j2k_decompress_incremental;
+
 		l_codec->m_codec = j2k_create_decompress();
 
 		if (!l_codec->m_codec) {
@@ -299,6 +335,7 @@ const char* GRK_CALLCONV grk_version(void) {
 	case GRK_CODEC_JP2:
 		/* get a JP2 decoder handle */
 		l_codec->grk_dump_codec = (void (*)(void*, int32_t, FILE*)) jp2_dump;
+		l_codec->get_code_stream = jp2_get_code_stream;
 		l_codec->get_codec_info =
 				( grk_codestream_info_v2  *  (*)(void*)) jp2_get_cstr_info;
 		l_codec->grk_get_codec_index =
@@ -325,6 +362,8 @@ const char* GRK_CALLCONV grk_version(void) {
 
 		l_codec->m_codec_data.m_decompression.get_decoded_tile = (bool (*)(
 				void *p_codec, BufferedStream *p_cio, grk_image *p_image, uint16_t tile_index)) jp2_get_tile;
+		l_codec->m_codec_data.m_decompression.decompress_incremental = (bool (*)(
+				void*, BufferedStream*, grk_image*, bool*)) jp2_decompress_incremental;
 		l_codec->m_codec = jp2_create(true);
 		if (!l_codec->m_codec) {
 			grok_free(l_codec);
@@ -355,6 +394,7 @@ bool GRK_CALLCONV grk_init_decompress( grk_codec  *p_codec,
 		}
 		l_codec->m_codec_data.m_decompression.setup_decoder(l_codec->m_codec,
 				parameters);
+		l_codec->m_num_jobs = parameters->numThreads;
 		return true;
 	}
 	return false;
@@ -385,11 +425,26 @@ bool GRK_CALLCONV grk_decompress( grk_codec  *p_codec, grk_plugin_tile *tile,
 		if (!l_codec->is_decompressor) {
 			return false;
 		}
+		CodecJobLimit limit(l_codec);
 		return l_codec->m_codec_data.m_decompression.decompress(l_codec->m_codec,
 				tile, l_stream, p_image);
 	}
 	return false;
 }
+bool GRK_CALLCONV grk_decompress_incremental(grk_codec *p_codec,
+		grk_image *p_image, bool *complete) {
+	if (p_codec && p_image && complete) {
+		grk_codec_private *l_codec = (grk_codec_private*) p_codec;
+		BufferedStream *l_stream = (BufferedStream*) l_codec->m_stream;
+		if (!l_codec->is_decompressor) {
+			return false;
+		}
+		CodecJobLimit limit(l_codec);
+		return l_codec->m_codec_data.m_decompression.decompress_incremental(
+				l_codec->m_codec, l_stream, p_image, complete);
+	}
+	return false;
+}
 bool GRK_CALLCONV grk_set_decompress_area( grk_codec  *p_codec,
 		grk_image *p_image, uint32_t start_x, uint32_t start_y,
 		uint32_t end_x, uint32_t end_y) {
@@ -431,6 +486,7 @@ bool GRK_CALLCONV grk_decompress_tile_to_buffer( grk_codec  *p_codec,
 			return false;
 		}
 
+		CodecJobLimit limit(l_codec);
 		return l_codec->m_codec_data.m_decompression.decode_tile_data(
 				l_codec->m_codec, tile_index, p_data, data_size, l_stream);
 	}
@@ -446,6 +502,7 @@ bool GRK_CALLCONV grk_decompress_tile( grk_codec  *p_codec,
 			return false;
 		}
 
+		CodecJobLimit limit(l_codec);
 		return l_codec->m_codec_data.m_decompression.get_decoded_tile(
 				l_codec->m_codec, l_stream, p_image,
 				tile_index);
@@ -468,6 +525,7 @@ bool GRK_CALLCONV grk_decompress_tile( grk_codec  *p_codec,
 
 	switch (p_format) {
 	case GRK_CODEC_J2K:
+		l_codec->get_code_stream = j2k_get_code_stream;
 		l_codec->m_codec_data.m_compression.compress =
 				(bool (*)(void*, grk_plugin_tile*, BufferedStream*)) j2k_compress;
 		l_codec->m_codec_data.m_compression.end_compress = (bool (*)(void*,
@@ -476,6 +534,9 @@ bool GRK_CALLCONV grk_decompress_tile( grk_codec  *p_codec,
 				(bool (*)(void*, BufferedStream*)) j2k_start_compress;
 		l_codec->m_codec_data.m_compression.write_tile =
 				(bool (*)(void*, uint16_t, uint8_t*, uint64_t, BufferedStream*)) j2k_compress_tile;
+		l_codec->m_codec_data.m_compression.write_strip =
+				(bool (*)(void*, const uint8_t*, uint32_t, uint32_t,
+						BufferedStream*)) j2k_compress_strip;
 		l_codec->m_codec_data.m_compression.destroy =
 				(void (*)(void*)) j2k_destroy;
 		l_codec->m_codec_data.m_compression.init_compress =
@@ -488,6 +549,7 @@ bool GRK_CALLCONV grk_decompress_tile( grk_codec  *p_codec,
 		break;
 	case GRK_CODEC_JP2:
 		/* get a JP2 decoder handle */
+		l_codec->get_code_stream = jp2_get_code_stream;
 		l_codec->m_codec_data.m_compression.compress =
 				(bool (*)(void*, grk_plugin_tile*, BufferedStream*)) jp2_compress;
 		l_codec->m_codec_data.m_compression.end_compress = (bool (*)(void*,
@@ -496,6 +558,9 @@ bool GRK_CALLCONV grk_decompress_tile( grk_codec  *p_codec,
 				BufferedStream*)) jp2_start_compress;
 		l_codec->m_codec_data.m_compression.write_tile =
 				(bool (*)(void*, uint16_t, uint8_t*, uint64_t, BufferedStream*)) jp2_compress_tile;
+		l_codec->m_codec_data.m_compression.write_strip =
+				(bool (*)(void*, const uint8_t*, uint32_t, uint32_t,
+						BufferedStream*)) jp2_compress_strip;
 		l_codec->m_codec_data.m_compression.destroy =
 				(void (*)(void*)) jp2_destroy;
 		l_codec->m_codec_data.m_compression.init_compress =
@@ -537,6 +602,8 @@ void GRK_CALLCONV grk_set_default_compress_params(
 		parameters->cp_fixed_quality = false;
 		parameters->writePLT = false;
 		parameters->writeTLM = false;
+		parameters->rewrite_on = false;
+		memset(&parameters->rewrite, 0, sizeof(grk_rewrite_params));
 		if (!parameters->numThreads)
 			parameters->numThreads = ThreadPool::hardware_concurrency();
 		parameters->deviceId = 0;
@@ -548,6 +615,7 @@ bool GRK_CALLCONV grk_init_compress( grk_codec  *p_codec,
 	if (p_codec && parameters && p_image) {
 		grk_codec_private *l_codec = (grk_codec_private*) p_codec;
 		if (!l_codec->is_decompressor) {
+			l_codec->m_num_jobs = parameters->numThreads;
 			return l_codec->m_codec_data.m_compression.init_compress(
 					l_codec->m_codec, parameters, p_image);
 		}
@@ -559,6 +627,7 @@ bool GRK_CALLCONV grk_start_compress( grk_codec  *p_codec) {
 		grk_codec_private *l_codec = (grk_codec_private*) p_codec;
 		BufferedStream *l_stream = (BufferedStream*) l_codec->m_stream;
 		if (!l_codec->is_decompressor) {
+			CodecJobLimit limit(l_codec);
 			return l_codec->m_codec_data.m_compression.start_compress(
 					l_codec->m_codec, l_stream	);
 		}
@@ -574,6 +643,7 @@ bool GRK_CALLCONV grk_compress_with_plugin( grk_codec  *p_info,
 		grk_codec_private *l_codec = (grk_codec_private*) p_info;
 		BufferedStream *l_stream = (BufferedStream*) l_codec->m_stream;
 		if (!l_codec->is_decompressor) {
+			CodecJobLimit limit(l_codec);
 			return l_codec->m_codec_data.m_compression.compress(l_codec->m_codec,
 					tile, l_stream);
 		}
@@ -585,6 +655,7 @@ bool GRK_CALLCONV grk_end_compress( grk_codec  *p_codec) {
 		grk_codec_private *l_codec = (grk_codec_private*) p_codec;
 		BufferedStream *l_stream = (BufferedStream*) l_codec->m_stream;
 		if (!l_codec->is_decompressor) {
+			CodecJobLimit limit(l_codec);
 			return l_codec->m_codec_data.m_compression.end_compress(
 					l_codec->m_codec, l_stream);
 		}
@@ -598,6 +669,7 @@ bool GRK_CALLCONV grk_end_decompress( grk_codec  *p_codec) {
 		if (!l_codec->is_decompressor) {
 			return false;
 		}
+		CodecJobLimit limit(l_codec);
 		return l_codec->m_codec_data.m_decompression.end_decompress(
 				l_codec->m_codec, l_stream);
 	}
@@ -637,12 +709,79 @@ bool GRK_CALLCONV grk_compress_tile( grk_codec  *p_codec, uint16_t tile_index,
 		if (l_codec->is_decompressor) {
 			return false;
 		}
+		CodecJobLimit limit(l_codec);
 		return l_codec->m_codec_data.m_compression.write_tile(l_codec->m_codec,
 				tile_index, p_data, data_size, l_stream	);
 	}
 	return false;
 }
 
+bool GRK_CALLCONV grk_compress_strip(grk_codec *p_codec, const uint8_t *p_data,
+		uint32_t num_rows, uint32_t sample_size) {
+	if (p_codec && p_data) {
+		grk_codec_private *l_codec = (grk_codec_private*) p_codec;
+		BufferedStream *l_stream = (BufferedStream*) l_codec->m_stream;
+		if (l_codec->is_decompressor) {
+			return false;
+		}
+		CodecJobLimit limit(l_codec);
+		return l_codec->m_codec_data.m_compression.write_strip(l_codec->m_codec,
+				p_data, num_rows, sample_size, l_stream);
+	}
+	return false;
+}
+bool GRK_CALLCONV grk_transcode(grk_codec *p_src_codec, grk_codec *p_codec,
+		grk_cparameters *parameters, grk_image *p_image) {
+	if (!p_src_codec || !p_codec || !parameters || !p_image)
+		return false;
+	grk_codec_private *l_src_codec = (grk_codec_private*) p_src_codec;
+	grk_codec_private *l_codec = (grk_codec_private*) p_codec;
+	if (!l_src_codec->is_decompressor || l_codec->is_decompressor) {
+		GROK_ERROR("grk_transcode requires a decompressor and a compressor");
+		return false;
+	}
+	BufferedStream *l_src_stream = (BufferedStream*) l_src_codec->m_stream;
+	BufferedStream *l_stream = (BufferedStream*) l_codec->m_stream;
+	auto src = l_src_codec->get_code_stream(l_src_codec->m_codec);
+	auto dest = l_codec->get_code_stream(l_codec->m_codec);
+	auto compression = &l_codec->m_codec_data.m_compression;
+
+	return j2k_init_transcode(src, parameters)
+			&& compression->init_compress(l_codec->m_codec, parameters, p_image)
+			&& j2k_init_transcode_compress(src, dest)
+			&& compression->start_compress(l_codec->m_codec, l_stream)
+			&& j2k_transcode(src, l_src_stream, dest, l_stream)
+			&& compression->end_compress(l_codec->m_codec, l_stream);
+}
+bool GRK_CALLCONV grk_rewrite(grk_codec *p_src_codec, grk_codec *p_codec,
+		grk_cparameters *parameters, grk_image *p_image) {
+	if (!p_src_codec || !p_codec || !parameters || !p_image)
+		return false;
+	grk_codec_private *l_src_codec = (grk_codec_private*) p_src_codec;
+	grk_codec_private *l_codec = (grk_codec_private*) p_codec;
+	if (!l_src_codec->is_decompressor || l_codec->is_decompressor) {
+		GROK_ERROR("grk_rewrite requires a decompressor and a compressor");
+		return false;
+	}
+	BufferedStream *l_src_stream = (BufferedStream*) l_src_codec->m_stream;
+	BufferedStream *l_stream = (BufferedStream*) l_codec->m_stream;
+	auto src = l_src_codec->get_code_stream(l_src_codec->m_codec);
+	auto dest = l_codec->get_code_stream(l_codec->m_codec);
+	auto compression = &l_codec->m_codec_data.m_compression;
+
+	auto image = j2k_init_rewrite(src, parameters, p_image);
+	if (!image)
+		return false;
+	bool rc = compression->init_compress(l_codec->m_codec, parameters, image)
+			&& j2k_init_rewrite_compress(src, dest, parameters)
+			&& compression->start_compress(l_codec->m_codec, l_stream)
+			&& j2k_rewrite(src, l_src_stream, dest, l_stream, parameters)
+			&& compression->end_compress(l_codec->m_codec, l_stream);
+	grk_image_destroy(image);
+
+	return rc;
+}
+
 /* ---------------------------------------------------------------------- */
 
 void GRK_CALLCONV grk_destroy_codec( grk_codec  *p_codec) {
@@ -764,6 +903,26 @@ GRK_API size_t GRK_CALLCONV grk_stream_get_write_mem_stream_length(
 		const char *fname) {
 	return create_mapped_file_read_stream(fname);
 }
+grk_stream* GRK_CALLCONV grk_stream_create_chunked_mem_stream(
+		size_t chunk_size) {
+	return create_chunked_mem_write_stream(chunk_size);
+}
+size_t GRK_CALLCONV grk_stream_copy_chunked_mem_stream(grk_stream *stream,
+		uint8_t *buf, size_t len) {
+	return copy_chunked_mem_stream(stream, buf, len);
+}
+size_t GRK_CALLCONV grk_stream_get_chunked_mem_stream_chunks(
+		grk_stream *stream, grk_stream_chunk *chunks, size_t max_chunks) {
+	return get_chunked_mem_stream_chunks(stream, chunks, max_chunks);
+}
+grk_stream* GRK_CALLCONV grk_stream_create_growable_mem_stream(
+		size_t initial_capacity) {
+	return create_growable_mem_read_stream(initial_capacity);
+}
+bool GRK_CALLCONV grk_stream_append(grk_stream *stream, const uint8_t *buf,
+		size_t len) {
+	return append_to_growable_mem_stream(stream, buf, len);
+}
 /* ---------------------------------------------------------------------- */
 void GRK_CALLCONV grk_image_all_components_data_free(grk_image *image) {
 	uint32_t i;
@@ -461,6 +461,26 @@ typedef struct _grk_raw_cparameters {
 	/*@}*/
 } grk_raw_cparameters;
 
+/**
+ * Packet rewriting parameters
+ * */
+typedef struct _grk_rewrite_params {
+	/** number of quality layers to keep: 0 keeps all layers */
+	uint32_t numlayers;
+	/** number of highest resolutions to discard */
+	uint32_t reduce;
+	/** number of components to keep: 0 keeps all components */
+	uint32_t numcomps;
+	/** components to keep, in increasing order */
+	uint32_t *comps;
+	/** rectangle of tiles to keep, in tile grid coordinates:
+	 *  all tiles are kept if tile_x1 or tile_y1 is 0 */
+	uint32_t tile_x0;
+	uint32_t tile_y0;
+	uint32_t tile_x1;
+	uint32_t tile_y1;
+} grk_rewrite_params;
+
 /**
  * Compress parameters
  * */
@@ -578,6 +598,16 @@ typedef struct _grk_cparameters {
 
 	// 0: bisect with all truncation points,  1: bisect with only feasible truncation points
 	uint32_t rateControlAlgorithm;
+	/* estimate rate control threshold before T1, and skip coding passes
+	 * that can not be included in the final layer. Only applies when
+	 * all layers are rate-limited (cp_disto_alloc). The threshold is
+	 * estimated from a sample of the code blocks, so the output may
+	 * differ from a full encode */
+	bool earlyTermination;
+	/** maximum number of library threads working on this compressor
+	 * at once (0: all threads; defaults to the number of hardware threads).
+	 * Images compressed concurrently on different threads can then split
+	 * the thread pool between them */
 	uint32_t numThreads;
 	int32_t deviceId;
 	uint32_t duration; //seconds
@@ -586,6 +616,14 @@ typedef struct _grk_cparameters {
 	bool writePLT;
 	bool writeTLM;
 	bool verbose;
+	/* number of reader, encoder and writer threads
+	 * for pipelined compress in image directory mode */
+	uint32_t batchReaders;
+	uint32_t batchEncoders;
+	uint32_t batchWriters;
+	/* rewrite packets of source code stream : see grk_rewrite */
+	bool rewrite_on;
+	grk_rewrite_params rewrite;
 } grk_cparameters;
 
 /**
@@ -721,6 +759,29 @@ typedef struct _grk_dparameters {
 	 if == 0 or not used, all the quality layers are decoded
 	 */
 	uint32_t cp_layer;
+	/**
+	 Set the maximum number of bytes of compressed data to decompress.
+	 Each tile gets a share of this budget, in proportion to its compressed
+	 size. Packets of a tile are decoded in progression order, until the first
+	 packet that does not fit in the tile's share.
+	 if == 0 or not used, there is no limit
+	 */
+	uint64_t cp_max_bytes;
+	/**
+	 Set the maximum number of bytes of compressed data to decompress
+	 in each tile.
+	 if == 0 or not used, there is no limit
+	 */
+	uint64_t cp_max_tile_bytes;
+	/**
+	 Fast preview: run the inverse 9/7 wavelet transform of components of
+	 8 bits precision or less in 16 bit fixed point, rather than in floating
+	 point. Only applies when whole tiles are decompressed.
+	 Against the floating point transform, PSNR stayed above 52 dB, with no
+	 sample off by more than 3, on natural, noise and checkerboard test images
+	 with up to 8 decomposition levels.
+	 */
+	bool cp_fast_preview;
 	/** input file name */
 	char infile[GRK_PATH_LEN];
 	/** output file name */
@@ -744,6 +805,10 @@ typedef struct _grk_dparameters {
 	/** Number of tiles to decompress */
 	uint32_t nb_tile_to_decode;
 	uint32_t flags;
+	/** maximum number of library threads working on this decompressor
+	 * at once (0: all threads). Images decompressed concurrently on
+	 * different threads can then split the thread pool between them */
+	uint32_t numThreads;
 } grk_dparameters;
 
 /**
@@ -813,6 +878,8 @@ typedef struct _grk_decompress_params {
 	uint32_t repeats;
 	bool verbose;
 	uint32_t numThreads;
+	/* number of images decompressed concurrently in image directory mode */
+	uint32_t numBatchJobs;
 } grk_decompress_parameters;
 
 typedef void *grk_codec;
@@ -857,6 +924,14 @@ typedef void (*grk_stream_free_user_data_fn)(void *user_data);
  */
 typedef void *grk_stream;
 
+/*
+ * Chunk of data stored in chunked memory stream
+ */
+typedef struct _grk_stream_chunk {
+	uint8_t *data;
+	size_t len;
+} grk_stream_chunk;
+
 /*
  ==========================================================
  image typedef definitions
@@ -1505,6 +1580,64 @@ GRK_API size_t GRK_CALLCONV grk_stream_get_write_mem_stream_length(
 GRK_API grk_stream* GRK_CALLCONV grk_stream_create_mapped_file_read_stream(
 		const char *fname);
 
+/**
+ * Create growable memory write stream. Compressed data is stored
+ * in a list of fixed size chunks, which are allocated as needed,
+ * so there is no need to know the compressed size in advance.
+ *
+ * @param chunk_size	size of each chunk; if zero, a default size is used
+ */
+GRK_API grk_stream* GRK_CALLCONV grk_stream_create_chunked_mem_stream(
+		size_t chunk_size);
+
+/**
+ * Copy contents of chunked memory stream into contiguous buffer.
+ * Use grk_stream_get_write_mem_stream_length to get total length.
+ *
+ * @param stream	chunked memory stream
+ * @param buf		destination buffer
+ * @param len		length of destination buffer
+ *
+ * @return number of bytes copied
+ */
+GRK_API size_t GRK_CALLCONV grk_stream_copy_chunked_mem_stream(
+		grk_stream *stream, uint8_t *buf, size_t len);
+
+/**
+ * Get chunks of chunked memory stream, for scatter/gather output.
+ * The chunks remain owned by the stream, and are valid until
+ * the stream is destroyed.
+ *
+ * @param stream		chunked memory stream
+ * @param chunks		array to receive at most max_chunks chunks (may be NULL)
+ * @param max_chunks	size of chunk array
+ *
+ * @return total number of chunks in stream
+ */
+GRK_API size_t GRK_CALLCONV grk_stream_get_chunked_mem_stream_chunks(
+		grk_stream *stream, grk_stream_chunk *chunks, size_t max_chunks);
+
+/**
+ * Create growable memory read stream, for a code stream that is received
+ * progressively. Data is added to the end of the stream with grk_stream_append.
+ *
+ * @param initial_capacity	initial size of stream buffer; if zero, a default size is used
+ */
+GRK_API grk_stream* GRK_CALLCONV grk_stream_create_growable_mem_stream(
+		size_t initial_capacity);
+
+/**
+ * Append data to growable memory read stream. Data is copied.
+ *
+ * @param stream	growable memory stream
+ * @param buf		data to append
+ * @param len		length of data
+ *
+ * @return true if successful
+ */
+GRK_API bool GRK_CALLCONV grk_stream_append(grk_stream *stream,
+		const uint8_t *buf, size_t len);
+
 /*
  ========================================
  logger functions definitions
@@ -1626,6 +1759,29 @@ GRK_API bool GRK_CALLCONV grk_set_decompress_area(grk_codec *codec,
 GRK_API bool GRK_CALLCONV grk_decompress(grk_codec *p_decompressor,
 		grk_plugin_tile *tile, grk_image *image);
 
+/**
+ * Decompress the part of the code stream that has been received so far,
+ * for a stream created with grk_stream_create_growable_mem_stream.
+ * Call repeatedly as data is appended to the stream: each call decodes
+ * the packets that have become complete, re-runs T1 for the affected
+ * code blocks only, and updates the affected tiles of the image.
+ *
+ * The main header must have been read with grk_read_header, which fails
+ * unless the stream already holds the whole main header and the first SOT
+ * marker that follows it: append data up to and including that marker
+ * before calling grk_read_header. Only single-tile images are supported,
+ * tile-parts must signal their length (Psot != 0), and decompress areas
+ * are not supported.
+ * For JP2 files, palette and component definition boxes are not applied.
+ *
+ * @param p_decompressor 	decompressor handle
+ * @param image 			the decoded image
+ * @param complete			set to true once the whole code stream has been decompressed
+ * @return 					true if success, otherwise false
+ * */
+GRK_API bool GRK_CALLCONV grk_decompress_incremental(
+		grk_codec *p_decompressor, grk_image *image, bool *complete);
+
 /**
  * Decompress a specific tile
  *
@@ -1772,6 +1928,89 @@ GRK_API bool GRK_CALLCONV grk_compress(grk_codec *codec);
 GRK_API bool GRK_CALLCONV grk_compress_tile(grk_codec *codec,
 		uint16_t tile_index, uint8_t *data, uint64_t data_size);
 
+/**
+ * Compress a strip of image rows.
+ * This method should be called right after grk_start_compress,
+ * and before grk_end_compress, and cannot be combined with grk_compress
+ * or grk_compress_tile.
+ *
+ * Strips are pushed from the top of the image to the bottom, and may
+ * contain any number of rows. The library buffers rows until a full row
+ * of tiles is available, and then compresses that tile row in the
+ * background while the next strips are pushed. Peak memory is therefore
+ * bounded by two tile rows, so the image passed to grk_init_compress
+ * does not need to have its component data allocated.
+ * Sub-sampled components are not supported.
+ *
+ * @param	codec			JPEG 2000 code stream
+ * @param	data			pointer to strip data. Data is arranged in planar
+ *  						sequence: num_rows rows of component 0, followed by
+ *  						num_rows rows of component 1 etc.
+ * @param	num_rows		number of rows in strip
+ * @param	sample_size		size in bytes of each sample: 1, 2 or 4.
+ * 							Samples are signed if the component is signed.
+ *
+ * @return	true if the strip was successfully pushed.
+ */
+GRK_API bool GRK_CALLCONV grk_compress_strip(grk_codec *codec,
+		const uint8_t *data, uint32_t num_rows, uint32_t sample_size);
+
+/**
+ * Transcode a reversible JPEG 2000 code stream to HTJ2K, without
+ * reconstructing pixels.
+ *
+ * Code blocks of the source are decompressed to wavelet coefficients,
+ * which are compressed again with the HT block coder. Inverse and forward
+ * DWT, MCT and DC level shift are skipped. Tile layout, wavelet, code block and
+ * precinct partitions, progression order and quantization are taken
+ * from the source, and all quality layers are merged into a single
+ * lossless layer. The source must be reversible, without region of interest,
+ * with tiles stored in order, and with the same coding style for all
+ * components.
+ *
+ * This method replaces grk_init_compress, grk_start_compress, grk_compress
+ * and grk_end_compress.
+ *
+ * @param	src_codec		decompressor, after grk_read_header
+ * @param	codec			compressor
+ * @param	parameters		compress parameters: coding structure parameters
+ * 							are overwritten with those of the source
+ * @param	image			image header returned by grk_read_header
+ *
+ * @return	true if successful
+ */
+GRK_API bool GRK_CALLCONV grk_transcode(grk_codec *src_codec,
+		grk_codec *codec, grk_cparameters *parameters, grk_image *image);
+
+/**
+ * Rewrite a JPEG 2000 code stream without decoding any code blocks:
+ * packets of the kept quality layers, resolutions, components and tiles
+ * are copied unchanged from the source code stream. Discarding resolutions
+ * reduces the image and tile size; keeping a rectangle of tiles crops the
+ * image to these tiles. Coding structure and quantization are taken from
+ * the source, and packets are written in the default progression order
+ * of the source. The source must not use packed packet headers,
+ * must store tiles in order, and must have the same coding style for all
+ * components. When resolutions are discarded and more than one tile is kept
+ * in a given direction, the tile size in that direction must be
+ * divisible by 2^reduce.
+ *
+ * This method replaces grk_init_compress, grk_start_compress, grk_compress
+ * and grk_end_compress.
+ *
+ * @param	src_codec		decompressor, after grk_read_header
+ * @param	codec			compressor
+ * @param	parameters		compress parameters, with parameters->rewrite
+ * 							selecting the packets to keep: coding structure
+ * 							parameters are overwritten with those
+ * 							of the source
+ * @param	image			image header returned by grk_read_header
+ *
+ * @return	true if successful
+ */
+GRK_API bool GRK_CALLCONV grk_rewrite(grk_codec *src_codec,
+		grk_codec *codec, grk_cparameters *parameters, grk_image *image);
+
 
 /**
  * Encode an image into a JPEG 2000 code stream using plugin
@@ -1923,8 +2162,9 @@ typedef struct grk_plugin_encode_user_callback_info {
 	grk_cparameters *encoder_parameters;
 	grk_image *image;
 	grk_plugin_tile *tile;
-	uint8_t *compressBuffer;
-	size_t compressBufferLen;
+	/* unused: compressed output goes to the output stream, see grk_plugin_compress */
+	GRK_DEPRECATED(uint8_t *compressBuffer);
+	GRK_DEPRECATED(size_t compressBufferLen);
 	unsigned int error_code;
 } grk_plugin_encode_user_callback_info;
 
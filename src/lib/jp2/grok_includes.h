@@ -187,8 +187,10 @@ static inline long grok_lrintf(float f) {
 #include "logger.h"
 #include "vector.h"
 #include "util.h"
+#include "simd_kernels.h"
 #include "grok_exceptions.h"
 #include "ChunkBuffer.h"
+#include "WriteChunkBuffer.h"
 #include "BitIO.h"
 #include "BufferedStream.h"
 #include "image.h"
@@ -203,6 +205,8 @@ static inline long grok_lrintf(float f) {
 #include "markers.h"
 #include <Dump.h>
 #include "FileFormat.h"
+#include "StripCompressor.h"
+#include "IncrementalDecompressor.h"
 #include "BitIO.h"
 #include "TileBuffer.h"
 #include "PacketIter.h"
@@ -215,6 +219,8 @@ static inline long grok_lrintf(float f) {
 #include "dwt.h"
 #include "sparse_array.h"
 #include "T2.h"
+#include "PrecinctIndex.h"
+#include "TilePackets.h"
 #include "mct.h"
 #include "grok_intmath.h"
 #include "plugin_bridge.h"
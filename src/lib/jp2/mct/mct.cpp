@@ -55,8 +55,6 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
-#include "CPUArch.h"
-#include "simd.h"
 #include "grok_includes.h"
 
 namespace grk {
@@ -84,111 +82,17 @@ const double* mct::get_norms_irrev() {
 /* </summary> */
 void mct::encode_rev(int32_t *GRK_RESTRICT chan0, int32_t *GRK_RESTRICT chan1,
 		int32_t *GRK_RESTRICT chan2, uint64_t n) {
-	size_t i = 0;
-
-#if (defined(__SSE2__) || defined(__AVX2__))
-    size_t chunkSize = n / ThreadPool::get()->num_threads();
-    //ensure it is divisible by VREG_INT_COUNT
-    chunkSize = (chunkSize/VREG_INT_COUNT) * VREG_INT_COUNT;
-	if (chunkSize > VREG_INT_COUNT) {
-	    std::vector< std::future<int> > results;
-	    for(uint64_t i = 0; i < ThreadPool::get()->num_threads(); ++i) {
-	    	uint64_t index = i;
-	        results.emplace_back(
-	            ThreadPool::get()->enqueue([index, chunkSize, chan0,chan1,chan2] {
-	        		uint64_t begin = (uint64_t)index * chunkSize;
-					for (auto j = begin; j < begin+chunkSize; j+=VREG_INT_COUNT ){
-						VREG y, u, v;
-						VREG r = LOAD((const VREG*) &chan0[j]);
-						VREG g = LOAD((const VREG*) &chan1[j]);
-						VREG b = LOAD((const VREG*) &chan2[j]);
-						y = ADD(g, g);
-						y = ADD(y, b);
-						y = ADD(y, r);
-						y = SAR(y, 2);
-						u = SUB(b, g);
-						v = SUB(r, g);
-						STORE((VREG*) &chan0[j], y);
-						STORE((VREG*) &chan1[j], u);
-						STORE((VREG*) &chan2[j], v);
-					}
-	                return 0;
-	            })
-	        );
-	    }
-	    for(auto && result: results){
-	        result.get();
-	    }
-		i = chunkSize * ThreadPool::get()->num_threads();
-	}
-#endif
-	for (; i < n; ++i) {
-		int32_t r = chan0[i];
-		int32_t g = chan1[i];
-		int32_t b = chan2[i];
-		int32_t y = (r + (g * 2) + b) >> 2;
-		int32_t u = b - g;
-		int32_t v = r - g;
-		chan0[i] = y;
-		chan1[i] = u;
-		chan2[i] = v;
-	}
+	simd_kernels().mct_encode_rev(chan0, chan1, chan2, n);
 }
 
-////////////////////////////////////////////////////////////////////////////////
-
 /* <summary> */
 /* Inverse reversible MCT. */
 /* </summary> */
 void mct::decode_rev(int32_t *GRK_RESTRICT chan0, int32_t *GRK_RESTRICT chan1,
 		int32_t *GRK_RESTRICT chan2, uint64_t n) {
-	size_t i = 0;
-#if (defined(__SSE2__) || defined(__AVX2__))
-    size_t chunkSize = n / ThreadPool::get()->num_threads();
-    //ensure it is divisible by VREG_INT_COUNT
-    chunkSize = (chunkSize/VREG_INT_COUNT) * VREG_INT_COUNT;
-	if (chunkSize > VREG_INT_COUNT) {
-	    std::vector< std::future<int> > results;
-	    for(uint64_t i = 0; i < ThreadPool::get()->num_threads(); ++i) {
-	    	uint64_t index = i;
-	        results.emplace_back(
-	            ThreadPool::get()->enqueue([index, chunkSize,chan0,chan1,chan2] {
-					uint64_t begin = (uint64_t)index * chunkSize;
-					for (auto j = begin; j < begin+chunkSize; j+=VREG_INT_COUNT ){
-						VREG r, g, b;
-						VREG y = LOAD((const VREG*) &(chan0[j]));
-						VREG u = LOAD((const VREG*) &(chan1[j]));
-						VREG v = LOAD((const VREG*) &(chan2[j]));
-						g = y;
-						g = SUB(g, SAR(ADD(u, v), 2));
-						r = ADD(v, g);
-						b = ADD(u, g);
-						STORE((VREG*) &(chan0[j]), r);
-						STORE((VREG*) &(chan1[j]), g);
-						STORE((VREG*) &(chan2[j]), b);
-					}
-					return 0;
-	            })
-	        );
-	    }
-	    for(auto && result: results){
-	        result.get();
-	    }
-		i = chunkSize * ThreadPool::get()->num_threads();
-	}
-#endif
-	for (; i < n; ++i) {
-		int32_t y = chan0[i];
-		int32_t u = chan1[i];
-		int32_t v = chan2[i];
-		int32_t g = y - ((u + v) >> 2);
-		int32_t r = v + g;
-		int32_t b = u + g;
-		chan0[i] = r;
-		chan1[i] = g;
-		chan2[i] = b;
-	}
+	simd_kernels().mct_decode_rev(chan0, chan1, chan2, n);
 }
+
 /* <summary> */
 /* Forward irreversible MCT. */
 /* </summary> */
@@ -197,153 +101,7 @@ void mct::encode_irrev( int32_t* GRK_RESTRICT chan0,
 						int32_t* GRK_RESTRICT chan2,
 						uint64_t n)
 {
-    size_t i = 0;
-#ifdef __SSE4_1__
-    const __m128i ry = _mm_set1_epi32(2449);
-    const __m128i gy = _mm_set1_epi32(4809);
-    const __m128i by = _mm_set1_epi32(934);
-    const __m128i ru = _mm_set1_epi32(1382);
-    const __m128i gu = _mm_set1_epi32(2714);
-    const __m128i gv = _mm_set1_epi32(3430);
-    const __m128i bv = _mm_set1_epi32(666);
-    const __m128i mulround = _mm_shuffle_epi32(_mm_cvtsi32_si128(4096), _MM_SHUFFLE(1, 0, 1, 0));
-
-    size_t chunkSize = n / ThreadPool::get()->num_threads();
-    //ensure it is divisible by 4
-    chunkSize = (chunkSize/4) * 4;
-	if (chunkSize > 4) {
-
-		std::vector< std::future<int> > results;
-		for(size_t k = 0; k < ThreadPool::get()->num_threads(); ++k) {
-			uint64_t index = k;
-			results.emplace_back(
-				ThreadPool::get()->enqueue([index, chunkSize, chan0,chan1,chan2,
-											 ry,gy,by,ru,gu,gv,bv,
-											 mulround] {
-
-				uint64_t begin = (uint64_t)index * chunkSize;
-				for (auto j = begin; j < begin+chunkSize; j+=4 ){
-					__m128i lo, hi;
-					__m128i y, u, v;
-					__m128i r = _mm_load_si128((const __m128i *)&(chan0[j]));
-					__m128i g = _mm_load_si128((const __m128i *)&(chan1[j]));
-					__m128i b = _mm_load_si128((const __m128i *)&(chan2[j]));
-
-					lo = r;
-					hi = _mm_shuffle_epi32(r, _MM_SHUFFLE(3, 3, 1, 1));
-					lo = _mm_mul_epi32(lo, ry);
-					hi = _mm_mul_epi32(hi, ry);
-					lo = _mm_add_epi64(lo, mulround);
-					hi = _mm_add_epi64(hi, mulround);
-					lo = _mm_srli_epi64(lo, 13);
-					hi = _mm_slli_epi64(hi, 32-13);
-					y = _mm_blend_epi16(lo, hi, 0xCC);
-
-					lo = g;
-					hi = _mm_shuffle_epi32(g, _MM_SHUFFLE(3, 3, 1, 1));
-					lo = _mm_mul_epi32(lo, gy);
-					hi = _mm_mul_epi32(hi, gy);
-					lo = _mm_add_epi64(lo, mulround);
-					hi = _mm_add_epi64(hi, mulround);
-					lo = _mm_srli_epi64(lo, 13);
-					hi = _mm_slli_epi64(hi, 32-13);
-					y = _mm_add_epi32(y, _mm_blend_epi16(lo, hi, 0xCC));
-
-					lo = b;
-					hi = _mm_shuffle_epi32(b, _MM_SHUFFLE(3, 3, 1, 1));
-					lo = _mm_mul_epi32(lo, by);
-					hi = _mm_mul_epi32(hi, by);
-					lo = _mm_add_epi64(lo, mulround);
-					hi = _mm_add_epi64(hi, mulround);
-					lo = _mm_srli_epi64(lo, 13);
-					hi = _mm_slli_epi64(hi, 32-13);
-					y = _mm_add_epi32(y, _mm_blend_epi16(lo, hi, 0xCC));
-					_mm_store_si128((__m128i *)&(chan0[j]), y);
-
-					lo = _mm_cvtepi32_epi64(_mm_shuffle_epi32(b, _MM_SHUFFLE(3, 2, 2, 0)));
-					hi = _mm_cvtepi32_epi64(_mm_shuffle_epi32(b, _MM_SHUFFLE(3, 2, 3, 1)));
-					lo = _mm_slli_epi64(lo, 12);
-					hi = _mm_slli_epi64(hi, 12);
-					lo = _mm_add_epi64(lo, mulround);
-					hi = _mm_add_epi64(hi, mulround);
-					lo = _mm_srli_epi64(lo, 13);
-					hi = _mm_slli_epi64(hi, 32-13);
-					u = _mm_blend_epi16(lo, hi, 0xCC);
-
-					lo = r;
-					hi = _mm_shuffle_epi32(r, _MM_SHUFFLE(3, 3, 1, 1));
-					lo = _mm_mul_epi32(lo, ru);
-					hi = _mm_mul_epi32(hi, ru);
-					lo = _mm_add_epi64(lo, mulround);
-					hi = _mm_add_epi64(hi, mulround);
-					lo = _mm_srli_epi64(lo, 13);
-					hi = _mm_slli_epi64(hi, 32-13);
-					u = _mm_sub_epi32(u, _mm_blend_epi16(lo, hi, 0xCC));
-
-					lo = g;
-					hi = _mm_shuffle_epi32(g, _MM_SHUFFLE(3, 3, 1, 1));
-					lo = _mm_mul_epi32(lo, gu);
-					hi = _mm_mul_epi32(hi, gu);
-					lo = _mm_add_epi64(lo, mulround);
-					hi = _mm_add_epi64(hi, mulround);
-					lo = _mm_srli_epi64(lo, 13);
-					hi = _mm_slli_epi64(hi, 32-13);
-					u = _mm_sub_epi32(u, _mm_blend_epi16(lo, hi, 0xCC));
-					_mm_store_si128((__m128i *)&(chan1[j]), u);
-
-					lo = _mm_cvtepi32_epi64(_mm_shuffle_epi32(r, _MM_SHUFFLE(3, 2, 2, 0)));
-					hi = _mm_cvtepi32_epi64(_mm_shuffle_epi32(r, _MM_SHUFFLE(3, 2, 3, 1)));
-					lo = _mm_slli_epi64(lo, 12);
-					hi = _mm_slli_epi64(hi, 12);
-					lo = _mm_add_epi64(lo, mulround);
-					hi = _mm_add_epi64(hi, mulround);
-					lo = _mm_srli_epi64(lo, 13);
-					hi = _mm_slli_epi64(hi, 32-13);
-					v = _mm_blend_epi16(lo, hi, 0xCC);
-
-					lo = g;
-					hi = _mm_shuffle_epi32(g, _MM_SHUFFLE(3, 3, 1, 1));
-					lo = _mm_mul_epi32(lo, gv);
-					hi = _mm_mul_epi32(hi, gv);
-					lo = _mm_add_epi64(lo, mulround);
-					hi = _mm_add_epi64(hi, mulround);
-					lo = _mm_srli_epi64(lo, 13);
-					hi = _mm_slli_epi64(hi, 32-13);
-					v = _mm_sub_epi32(v, _mm_blend_epi16(lo, hi, 0xCC));
-
-					lo = b;
-					hi = _mm_shuffle_epi32(b, _MM_SHUFFLE(3, 3, 1, 1));
-					lo = _mm_mul_epi32(lo, bv);
-					hi = _mm_mul_epi32(hi, bv);
-					lo = _mm_add_epi64(lo, mulround);
-					hi = _mm_add_epi64(hi, mulround);
-					lo = _mm_srli_epi64(lo, 13);
-					hi = _mm_slli_epi64(hi, 32-13);
-					v = _mm_sub_epi32(v, _mm_blend_epi16(lo, hi, 0xCC));
-					_mm_store_si128((__m128i *)&(chan2[j]), v);
-
-				}
-				return 0;
-				})
-			);
-		}
-		for(auto && result: results){
-			result.get();
-		}
-		i = ThreadPool::get()->num_threads() * chunkSize;
-	}
-#endif
-    for(; i < n; ++i) {
-        int32_t r = chan0[i];
-        int32_t g = chan1[i];
-        int32_t b = chan2[i];
-        int32_t y =  int_fix_mul(r, 2449) + int_fix_mul(g, 4809) + int_fix_mul(b, 934);
-        int32_t u = -int_fix_mul(r, 1382) - int_fix_mul(g, 2714) + int_fix_mul(b, 4096);
-        int32_t v =  int_fix_mul(r, 4096) - int_fix_mul(g, 3430) - int_fix_mul(b, 666);
-        chan0[i] = y;
-        chan1[i] = u;
-        chan2[i] = v;
-    }
+	simd_kernels().mct_encode_irrev(chan0, chan1, chan2, n);
 }
 
 /* <summary> */
@@ -351,57 +109,51 @@ void mct::encode_irrev( int32_t* GRK_RESTRICT chan0,
 /* </summary> */
 void mct::decode_irrev(float *GRK_RESTRICT c0, float *GRK_RESTRICT c1, float *GRK_RESTRICT c2,
 		uint64_t n) {
-	uint64_t i = 0;
-#if (defined(__SSE2__) || defined(__AVX2__))
-	size_t chunkSize = n / ThreadPool::get()->num_threads();
-	//ensure it is divisible by VREG_INT_COUNT
-	chunkSize = (chunkSize/VREG_INT_COUNT) * VREG_INT_COUNT;
-	if (chunkSize > VREG_INT_COUNT) {
-		std::vector< std::future<int> > results;
-		for(uint64_t i = 0; i < ThreadPool::get()->num_threads(); ++i) {
-			uint64_t index = i;
-			results.emplace_back(
-				ThreadPool::get()->enqueue([index, chunkSize, c0,c1,c2] {
-				const VREGF vrv = LOAD_CST_F(1.402f);
-				const VREGF vgu = LOAD_CST_F(0.34413f);
-				const VREGF vgv = LOAD_CST_F(0.71414f);
-				const VREGF vbu = LOAD_CST_F(1.772f);
-				uint64_t begin = (uint64_t)index * chunkSize;
-				for (auto j = begin; j < begin+chunkSize; j +=VREG_INT_COUNT){
-					VREGF vy, vu, vv;
-					VREGF vr, vg, vb;
-
-					vy = LOADF(c0 + j);
-					vu = LOADF(c1 + j);
-					vv = LOADF(c2 + j);
-					vr = ADDF(vy, MULF(vv, vrv));
-					vg = SUBF(SUBF(vy, MULF(vu, vgu)),MULF(vv, vgv));
-					vb = ADDF(vy, MULF(vu, vbu));
-					STOREF(c0 + j, vr);
-					STOREF(c1 + j, vg);
-					STOREF(c2 + j, vb);
-				}
-				return 0;
-				})
-			);
-		}
-		for(auto && result: results){
-			result.get();
-		}
-		i = chunkSize * ThreadPool::get()->num_threads();
+	simd_kernels().mct_decode_irrev(c0, c1, c2, n);
+}
+
+/*
+ Split n samples of each component into one chunk per thread,
+ and run kernel on each chunk
+ */
+template<typename T, typename K> static void decode_shift(T *c0, T *c1, T *c2,
+		uint64_t n, const DcShiftParams *params, K kernel) {
+	uint64_t num_threads = ThreadPool::get()->num_jobs();
+	uint64_t chunkSize = n / num_threads;
+	if (num_threads <= 1 || chunkSize == 0) {
+		kernel(c0, c1, c2, n, params);
+		return;
 	}
-#endif
-	for (; i < n; ++i) {
-		float y = c0[i];
-		float u = c1[i];
-		float v = c2[i];
-		float r = y + (v * 1.402f);
-		float g = y - (u * 0.34413f) - (v * (0.71414f));
-		float b = y + (u * 1.772f);
-		c0[i] = r;
-		c1[i] = g;
-		c2[i] = b;
+	std::vector<std::future<int> > results;
+	for (uint64_t i = 0; i < num_threads; ++i) {
+		uint64_t begin = i * chunkSize;
+		uint64_t len = (i == num_threads - 1) ? n - begin : chunkSize;
+		results.emplace_back(
+				ThreadPool::get()->enqueue(
+						[c0, c1, c2, begin, len, params, kernel] {
+							kernel(c0 + begin, c1 + begin, c2 + begin, len,
+									params);
+							return 0;
+						}));
 	}
+	for (auto &&result : results)
+		result.get();
+}
+
+/* <summary> */
+/* Inverse reversible MCT, DC level shift and clamp. */
+/* </summary> */
+void mct::decode_rev_shift(int32_t *c0, int32_t *c1, int32_t *c2, uint64_t n,
+		const DcShiftParams *params) {
+	decode_shift(c0, c1, c2, n, params, simd_kernels().mct_decode_rev_shift);
+}
+
+/* <summary> */
+/* Inverse irreversible MCT, DC level shift and clamp. */
+/* </summary> */
+void mct::decode_irrev_shift(float *c0, float *c1, float *c2, uint64_t n,
+		const DcShiftParams *params) {
+	decode_shift(c0, c1, c2, n, params, simd_kernels().mct_decode_irrev_shift);
 }
 
 //////////////////////////////////////////////////////////////////////////////
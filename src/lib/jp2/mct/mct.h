@@ -56,8 +56,19 @@
  */
 
 #pragma once
+#include "simd_kernels.h"
+
 namespace grk {
 
+/**
+ DC level shift of a component, and clamp to its precision
+ */
+struct DcShiftParams {
+	int32_t shift;
+	int32_t min;
+	int32_t max;
+};
+
 class mct {
 
 public:
@@ -116,6 +127,30 @@ public:
 	 */
 	static void decode_irrev(float *c0, float *c1, float *c2, uint64_t n);
 
+	/**
+	 Apply a reversible multi-component inverse transform to an image,
+	 followed by the DC level shift and clamp of each component
+	 @param c0 Samples for luminance component
+	 @param c1 Samples for red chrominance component
+	 @param c2 Samples for blue chrominance component
+	 @param n Number of samples for each component
+	 @param params DC level shift and clamp of each of the three components
+	 */
+	static void decode_rev_shift(int32_t *c0, int32_t *c1, int32_t *c2,
+			uint64_t n, const DcShiftParams *params);
+	/**
+	 Apply an irreversible multi-component inverse transform to an image,
+	 followed by the DC level shift and clamp of each component.
+	 Samples are rounded to integers, which are written over the input.
+	 @param c0 Samples for luminance component
+	 @param c1 Samples for red chrominance component
+	 @param c2 Samples for blue chrominance component
+	 @param n Number of samples for each component
+	 @param params DC level shift and clamp of each of the three components
+	 */
+	static void decode_irrev_shift(float *c0, float *c1, float *c2,
+			uint64_t n, const DcShiftParams *params);
+
 	/**
 	 FIXME DOC
 	 */
@@ -153,6 +188,28 @@ public:
 
 };
 
+namespace GRK_SIMD_NS {
+
+/**
+ SIMD kernels of mct::encode_rev, mct::decode_rev, mct::encode_irrev
+ and mct::decode_irrev
+ */
+void mct_encode_rev(int32_t *c0, int32_t *c1, int32_t *c2, uint64_t n);
+void mct_decode_rev(int32_t *c0, int32_t *c1, int32_t *c2, uint64_t n);
+void mct_encode_irrev(int32_t *c0, int32_t *c1, int32_t *c2, uint64_t n);
+void mct_decode_irrev(float *c0, float *c1, float *c2, uint64_t n);
+
+/**
+ SIMD kernels of mct::decode_rev_shift and mct::decode_irrev_shift.
+ Unlike the kernels above, they run on the calling thread.
+ */
+void mct_decode_rev_shift(int32_t *c0, int32_t *c1, int32_t *c2, uint64_t n,
+		const DcShiftParams *params);
+void mct_decode_irrev_shift(float *c0, float *c1, float *c2, uint64_t n,
+		const DcShiftParams *params);
+
+}
+
 /* ----------------------------------------------------------------------- */
 /*@}*/
 
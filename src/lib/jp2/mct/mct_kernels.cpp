@@ -0,0 +1,484 @@
+/*
+ *    Copyright (C) 2016-2020 Grok Image Compression Inc.
+ *
+ *    This source code is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This source code is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ *    This source code incorporates work covered by the following copyright and
+ *    permission notice:
+ *
+ * The copyright in this software is being made available under the 2-clauses
+ * BSD License, included below. This software may be subject to other third
+ * party and contributor rights, including patent rights, and no such rights
+ * are granted under this license.
+ *
+ * Copyright (c) 2002-2014, Universite catholique de Louvain (UCL), Belgium
+ * Copyright (c) 2002-2014, Professor Benoit Macq
+ * Copyright (c) 2001-2003, David Janssens
+ * Copyright (c) 2002-2003, Yannick Verschueren
+ * Copyright (c) 2003-2007, Francois-Olivier Devaux
+ * Copyright (c) 2003-2014, Antonin Descampe
+ * Copyright (c) 2005, Herve Drolon, FreeImage Team
+ * Copyright (c) 2008, 2011-2012, Centre National d'Etudes Spatiales (CNES), FR
+ * Copyright (c) 2012, CS Systemes d'Information, France
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS `AS IS'
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "simd.h"
+#include "grok_includes.h"
+
+namespace grk {
+namespace GRK_SIMD_NS {
+
+/* <summary> */
+/* Forward reversible MCT. */
+/* </summary> */
+void mct_encode_rev(int32_t *GRK_RESTRICT chan0, int32_t *GRK_RESTRICT chan1,
+		int32_t *GRK_RESTRICT chan2, uint64_t n) {
+	size_t i = 0;
+
+#if (defined(__SSE2__) || defined(__AVX2__))
+    size_t chunkSize = n / ThreadPool::get()->num_jobs();
+    //ensure it is divisible by VREG_INT_COUNT
+    chunkSize = (chunkSize/VREG_INT_COUNT) * VREG_INT_COUNT;
+	if (chunkSize > VREG_INT_COUNT) {
+	    std::vector< std::future<int> > results;
+	    for(uint64_t i = 0; i < ThreadPool::get()->num_jobs(); ++i) {
+	    	uint64_t index = i;
+	        results.emplace_back(
+	            ThreadPool::get()->enqueue([index, chunkSize, chan0,chan1,chan2] {
+	        		uint64_t begin = (uint64_t)index * chunkSize;
+					for (auto j = begin; j < begin+chunkSize; j+=VREG_INT_COUNT ){
+						VREG y, u, v;
+						VREG r = LOAD((const VREG*) &chan0[j]);
+						VREG g = LOAD((const VREG*) &chan1[j]);
+						VREG b = LOAD((const VREG*) &chan2[j]);
+						y = ADD(g, g);
+						y = ADD(y, b);
+						y = ADD(y, r);
+						y = SAR(y, 2);
+						u = SUB(b, g);
+						v = SUB(r, g);
+						STORE((VREG*) &chan0[j], y);
+						STORE((VREG*) &chan1[j], u);
+						STORE((VREG*) &chan2[j], v);
+					}
+	                return 0;
+	            })
+	        );
+	    }
+	    for(auto && result: results){
+	        result.get();
+	    }
+		i = chunkSize * ThreadPool::get()->num_jobs();
+	}
+#endif
+	for (; i < n; ++i) {
+		int32_t r = chan0[i];
+		int32_t g = chan1[i];
+		int32_t b = chan2[i];
+		int32_t y = (r + (g * 2) + b) >> 2;
+		int32_t u = b - g;
+		int32_t v = r - g;
+		chan0[i] = y;
+		chan1[i] = u;
+		chan2[i] = v;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+/* <summary> */
+/* Inverse reversible MCT. */
+/* </summary> */
+void mct_decode_rev(int32_t *GRK_RESTRICT chan0, int32_t *GRK_RESTRICT chan1,
+		int32_t *GRK_RESTRICT chan2, uint64_t n) {
+	size_t i = 0;
+#if (defined(__SSE2__) || defined(__AVX2__))
+    size_t chunkSize = n / ThreadPool::get()->num_jobs();
+    //ensure it is divisible by VREG_INT_COUNT
+    chunkSize = (chunkSize/VREG_INT_COUNT) * VREG_INT_COUNT;
+	if (chunkSize > VREG_INT_COUNT) {
+	    std::vector< std::future<int> > results;
+	    for(uint64_t i = 0; i < ThreadPool::get()->num_jobs(); ++i) {
+	    	uint64_t index = i;
+	        results.emplace_back(
+	            ThreadPool::get()->enqueue([index, chunkSize,chan0,chan1,chan2] {
+					uint64_t begin = (uint64_t)index * chunkSize;
+					for (auto j = begin; j < begin+chunkSize; j+=VREG_INT_COUNT ){
+						VREG r, g, b;
+						VREG y = LOAD((const VREG*) &(chan0[j]));
+						VREG u = LOAD((const VREG*) &(chan1[j]));
+						VREG v = LOAD((const VREG*) &(chan2[j]));
+						g = y;
+						g = SUB(g, SAR(ADD(u, v), 2));
+						r = ADD(v, g);
+						b = ADD(u, g);
+						STORE((VREG*) &(chan0[j]), r);
+						STORE((VREG*) &(chan1[j]), g);
+						STORE((VREG*) &(chan2[j]), b);
+					}
+					return 0;
+	            })
+	        );
+	    }
+	    for(auto && result: results){
+	        result.get();
+	    }
+		i = chunkSize * ThreadPool::get()->num_jobs();
+	}
+#endif
+	for (; i < n; ++i) {
+		int32_t y = chan0[i];
+		int32_t u = chan1[i];
+		int32_t v = chan2[i];
+		int32_t g = y - ((u + v) >> 2);
+		int32_t r = v + g;
+		int32_t b = u + g;
+		chan0[i] = r;
+		chan1[i] = g;
+		chan2[i] = b;
+	}
+}
+/* <summary> */
+/* Forward irreversible MCT. */
+/* </summary> */
+void mct_encode_irrev( int32_t* GRK_RESTRICT chan0,
+						int32_t* GRK_RESTRICT chan1,
+						int32_t* GRK_RESTRICT chan2,
+						uint64_t n)
+{
+    size_t i = 0;
+#ifdef __SSE4_1__
+    const __m128i ry = _mm_set1_epi32(2449);
+    const __m128i gy = _mm_set1_epi32(4809);
+    const __m128i by = _mm_set1_epi32(934);
+    const __m128i ru = _mm_set1_epi32(1382);
+    const __m128i gu = _mm_set1_epi32(2714);
+    const __m128i gv = _mm_set1_epi32(3430);
+    const __m128i bv = _mm_set1_epi32(666);
+    const __m128i mulround = _mm_shuffle_epi32(_mm_cvtsi32_si128(4096), _MM_SHUFFLE(1, 0, 1, 0));
+
+    size_t chunkSize = n / ThreadPool::get()->num_jobs();
+    //ensure it is divisible by 4
+    chunkSize = (chunkSize/4) * 4;
+	if (chunkSize > 4) {
+
+		std::vector< std::future<int> > results;
+		for(size_t k = 0; k < ThreadPool::get()->num_jobs(); ++k) {
+			uint64_t index = k;
+			results.emplace_back(
+				ThreadPool::get()->enqueue([index, chunkSize, chan0,chan1,chan2,
+											 ry,gy,by,ru,gu,gv,bv,
+											 mulround] {
+
+				uint64_t begin = (uint64_t)index * chunkSize;
+				for (auto j = begin; j < begin+chunkSize; j+=4 ){
+					__m128i lo, hi;
+					__m128i y, u, v;
+					__m128i r = _mm_load_si128((const __m128i *)&(chan0[j]));
+					__m128i g = _mm_load_si128((const __m128i *)&(chan1[j]));
+					__m128i b = _mm_load_si128((const __m128i *)&(chan2[j]));
+
+					lo = r;
+					hi = _mm_shuffle_epi32(r, _MM_SHUFFLE(3, 3, 1, 1));
+					lo = _mm_mul_epi32(lo, ry);
+					hi = _mm_mul_epi32(hi, ry);
+					lo = _mm_add_epi64(lo, mulround);
+					hi = _mm_add_epi64(hi, mulround);
+					lo = _mm_srli_epi64(lo, 13);
+					hi = _mm_slli_epi64(hi, 32-13);
+					y = _mm_blend_epi16(lo, hi, 0xCC);
+
+					lo = g;
+					hi = _mm_shuffle_epi32(g, _MM_SHUFFLE(3, 3, 1, 1));
+					lo = _mm_mul_epi32(lo, gy);
+					hi = _mm_mul_epi32(hi, gy);
+					lo = _mm_add_epi64(lo, mulround);
+					hi = _mm_add_epi64(hi, mulround);
+					lo = _mm_srli_epi64(lo, 13);
+					hi = _mm_slli_epi64(hi, 32-13);
+					y = _mm_add_epi32(y, _mm_blend_epi16(lo, hi, 0xCC));
+
+					lo = b;
+					hi = _mm_shuffle_epi32(b, _MM_SHUFFLE(3, 3, 1, 1));
+					lo = _mm_mul_epi32(lo, by);
+					hi = _mm_mul_epi32(hi, by);
+					lo = _mm_add_epi64(lo, mulround);
+					hi = _mm_add_epi64(hi, mulround);
+					lo = _mm_srli_epi64(lo, 13);
+					hi = _mm_slli_epi64(hi, 32-13);
+					y = _mm_add_epi32(y, _mm_blend_epi16(lo, hi, 0xCC));
+					_mm_store_si128((__m128i *)&(chan0[j]), y);
+
+					lo = _mm_cvtepi32_epi64(_mm_shuffle_epi32(b, _MM_SHUFFLE(3, 2, 2, 0)));
+					hi = _mm_cvtepi32_epi64(_mm_shuffle_epi32(b, _MM_SHUFFLE(3, 2, 3, 1)));
+					lo = _mm_slli_epi64(lo, 12);
+					hi = _mm_slli_epi64(hi, 12);
+					lo = _mm_add_epi64(lo, mulround);
+					hi = _mm_add_epi64(hi, mulround);
+					lo = _mm_srli_epi64(lo, 13);
+					hi = _mm_slli_epi64(hi, 32-13);
+					u = _mm_blend_epi16(lo, hi, 0xCC);
+
+					lo = r;
+					hi = _mm_shuffle_epi32(r, _MM_SHUFFLE(3, 3, 1, 1));
+					lo = _mm_mul_epi32(lo, ru);
+					hi = _mm_mul_epi32(hi, ru);
+					lo = _mm_add_epi64(lo, mulround);
+					hi = _mm_add_epi64(hi, mulround);
+					lo = _mm_srli_epi64(lo, 13);
+					hi = _mm_slli_epi64(hi, 32-13);
+					u = _mm_sub_epi32(u, _mm_blend_epi16(lo, hi, 0xCC));
+
+					lo = g;
+					hi = _mm_shuffle_epi32(g, _MM_SHUFFLE(3, 3, 1, 1));
+					lo = _mm_mul_epi32(lo, gu);
+					hi = _mm_mul_epi32(hi, gu);
+					lo = _mm_add_epi64(lo, mulround);
+					hi = _mm_add_epi64(hi, mulround);
+					lo = _mm_srli_epi64(lo, 13);
+					hi = _mm_slli_epi64(hi, 32-13);
+					u = _mm_sub_epi32(u, _mm_blend_epi16(lo, hi, 0xCC));
+					_mm_store_si128((__m128i *)&(chan1[j]), u);
+
+					lo = _mm_cvtepi32_epi64(_mm_shuffle_epi32(r, _MM_SHUFFLE(3, 2, 2, 0)));
+					hi = _mm_cvtepi32_epi64(_mm_shuffle_epi32(r, _MM_SHUFFLE(3, 2, 3, 1)));
+					lo = _mm_slli_epi64(lo, 12);
+					hi = _mm_slli_epi64(hi, 12);
+					lo = _mm_add_epi64(lo, mulround);
+					hi = _mm_add_epi64(hi, mulround);
+					lo = _mm_srli_epi64(lo, 13);
+					hi = _mm_slli_epi64(hi, 32-13);
+					v = _mm_blend_epi16(lo, hi, 0xCC);
+
+					lo = g;
+					hi = _mm_shuffle_epi32(g, _MM_SHUFFLE(3, 3, 1, 1));
+					lo = _mm_mul_epi32(lo, gv);
+					hi = _mm_mul_epi32(hi, gv);
+					lo = _mm_add_epi64(lo, mulround);
+					hi = _mm_add_epi64(hi, mulround);
+					lo = _mm_srli_epi64(lo, 13);
+					hi = _mm_slli_epi64(hi, 32-13);
+					v = _mm_sub_epi32(v, _mm_blend_epi16(lo, hi, 0xCC));
+
+					lo = b;
+					hi = _mm_shuffle_epi32(b, _MM_SHUFFLE(3, 3, 1, 1));
+					lo = _mm_mul_epi32(lo, bv);
+					hi = _mm_mul_epi32(hi, bv);
+					lo = _mm_add_epi64(lo, mulround);
+					hi = _mm_add_epi64(hi, mulround);
+					lo = _mm_srli_epi64(lo, 13);
+					hi = _mm_slli_epi64(hi, 32-13);
+					v = _mm_sub_epi32(v, _mm_blend_epi16(lo, hi, 0xCC));
+					_mm_store_si128((__m128i *)&(chan2[j]), v);
+
+				}
+				return 0;
+				})
+			);
+		}
+		for(auto && result: results){
+			result.get();
+		}
+		i = ThreadPool::get()->num_jobs() * chunkSize;
+	}
+#endif
+    for(; i < n; ++i) {
+        int32_t r = chan0[i];
+        int32_t g = chan1[i];
+        int32_t b = chan2[i];
+        int32_t y =  int_fix_mul(r, 2449) + int_fix_mul(g, 4809) + int_fix_mul(b, 934);
+        int32_t u = -int_fix_mul(r, 1382) - int_fix_mul(g, 2714) + int_fix_mul(b, 4096);
+        int32_t v =  int_fix_mul(r, 4096) - int_fix_mul(g, 3430) - int_fix_mul(b, 666);
+        chan0[i] = y;
+        chan1[i] = u;
+        chan2[i] = v;
+    }
+}
+
+/* <summary> */
+/* Inverse irreversible MCT. */
+/* </summary> */
+void mct_decode_irrev(float *GRK_RESTRICT c0, float *GRK_RESTRICT c1, float *GRK_RESTRICT c2,
+		uint64_t n) {
+	uint64_t i = 0;
+#if (defined(__SSE2__) || defined(__AVX2__))
+	size_t chunkSize = n / ThreadPool::get()->num_jobs();
+	//ensure it is divisible by VREG_INT_COUNT
+	chunkSize = (chunkSize/VREG_INT_COUNT) * VREG_INT_COUNT;
+	if (chunkSize > VREG_INT_COUNT) {
+		std::vector< std::future<int> > results;
+		for(uint64_t i = 0; i < ThreadPool::get()->num_jobs(); ++i) {
+			uint64_t index = i;
+			results.emplace_back(
+				ThreadPool::get()->enqueue([index, chunkSize, c0,c1,c2] {
+				const VREGF vrv = LOAD_CST_F(1.402f);
+				const VREGF vgu = LOAD_CST_F(0.34413f);
+				const VREGF vgv = LOAD_CST_F(0.71414f);
+				const VREGF vbu = LOAD_CST_F(1.772f);
+				uint64_t begin = (uint64_t)index * chunkSize;
+				for (auto j = begin; j < begin+chunkSize; j +=VREG_INT_COUNT){
+					VREGF vy, vu, vv;
+					VREGF vr, vg, vb;
+
+					vy = LOADF(c0 + j);
+					vu = LOADF(c1 + j);
+					vv = LOADF(c2 + j);
+					vr = ADDF(vy, MULF(vv, vrv));
+					vg = SUBF(SUBF(vy, MULF(vu, vgu)),MULF(vv, vgv));
+					vb = ADDF(vy, MULF(vu, vbu));
+					STOREF(c0 + j, vr);
+					STOREF(c1 + j, vg);
+					STOREF(c2 + j, vb);
+				}
+				return 0;
+				})
+			);
+		}
+		for(auto && result: results){
+			result.get();
+		}
+		i = chunkSize * ThreadPool::get()->num_jobs();
+	}
+#endif
+	for (; i < n; ++i) {
+		float y = c0[i];
+		float u = c1[i];
+		float v = c2[i];
+		float r = y + (v * 1.402f);
+		float g = y - (u * 0.34413f) - (v * (0.71414f));
+		float b = y + (u * 1.772f);
+		c0[i] = r;
+		c1[i] = g;
+		c2[i] = b;
+	}
+}
+
+/* <summary> */
+/* Inverse reversible MCT, DC level shift and clamp. */
+/* </summary> */
+void mct_decode_rev_shift(int32_t *GRK_RESTRICT c0, int32_t *GRK_RESTRICT c1,
+		int32_t *GRK_RESTRICT c2, uint64_t n, const DcShiftParams *params) {
+	uint64_t i = 0;
+#if (defined(__SSE2__) || defined(__AVX2__))
+	const VREG shift0 = LOAD_CST(params[0].shift);
+	const VREG shift1 = LOAD_CST(params[1].shift);
+	const VREG shift2 = LOAD_CST(params[2].shift);
+	const VREG min0 = LOAD_CST(params[0].min);
+	const VREG min1 = LOAD_CST(params[1].min);
+	const VREG min2 = LOAD_CST(params[2].min);
+	const VREG max0 = LOAD_CST(params[0].max);
+	const VREG max1 = LOAD_CST(params[1].max);
+	const VREG max2 = LOAD_CST(params[2].max);
+	for (; i + VREG_INT_COUNT <= n; i += VREG_INT_COUNT) {
+		VREG y = LOADU(c0 + i);
+		VREG u = LOADU(c1 + i);
+		VREG v = LOADU(c2 + i);
+		VREG g = SUB(y, SAR(ADD(u, v), 2));
+		VREG r = ADD(v, g);
+		VREG b = ADD(u, g);
+		STOREU(c0 + i, MIN(MAX(ADD(r, shift0), min0), max0));
+		STOREU(c1 + i, MIN(MAX(ADD(g, shift1), min1), max1));
+		STOREU(c2 + i, MIN(MAX(ADD(b, shift2), min2), max2));
+	}
+#endif
+	for (; i < n; ++i) {
+		int32_t y = c0[i];
+		int32_t u = c1[i];
+		int32_t v = c2[i];
+		int32_t g = y - ((u + v) >> 2);
+		int32_t r = v + g;
+		int32_t b = u + g;
+		c0[i] = int_clamp(r + params[0].shift, params[0].min, params[0].max);
+		c1[i] = int_clamp(g + params[1].shift, params[1].min, params[1].max);
+		c2[i] = int_clamp(b + params[2].shift, params[2].min, params[2].max);
+	}
+}
+
+/* <summary> */
+/* Inverse irreversible MCT, DC level shift and clamp. */
+/* </summary> */
+void mct_decode_irrev_shift(float *c0, float *c1, float *c2, uint64_t n,
+		const DcShiftParams *params) {
+	uint64_t i = 0;
+	/* integer samples are written over the float samples,
+	 * so neither may be declared restrict */
+	int32_t *d0 = (int32_t*) c0;
+	int32_t *d1 = (int32_t*) c1;
+	int32_t *d2 = (int32_t*) c2;
+#if (defined(__SSE2__) || defined(__AVX2__))
+	const VREGF vrv = LOAD_CST_F(1.402f);
+	const VREGF vgu = LOAD_CST_F(0.34413f);
+	const VREGF vgv = LOAD_CST_F(0.71414f);
+	const VREGF vbu = LOAD_CST_F(1.772f);
+	const VREG shift0 = LOAD_CST(params[0].shift);
+	const VREG shift1 = LOAD_CST(params[1].shift);
+	const VREG shift2 = LOAD_CST(params[2].shift);
+	const VREG min0 = LOAD_CST(params[0].min);
+	const VREG min1 = LOAD_CST(params[1].min);
+	const VREG min2 = LOAD_CST(params[2].min);
+	const VREG max0 = LOAD_CST(params[0].max);
+	const VREG max1 = LOAD_CST(params[1].max);
+	const VREG max2 = LOAD_CST(params[2].max);
+	for (; i + VREG_INT_COUNT <= n; i += VREG_INT_COUNT) {
+		VREGF vy = LOADUF(c0 + i);
+		VREGF vu = LOADUF(c1 + i);
+		VREGF vv = LOADUF(c2 + i);
+		VREGF vr = ADDF(vy, MULF(vv, vrv));
+		VREGF vg = SUBF(SUBF(vy, MULF(vu, vgu)), MULF(vv, vgv));
+		VREGF vb = ADDF(vy, MULF(vu, vbu));
+		STOREU(d0 + i, MIN(MAX(ADD(CVT_F2I(vr), shift0), min0), max0));
+		STOREU(d1 + i, MIN(MAX(ADD(CVT_F2I(vg), shift1), min1), max1));
+		STOREU(d2 + i, MIN(MAX(ADD(CVT_F2I(vb), shift2), min2), max2));
+	}
+#endif
+	for (; i < n; ++i) {
+		float y = c0[i];
+		float u = c1[i];
+		float v = c2[i];
+		float r = y + (v * 1.402f);
+		float g = y - (u * 0.34413f) - (v * (0.71414f));
+		float b = y + (u * 1.772f);
+		d0[i] = int_clamp((int32_t) grok_lrintf(r) + params[0].shift,
+				params[0].min, params[0].max);
+		d1[i] = int_clamp((int32_t) grok_lrintf(g) + params[1].shift,
+				params[1].min, params[1].max);
+		d2[i] = int_clamp((int32_t) grok_lrintf(b) + params[2].shift,
+				params[2].min, params[2].max);
+	}
+}
+
+}
+}
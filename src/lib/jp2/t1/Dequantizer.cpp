@@ -0,0 +1,179 @@
+/*
+ *    Copyright (C) 2016-2020 Grok Image Compression Inc.
+ *
+ *    This source code is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This source code is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "simd.h"
+#include "grok_includes.h"
+#include "Dequantizer.h"
+
+namespace grk {
+namespace GRK_SIMD_NS {
+
+static inline void dequantize_scalar(const int32_t *src, int32_t *dest,
+		uint32_t count, const DequantizeParams &params) {
+	uint32_t roishift = params.roishift;
+	uint32_t thresh = roishift < 31 ? 1U << roishift : 0;
+	for (uint32_t i = 0; i < count; ++i) {
+		int32_t val = src[i];
+		bool neg = val < 0;
+		uint32_t mag =
+				params.signMagnitude ?
+						(uint32_t) val & 0x7FFFFFFF : (uint32_t) abs(val);
+		if (roishift) {
+			if (roishift >= 31)
+				mag = 0;
+			else if (mag >= thresh)
+				mag >>= roishift;
+		}
+		if (params.reversible) {
+			mag >>= params.shift;
+			dest[i] = neg ? -(int32_t) mag : (int32_t) mag;
+		} else {
+			float f = (float) mag * params.stepsize;
+			((float*) dest)[i] = neg ? -f : f;
+		}
+	}
+}
+
+#if defined(__AVX2__)
+const uint32_t dequantize_vec_len = 8;
+#define DQ_VREG 			__m256i
+#define DQ_LOADU(x)			_mm256_loadu_si256((const __m256i*)(x))
+#define DQ_STOREU(x,y)		_mm256_storeu_si256((__m256i*)(x),(y))
+#define DQ_SET1(x)			_mm256_set1_epi32(x)
+#define DQ_AND(x,y)			_mm256_and_si256((x),(y))
+#define DQ_XOR(x,y)			_mm256_xor_si256((x),(y))
+#define DQ_SUB(x,y)			_mm256_sub_epi32((x),(y))
+#define DQ_ABS(x)			_mm256_abs_epi32(x)
+#define DQ_SRAI(x,y)		_mm256_srai_epi32((x),(y))
+#define DQ_SRL(x,y)			_mm256_srl_epi32((x),(y))
+#define DQ_CMPGT(x,y)		_mm256_cmpgt_epi32((x),(y))
+#define DQ_BLENDV(x,y,m)	_mm256_blendv_epi8((x),(y),(m))
+#define DQ_TO_FLOAT(x)		_mm256_cvtepi32_ps(x)
+#define DQ_MULF(x,y)		_mm256_mul_ps((x),(y))
+#define DQ_SET1F(x)			_mm256_set1_ps(x)
+#define DQ_CASTF(x)			_mm256_castps_si256(x)
+#define DQ_CASTI(x)			_mm256_castsi256_ps(x)
+#define DQ_ZERO()			_mm256_setzero_si256()
+#define DQ_VREGF			__m256
+#elif defined(__SSE4_1__)
+const uint32_t dequantize_vec_len = 4;
+#define DQ_VREG 			__m128i
+#define DQ_LOADU(x)			_mm_loadu_si128((const __m128i*)(x))
+#define DQ_STOREU(x,y)		_mm_storeu_si128((__m128i*)(x),(y))
+#define DQ_SET1(x)			_mm_set1_epi32(x)
+#define DQ_AND(x,y)			_mm_and_si128((x),(y))
+#define DQ_XOR(x,y)			_mm_xor_si128((x),(y))
+#define DQ_SUB(x,y)			_mm_sub_epi32((x),(y))
+#define DQ_ABS(x)			_mm_abs_epi32(x)
+#define DQ_SRAI(x,y)		_mm_srai_epi32((x),(y))
+#define DQ_SRL(x,y)			_mm_srl_epi32((x),(y))
+#define DQ_CMPGT(x,y)		_mm_cmpgt_epi32((x),(y))
+#define DQ_BLENDV(x,y,m)	_mm_blendv_epi8((x),(y),(m))
+#define DQ_TO_FLOAT(x)		_mm_cvtepi32_ps(x)
+#define DQ_MULF(x,y)		_mm_mul_ps((x),(y))
+#define DQ_SET1F(x)			_mm_set1_ps(x)
+#define DQ_CASTF(x)			_mm_castps_si128(x)
+#define DQ_CASTI(x)			_mm_castsi128_ps(x)
+#define DQ_ZERO()			_mm_setzero_si128()
+#define DQ_VREGF			__m128
+#endif
+
+#ifdef DQ_VREG
+/*
+ Vector kernel for one row. The sign mask (all ones for negative samples)
+ comes from the sign bit in both sample formats, and is applied to the
+ magnitude with xor/subtract for integers, or to the float sign bit.
+ */
+template<bool signMagnitude, bool roi, bool reversible> uint32_t dequantize_vec(
+		const int32_t *src, int32_t *dest, uint32_t count,
+		const DequantizeParams &params) {
+	const DQ_VREG magMask = DQ_SET1(0x7FFFFFFF);
+	const DQ_VREG signBit = DQ_SET1((int32_t) 0x80000000);
+	const DQ_VREG threshMinusOne = DQ_SET1(
+			(int32_t) ((1U << (params.roishift & 31)) - 1));
+	const __m128i roiShift = _mm_cvtsi32_si128((int) params.roishift);
+	const __m128i revShift = _mm_cvtsi32_si128((int) params.shift);
+	const DQ_VREGF step = DQ_SET1F(params.stepsize);
+	uint32_t i = 0;
+	for (; i + dequantize_vec_len <= count; i += dequantize_vec_len) {
+		DQ_VREG val = DQ_LOADU(src + i);
+		DQ_VREG sign = DQ_SRAI(val, 31);
+		DQ_VREG mag = signMagnitude ? DQ_AND(val, magMask) : DQ_ABS(val);
+		if (roi) {
+			DQ_VREG above = DQ_CMPGT(mag, threshMinusOne);
+			mag = DQ_BLENDV(mag, DQ_SRL(mag, roiShift), above);
+		}
+		if (reversible) {
+			mag = DQ_SRL(mag, revShift);
+			DQ_STOREU(dest + i, DQ_SUB(DQ_XOR(mag, sign), sign));
+		} else {
+			DQ_VREG f = DQ_CASTF(DQ_MULF(DQ_TO_FLOAT(mag), step));
+			DQ_STOREU(dest + i, DQ_XOR(f, DQ_AND(sign, signBit)));
+		}
+	}
+
+	return i;
+}
+
+typedef uint32_t (*dequantize_vec_fn)(const int32_t*, int32_t*, uint32_t,
+		const DequantizeParams&);
+
+static dequantize_vec_fn get_dequantize_vec(const DequantizeParams &params) {
+	bool roi = params.roishift != 0;
+	if (params.signMagnitude) {
+		if (roi)
+			return params.reversible ?
+					dequantize_vec<true, true, true> :
+					dequantize_vec<true, true, false>;
+		return params.reversible ?
+				dequantize_vec<true, false, true> :
+				dequantize_vec<true, false, false>;
+	}
+	if (roi)
+		return params.reversible ?
+				dequantize_vec<false, true, true> :
+				dequantize_vec<false, true, false>;
+	return params.reversible ?
+			dequantize_vec<false, false, true> :
+			dequantize_vec<false, false, false>;
+}
+#endif
+
+void dequantize_cblk(const int32_t *src, uint32_t w, uint32_t h,
+		int32_t *dest, uint32_t dest_stride, const DequantizeParams &params) {
+	// all samples are discarded by ROI shift
+	if (params.roishift >= 31) {
+		for (uint32_t j = 0; j < h; ++j)
+			memset(dest + (size_t) j * dest_stride, 0, w * sizeof(int32_t));
+		return;
+	}
+#ifdef DQ_VREG
+	auto vec = get_dequantize_vec(params);
+#endif
+	for (uint32_t j = 0; j < h; ++j) {
+		uint32_t i = 0;
+#ifdef DQ_VREG
+		i = vec(src, dest, w, params);
+#endif
+		dequantize_scalar(src + i, dest + i, w - i, params);
+		src += w;
+		dest += dest_stride;
+	}
+}
+
+}
+}
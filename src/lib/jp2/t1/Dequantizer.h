@@ -0,0 +1,62 @@
+/*
+ *    Copyright (C) 2016-2020 Grok Image Compression Inc.
+ *
+ *    This source code is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This source code is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#pragma once
+#include <cstdint>
+#include "simd_kernels.h"
+
+namespace grk {
+
+struct DequantizeParams {
+	DequantizeParams() :
+			roishift(0), reversible(true), shift(1), stepsize(1.0f), signMagnitude(
+					false) {
+	}
+	// ROI up shift
+	uint32_t roishift;
+	// reversible: integer output, otherwise float output
+	bool reversible;
+	// reversible: right shift from decoded magnitude to coefficient
+	uint32_t shift;
+	// irreversible: quantization step size
+	float stepsize;
+	// code block samples are stored in sign-magnitude form (HT)
+	// rather than two's complement form (Part 1)
+	bool signMagnitude;
+};
+
+/*
+ Convert decoded code block samples to wavelet coefficients in a single pass:
+ ROI down shift, conversion to two's complement, and dequantization.
+ Coefficients are stored to dest, with row stride dest_stride.
+ Source and destination may be the same buffer when dest_stride equals w.
+ */
+void dequantize_cblk(const int32_t *src, uint32_t w, uint32_t h,
+		int32_t *dest, uint32_t dest_stride, const DequantizeParams &params);
+
+namespace GRK_SIMD_NS {
+
+/*
+ SIMD kernel of dequantize_cblk
+ */
+void dequantize_cblk(const int32_t *src, uint32_t w, uint32_t h,
+		int32_t *dest, uint32_t dest_stride, const DequantizeParams &params);
+
+}
+
+}
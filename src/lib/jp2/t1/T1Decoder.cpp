@@ -51,7 +51,7 @@ bool T1Decoder::decompress(std::vector<decodeBlockInfo*> *blocks) {
 	std::atomic<int> blockCount(-1);
 	success = true;
     std::vector< std::future<int> > results;
-    for(size_t i = 0; i < ThreadPool::get()->num_threads(); ++i) {
+    for(size_t i = 0; i < ThreadPool::get()->num_jobs(); ++i) {
         results.emplace_back(
             ThreadPool::get()->enqueue([this, maxBlocks, &blockCount] {
                 auto threadnum =  ThreadPool::get()->thread_number(std::this_thread::get_id());
@@ -21,12 +21,22 @@
 
 namespace grk {
 
+/* early termination: one out of every sampleStride blocks of each band
+ * is coded in full, and the rate control threshold for the tile
+ * is estimated from this sample */
+const uint64_t sampleStride = 8;
+// estimated threshold is divided by this margin to allow for
+// sampling error; a factor of four is roughly one bit plane
+const double earlyTerminationMargin = 4.0;
+
 T1Encoder::T1Encoder(TileCodingParams *tcp, grk_tcd_tile *tile, uint32_t encodeMaxCblkW,
-		uint32_t encodeMaxCblkH, bool needsRateControl) :
+		uint32_t encodeMaxCblkH, bool needsRateControl, double maxBytes) :
 		tile(tile),
 		needsRateControl(needsRateControl),
+		maxBytes(maxBytes),
 		encodeBlocks(nullptr),
-		blockCount(-1)
+		blockCount(-1),
+		terminatedCount(0)
 {
 	for (auto i = 0U; i < ThreadPool::get()->num_threads(); ++i) {
 		threadStructs.push_back(
@@ -46,6 +56,8 @@ bool T1Encoder::compress(size_t threadId, uint64_t maxBlocks) {
 	uint32_t max = 0;
 	impl->preEncode(block, tile, max);
 	auto dist = impl->compress(block, tile, max, needsRateControl);
+	if (block->terminated_early)
+		++terminatedCount;
 	if (needsRateControl) {
 		std::unique_lock<std::mutex> lk(distortion_mutex);
 		tile->distotile += dist;
@@ -54,21 +66,15 @@ bool T1Encoder::compress(size_t threadId, uint64_t maxBlocks) {
 	return true;
 
 }
-bool T1Encoder::compress(std::vector<encodeBlockInfo*> *blocks) {
-	if (!blocks || blocks->size() == 0)
-		return true;
-
-	auto maxBlocks = blocks->size();
-	encodeBlocks = new encodeBlockInfo*[maxBlocks];
-	for (uint64_t i = 0; i < maxBlocks; ++i)
-		encodeBlocks[i] = blocks->operator[](i);
-	blocks->clear();
+void T1Encoder::compress(encodeBlockInfo **blocks, uint64_t numBlocks) {
+	encodeBlocks = blocks;
+	blockCount = -1;
     std::vector< std::future<int> > results;
-    for(size_t i = 0; i < ThreadPool::get()->num_threads(); ++i) {
+    for(size_t i = 0; i < ThreadPool::get()->num_jobs(); ++i) {
           results.emplace_back(
-            ThreadPool::get()->enqueue([this, maxBlocks] {
+            ThreadPool::get()->enqueue([this, numBlocks] {
                 auto threadnum =  ThreadPool::get()->thread_number(std::this_thread::get_id());
-                while(compress((size_t)threadnum, maxBlocks)){
+                while(compress((size_t)threadnum, numBlocks)){
 
                 }
                 return 0;
@@ -78,7 +84,123 @@ bool T1Encoder::compress(std::vector<encodeBlockInfo*> *blocks) {
     for(auto && result: results){
         result.get();
     }
-	delete[] encodeBlocks;
+}
+/*
+ Estimate rate control threshold from code blocks in sample, by filling
+ the tile budget with convex hull segments, in order of decreasing slope.
+ Segment lengths of a block are scaled by the weight of its band
+ in the sample
+ */
+double T1Encoder::estimate_min_slope(
+		std::vector<std::pair<grk_tcd_cblk_enc*, double>> &sample) {
+	// (slope, length) of convex hull segments
+	std::vector<std::pair<double, double>> segments;
+	std::vector<std::pair<uint32_t, double>> hull;
+	for (auto &s : sample) {
+		auto cblk = s.first;
+		hull.clear();
+		hull.push_back(std::make_pair(0, 0.0));
+		for (uint32_t passno = 0; passno < cblk->num_passes_encoded; ++passno) {
+			auto pass = cblk->passes + passno;
+			uint32_t rate = pass->rate;
+			double disto = pass->distortiondec;
+			while (hull.size() > 1) {
+				auto &b = hull.back();
+				auto &a = hull[hull.size() - 2];
+				// keep hull convex: slopes must decrease
+				if (rate > b.first
+						&& (disto - b.second) * (double) (b.first - a.first)
+								< (b.second - a.second)
+										* (double) (rate - b.first))
+					break;
+				hull.pop_back();
+			}
+			if (rate > hull.back().first && disto > hull.back().second)
+				hull.push_back(std::make_pair(rate, disto));
+		}
+		for (size_t i = 1; i < hull.size(); ++i) {
+			uint32_t len = hull[i].first - hull[i - 1].first;
+			segments.push_back(
+					std::make_pair((hull[i].second - hull[i - 1].second) / len,
+							len * s.second));
+		}
+	}
+	std::sort(segments.begin(), segments.end(),
+			[](const std::pair<double, double> &a,
+					const std::pair<double, double> &b) {
+				return a.first > b.first;
+			});
+	double len = 0;
+	for (auto &seg : segments) {
+		len += seg.second;
+		if (len > maxBytes)
+			return seg.first / earlyTerminationMargin;
+	}
+
+	// all passes fit within budget
+	return 0;
+}
+bool T1Encoder::compress(std::vector<encodeBlockInfo*> *blocks) {
+	if (!blocks || blocks->size() == 0)
+		return true;
+
+	auto maxBlocks = blocks->size();
+	auto allBlocks = new encodeBlockInfo*[maxBlocks];
+	if (needsRateControl && maxBytes > 0) {
+		// sample blocks are coded first, in full;
+		// remaining blocks are coded with early termination
+		std::vector<std::pair<grk_tcd_cblk_enc*, double>> sample;
+		std::vector<encodeBlockInfo*> rest;
+		// blocks are ordered by component, resolution and band
+		uint64_t bandBegin = 0;
+		while (bandBegin < maxBlocks) {
+			auto first = blocks->operator[](bandBegin);
+			uint64_t bandEnd = bandBegin;
+			uint64_t bandPixels = 0;
+			uint64_t samplePixels = 0;
+			size_t sampleBegin = sample.size();
+			for (; bandEnd < maxBlocks; ++bandEnd) {
+				auto block = blocks->operator[](bandEnd);
+				if (block->compno != first->compno
+						|| block->resno != first->resno
+						|| block->bandno != first->bandno)
+					break;
+				auto cblk = block->cblk;
+				uint64_t pixels = (uint64_t) (cblk->x1 - cblk->x0)
+						* (cblk->y1 - cblk->y0);
+				bandPixels += pixels;
+				if ((bandEnd - bandBegin) % sampleStride == 0) {
+					allBlocks[sample.size()] = block;
+					sample.push_back(std::make_pair(cblk, 0.0));
+					samplePixels += pixels;
+				} else {
+					rest.push_back(block);
+				}
+			}
+			for (size_t i = sampleBegin; i < sample.size(); ++i)
+				sample[i].second = (double) bandPixels / (double) samplePixels;
+			bandBegin = bandEnd;
+		}
+		blocks->clear();
+		uint64_t numSample = sample.size();
+		compress(allBlocks, numSample);
+		double minSlope = estimate_min_slope(sample);
+		for (uint64_t i = 0; i < rest.size(); ++i) {
+			rest[i]->min_slope = minSlope;
+			allBlocks[numSample + i] = rest[i];
+		}
+		compress(allBlocks + numSample, rest.size());
+		GROK_INFO("Early termination: %llu of %llu code blocks stopped "
+				"coding before their last bit plane",
+				(unsigned long long) terminatedCount,
+				(unsigned long long) maxBlocks);
+	} else {
+		for (uint64_t i = 0; i < maxBlocks; ++i)
+			allBlocks[i] = blocks->operator[](i);
+		blocks->clear();
+		compress(allBlocks, maxBlocks);
+	}
+	delete[] allBlocks;
 	return true;
 }
 
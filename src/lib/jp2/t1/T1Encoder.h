@@ -23,21 +23,32 @@ namespace grk {
 
 class T1Encoder {
 public:
+	/*
+	 maxBytes: if non-zero, maximum number of bytes of the tile. Coding
+	 passes that can not be included within this budget are not coded
+	 (early termination)
+	 */
 	T1Encoder(TileCodingParams *tcp, grk_tcd_tile *tile, uint32_t encodeMaxCblkW,
-			uint32_t encodeMaxCblkH, bool needsRateControl);
+			uint32_t encodeMaxCblkH, bool needsRateControl, double maxBytes);
 	~T1Encoder();
 	bool compress(std::vector<encodeBlockInfo*> *blocks);
 
 private:
 	bool compress(size_t threadId, uint64_t maxBlocks);
+	void compress(encodeBlockInfo **blocks, uint64_t numBlocks);
+	double estimate_min_slope(
+			std::vector<std::pair<grk_tcd_cblk_enc*, double>> &sample);
 
 	grk_tcd_tile *tile;
 	std::vector<T1Interface*> threadStructs;
 	mutable std::mutex distortion_mutex;
 	bool needsRateControl;
+	double maxBytes;
 	mutable std::mutex block_mutex;
 	encodeBlockInfo** encodeBlocks;
 	std::atomic<int64_t> blockCount;
+	// number of blocks whose coding stopped before the last bit plane
+	std::atomic<uint64_t> terminatedCount;
 
 };
 
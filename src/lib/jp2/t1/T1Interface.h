@@ -72,7 +72,9 @@ struct encodeBlockInfo {
 		unencodedData(nullptr),
 #endif
 					mct_numcomps(0),
-					k_msbs(0)
+					k_msbs(0),
+					min_slope(0),
+					terminated_early(false)
 	{
 	}
 	int32_t *tiledp;
@@ -95,6 +97,11 @@ struct encodeBlockInfo {
 #endif
 	uint32_t mct_numcomps;
 	uint8_t k_msbs;
+	// coding stops after first bit plane with distortion-rate
+	// slope below this threshold (0: code all bit planes)
+	double min_slope;
+	// set by the coder when coding stopped before the last bit plane
+	bool terminated_early;
 };
 
 class T1Interface {
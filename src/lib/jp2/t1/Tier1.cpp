@@ -25,7 +25,8 @@ bool Tier1::encodeCodeblocks(TileCodingParams *tcp,
 							grk_tcd_tile *tile,
 							const double *mct_norms,
 							uint32_t mct_numcomps,
-							bool doRateControl) {
+							bool doRateControl,
+							double maxBytes) {
 
 	uint32_t compno, resno, bandno, precno;
 	tile->distotile = 0;
@@ -91,7 +92,7 @@ bool Tier1::encodeCodeblocks(TileCodingParams *tcp,
 			}
 		}
 	}
-	T1Encoder encoder(tcp, tile, maxCblkW, maxCblkH, doRateControl);
+	T1Encoder encoder(tcp, tile, maxCblkW, maxCblkH, doRateControl, maxBytes);
 	return encoder.compress(&blocks);
 }
 
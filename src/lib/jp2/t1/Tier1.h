@@ -29,7 +29,7 @@ public:
 	bool encodeCodeblocks(	TileCodingParams *tcp,
 							grk_tcd_tile *tile,
 							const double *mct_norms,
-			uint32_t mct_numcomps, bool doRateControl);
+			uint32_t mct_numcomps, bool doRateControl, double maxBytes);
 
 	bool prepareDecodeCodeblocks(TileComponent *tilec, TileComponentCodingParams *tccp,
 			std::vector<decodeBlockInfo*> *blocks);
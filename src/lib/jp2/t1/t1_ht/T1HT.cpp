@@ -26,6 +26,7 @@ using namespace ojph::local;
 #include "grok_includes.h"
 #include "T1HT.h"
 #include "testing.h"
+#include "Dequantizer.h"
 #include <algorithm>
 using namespace std;
 
@@ -33,12 +34,16 @@ using namespace std;
 namespace grk {
 namespace t1_ht {
 
+// extra bytes needed by the MagSgn unstuffing, beyond the segment length
+const uint32_t magsgn_padding = 32;
+
 T1HT::T1HT(bool isEncoder,
 			TileCodingParams *tcp,
 			uint32_t maxCblkW,
 			uint32_t maxCblkH) :
 				coded_data_size(isEncoder ? 0 : (uint32_t)(maxCblkW*maxCblkH* sizeof(int32_t))),
 				coded_data(isEncoder ? nullptr : new uint8_t[coded_data_size]),
+				magsgn_data(isEncoder ? nullptr : new uint8_t[coded_data_size + magsgn_padding]),
 				unencoded_data_size(maxCblkW*maxCblkH),
 				unencoded_data(new int32_t[unencoded_data_size]),
 				allocator( new mem_fixed_allocator),
@@ -49,6 +54,7 @@ T1HT::T1HT(bool isEncoder,
 }
 T1HT::~T1HT() {
    delete[] coded_data;
+   delete[] magsgn_data;
    delete[] unencoded_data;
    delete allocator;
    delete elastic_alloc;
@@ -144,6 +150,8 @@ bool T1HT::decompress(decodeBlockInfo *block) {
 	if (coded_data_size < total_seg_len) {
 		delete[] coded_data;
 		coded_data = new uint8_t[total_seg_len];
+		delete[] magsgn_data;
+		magsgn_data = new uint8_t[total_seg_len + magsgn_padding];
 		coded_data_size = (uint32_t)total_seg_len;
 	}
 	size_t offset = 0;
@@ -168,7 +176,8 @@ bool T1HT::decompress(decodeBlockInfo *block) {
 									   0,
 									   (int)(cblk->x1 - cblk->x0),
 									   (int)(cblk->y1 - cblk->y0),
-									   (int)(cblk->x1 - cblk->x0));
+									   (int)(cblk->x1 - cblk->x0),
+									   magsgn_data);
    else
 	   memset(unencoded_data, 0, (cblk->x1 - cblk->x0) * (cblk->y1 - cblk->y0) * sizeof(int32_t));
    return true;
@@ -180,61 +189,22 @@ void T1HT::postDecode(decodeBlockInfo *block) {
 	uint16_t cblk_w =  (uint16_t)(cblk->x1 - cblk->x0);
 	uint16_t cblk_h =  (uint16_t)(cblk->y1 - cblk->y0);
 
-	auto src = unencoded_data;
 	bool whole_tile_decoding = block->tilec->whole_tile_decoding;
 	auto tilec = block->tilec;
 
-	// ROI shift
-	if (block->roishift) {
-		int32_t threshold = 1 << block->roishift;
-		for (auto j = 0U; j < cblk_h; ++j) {
-			for (auto i = 0U; i < cblk_w; ++i) {
-				auto value = *src;
-				auto magnitude = abs(value);
-				if (magnitude >= threshold) {
-					magnitude >>= block->roishift;
-					// ((value > 0) - (value < 0)) == signum(value)
-					*src = ((value > 0) - (value < 0)) * magnitude;
-				}
-				src++;
-			}
-		}
-		//reset t1_data to start of buffer
-		src = unencoded_data;
-	}
-
-	uint32_t dest_width = tilec->width();
-	int32_t *dest = block->tiledp;
-	if (!whole_tile_decoding){
-       dest_width = cblk_w;
-       dest = src;
-	}
-
-	if (block->qmfbid == 1) {
-		int32_t shift = 31 - (block->k_msbs + 1);
-		int32_t *GRK_RESTRICT tile_data = dest;
-		for (auto j = 0U; j < cblk_h; ++j) {
-			int32_t *GRK_RESTRICT tile_row_data = tile_data;
-			for (auto i = 0U; i < cblk_w; ++i) {
-				int32_t temp = *src;
-				int32_t val = (temp & 0x7FFFFFFF) >> shift;
-				tile_row_data[i] = (int32_t)((temp & 0x80000000) ? -val : val);
-				src++;
-			}
-			tile_data += dest_width;
-		}
-	} else {
-		int32_t *GRK_RESTRICT tile_data = dest;
-		for (auto j = 0U; j < cblk_h; ++j) {
-			float *GRK_RESTRICT tile_row_data = (float*)tile_data;
-			for (auto i = 0U; i < cblk_w; ++i) {
-		       float val = (float)(*src & 0x7FFFFFFF) * block->stepsize;
-		       tile_row_data[i] = (*src & 0x80000000) ? -val : val;
-			   src++;
-			}
-			tile_data += dest_width;
-		}
-	}
+	DequantizeParams params;
+	params.roishift = block->roishift;
+	params.reversible = block->qmfbid == 1;
+	params.shift = 31U - (block->k_msbs + 1U);
+	params.stepsize = block->stepsize;
+	params.signMagnitude = true;
+
+	if (whole_tile_decoding)
+		dequantize_cblk(unencoded_data, cblk_w, cblk_h, block->tiledp,
+				tilec->width(), params);
+	else
+		dequantize_cblk(unencoded_data, cblk_w, cblk_h, unencoded_data,
+				cblk_w, params);
 	if (!whole_tile_decoding){
 		// write directly from t1 to sparse array
 		if (!tilec->m_sa->write(block->x,
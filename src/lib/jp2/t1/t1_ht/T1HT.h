@@ -46,6 +46,8 @@ public:
 private:
 	uint32_t coded_data_size;
 	uint8_t *coded_data;
+	// unstuffed MagSgn bits of the code block being decoded
+	uint8_t *magsgn_data;
 	uint32_t unencoded_data_size;
 	int32_t *unencoded_data;
 
@@ -41,6 +41,7 @@
 #include "ojph_block_decoder.h"
 #include "ojph_arch.h"
 #include "ojph_message.h"
+#include "CPUArch.h"
 
 namespace ojph {
   namespace local {
@@ -681,13 +682,305 @@ namespace ojph {
     }
 
 
+    /////////////////////////////////////////////////////////////////////////
+    // MagSgn decoding
+    //
+    // The MagSgn segment is unstuffed into a linear bit buffer before the
+    // cleanup pass, so that the bits of all significant samples of a quad
+    // pair can be located with a prefix sum of their m_n, and fetched
+    // independently of each other.  Bits past the end of the segment
+    // are ones, as they are for frwd_read<0xFF>.
+    /////////////////////////////////////////////////////////////////////////
+
+    /////////////////////////////////////////////////////////////////////////
+    ui32 magsgn_unstuff(const ui8* data, int size, ui8* dst)
+    {
+      ui64 tmp = 0;
+      int bits = 0;
+      bool unstuff = false;
+      ui8* dp = dst;
+      for (int i = 0; i < size; ++i)
+      {
+        ui64 d = data[i];
+        tmp |= d << bits;
+        bits += 8 - unstuff;
+        unstuff = (d == 0xFF);
+        if (bits >= 32)
+        {
+          ui32 t = (ui32)tmp;
+          memcpy(dp, &t, sizeof(t));
+          dp += 4;
+          tmp >>= 32;
+          bits -= 32;
+        }
+      }
+      tmp |= ~(ui64)0 << bits;
+      memcpy(dp, &tmp, sizeof(tmp));
+      dp += 8;
+      memset(dp, 0xFF, 16);
+      dp += 16;
+
+      // any window read at or after this byte holds only ones
+      return (ui32)(dp - dst) - 8;
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+    static inline ui32 magsgn_window(const ui8* buf, ui32 lim, ui32 pos)
+    {
+      ui32 idx = pos >> 3;
+      idx = idx < lim ? idx : lim;
+      ui64 t;
+      memcpy(&t, buf + idx, sizeof(t));
+      return (ui32)(t >> (pos & 7));
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+    // shift that yields 0 for shift counts of 32 or more, as SIMD shifts do
+    static inline ui32 magsgn_shl(ui32 val, ui32 shift)
+    {
+      return shift < 32 ? val << shift : 0;
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+    static inline
+    void decode_magsgn_quad(const ui8* buf, ui32 lim, ui32& pos, ui32 qinf,
+                            ui32 U, ui32 locs, int p, si32* sp, int stride,
+                            ui32* v_n)
+    {
+      for (int j = 0; j < 4; ++j)
+      {
+        si32* dp = sp + (j >> 1) + (j & 1) * stride;
+        if (qinf & (0x10u << j)) //sigma_n
+        {
+          ui32 m_n = U - ((qinf >> (12 + j)) & 1);
+          ui32 ms_val = magsgn_window(buf, lim, pos);
+          pos += m_n;
+          ui32 v = ms_val & (magsgn_shl(1, m_n) - 1);
+          v |= magsgn_shl((qinf >> (8 + j)) & 1, m_n);
+          v |= 1; //center of bin
+          *dp = (si32)((ms_val << 31) | magsgn_shl(v + 2, (ui32)(p - 1)));
+          v_n[j] = v;
+        }
+        else if (locs & (1u << j))
+          *dp = 0;
+      }
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+    void decode_magsgn_pair(const ui8* buf, ui32 lim, ui32& pos,
+                            ui32 qinf0, ui32 qinf1, ui32 U0, ui32 U1,
+                            ui32 locs, int p, si32* sp, int stride,
+                            ui32* v_n)
+    {
+      decode_magsgn_quad(buf, lim, pos, qinf0, U0, locs, p,
+                         sp, stride, v_n);
+      decode_magsgn_quad(buf, lim, pos, qinf1, U1, locs >> 4, p,
+                         sp + 2, stride, v_n + 4);
+    }
+
+#if (defined(__GNUC__) || defined(_MSC_VER)) && \
+    (defined(__x86_64__) || defined(__i386__) || \
+     defined(_M_X64) || defined(_M_IX86))
+#define OJPH_MAGSGN_SIMD
+#ifdef OJPH_COMPILER_GNUC
+#define OJPH_TARGET_SSE41 __attribute__((target("sse4.1")))
+#define OJPH_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define OJPH_TARGET_SSE41
+#define OJPH_TARGET_AVX2
+#endif
+
+    /////////////////////////////////////////////////////////////////////////
+    // one quad per call; the windows are fetched with scalar loads, as
+    // SSE4.1 has no variable shifts, and the samples are assembled in
+    // SIMD, using the float exponent to form 1 << m_n
+    /////////////////////////////////////////////////////////////////////////
+    OJPH_TARGET_SSE41 static inline
+    void decode_magsgn_quad_sse41(const ui8* buf, ui32 lim, ui32& pos,
+                                  ui32 qinf, ui32 U, ui32 locs, int p,
+                                  si32* sp, int stride, ui32* v_n)
+    {
+      const __m128i one = _mm_set1_epi32(1);
+      __m128i q = _mm_set1_epi32((int)qinf);
+      __m128i sig_bits = _mm_setr_epi32(0x10, 0x20, 0x40, 0x80);
+      __m128i sig = _mm_cmpeq_epi32(_mm_and_si128(q, sig_bits), sig_bits);
+      __m128i e1 = _mm_and_si128(q, _mm_slli_epi32(sig_bits, 4));
+      e1 = _mm_min_epu32(e1, one);
+      __m128i ek = _mm_and_si128(q, _mm_slli_epi32(sig_bits, 8));
+      ek = _mm_min_epu32(ek, one);
+      __m128i m = _mm_and_si128(_mm_sub_epi32(_mm_set1_epi32((int)U), ek),
+                                sig);
+
+      // m_n of 32 or more only occurs in corrupt code blocks
+      __m128i big = _mm_cmpeq_epi32(_mm_max_epu32(m, _mm_set1_epi32(31)),
+                                    _mm_set1_epi32(31));
+      if (_mm_movemask_epi8(big) != 0xFFFF)
+      {
+        decode_magsgn_quad(buf, lim, pos, qinf, U, locs, p, sp, stride, v_n);
+        return;
+      }
+
+      // exclusive prefix sum of m_n gives the position of each sample
+      __m128i incl = _mm_add_epi32(m, _mm_slli_si128(m, 4));
+      incl = _mm_add_epi32(incl, _mm_slli_si128(incl, 8));
+      __m128i excl = _mm_sub_epi32(incl, m);
+      ui32 w0 = magsgn_window(buf, lim, pos);
+      ui32 w1 = magsgn_window(buf, lim, pos + (ui32)_mm_extract_epi32(excl, 1));
+      ui32 w2 = magsgn_window(buf, lim, pos + (ui32)_mm_extract_epi32(excl, 2));
+      ui32 w3 = magsgn_window(buf, lim, pos + (ui32)_mm_extract_epi32(excl, 3));
+      pos += (ui32)_mm_extract_epi32(incl, 3);
+      __m128i ms_val = _mm_setr_epi32((int)w0, (int)w1, (int)w2, (int)w3);
+
+      __m128i pow2 = _mm_add_epi32(_mm_slli_epi32(m, 23),
+                                   _mm_set1_epi32(127 << 23));
+      pow2 = _mm_cvttps_epi32(_mm_castsi128_ps(pow2));
+      __m128i v = _mm_and_si128(ms_val, _mm_sub_epi32(pow2, one));
+      v = _mm_or_si128(v, _mm_mullo_epi32(e1, pow2));
+      v = _mm_or_si128(v, one); //center of bin
+      __m128i val = _mm_sll_epi32(_mm_add_epi32(v, _mm_set1_epi32(2)),
+                                  _mm_cvtsi32_si128(p - 1));
+      val = _mm_or_si128(val, _mm_slli_epi32(ms_val, 31));
+      val = _mm_and_si128(val, sig);
+      _mm_storeu_si128((__m128i*)v_n, v);
+
+      ui32 write = (ui32)_mm_movemask_ps(_mm_castsi128_ps(sig)) | (locs & 0xF);
+      if (write & 1)
+        sp[0] = _mm_cvtsi128_si32(val);
+      if (write & 2)
+        sp[stride] = _mm_extract_epi32(val, 1);
+      if (write & 4)
+        sp[1] = _mm_extract_epi32(val, 2);
+      if (write & 8)
+        sp[stride + 1] = _mm_extract_epi32(val, 3);
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+    OJPH_TARGET_SSE41
+    void decode_magsgn_pair_sse41(const ui8* buf, ui32 lim, ui32& pos,
+                                  ui32 qinf0, ui32 qinf1, ui32 U0, ui32 U1,
+                                  ui32 locs, int p, si32* sp, int stride,
+                                  ui32* v_n)
+    {
+      decode_magsgn_quad_sse41(buf, lim, pos, qinf0, U0, locs, p,
+                               sp, stride, v_n);
+      decode_magsgn_quad_sse41(buf, lim, pos, qinf1, U1, locs >> 4, p,
+                               sp + 2, stride, v_n + 4);
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+    // both quads at once: lane k holds sample k of the pair, in the
+    // order of the scalar decoder (down the columns, quad 0 first)
+    /////////////////////////////////////////////////////////////////////////
+    OJPH_TARGET_AVX2
+    void decode_magsgn_pair_avx2(const ui8* buf, ui32 lim, ui32& pos,
+                                 ui32 qinf0, ui32 qinf1, ui32 U0, ui32 U1,
+                                 ui32 locs, int p, si32* sp, int stride,
+                                 ui32* v_n)
+    {
+      const __m256i one = _mm256_set1_epi32(1);
+      const __m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 0, 1, 2, 3);
+      __m256i q = _mm256_setr_epi32((int)qinf0, (int)qinf0, (int)qinf0,
+        (int)qinf0, (int)qinf1, (int)qinf1, (int)qinf1, (int)qinf1);
+      __m256i U = _mm256_setr_epi32((int)U0, (int)U0, (int)U0, (int)U0,
+                                    (int)U1, (int)U1, (int)U1, (int)U1);
+      __m256i sig = _mm256_srlv_epi32(q, _mm256_add_epi32(lane,
+                                               _mm256_set1_epi32(4)));
+      sig = _mm256_cmpeq_epi32(_mm256_and_si256(sig, one), one);
+      __m256i e1 = _mm256_srlv_epi32(q, _mm256_add_epi32(lane,
+                                               _mm256_set1_epi32(8)));
+      e1 = _mm256_and_si256(e1, one);
+      __m256i ek = _mm256_srlv_epi32(q, _mm256_add_epi32(lane,
+                                               _mm256_set1_epi32(12)));
+      ek = _mm256_and_si256(ek, one);
+      __m256i m = _mm256_and_si256(_mm256_sub_epi32(U, ek), sig);
+
+      // exclusive prefix sum of m_n across the eight lanes
+      __m256i incl = _mm256_add_epi32(m, _mm256_slli_si256(m, 4));
+      incl = _mm256_add_epi32(incl, _mm256_slli_si256(incl, 8));
+      __m256i carry = _mm256_permutevar8x32_epi32(incl,
+                                                  _mm256_set1_epi32(3));
+      carry = _mm256_and_si256(carry,
+                  _mm256_setr_epi32(0, 0, 0, 0, -1, -1, -1, -1));
+      incl = _mm256_add_epi32(incl, carry);
+      __m256i excl = _mm256_sub_epi32(incl, m);
+      __m256i bitpos = _mm256_add_epi32(_mm256_set1_epi32((int)pos), excl);
+      pos += (ui32)_mm256_extract_epi32(incl, 7);
+
+      // fetch a 64 bit window for each sample and align it
+      __m256i idx = _mm256_min_epu32(_mm256_srli_epi32(bitpos, 3),
+                                     _mm256_set1_epi32((int)lim));
+      __m256i sh = _mm256_and_si256(bitpos, _mm256_set1_epi32(7));
+      __m256i w0 = _mm256_i32gather_epi64((const long long*)buf,
+                                          _mm256_castsi256_si128(idx), 1);
+      __m256i w1 = _mm256_i32gather_epi64((const long long*)buf,
+                                          _mm256_extracti128_si256(idx, 1), 1);
+      w0 = _mm256_srlv_epi64(w0,
+             _mm256_cvtepu32_epi64(_mm256_castsi256_si128(sh)));
+      w1 = _mm256_srlv_epi64(w1,
+             _mm256_cvtepu32_epi64(_mm256_extracti128_si256(sh, 1)));
+      const __m256i lo_dwords = _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6);
+      w0 = _mm256_permutevar8x32_epi32(w0, lo_dwords);
+      w1 = _mm256_permutevar8x32_epi32(w1, lo_dwords);
+      __m256i ms_val = _mm256_permute2x128_si256(w0, w1, 0x20);
+
+      __m256i v = _mm256_and_si256(ms_val,
+                    _mm256_sub_epi32(_mm256_sllv_epi32(one, m), one));
+      v = _mm256_or_si256(v, _mm256_sllv_epi32(e1, m));
+      v = _mm256_or_si256(v, one); //center of bin
+      __m256i val = _mm256_sll_epi32(_mm256_add_epi32(v,
+                                       _mm256_set1_epi32(2)),
+                                     _mm_cvtsi32_si128(p - 1));
+      val = _mm256_or_si256(val, _mm256_slli_epi32(ms_val, 31));
+      val = _mm256_and_si256(val, sig);
+      _mm256_storeu_si256((__m256i*)v_n, v);
+
+      // write significant samples, and zeros at the other locations
+      __m256i loc = _mm256_srlv_epi32(_mm256_set1_epi32((int)locs),
+                      _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+      loc = _mm256_cmpeq_epi32(_mm256_and_si256(loc, one), one);
+      __m256i write = _mm256_or_si256(sig, loc);
+      const __m256i rows = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+      val = _mm256_permutevar8x32_epi32(val, rows);
+      write = _mm256_permutevar8x32_epi32(write, rows);
+      _mm_maskstore_epi32(sp, _mm256_castsi256_si128(write),
+                          _mm256_castsi256_si128(val));
+      _mm_maskstore_epi32(sp + stride, _mm256_extracti128_si256(write, 1),
+                          _mm256_extracti128_si256(val, 1));
+    }
+#endif
+
+    /////////////////////////////////////////////////////////////////////////
+    magsgn_pair_fn get_magsgn_pair_kernel(int simd_level)
+    {
+#ifdef OJPH_MAGSGN_SIMD
+      grk::CPUArch arch;
+      if (simd_level >= 2 && arch.AVX2())
+        return decode_magsgn_pair_avx2;
+      if (simd_level >= 1 && arch.SSE4_1())
+        return decode_magsgn_pair_sse41;
+#else
+      (void)simd_level;
+#endif
+      return decode_magsgn_pair;
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+    // follows the instruction set level of the library's SIMD kernels
+    static magsgn_pair_fn default_magsgn_pair_kernel()
+    {
+      static magsgn_pair_fn kernel = get_magsgn_pair_kernel(
+        grk::simd_level() >= grk::GRK_SIMD_AVX2 ? 2 : 1);
+      return kernel;
+    }
+
     /////////////////////////////////////////////////////////////////////////
     //
     /////////////////////////////////////////////////////////////////////////
     void ojph_decode_codeblock(ui8* coded_data, si32* decoded_data,
                                int missing_msbs, int num_passes,
                                int lengths1, int lengths2,
-                               int width, int height, int stride)
+                               int width, int height, int stride,
+                               ui8* scratch, magsgn_pair_fn magsgn)
     {
       //sigma: each ui32 contains flags for 32 locations, stripe high;
       // that is, 4 rows by 8 columns.  For 1024 columns, we need 32 integers.
@@ -715,8 +1008,10 @@ namespace ojph {
       mel_init(&mel, coded_data, lcup, scup);
       rev_struct vlc;
       rev_init(&vlc, coded_data, lcup, scup);
-      frwd_struct magsgn;
-      frwd_init<0xFF>(&magsgn, coded_data, lcup - scup);
+      ui8* ms_buf = scratch;
+      ui32 ms_lim = magsgn_unstuff(coded_data, lcup - scup, ms_buf);
+      ui32 ms_pos = 0;
+      magsgn_pair_fn decode_magsgn = magsgn ? magsgn : default_magsgn_pair_kernel();
       frwd_struct sigprop;
       frwd_init<0>(&sigprop, coded_data + lengths1, lengths2);
       rev_struct magref;
@@ -801,155 +1096,48 @@ namespace ojph {
 
         //decode magsgn and update line_state
         /////////////////////////////////////
-        int m_n, v_n;
-        ui32 ms_val;
+        ui32 v_n[8];
 
         //locations where samples need update
         int locs = 4 - (width - x);
         locs = 0xFF >> (locs > 0 ? (locs<<1) : 0);
         locs = height > 1 ? locs : (locs & 0x55);
 
-        if (qinf[0] & 0x10) //sigma_n
-        {
-          ms_val = frwd_fetch<0xFF>(&magsgn);
-          m_n = U_p[0] - ((qinf[0] >> 12) & 1); //m_n
-          frwd_advance(&magsgn, m_n);
-          si32 val = ms_val << 31;
-          v_n = ms_val & ((1 << m_n) - 1);
-          v_n |= ((qinf[0] & 0x100) >> 8) << m_n;
-          v_n |= 1; //center of bin
-          sp[0] = val | ((v_n + 2) << (p - 1));
-        }
-        else if (locs & 0x1)
-          sp[0] = 0;
+        decode_magsgn(ms_buf, ms_lim, ms_pos, qinf[0], qinf[1],
+                      (ui32)U_p[0], (ui32)U_p[1], (ui32)locs, p,
+                      sp, stride, v_n);
 
         if (qinf[0] & 0x20) //sigma_n
         {
-          ms_val = frwd_fetch<0xFF>(&magsgn);
-          m_n = U_p[0] - ((qinf[0] >> 13) & 1); //m_n
-          frwd_advance(&magsgn, m_n);
-          si32 val = ms_val << 31;
-          v_n = ms_val & ((1 << m_n) - 1);
-          v_n |= ((qinf[0] & 0x200) >> 9) << m_n;
-          v_n |= 1; //center of bin
-          sp[stride] = val | ((v_n + 2) << (p - 1));
-
           //update line_state: bit 7 (\sigma^N), and E^N
           int s = (lsp[0] & 0x80) | 0x80; //\sigma^NW | \sigma^N
           int t = lsp[0] & 0x7F; //E^NW
-          v_n = 32 - count_leading_zeros(v_n); //because E-=2;
-          lsp[0] = (ui8)(s | (t > v_n ? t : v_n));
+          int e = 32 - count_leading_zeros(v_n[1]); //because E-=2;
+          lsp[0] = (ui8)(s | (t > e ? t : e));
         }
-        else if (locs & 0x2)
-          sp[stride] = 0; //no need to update line_state
-
         ++lsp;
-        ++sp;
-
-        if (qinf[0] & 0x40) //sigma_n
-        {
-          ms_val = frwd_fetch<0xFF>(&magsgn);
-          m_n = U_p[0] - ((qinf[0] >> 14) & 1); //m_n
-          frwd_advance(&magsgn, m_n);
-          si32 val = ms_val << 31;
-          v_n = ms_val & ((1 << m_n) - 1);
-          v_n |= (((qinf[0] & 0x400) >> 10) << m_n);
-          v_n |= 1; //center of bin
-          sp[0] = val | ((v_n + 2) << (p - 1));
-        }
-        else if (locs & 0x4)
-          sp[0] = 0;
 
         lsp[0] = 0;
         if (qinf[0] & 0x80) //sigma_n
-        {
-          ms_val = frwd_fetch<0xFF>(&magsgn);
-          m_n = U_p[0] - ((qinf[0] >> 15) & 1); //m_n
-          frwd_advance(&magsgn, m_n);
-          si32 val = ms_val << 31;
-          v_n = ms_val & ((1 << m_n) - 1);
-          v_n |= ((qinf[0] & 0x800) >> 11) << m_n;
-          v_n |= 1; //center of bin
-          sp[stride] = val | ((v_n + 2) << (p - 1));
-
           //update line_state: bit 7 (\sigma^NW), and E^NW for next quad
-          lsp[0] = (ui8)(0x80 | (32 - count_leading_zeros(v_n)));//cause E-=2;
-        }
-        else if (locs & 0x8)
-          sp[stride] = 0;
-
-        ++sp;
-
-        if (qinf[1] & 0x10) //sigma_n
-        {
-          ms_val = frwd_fetch<0xFF>(&magsgn);
-          m_n = U_p[1] - ((qinf[1] >> 12) & 1); //m_n
-          frwd_advance(&magsgn, m_n);
-          si32 val = ms_val << 31;
-          v_n = ms_val & ((1 << m_n) - 1);
-          v_n |= (((qinf[1] & 0x100) >> 8) << m_n);
-          v_n |= 1; //center of bin
-          sp[0] = val | ((v_n + 2) << (p - 1));
-        }
-        else if (locs & 0x10)
-          sp[0] = 0;
+          lsp[0] = (ui8)(0x80 | (32 - count_leading_zeros(v_n[3])));
 
         if (qinf[1] & 0x20) //sigma_n
         {
-          ms_val = frwd_fetch<0xFF>(&magsgn);
-          m_n = U_p[1] - ((qinf[1] >> 13) & 1); //m_n
-          frwd_advance(&magsgn, m_n);
-          si32 val = ms_val << 31;
-          v_n = ms_val & ((1 << m_n) - 1);
-          v_n |= (((qinf[1] & 0x200) >> 9) << m_n);
-          v_n |= 1; //center of bin
-          sp[stride] = val | ((v_n + 2) << (p - 1));
-
           //update line_state: bit 7 (\sigma^N), and E^N
           int s = (lsp[0] & 0x80) | 0x80; //\sigma^NW | \sigma^N
           int t = lsp[0] & 0x7F; //E^NW
-          v_n = 32 - count_leading_zeros(v_n); //because E-=2;
-          lsp[0] = (ui8)(s | (t > v_n ? t : v_n));
+          int e = 32 - count_leading_zeros(v_n[5]); //because E-=2;
+          lsp[0] = (ui8)(s | (t > e ? t : e));
         }
-        else if (locs & 0x20)
-          sp[stride] = 0; //no need to update line_state
-
         ++lsp;
-        ++sp;
-
-        if (qinf[1] & 0x40) //sigma_n
-        {
-          ms_val = frwd_fetch<0xFF>(&magsgn);
-          m_n = U_p[1] - ((qinf[1] >> 14) & 1); //m_n
-          frwd_advance(&magsgn, m_n);
-          si32 val = ms_val << 31;
-          v_n = ms_val & ((1 << m_n) - 1);
-          v_n |= (((qinf[1] & 0x400) >> 10) << m_n);
-          v_n |= 1; //center of bin
-          sp[0] = val | ((v_n + 2) << (p - 1));
-        }
-        else if (locs & 0x40)
-          sp[0] = 0;
 
         lsp[0] = 0;
         if (qinf[1] & 0x80) //sigma_n
-        {
-          ms_val = frwd_fetch<0xFF>(&magsgn);
-          m_n = U_p[1] - ((qinf[1] >> 15) & 1); //m_n
-          frwd_advance(&magsgn, m_n);
-          si32 val = ms_val << 31;
-          v_n = ms_val & ((1 << m_n) - 1);
-          v_n |= (((qinf[1] & 0x800) >> 11) << m_n);
-          v_n |= 1; //center of bin
-          sp[stride] = val | ((v_n + 2) << (p - 1));
-
           //update line_state: bit 7 (\sigma^NW), and E^NW for next quad
-          lsp[0] = (ui8)(0x80 | (32 - count_leading_zeros(v_n))); //cause E-=2;
-        }
-        else if (locs & 0x80)
-          sp[stride] = 0;
+          lsp[0] = (ui8)(0x80 | (32 - count_leading_zeros(v_n[7])));
 
-        ++sp;
+        sp += 4;
       }
 
       //non-initial lines
@@ -1045,156 +1233,46 @@ namespace ojph {
 
           //decode magsgn and update line_state
           /////////////////////////////////////
-          int m_n, v_n;
-          ui32 ms_val;
+          ui32 v_n[8];
 
           //locations where samples need update
           int locs = 4 - (width - x);
           locs = 0xFF >> (locs > 0 ? (locs << 1) : 0);
           locs = y < height - 1 ? locs : (locs & 0x55);
 
-          if (qinf[0] & 0x10) //sigma_n
-          {
-            ms_val = frwd_fetch<0xFF>(&magsgn);
-            m_n = U_p[0] - ((qinf[0] >> 12) & 1); //m_n
-            frwd_advance(&magsgn, m_n);
-            si32 val = ms_val << 31;
-            v_n = ms_val & ((1 << m_n) - 1);
-            v_n |= ((qinf[0] & 0x100) >> 8) << m_n;
-            v_n |= 1; //center of bin
-            sp[0] = val | ((v_n + 2) << (p - 1));
-          }
-          else if (locs & 0x1)
-            sp[0] = 0;
+          decode_magsgn(ms_buf, ms_lim, ms_pos, qinf[0], qinf[1],
+                        (ui32)U_p[0], (ui32)U_p[1], (ui32)locs, p,
+                        sp, stride, v_n);
 
           if (qinf[0] & 0x20) //sigma_n
           {
-            ms_val = frwd_fetch<0xFF>(&magsgn);
-            m_n = U_p[0] - ((qinf[0] >> 13) & 1); //m_n
-            frwd_advance(&magsgn, m_n);
-            si32 val = ms_val << 31;
-            v_n = ms_val & ((1 << m_n) - 1);
-            v_n |= ((qinf[0] & 0x200) >> 9) << m_n;
-            v_n |= 1; //center of bin
-            sp[stride] = val | ((v_n + 2) << (p - 1));
-
             //update line_state: bit 7 (\sigma^N), and E^N
             int s = (lsp[0] & 0x80) | 0x80; //\sigma^NW | \sigma^N
             int t = lsp[0] & 0x7F; //E^NW
-            v_n = 32 - count_leading_zeros(v_n); //because E-=2;
-            lsp[0] = (ui8)(s | (t > v_n ? t : v_n));
+            int e = 32 - count_leading_zeros(v_n[1]); //because E-=2;
+            lsp[0] = (ui8)(s | (t > e ? t : e));
           }
-          else if (locs & 0x2)
-            sp[stride] = 0; //no need to update line_state
-
           ++lsp;
-          ++sp;
 
-          if (qinf[0] & 0x40) //sigma_n
-          {
-            ms_val = frwd_fetch<0xFF>(&magsgn);
-            m_n = U_p[0] - ((qinf[0] >> 14) & 1); //m_n
-            frwd_advance(&magsgn, m_n);
-            si32 val = ms_val << 31;
-            v_n = ms_val & ((1 << m_n) - 1);
-            v_n |= (((qinf[0] & 0x400) >> 10) << m_n);
-            v_n |= 1; //center of bin
-            sp[0] = val | ((v_n + 2) << (p - 1));
-          }
-          else if (locs & 0x4)
-            sp[0] = 0;
-
-          //      lsp[0] = 0;
           if (qinf[0] & 0x80) //sigma_n
-          {
-            ms_val = frwd_fetch<0xFF>(&magsgn);
-            m_n = U_p[0] - ((qinf[0] >> 15) & 1); //m_n
-            frwd_advance(&magsgn, m_n);
-            si32 val = ms_val << 31;
-            v_n = ms_val & ((1 << m_n) - 1);
-            v_n |= ((qinf[0] & 0x800) >> 11) << m_n;
-            v_n |= 1; //center of bin
-            sp[stride] = val | ((v_n + 2) << (p - 1));
-
             //update line_state: bit 7 (\sigma^NW), and E^NW for next quad
-            lsp[0] = (ui8)(0x80 | (32 - count_leading_zeros(v_n)));//cause E-=2
-          }
-          else if (locs & 0x8)
-            sp[stride] = 0;
-
-          ++sp;
-
-          if (qinf[1] & 0x10) //sigma_n
-          {
-            ms_val = frwd_fetch<0xFF>(&magsgn);
-            m_n = U_p[1] - ((qinf[1] >> 12) & 1); //m_n
-            frwd_advance(&magsgn, m_n);
-            si32 val = ms_val << 31;
-            v_n = ms_val & ((1 << m_n) - 1);
-            v_n |= (((qinf[1] & 0x100) >> 8) << m_n);
-            v_n |= 1; //center of bin
-            sp[0] = val | ((v_n + 2) << (p - 1));
-          }
-          else if (locs & 0x10)
-            sp[0] = 0;
+            lsp[0] = (ui8)(0x80 | (32 - count_leading_zeros(v_n[3])));
 
           if (qinf[1] & 0x20) //sigma_n
           {
-            ms_val = frwd_fetch<0xFF>(&magsgn);
-            m_n = U_p[1] - ((qinf[1] >> 13) & 1); //m_n
-            frwd_advance(&magsgn, m_n);
-            si32 val = ms_val << 31;
-            v_n = ms_val & ((1 << m_n) - 1);
-            v_n |= (((qinf[1] & 0x200) >> 9) << m_n);
-            v_n |= 1; //center of bin
-            sp[stride] = val | ((v_n + 2) << (p - 1));
-
             //update line_state: bit 7 (\sigma^N), and E^N
             int s = (lsp[0] & 0x80) | 0x80; //\sigma^NW | \sigma^N
             int t = lsp[0] & 0x7F; //E^NW
-            v_n = 32 - count_leading_zeros(v_n); //because E-=2;
-            lsp[0] = (ui8)(s | (t > v_n ? t : v_n));
+            int e = 32 - count_leading_zeros(v_n[5]); //because E-=2;
+            lsp[0] = (ui8)(s | (t > e ? t : e));
           }
-          else if (locs & 0x20)
-            sp[stride] = 0; //no need to update line_state
-
           ++lsp;
-          ++sp;
 
-          if (qinf[1] & 0x40) //sigma_n
-          {
-            ms_val = frwd_fetch<0xFF>(&magsgn);
-            m_n = U_p[1] - ((qinf[1] >> 14) & 1); //m_n
-            frwd_advance(&magsgn, m_n);
-            si32 val = ms_val << 31;
-            v_n = ms_val & ((1 << m_n) - 1);
-            v_n |= (((qinf[1] & 0x400) >> 10) << m_n);
-            v_n |= 1; //center of bin
-            sp[0] = val | ((v_n + 2) << (p - 1));
-          }
-          else if (locs & 0x40)
-            sp[0] = 0;
-
-          //      lsp[0] = 0;
           if (qinf[1] & 0x80) //sigma_n
-          {
-            ms_val = frwd_fetch<0xFF>(&magsgn);
-            m_n = U_p[1] - ((qinf[1] >> 15) & 1); //m_n
-            frwd_advance(&magsgn, m_n);
-            si32 val = ms_val << 31;
-            v_n = ms_val & ((1 << m_n) - 1);
-            v_n |= (((qinf[1] & 0x800) >> 11) << m_n);
-            v_n |= 1; //center of bin
-            sp[stride] = val | ((v_n + 2) << (p - 1));
-
             //update line_state: bit 7 (\sigma^NW), and E^NW for next quad
-            lsp[0] = (ui8)(0x80 | (32 - count_leading_zeros(v_n)));//cause E-=2
-          }
-          else if (locs & 0x80)
-            sp[stride] = 0;
-
-          ++sp;
+            lsp[0] = (ui8)(0x80 | (32 - count_leading_zeros(v_n[7])));
 
+          sp += 4;
         }
 
         y += 2;
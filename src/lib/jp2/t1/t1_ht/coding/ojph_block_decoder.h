@@ -44,13 +44,35 @@
 namespace ojph {
   namespace local {
 
+    //////////////////////////////////////////////////////////////////////////
+    //decodes the MagSgn bits of a pair of quads, starting at bit pos of
+    // the unstuffed buffer, and writes the samples of the two quads to sp;
+    // v_n receives the magnitude of each sample, in decoding order
+    typedef void (*magsgn_pair_fn)(const ui8* buf, ui32 lim, ui32& pos,
+        ui32 qinf0, ui32 qinf1, ui32 U0, ui32 U1, ui32 locs, int p,
+        si32* sp, int stride, ui32* v_n);
+
+    //////////////////////////////////////////////////////////////////////////
+    //returns the widest MagSgn kernel supported by the CPU, up to
+    // simd_level: 0 is scalar, 1 is SSE4.1 and 2 is AVX2
+    magsgn_pair_fn get_magsgn_pair_kernel(int simd_level);
+
+    //////////////////////////////////////////////////////////////////////////
+    //unstuffs a MagSgn segment of size bytes into dst, which must hold
+    // size + 32 bytes; returns the last byte index at which a 64 bit
+    // window may be read
+    ui32 magsgn_unstuff(const ui8* data, int size, ui8* dst);
+
     //////////////////////////////////////////////////////////////////////////
     //decodes the cleanup pass, significance propagation pass,
     // and magnitude refinement pass
+    //scratch must hold at least lengths1 + 32 bytes; the MagSgn kernel
+    // is chosen at start up, unless one is passed in
     void
       ojph_decode_codeblock(ui8* coded_data, si32* decoded_data,
         int missing_msbs, int num_passes, int lengths1, int lengths2,
-        int width, int height, int stride);
+        int width, int height, int stride, ui8* scratch,
+        magsgn_pair_fn magsgn = nullptr);
   }
 }
 
@@ -44,6 +44,7 @@
 #include "ojph_arch.h"
 #include "ojph_block_encoder.h"
 #include "ojph_message.h"
+#include "CPUArch.h"
 
 namespace ojph {
   namespace local {
@@ -435,6 +436,29 @@ namespace ojph {
       }
     }
 
+    //////////////////////////////////////////////////////////////////////////
+    //codes 32 bits; unless a 0xFF byte is produced, which requires
+    // stuffing, the 4 bytes are written at once
+    static inline void
+    ms_encode32(ms_struct* msp, ui32 cwd)
+    {
+      if (msp->max_bits == 8 && msp->pos + 4 <= msp->buf_size)
+      {
+        ui64 t = (ui32)msp->tmp | ((ui64)cwd << msp->used_bits);
+        ui32 bytes = (ui32)t;
+        if ((((~bytes) - 0x01010101u) & bytes & 0x80808080u) == 0)
+        {
+          msp->buf[msp->pos++] = (ui8)bytes;
+          msp->buf[msp->pos++] = (ui8)(bytes >> 8);
+          msp->buf[msp->pos++] = (ui8)(bytes >> 16);
+          msp->buf[msp->pos++] = (ui8)(bytes >> 24);
+          msp->tmp = (int)(t >> 32);
+          return;
+        }
+      }
+      ms_encode(msp, (int)cwd, 32);
+    }
+
     //////////////////////////////////////////////////////////////////////////
     static inline void
     ms_terminate(ms_struct* msp)
@@ -455,6 +479,237 @@ namespace ojph {
         msp->pos--;
     }
 
+    //////////////////////////////////////////////////////////////////////////
+    //
+    //////////////////////////////////////////////////////////////////////////
+    //codewords are collected in a 64 bit accumulator, and handed over to
+    // the encoders above 32 bits at a time; bit stuffing is decided bit by
+    // bit, so the coded bytes are the same as when coding each codeword
+    struct bit_acc {
+      ui64 tmp;  //collected bits, first bit in the LSB
+      int bits;  //number of collected bits, always less than 32
+    };
+
+    //////////////////////////////////////////////////////////////////////////
+    static inline void
+    acc_init(bit_acc* accp)
+    {
+      accp->tmp = 0;
+      accp->bits = 0;
+    }
+
+    //////////////////////////////////////////////////////////////////////////
+    static inline void
+    vlc_put(vlc_struct* vlcp, bit_acc* accp, int cwd, int cwd_len)
+    {
+      accp->tmp |= (ui64)(cwd & ((1 << cwd_len) - 1)) << accp->bits;
+      accp->bits += cwd_len;
+      if (accp->bits >= 32)
+      {
+        vlc_encode(vlcp, (int)(ui32)accp->tmp, 32);
+        accp->tmp >>= 32;
+        accp->bits -= 32;
+      }
+    }
+
+    //////////////////////////////////////////////////////////////////////////
+    static inline void
+    vlc_flush(vlc_struct* vlcp, bit_acc* accp)
+    {
+      vlc_encode(vlcp, (int)(ui32)accp->tmp, accp->bits);
+      acc_init(accp);
+    }
+
+    //////////////////////////////////////////////////////////////////////////
+    //cwd must have no bits set beyond cwd_len
+    static inline void
+    ms_put(ms_struct* msp, bit_acc* accp, ui32 cwd, int cwd_len)
+    {
+      accp->tmp |= (ui64)cwd << accp->bits;
+      accp->bits += cwd_len;
+      if (accp->bits >= 32)
+      {
+        ms_encode32(msp, (ui32)accp->tmp);
+        accp->tmp >>= 32;
+        accp->bits -= 32;
+      }
+    }
+
+    //////////////////////////////////////////////////////////////////////////
+    static inline void
+    ms_flush(ms_struct* msp, bit_acc* accp)
+    {
+      ms_encode(msp, (int)(ui32)accp->tmp, accp->bits);
+      acc_init(accp);
+    }
+
+    //////////////////////////////////////////////////////////////////////////
+    //
+    //////////////////////////////////////////////////////////////////////////
+    static void quad_pair_scalar(const si32* sp, int stride, int cols,
+                                 int rows, int p, quad_pair* qp)
+    {
+      qp->rho[0] = qp->rho[1] = 0;
+      for (int k = 0; k < 8; ++k)
+      {
+        int col = k >> 1, row = k & 1;
+        ui32 t = (col < cols && row < rows) ? (ui32)sp[row * stride + col] : 0;
+        ui32 val = t + t; //multiply by 2 and get rid of sign
+        val >>= p; // 2 \mu_p + x
+        val &= ~1u; // 2 \mu_p
+        qp->e_q[k] = 0;
+        qp->s[k] = 0;
+        if (val)
+        {
+          qp->rho[k >> 2] |= 1 << (k & 3);
+          qp->e_q[k] = 32 - count_leading_zeros(--val); //2\mu_p - 1
+          qp->s[k] = --val + (t >> 31); //v_n = 2(\mu_p-1) + s_n
+        }
+      }
+      for (int q = 0; q < 2; ++q)
+      {
+        const int* e_q = qp->e_q + 4 * q;
+        int e_qmax = ojph_max(ojph_max(e_q[0], e_q[1]),
+                              ojph_max(e_q[2], e_q[3]));
+        qp->e_qmax[q] = e_qmax;
+        qp->eps[q] = (e_q[0] == e_qmax) | ((e_q[1] == e_qmax) << 1)
+                   | ((e_q[2] == e_qmax) << 2) | ((e_q[3] == e_qmax) << 3);
+      }
+    }
+
+    //////////////////////////////////////////////////////////////////////////
+    static void ms_pair_scalar(const quad_pair* qp, int U0, int U1,
+                               int e_k, ui32* cwd, int* len)
+    {
+      int rho = qp->rho[0] | (qp->rho[1] << 4);
+      for (int k = 0; k < 8; ++k)
+      {
+        int m = ((rho >> k) & 1) ? (k < 4 ? U0 : U1) - ((e_k >> k) & 1) : 0;
+        cwd[k] = qp->s[k] & (ui32)((1ull << m) - 1);
+        len[k] = m;
+      }
+    }
+
+#if (defined(__GNUC__) || defined(_MSC_VER)) && \
+    (defined(__x86_64__) || defined(__i386__) || \
+     defined(_M_X64) || defined(_M_IX86))
+#define OJPH_ENCODER_SIMD
+#ifdef OJPH_COMPILER_GNUC
+#define OJPH_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define OJPH_TARGET_AVX2
+#endif
+
+    /////////////////////////////////////////////////////////////////////////
+    // lane k holds sample k of the pair; E_n is taken from the float
+    // exponent of 2\mu_p - 1, as AVX2 has no leading zero count
+    /////////////////////////////////////////////////////////////////////////
+    OJPH_TARGET_AVX2
+    static void quad_pair_avx2(const si32* sp, int stride, int cols,
+                               int rows, int p, quad_pair* qp)
+    {
+      // 2 \mu_p must fit in 31 bits for the float conversion
+      if (p < 1)
+      {
+        quad_pair_scalar(sp, stride, cols, rows, p, qp);
+        return;
+      }
+
+      const __m256i one = _mm256_set1_epi32(1);
+      __m128i cmask = _mm_cmpgt_epi32(_mm_set1_epi32(cols),
+                                      _mm_setr_epi32(0, 1, 2, 3));
+      __m128i r0 = _mm_maskload_epi32(sp, cmask);
+      __m128i r1 = rows > 1 ? _mm_maskload_epi32(sp + stride, cmask)
+                            : _mm_setzero_si128();
+      __m256i t = _mm256_inserti128_si256(
+        _mm256_castsi128_si256(_mm_unpacklo_epi32(r0, r1)),
+        _mm_unpackhi_epi32(r0, r1), 1);
+
+      __m256i val = _mm256_srl_epi32(_mm256_add_epi32(t, t),
+                                     _mm_cvtsi32_si128(p)); // 2 \mu_p + x
+      val = _mm256_andnot_si256(one, val); // 2 \mu_p
+      __m256i sig = _mm256_cmpeq_epi32(val, _mm256_setzero_si256());
+      sig = _mm256_xor_si256(sig, _mm256_set1_epi32(-1));
+      val = _mm256_sub_epi32(val, one); //2\mu_p - 1
+
+      // values of 2^24 or more may round up to the next power of two
+      __m256i e = _mm256_castps_si256(_mm256_cvtepi32_ps(val));
+      e = _mm256_sub_epi32(_mm256_srli_epi32(e, 23), _mm256_set1_epi32(126));
+      __m256i pow2 = _mm256_sllv_epi32(one, _mm256_sub_epi32(e, one));
+      __m256i fits = _mm256_cmpeq_epi32(_mm256_max_epu32(val, pow2), val);
+      e = _mm256_add_epi32(e, _mm256_andnot_si256(fits,
+                                                  _mm256_set1_epi32(-1)));
+      e = _mm256_and_si256(e, sig);
+
+      __m256i s = _mm256_add_epi32(_mm256_sub_epi32(val, one),
+                                   _mm256_srli_epi32(t, 31));
+      s = _mm256_and_si256(s, sig); //v_n = 2(\mu_p-1) + s_n
+      _mm256_storeu_si256((__m256i*)qp->s, s);
+      _mm256_storeu_si256((__m256i*)qp->e_q, e);
+
+      // maximum of each quad, in all of its lanes
+      __m256i e_qmax = _mm256_max_epi32(e, _mm256_shuffle_epi32(e, 0x4E));
+      e_qmax = _mm256_max_epi32(e_qmax, _mm256_shuffle_epi32(e_qmax, 0xB1));
+      int eps = _mm256_movemask_ps(
+        _mm256_castsi256_ps(_mm256_cmpeq_epi32(e, e_qmax)));
+      int rho = _mm256_movemask_ps(_mm256_castsi256_ps(sig));
+      qp->rho[0] = rho & 0xF;
+      qp->rho[1] = rho >> 4;
+      qp->eps[0] = eps & 0xF;
+      qp->eps[1] = eps >> 4;
+      qp->e_qmax[0] = _mm256_extract_epi32(e_qmax, 0);
+      qp->e_qmax[1] = _mm256_extract_epi32(e_qmax, 4);
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+    OJPH_TARGET_AVX2
+    static void ms_pair_avx2(const quad_pair* qp, int U0, int U1,
+                             int e_k, ui32* cwd, int* len)
+    {
+      const __m256i one = _mm256_set1_epi32(1);
+      const __m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+      __m256i sig = _mm256_set1_epi32(qp->rho[0] | (qp->rho[1] << 4));
+      sig = _mm256_and_si256(_mm256_srlv_epi32(sig, lane), one);
+      sig = _mm256_cmpeq_epi32(sig, one);
+      __m256i ek = _mm256_srlv_epi32(_mm256_set1_epi32(e_k), lane);
+      ek = _mm256_and_si256(ek, one);
+      __m256i U = _mm256_setr_epi32(U0, U0, U0, U0, U1, U1, U1, U1);
+      __m256i m = _mm256_and_si256(_mm256_sub_epi32(U, ek), sig);
+
+      // shifts of 32 give 0, so the mask is all ones for m_n of 32
+      __m256i mask = _mm256_sub_epi32(_mm256_sllv_epi32(one, m), one);
+      __m256i s = _mm256_loadu_si256((const __m256i*)qp->s);
+      _mm256_storeu_si256((__m256i*)cwd, _mm256_and_si256(s, mask));
+      _mm256_storeu_si256((__m256i*)len, m);
+    }
+#endif
+
+    /////////////////////////////////////////////////////////////////////////
+    encoder_kernels get_encoder_kernels(int simd_level)
+    {
+      encoder_kernels kernels = { quad_pair_scalar, ms_pair_scalar };
+#ifdef OJPH_ENCODER_SIMD
+      grk::CPUArch arch;
+      if (simd_level >= 2 && arch.AVX2())
+      {
+        kernels.quad_pair = quad_pair_avx2;
+        kernels.ms_pair = ms_pair_avx2;
+      }
+#else
+      (void)simd_level;
+#endif
+      return kernels;
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+    // follows the instruction set level of the library's SIMD kernels
+    static const encoder_kernels& default_encoder_kernels()
+    {
+      static encoder_kernels kernels = get_encoder_kernels(
+        grk::simd_level() >= grk::GRK_SIMD_AVX2 ? 2 : 1);
+      return kernels;
+    }
+
     //////////////////////////////////////////////////////////////////////////
     //
     //
@@ -466,7 +721,8 @@ namespace ojph {
                                int width, int height, int stride,
                                int* lengths,
                                ojph::mem_elastic_allocator *elastic,
-                               ojph::coded_lists *& coded)
+                               ojph::coded_lists *& coded,
+                               const encoder_kernels* kernels)
     {
       assert(num_passes == 1);
       const int ms_size = 16384;         //more than enough
@@ -484,6 +740,11 @@ namespace ojph {
       vlc_init(&vlc, vlc_size, vlc_buf);
       ms_struct ms;
       ms_init(&ms, ms_size, ms_buf);
+      bit_acc vlc_acc, ms_acc;
+      acc_init(&vlc_acc);
+      acc_init(&ms_acc);
+
+      const encoder_kernels& kern = kernels ? *kernels : default_encoder_kernels();
 
       int p = 30 - missing_msbs;
 
@@ -501,185 +762,66 @@ namespace ojph {
       ui8* lep = e_val;     lep[0] = 0;
       ui8* lcxp = cx_val;   lcxp[0] = 0;
 
+      //MagSgn codewords of a pair of quads
+      quad_pair qp;
+      ui32 cwd[8];
+      int cwd_len[8];
+
       //initial row of quads
-      int e_qmax[2] = {0,0}, e_q[8] = {0,0,0,0,0,0,0,0};
-      int rho[2] = {0,0};
       int c_q0 = 0;
-      ui32 s[8] = {0,0,0,0,0,0,0,0}, val, t;
-      int y = 0;
+      int rows = ojph_min(height, 2);
       si32 *sp = buf;
       for (int x = 0; x < width; x += 4)
       {
         //prepare two quads
-        t = sp[0];
-        val = t + t; //multiply by 2 and get rid of sign
-        val >>= p; // 2 \mu_p + x
-        val &= ~1; // 2 \mu_p
-        if (val)
-        {
-          rho[0] = 1;
-          e_q[0] = 32 - count_leading_zeros(--val); //2\mu_p - 1
-          e_qmax[0] = e_q[0];
-          s[0] = --val + (t >> 31); //v_n = 2(\mu_p-1) + s_n
-        }
-
-        t = height > 1 ? sp[stride] : 0;
-        ++sp;
-        val = t + t; //multiply by 2 and get rid of sign
-        val >>= p; // 2 \mu_p + x
-        val &= ~1; // 2 \mu_p
-        if (val)
-        {
-          rho[0] += 2;
-          e_q[1] = 32 - count_leading_zeros(--val); //2\mu_p - 1
-          e_qmax[0] = ojph_max(e_qmax[0], e_q[1]);
-          s[1] = --val + (t >> 31); //v_n = 2(\mu_p-1) + s_n
-        }
-
-        if (x+1 < width)
-        {
-          t = sp[0];
-          val = t + t; //multiply by 2 and get rid of sign
-          val >>= p; // 2 \mu_p + x
-          val &= ~1; // 2 \mu_p
-          if (val)
-          {
-            rho[0] += 4;
-            e_q[2] = 32 - count_leading_zeros(--val); //2\mu_p - 1
-            e_qmax[0] = ojph_max(e_qmax[0], e_q[2]);
-            s[2] = --val + (t >> 31); //v_n = 2(\mu_p-1) + s_n
-          }
-
-          t = height > 1 ? sp[stride] : 0;
-          ++sp;
-          val = t + t; //multiply by 2 and get rid of sign
-          val >>= p; // 2 \mu_p + x
-          val &= ~1; // 2 \mu_p
-          if (val)
-          {
-            rho[0] += 8;
-            e_q[3] = 32 - count_leading_zeros(--val); //2\mu_p - 1
-            e_qmax[0] = ojph_max(e_qmax[0], e_q[3]);
-            s[3] = --val + (t >> 31); //v_n = 2(\mu_p-1) + s_n
-          }
-        }
+        kern.quad_pair(sp, stride, ojph_min(width - x, 4), rows, p, &qp);
+        sp += 4;
+        int rho0 = qp.rho[0], rho1 = qp.rho[1];
 
-        int Uq0 = ojph_max(e_qmax[0], 1); //kappa_q = 1
+        int Uq0 = ojph_max(qp.e_qmax[0], 1); //kappa_q = 1
+        int Uq1 = 0;
         int u_q0 = Uq0 - 1, u_q1 = 0; //kappa_q = 1
 
-        int eps0 = 0;
-        if (u_q0 > 0)
-        {
-          eps0 |= (e_q[0] == e_qmax[0]);
-          eps0 |= (e_q[1] == e_qmax[0]) << 1;
-          eps0 |= (e_q[2] == e_qmax[0]) << 2;
-          eps0 |= (e_q[3] == e_qmax[0]) << 3;
-        }
-        lep[0] = ojph_max(lep[0], (ui8)e_q[1]); lep++;
-        lep[0] = (ui8)e_q[3];
-        lcxp[0] |= (ui8)((rho[0] & 2) >> 1); lcxp++;
-        lcxp[0] = (ui8)((rho[0] & 8) >> 3);
+        int eps0 = u_q0 > 0 ? qp.eps[0] : 0;
+        lep[0] = ojph_max(lep[0], (ui8)qp.e_q[1]); lep++;
+        lep[0] = (ui8)qp.e_q[3];
+        lcxp[0] |= (ui8)((rho0 & 2) >> 1); lcxp++;
+        lcxp[0] = (ui8)((rho0 & 8) >> 3);
 
-        ui16 tuple0 = vlc_tbl0[(c_q0 << 8) + (rho[0] << 4) + eps0];
-        vlc_encode(&vlc, tuple0 >> 8, (tuple0 >> 4) & 7);
+        ui16 tuple0 = vlc_tbl0[(c_q0 << 8) + (rho0 << 4) + eps0];
+        vlc_put(&vlc, &vlc_acc, tuple0 >> 8, (tuple0 >> 4) & 7);
 
         if (c_q0 == 0)
-            mel_encode(&mel, rho[0] != 0);
-
-        int m = (rho[0] & 1) ? Uq0 - (tuple0 & 1) : 0;
-        ms_encode(&ms, s[0] & ((1<<m)-1), m);
-        m = (rho[0] & 2) ? Uq0 - ((tuple0 & 2) >> 1) : 0;
-        ms_encode(&ms, s[1] & ((1<<m)-1), m);
-        m = (rho[0] & 4) ? Uq0 - ((tuple0 & 4) >> 2) : 0;
-        ms_encode(&ms, s[2] & ((1<<m)-1), m);
-        m = (rho[0] & 8) ? Uq0 - ((tuple0 & 8) >> 3) : 0;
-        ms_encode(&ms, s[3] & ((1<<m)-1), m);
+            mel_encode(&mel, rho0 != 0);
 
+        int e_k = tuple0 & 0xF;
         if (x+2 < width)
         {
-          t = sp[0];
-          val = t + t; //multiply by 2 and get rid of sign
-          val >>= p; // 2 \mu_p + x
-          val &= ~1; // 2 \mu_p
-          if (val)
-          {
-            rho[1] = 1;
-            e_q[4] = 32 - count_leading_zeros(--val); //2\mu_p - 1
-            e_qmax[1] = e_q[4];
-            s[4] = --val + (t >> 31); //v_n = 2(\mu_p-1) + s_n
-          }
-
-          t = height > 1 ? sp[stride] : 0;
-          ++sp;
-          val = t + t; //multiply by 2 and get rid of sign
-          val >>= p; // 2 \mu_p + x
-          val &= ~1; // 2 \mu_p
-          if (val)
-          {
-            rho[1] += 2;
-            e_q[5] = 32 - count_leading_zeros(--val); //2\mu_p - 1
-            e_qmax[1] = ojph_max(e_qmax[1], e_q[5]);
-            s[5] = --val + (t >> 31); //v_n = 2(\mu_p-1) + s_n
-          }
+          int c_q1 = (rho0 >> 1) | (rho0 & 1);
+          Uq1 = ojph_max(qp.e_qmax[1], 1); //kappa_q = 1
+          u_q1 = Uq1 - 1; //kappa_q = 1
 
-          if (x+3 < width)
-          {
-            t = sp[0];
-            val = t + t; //multiply by 2 and get rid of sign
-            val >>= p; // 2 \mu_p + x
-            val &= ~1; // 2 \mu_p
-            if (val)
-            {
-              rho[1] += 4;
-              e_q[6] = 32 - count_leading_zeros(--val); //2\mu_p - 1
-              e_qmax[1] = ojph_max(e_qmax[1], e_q[6]);
-              s[6] = --val + (t >> 31); //v_n = 2(\mu_p-1) + s_n
-            }
+          int eps1 = u_q1 > 0 ? qp.eps[1] : 0;
+          lep[0] = ojph_max(lep[0], (ui8)qp.e_q[5]); lep++;
+          lep[0] = (ui8)qp.e_q[7];
+          lcxp[0] |= (ui8)((rho1 & 2) >> 1); lcxp++;
+          lcxp[0] = (ui8)((rho1 & 8) >> 3);
+          ui16 tuple1 = vlc_tbl0[(c_q1 << 8) + (rho1 << 4) + eps1];
+          vlc_put(&vlc, &vlc_acc, tuple1 >> 8, (tuple1 >> 4) & 7);
 
-            t = height > 1 ? sp[stride] : 0;
-            ++sp;
-            val = t + t; //multiply by 2 and get rid of sign
-            val >>= p; // 2 \mu_p + x
-            val &= ~1; // 2 \mu_p
-            if (val)
-            {
-              rho[1] += 8;
-              e_q[7] = 32 - count_leading_zeros(--val); //2\mu_p - 1
-              e_qmax[1] = ojph_max(e_qmax[1], e_q[7]);
-              s[7] = --val + (t >> 31); //v_n = 2(\mu_p-1) + s_n
-            }
-          }
-
-          int c_q1 = (rho[0] >> 1) | (rho[0] & 1);
-          int Uq1 = ojph_max(e_qmax[1], 1); //kappa_q = 1
-          u_q1 = Uq1 - 1; //kappa_q = 1
+          if (c_q1 == 0)
+            mel_encode(&mel, rho1 != 0);
+          e_k |= (tuple1 & 0xF) << 4;
+        }
 
-          int eps1 = 0;
-          if (u_q1 > 0)
+        if (rho0 | rho1)
+        {
+          if (rho0 | rho1)
           {
-            eps1 |= (e_q[4] == e_qmax[1]);
-            eps1 |= (e_q[5] == e_qmax[1]) << 1;
-            eps1 |= (e_q[6] == e_qmax[1]) << 2;
-            eps1 |= (e_q[7] == e_qmax[1]) << 3;
+            kern.ms_pair(&qp, Uq0, Uq1, e_k, cwd, cwd_len);
+            for (int k = 0; k < 8; ++k)
+              ms_put(&ms, &ms_acc, cwd[k], cwd_len[k]);
           }
-          lep[0] = ojph_max(lep[0], (ui8)e_q[5]); lep++;
-          lep[0] = (ui8)e_q[7];
-          lcxp[0] |= (ui8)((rho[1] & 2) >> 1); lcxp++;
-          lcxp[0] = (ui8)((rho[1] & 8) >> 3);
-          ui16 tuple1 = vlc_tbl0[(c_q1 << 8) + (rho[1] << 4) + eps1];
-          vlc_encode(&vlc, tuple1 >> 8, (tuple1 >> 4) & 7);
-
-          if (c_q1 == 0)
-            mel_encode(&mel, rho[1] != 0);
-
-          int m = (rho[1] & 1) ? Uq1 - (tuple1 & 1) : 0;
-          ms_encode(&ms, s[4] & ((1<<m)-1), m);
-          m = (rho[1] & 2) ? Uq1 - ((tuple1 & 2) >> 1) : 0;
-          ms_encode(&ms, s[5] & ((1<<m)-1), m);
-          m = (rho[1] & 4) ? Uq1 - ((tuple1 & 4) >> 2) : 0;
-          ms_encode(&ms, s[6] & ((1<<m)-1), m);
-          m = (rho[1] & 8) ? Uq1 - ((tuple1 & 8) >> 3) : 0;
-          ms_encode(&ms, s[7] & ((1<<m)-1), m);
         }
 
         if (u_q0 > 0 && u_q1 > 0)
@@ -687,35 +829,32 @@ namespace ojph {
 
         if (u_q0 > 2 && u_q1 > 2)
         {
-          vlc_encode(&vlc, ulvc_cwd_pre[u_q0-2], ulvc_cwd_pre_len[u_q0-2]);
-          vlc_encode(&vlc, ulvc_cwd_pre[u_q1-2], ulvc_cwd_pre_len[u_q1-2]);
-          vlc_encode(&vlc, ulvc_cwd_suf[u_q0-2], ulvc_cwd_suf_len[u_q0-2]);
-          vlc_encode(&vlc, ulvc_cwd_suf[u_q1-2], ulvc_cwd_suf_len[u_q1-2]);
+          vlc_put(&vlc, &vlc_acc, ulvc_cwd_pre[u_q0-2], ulvc_cwd_pre_len[u_q0-2]);
+          vlc_put(&vlc, &vlc_acc, ulvc_cwd_pre[u_q1-2], ulvc_cwd_pre_len[u_q1-2]);
+          vlc_put(&vlc, &vlc_acc, ulvc_cwd_suf[u_q0-2], ulvc_cwd_suf_len[u_q0-2]);
+          vlc_put(&vlc, &vlc_acc, ulvc_cwd_suf[u_q1-2], ulvc_cwd_suf_len[u_q1-2]);
         }
         else if (u_q0 > 2 && u_q1 > 0)
         {
-          vlc_encode(&vlc, ulvc_cwd_pre[u_q0], ulvc_cwd_pre_len[u_q0]);
-          vlc_encode(&vlc, u_q1 - 1, 1);
-          vlc_encode(&vlc, ulvc_cwd_suf[u_q0], ulvc_cwd_suf_len[u_q0]);
+          vlc_put(&vlc, &vlc_acc, ulvc_cwd_pre[u_q0], ulvc_cwd_pre_len[u_q0]);
+          vlc_put(&vlc, &vlc_acc, u_q1 - 1, 1);
+          vlc_put(&vlc, &vlc_acc, ulvc_cwd_suf[u_q0], ulvc_cwd_suf_len[u_q0]);
         }
         else
         {
-          vlc_encode(&vlc, ulvc_cwd_pre[u_q0], ulvc_cwd_pre_len[u_q0]);
-          vlc_encode(&vlc, ulvc_cwd_pre[u_q1], ulvc_cwd_pre_len[u_q1]);
-          vlc_encode(&vlc, ulvc_cwd_suf[u_q0], ulvc_cwd_suf_len[u_q0]);
-          vlc_encode(&vlc, ulvc_cwd_suf[u_q1], ulvc_cwd_suf_len[u_q1]);
+          vlc_put(&vlc, &vlc_acc, ulvc_cwd_pre[u_q0], ulvc_cwd_pre_len[u_q0]);
+          vlc_put(&vlc, &vlc_acc, ulvc_cwd_pre[u_q1], ulvc_cwd_pre_len[u_q1]);
+          vlc_put(&vlc, &vlc_acc, ulvc_cwd_suf[u_q0], ulvc_cwd_suf_len[u_q0]);
+          vlc_put(&vlc, &vlc_acc, ulvc_cwd_suf[u_q1], ulvc_cwd_suf_len[u_q1]);
         }
 
         //prepare for next iteration
-        c_q0 = (rho[1] >> 1) | (rho[1] & 1);
-        s[0] = s[1] = s[2] = s[3] = s[4] = s[5] = s[6] = s[7] = 0;
-        e_q[0]=e_q[1]=e_q[2]=e_q[3]=e_q[4]=e_q[5]=e_q[6]=e_q[7]=0;
-        rho[0] = rho[1] = 0; e_qmax[0] = e_qmax[1] = 0;
+        c_q0 = (rho1 >> 1) | (rho1 & 1);
       }
 
       lep[1] = 0;
 
-      for (y = 2; y < height; y += 2)
+      for (int y = 2; y < height; y += 2)
       {
         lep = e_val;
         int max_e = ojph_max(lep[0], lep[1]) - 1;
@@ -724,200 +863,75 @@ namespace ojph {
         c_q0 = lcxp[0] + (lcxp[1] << 2);
         lcxp[0] = 0;
 
+        rows = ojph_min(height - y, 2);
         sp = buf + y * stride;
         for (int x = 0; x < width; x += 4)
         {
           //prepare two quads
-          t = sp[0];
-          val = t + t; //multiply by 2 and get rid of sign
-          val >>= p; // 2 \mu_p + x
-          val &= ~1; // 2 \mu_p
-          if (val)
-          {
-            rho[0] = 1;
-            e_q[0] = 32 - count_leading_zeros(--val); //2\mu_p - 1
-            e_qmax[0] = e_q[0];
-            s[0] = --val + (t >> 31); //v_n = 2(\mu_p-1) + s_n
-          }
+          kern.quad_pair(sp, stride, ojph_min(width - x, 4), rows, p, &qp);
+          sp += 4;
+          int rho0 = qp.rho[0], rho1 = qp.rho[1];
 
-          t = y + 1 < height ? sp[stride] : 0;
-          ++sp;
-          val = t + t; //multiply by 2 and get rid of sign
-          val >>= p; // 2 \mu_p + x
-          val &= ~1; // 2 \mu_p
-          if (val)
-          {
-            rho[0] += 2;
-            e_q[1] = 32 - count_leading_zeros(--val); //2\mu_p - 1
-            e_qmax[0] = ojph_max(e_qmax[0], e_q[1]);
-            s[1] = --val + (t >> 31); //v_n = 2(\mu_p-1) + s_n
-          }
-
-          if (x+1 < width)
-          {
-            t = sp[0];
-            val = t + t; //multiply by 2 and get rid of sign
-            val >>= p; // 2 \mu_p + x
-            val &= ~1; // 2 \mu_p
-            if (val)
-            {
-              rho[0] += 4;
-              e_q[2] = 32 - count_leading_zeros(--val); //2\mu_p - 1
-              e_qmax[0] = ojph_max(e_qmax[0], e_q[2]);
-              s[2] = --val + (t >> 31); //v_n = 2(\mu_p-1) + s_n
-            }
-
-            t = y + 1 < height ? sp[stride] : 0;
-            ++sp;
-            val = t + t; //multiply by 2 and get rid of sign
-            val >>= p; // 2 \mu_p + x
-            val &= ~1; // 2 \mu_p
-            if (val)
-            {
-              rho[0] += 8;
-              e_q[3] = 32 - count_leading_zeros(--val); //2\mu_p - 1
-              e_qmax[0] = ojph_max(e_qmax[0], e_q[3]);
-              s[3] = --val + (t >> 31); //v_n = 2(\mu_p-1) + s_n
-            }
-          }
-
-          int kappa = (rho[0] & (rho[0]-1)) ? ojph_max(1,max_e) : 1;
-          int Uq0 = ojph_max(e_qmax[0], kappa);
+          int kappa = (rho0 & (rho0-1)) ? ojph_max(1,max_e) : 1;
+          int Uq0 = ojph_max(qp.e_qmax[0], kappa);
+          int Uq1 = 0;
           int u_q0 = Uq0 - kappa, u_q1 = 0;
 
-          int eps0 = 0;
-          if (u_q0 > 0)
-          {
-            eps0 |= (e_q[0] == e_qmax[0]);
-            eps0 |= (e_q[1] == e_qmax[0]) << 1;
-            eps0 |= (e_q[2] == e_qmax[0]) << 2;
-            eps0 |= (e_q[3] == e_qmax[0]) << 3;
-          }
-          lep[0] = ojph_max(lep[0], (ui8)e_q[1]); lep++;
+          int eps0 = u_q0 > 0 ? qp.eps[0] : 0;
+          lep[0] = ojph_max(lep[0], (ui8)qp.e_q[1]); lep++;
           max_e = ojph_max(lep[0], lep[1]) - 1;
-          lep[0] = (ui8)e_q[3];
-          lcxp[0] |= (ui8)((rho[0] & 2) >> 1); lcxp++;
+          lep[0] = (ui8)qp.e_q[3];
+          lcxp[0] |= (ui8)((rho0 & 2) >> 1); lcxp++;
           int c_q1 = lcxp[0] + (lcxp[1] << 2);
-          lcxp[0] = (ui8)((rho[0] & 8) >> 3);
-          ui16 tuple0 = vlc_tbl1[(c_q0 << 8) + (rho[0] << 4) + eps0];
-          vlc_encode(&vlc, tuple0 >> 8, (tuple0 >> 4) & 7);
+          lcxp[0] = (ui8)((rho0 & 8) >> 3);
+          ui16 tuple0 = vlc_tbl1[(c_q0 << 8) + (rho0 << 4) + eps0];
+          vlc_put(&vlc, &vlc_acc, tuple0 >> 8, (tuple0 >> 4) & 7);
 
           if (c_q0 == 0)
-              mel_encode(&mel, rho[0] != 0);
-
-          int m = (rho[0] & 1) ? Uq0 - (tuple0 & 1) : 0;
-          ms_encode(&ms, s[0] & ((1<<m)-1), m);
-          m = (rho[0] & 2) ? Uq0 - ((tuple0 & 2) >> 1) : 0;
-          ms_encode(&ms, s[1] & ((1<<m)-1), m);
-          m = (rho[0] & 4) ? Uq0 - ((tuple0 & 4) >> 2) : 0;
-          ms_encode(&ms, s[2] & ((1<<m)-1), m);
-          m = (rho[0] & 8) ? Uq0 - ((tuple0 & 8) >> 3) : 0;
-          ms_encode(&ms, s[3] & ((1<<m)-1), m);
+              mel_encode(&mel, rho0 != 0);
 
+          int e_k = tuple0 & 0xF;
           if (x+2 < width)
           {
-            t = sp[0];
-            val = t + t; //multiply by 2 and get rid of sign
-            val >>= p; // 2 \mu_p + x
-            val &= ~1; // 2 \mu_p
-            if (val)
-            {
-              rho[1] = 1;
-              e_q[4] = 32 - count_leading_zeros(--val); //2\mu_p - 1
-              e_qmax[1] = e_q[4];
-              s[4] = --val + (t >> 31); //v_n = 2(\mu_p-1) + s_n
-            }
-
-            t = y + 1 < height ? sp[stride] : 0;
-            ++sp;
-            val = t + t; //multiply by 2 and get rid of sign
-            val >>= p; // 2 \mu_p + x
-            val &= ~1; // 2 \mu_p
-            if (val)
-            {
-              rho[1] += 2;
-              e_q[5] = 32 - count_leading_zeros(--val); //2\mu_p - 1
-              e_qmax[1] = ojph_max(e_qmax[1], e_q[5]);
-              s[5] = --val + (t >> 31); //v_n = 2(\mu_p-1) + s_n
-            }
-
-            if (x+3 < width)
-            {
-              t = sp[0];
-              val = t + t; //multiply by 2 and get rid of sign
-              val >>= p; // 2 \mu_p + x
-              val &= ~1; // 2 \mu_p
-              if (val)
-              {
-                rho[1] += 4;
-                e_q[6] = 32 - count_leading_zeros(--val); //2\mu_p - 1
-                e_qmax[1] = ojph_max(e_qmax[1], e_q[6]);
-                s[6] = --val + (t >> 31); //v_n = 2(\mu_p-1) + s_n
-              }
-
-              t = y + 1 < height ? sp[stride] : 0;
-              ++sp;
-              val = t + t; //multiply by 2 and get rid of sign
-              val >>= p; // 2 \mu_p + x
-              val &= ~1; // 2 \mu_p
-              if (val)
-              {
-                rho[1] += 8;
-                e_q[7] = 32 - count_leading_zeros(--val); //2\mu_p - 1
-                e_qmax[1] = ojph_max(e_qmax[1], e_q[7]);
-                s[7] = --val + (t >> 31); //v_n = 2(\mu_p-1) + s_n
-              }
-            }
-
-            kappa = (rho[1] & (rho[1]-1)) ? ojph_max(1,max_e) : 1;
-            c_q1 |= ((rho[0] & 4) >> 1) | ((rho[0] & 8) >> 2);
-            int Uq1 = ojph_max(e_qmax[1], kappa);
+            kappa = (rho1 & (rho1-1)) ? ojph_max(1,max_e) : 1;
+            c_q1 |= ((rho0 & 4) >> 1) | ((rho0 & 8) >> 2);
+            Uq1 = ojph_max(qp.e_qmax[1], kappa);
             u_q1 = Uq1 - kappa;
 
-            int eps1 = 0;
-            if (u_q1 > 0)
-            {
-              eps1 |= (e_q[4] == e_qmax[1]);
-              eps1 |= (e_q[5] == e_qmax[1]) << 1;
-              eps1 |= (e_q[6] == e_qmax[1]) << 2;
-              eps1 |= (e_q[7] == e_qmax[1]) << 3;
-            }
-            lep[0] = ojph_max(lep[0], (ui8)e_q[5]); lep++;
+            int eps1 = u_q1 > 0 ? qp.eps[1] : 0;
+            lep[0] = ojph_max(lep[0], (ui8)qp.e_q[5]); lep++;
             max_e = ojph_max(lep[0], lep[1]) - 1;
-            lep[0] = (ui8)e_q[7];
-            lcxp[0] |= (ui8)((rho[1] & 2) >> 1); lcxp++;
+            lep[0] = (ui8)qp.e_q[7];
+            lcxp[0] |= (ui8)((rho1 & 2) >> 1); lcxp++;
             c_q0 = lcxp[0] + (lcxp[1] << 2);
-            lcxp[0] = (ui8)((rho[1] & 8) >> 3);
-            ui16 tuple1 = vlc_tbl1[(c_q1 << 8) + (rho[1] << 4) + eps1];
-            vlc_encode(&vlc, tuple1 >> 8, (tuple1 >> 4) & 7);
+            lcxp[0] = (ui8)((rho1 & 8) >> 3);
+            ui16 tuple1 = vlc_tbl1[(c_q1 << 8) + (rho1 << 4) + eps1];
+            vlc_put(&vlc, &vlc_acc, tuple1 >> 8, (tuple1 >> 4) & 7);
 
             if (c_q1 == 0)
-              mel_encode(&mel, rho[1] != 0);
-
-            int m = (rho[1] & 1) ? Uq1 - (tuple1 & 1) : 0;
-            ms_encode(&ms, s[4] & ((1<<m)-1), m);
-            m = (rho[1] & 2) ? Uq1 - ((tuple1 & 2) >> 1) : 0;
-            ms_encode(&ms, s[5] & ((1<<m)-1), m);
-            m = (rho[1] & 4) ? Uq1 - ((tuple1 & 4) >> 2) : 0;
-            ms_encode(&ms, s[6] & ((1<<m)-1), m);
-            m = (rho[1] & 8) ? Uq1 - ((tuple1 & 8) >> 3) : 0;
-            ms_encode(&ms, s[7] & ((1<<m)-1), m);
+              mel_encode(&mel, rho1 != 0);
+            e_k |= (tuple1 & 0xF) << 4;
           }
 
-          vlc_encode(&vlc, ulvc_cwd_pre[u_q0], ulvc_cwd_pre_len[u_q0]);
-          vlc_encode(&vlc, ulvc_cwd_pre[u_q1], ulvc_cwd_pre_len[u_q1]);
-          vlc_encode(&vlc, ulvc_cwd_suf[u_q0], ulvc_cwd_suf_len[u_q0]);
-          vlc_encode(&vlc, ulvc_cwd_suf[u_q1], ulvc_cwd_suf_len[u_q1]);
+          if (rho0 | rho1)
+          {
+            kern.ms_pair(&qp, Uq0, Uq1, e_k, cwd, cwd_len);
+            for (int k = 0; k < 8; ++k)
+              ms_put(&ms, &ms_acc, cwd[k], cwd_len[k]);
+          }
+
+          vlc_put(&vlc, &vlc_acc, ulvc_cwd_pre[u_q0], ulvc_cwd_pre_len[u_q0]);
+          vlc_put(&vlc, &vlc_acc, ulvc_cwd_pre[u_q1], ulvc_cwd_pre_len[u_q1]);
+          vlc_put(&vlc, &vlc_acc, ulvc_cwd_suf[u_q0], ulvc_cwd_suf_len[u_q0]);
+          vlc_put(&vlc, &vlc_acc, ulvc_cwd_suf[u_q1], ulvc_cwd_suf_len[u_q1]);
 
           //prepare for next iteration
-          c_q0 |= ((rho[1] & 4) >> 1) | ((rho[1] & 8) >> 2);
-          s[0] = s[1] = s[2] = s[3] = s[4] = s[5] = s[6] = s[7] = 0;
-          e_q[0]=e_q[1]=e_q[2]=e_q[3]=e_q[4]=e_q[5]=e_q[6]=e_q[7]=0;
-          rho[0] = rho[1] = 0; e_qmax[0] = e_qmax[1] = 0;
+          c_q0 |= ((rho1 & 4) >> 1) | ((rho1 & 8) >> 2);
         }
       }
 
-
+      vlc_flush(&vlc, &vlc_acc);
+      ms_flush(&ms, &ms_acc);
       terminate_mel_vlc(&mel, &vlc);
       ms_terminate(&ms);
 
@@ -932,7 +946,7 @@ namespace ojph {
       int num_bytes = mel.pos + vlc.pos;
       coded->buf[lengths[0]-1] = (ui8)(num_bytes >> 4);
       coded->buf[lengths[0]-2] = coded->buf[lengths[0]-2] & 0xF0;
-      coded->buf[lengths[0]-2] = 
+      coded->buf[lengths[0]-2] =
         (ui8)(coded->buf[lengths[0]-2] | (num_bytes & 0xF));
 
       coded->avail_size -= lengths[0];
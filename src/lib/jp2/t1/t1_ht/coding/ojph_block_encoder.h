@@ -51,11 +51,50 @@ namespace ojph {
   namespace local {
 
     //////////////////////////////////////////////////////////////////////////
+    //the samples of a pair of quads, in coding order; that is, down the
+    // columns, quad 0 first
+    struct quad_pair {
+      ui32 s[8];      //v_n = 2(\mu_p-1) + s_n, or 0 if insignificant
+      int e_q[8];     //exponents E_n, or 0 if insignificant
+      int rho[2];     //significance pattern of each quad
+      int e_qmax[2];  //largest exponent of each quad
+      int eps[2];     //samples whose exponent equals e_qmax, for each quad
+    };
+
+    //////////////////////////////////////////////////////////////////////////
+    //computes significance, exponents and MagSgn values of the quad pair
+    // whose top left sample is sp; cols (1 to 4) and rows (1 or 2) are
+    // the number of columns and rows that lie inside the code block
+    typedef void (*quad_pair_fn)(const si32* sp, int stride, int cols,
+                                 int rows, int p, quad_pair* qp);
+
+    //////////////////////////////////////////////////////////////////////////
+    //computes the MagSgn codewords of a quad pair, and their lengths m_n,
+    // from U_q of each quad and the e_k bits of their VLC codewords
+    // (quad 0 in bits 0 to 3, quad 1 in bits 4 to 7)
+    typedef void (*ms_pair_fn)(const quad_pair* qp, int U0, int U1,
+                               int e_k, ui32* cwd, int* len);
+
+    //////////////////////////////////////////////////////////////////////////
+    struct encoder_kernels {
+      quad_pair_fn quad_pair;
+      ms_pair_fn ms_pair;
+    };
+
+    //////////////////////////////////////////////////////////////////////////
+    //returns the widest encoder kernels supported by the CPU, up to
+    // simd_level: 0 is scalar and 2 is AVX2
+    encoder_kernels get_encoder_kernels(int simd_level);
+
+    //////////////////////////////////////////////////////////////////////////
+    //encodes the cleanup pass; the kernels are chosen at start up,
+    // unless some are passed in
     void
       ojph_encode_codeblock(si32* buf, int missing_msbs, int num_passes,
                             int width, int height, int stride,
                             int* lengths, ojph::mem_elastic_allocator *elastic,
-                            ojph::coded_lists *& coded);
+                            ojph::coded_lists *& coded,
+                            const encoder_kernels* kernels = nullptr);
   }
 }
 
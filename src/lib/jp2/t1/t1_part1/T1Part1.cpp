@@ -17,6 +17,7 @@
 #include <T1Part1.h>
 #include "grok_includes.h"
 #include "testing.h"
+#include "Dequantizer.h"
 #include <algorithm>
 using namespace std;
 
@@ -113,10 +114,15 @@ double T1Part1::compress(encodeBlockInfo *block, grk_tcd_tile *tile,
 			block->compno,
 			(tile->comps + block->compno)->numresolutions - 1 - block->resno,
 			block->qmfbid, block->stepsize, block->cblk_sty,
-			block->mct_norms, block->mct_numcomps, doRateControl);
+			block->mct_norms, block->mct_numcomps, doRateControl,
+			block->min_slope);
 
 	cblk->num_passes_encoded = cblkopj.totalpasses;
 	cblk->numbps = cblkopj.numbps;
+	// a full encode has one cleanup pass in the first bit plane,
+	// and three passes in each of the others
+	block->terminated_early = cblkopj.numbps > 0
+			&& cblkopj.totalpasses < 3 * cblkopj.numbps - 2;
 	for (uint32_t i = 0; i < cblk->num_passes_encoded; ++i) {
 		auto passopj = cblkopj.passes + i;
 		auto passgrk = cblk->passes + i;
@@ -216,65 +222,19 @@ void T1Part1::postDecode(decodeBlockInfo *block) {
 void T1Part1::post_decode(t1_info *t1,
 						tcd_cblk_dec_t *cblk,
 						decodeBlockInfo *block) {
-	uint32_t roishift = block->roishift;
-	uint32_t qmfbid = block->qmfbid;
-	float stepsize = block->stepsize;
-	int32_t *tilec_data = block->tiledp;
-	uint32_t tile_w = block->tilec->width();
-	bool whole_tile_decoding = block->tilec->whole_tile_decoding;
-	auto src = t1->data;
-	uint32_t dest_width = tile_w;
 	uint32_t cblk_w = (uint32_t) (cblk->x1 - cblk->x0);
 	uint32_t cblk_h = (uint32_t) (cblk->y1 - cblk->y0);
 
-	if (roishift) {
-		if (roishift >= 31) {
-			for (uint16_t j = 0; j < cblk_h; ++j) {
-				for (uint16_t i = 0; i < cblk_w; ++i) {
-					src[(j * cblk_w) + i] = 0;
-				}
-			}
-		} else {
-			int32_t thresh = 1 << roishift;
-			for (uint32_t j = 0; j < cblk_h; ++j) {
-				for (uint32_t i = 0; i < cblk_w; ++i) {
-					int32_t val = src[(j * cblk_w) + i];
-					int32_t mag = abs(val);
-					if (mag >= thresh) {
-						mag >>= roishift;
-						src[(j * cblk_w) + i] = val < 0 ? -mag : mag;
-					}
-				}
-			}
-		}
-	}
+	DequantizeParams params;
+	params.roishift = block->roishift;
+	params.reversible = block->qmfbid == 1;
+	// decoded samples carry an extra half bit
+	params.shift = 1;
+	params.stepsize = block->stepsize;
+	params.signMagnitude = false;
 
-	if (!whole_tile_decoding) {
-    	if (qmfbid == 1) {
-    		for (uint32_t j = 0; j < cblk_h; ++j) {
-    			uint32_t i = 0;
-    			for (; i < (cblk_w & ~(uint32_t) 3U); i += 4U) {
-    				src[(j * cblk_w) + i + 0U] /= 2;
-    				src[(j * cblk_w) + i + 1U] /= 2;
-    				src[(j * cblk_w) + i + 2U] /= 2;
-    				src[(j * cblk_w) + i + 3U] /= 2;
-    			}
-    			for (; i < cblk_w; ++i)
-    				src[(j * cblk_w) + i] /= 2;
-     		}
-    	} else {
-			float *GRK_RESTRICT tiledp = (float*) src;
-			for (uint32_t j = 0; j < cblk_h; ++j) {
-				float *GRK_RESTRICT tiledp2 = tiledp;
-				for (uint32_t i = 0; i < cblk_w; ++i) {
-					float tmp = (float) (*src) * stepsize;
-					*tiledp2 = tmp;
-					src++;
-					tiledp2++;
-				}
-				tiledp += cblk_w;
-			}
-    	}
+	if (!block->tilec->whole_tile_decoding) {
+		dequantize_cblk(t1->data, cblk_w, cblk_h, t1->data, cblk_w, params);
 		// write directly from t1 to sparse array
         if (!block->tilec->m_sa->write(block->x,
 					  block->y,
@@ -287,44 +247,8 @@ void T1Part1::post_decode(t1_info *t1,
 			  return;
 		  }
 	} else {
-		auto dest = tilec_data;
-		if (qmfbid == 1) {
-			int32_t *GRK_RESTRICT tiledp = dest;
-			for (uint32_t j = 0; j < cblk_h; ++j) {
-				uint32_t i = 0;
-				for (; i < (cblk_w & ~(uint32_t) 3U); i += 4U) {
-					int32_t tmp0 = src[(j * cblk_w) + i + 0U];
-					int32_t tmp1 = src[(j * cblk_w) + i + 1U];
-					int32_t tmp2 = src[(j * cblk_w) + i + 2U];
-					int32_t tmp3 = src[(j * cblk_w) + i + 3U];
-					((int32_t*) tiledp)[(j * (size_t) dest_width) + i + 0U] = tmp0
-							/ 2;
-					((int32_t*) tiledp)[(j * (size_t) dest_width) + i + 1U] = tmp1
-							/ 2;
-					((int32_t*) tiledp)[(j * (size_t) dest_width) + i + 2U] = tmp2
-							/ 2;
-					((int32_t*) tiledp)[(j * (size_t) dest_width) + i + 3U] = tmp3
-							/ 2;
-				}
-				for (; i < cblk_w; ++i) {
-					int32_t tmp = src[(j * cblk_w) + i];
-					((int32_t*) tiledp)[(j * (size_t) dest_width) + i] = tmp / 2;
-				}
-			}
-		} else {
-			float *GRK_RESTRICT tiledp = (float*) dest;
-			for (uint32_t j = 0; j < cblk_h; ++j) {
-				float *GRK_RESTRICT tiledp2 = tiledp;
-				for (uint32_t i = 0; i < cblk_w; ++i) {
-					float tmp = (float) (*src) * stepsize;
-					*tiledp2 = tmp;
-					src++;
-					tiledp2++;
-				}
-				tiledp += dest_width;
-			}
-		}
-
+		dequantize_cblk(t1->data, cblk_w, cblk_h, block->tiledp,
+				block->tilec->width(), params);
 	}
 }
 
@@ -97,6 +97,10 @@ struct mqcoder {
     const uint8_t* lut_ctxno_zc_orient;
     /** Original value of the 2 bytes at end[0] and end[1] */
     uint8_t backup[GRK_FAKE_MARKER_BYTES];
+    /** only used by raw decoder: unstuffed bits, most significant bit first */
+    uint64_t raw_buf;
+    /** only used by raw decoder: number of bits in raw_buf */
+    uint32_t raw_bits;
 } ;
 
 const uint32_t A_MIN = 0x8000;
@@ -197,6 +197,8 @@ void mqc_raw_init_dec(mqcoder *mqc, uint8_t *bp, uint32_t len,
     mqc_init_dec_common(mqc, bp, len, extra_writable_bytes);
     mqc->c = 0;
     mqc->ct = 0;
+    mqc->raw_buf = 0;
+    mqc->raw_bits = 0;
 }
 
 void opq_mqc_finish_dec(mqcoder *mqc){
@@ -83,32 +83,60 @@
 }
 
 /**
-Decode a symbol using raw-decoder. Cfr p.506 TAUBMAN
+Refill the raw-decoder bit buffer with at least 56 bits. Cfr p.506 TAUBMAN
+
+The byte following an 0xFF only carries 7 bits, and once a marker
+is reached (0xFF followed by a byte > 0x8F) the buffer is padded with ones.
+Four bytes are read at a time while they are clear of both.
 @param mqc MQC handle
-@return Returns the decoded symbol (0 or 1)
 */
-static INLINE uint32_t mqc_raw_decode(mqcoder *mqc){
-    if (mqc->ct == 0) {
+static INLINE void mqc_raw_fill_dec(mqcoder *mqc){
+    if (mqc->raw_bits <= 32 && mqc->c != 0xff && mqc->bp + 4 <= mqc->end) {
+        uint32_t word = ((uint32_t)mqc->bp[0] << 24) | ((uint32_t)mqc->bp[1] << 16) |
+                        ((uint32_t)mqc->bp[2] << 8) | (uint32_t)mqc->bp[3];
+        /* no 0xFF byte in word, i.e. no zero byte in its complement */
+        uint32_t inv = ~word;
+        if (((inv - 0x01010101U) & ~inv & 0x80808080U) == 0) {
+            mqc->raw_buf |= (uint64_t)word << (32 - mqc->raw_bits);
+            mqc->raw_bits += 32;
+            mqc->c = word & 0xff;
+            mqc->bp += 4;
+        }
+    }
+    while (mqc->raw_bits <= 56) {
         /* Given mqc_raw_init_dec() we know that at some point we will */
         /* have a 0xFF 0xFF artificial marker */
+        uint32_t byte = 0xff;
+        uint32_t nb = 8;
         if (mqc->c == 0xff) {
-            if (*mqc->bp  > 0x8f) {
-                mqc->c = 0xff;
-                mqc->ct = 8;
-            } else {
+            if (*mqc->bp <= 0x8f) {
                 mqc->c = *mqc->bp;
                 mqc->bp ++;
-                mqc->ct = 7;
+                byte = mqc->c & 0x7f;
+                nb = 7;
             }
         } else {
             mqc->c = *mqc->bp;
             mqc->bp ++;
-            mqc->ct = 8;
+            byte = mqc->c;
         }
+        mqc->raw_buf |= (uint64_t)byte << (64 - mqc->raw_bits - nb);
+        mqc->raw_bits += nb;
     }
-    mqc->ct--;
+}
+
+/**
+Decode a symbol using raw-decoder. The caller must ensure,
+with mqc_raw_fill_dec(), that the bit buffer is not empty
+@param mqc MQC handle
+@return Returns the decoded symbol (0 or 1)
+*/
+static INLINE uint32_t mqc_raw_decode(mqcoder *mqc){
+    uint32_t v = (uint32_t)(mqc->raw_buf >> 63);
+    mqc->raw_buf <<= 1;
+    mqc->raw_bits--;
 
-    return ((uint32_t)mqc->c >> mqc->ct) & 0x01U;
+    return v;
 }
 
 #define bytein_dec_macro(mqc, c, ct) \
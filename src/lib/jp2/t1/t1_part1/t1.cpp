@@ -68,6 +68,9 @@ namespace grk {
 #define T1_TYPE_MQ 0    /**< Normal coding using entropy coder */
 #define T1_TYPE_RAW 1   /**< No encoding the information is store under raw format
 							in code stream (mode switch RAW)*/
+/* smaller code blocks are always coded in full: their pass rates are
+ * too coarse to predict slopes of later passes */
+#define T1_EARLY_TERMINATION_MIN_AREA 1024
 
 #include "t1_luts.h"
 #define T1_FLAGS(x, y) (t1->flags[x + 1 + ((y>>2) + 1) * (t1->w+2)])
@@ -83,22 +86,22 @@ static INLINE void 		t1_update_flags(grk_flag *flagsp, uint32_t ci, uint32_t s,
 										uint32_t stride, uint32_t vsc);
 static INLINE void 		t1_dec_sigpass_step_raw(t1_info *t1, grk_flag *flagsp,
 												int32_t *datap, int32_t oneplushalf,
-												uint32_t vsc, uint32_t ci);
+												uint32_t vsc, uint32_t ci, uint32_t flags_stride);
 static INLINE void 		t1_dec_sigpass_step_mqc(t1_info *t1, grk_flag *flagsp,
 												int32_t *datap, int32_t oneplushalf, uint32_t ci,
 												uint32_t flags_stride, uint32_t vsc);
 static void 			t1_enc_sigpass(t1_info *t1, int32_t bpno, int32_t *nmsedec,
 										uint8_t type, uint32_t cblksty);
-static void 			t1_dec_sigpass_raw(t1_info *t1, int32_t bpno, int32_t cblksty);
 static void 			t1_enc_refpass(t1_info *t1, int32_t bpno, int32_t *nmsedec,
 										uint8_t type);
-static void 			t1_dec_refpass_raw(t1_info *t1, int32_t bpno);
-static INLINE void 		t1_dec_refpass_step_raw(t1_info *t1, grk_flag *flagsp,
-												int32_t *datap, int32_t poshalf, uint32_t ci);
+template<uint32_t height> void t1_dec_refpass_col_raw(t1_info *t1,
+												grk_flag *flagsp, int32_t *datap, uint32_t data_stride,
+												int32_t poshalf);
 static INLINE void 		t1_dec_refpass_step_mqc(t1_info *t1, grk_flag *flagsp,
 												int32_t *datap, int32_t poshalf, uint32_t ci);
 static void 			t1_dec_clnpass_step(t1_info *t1, grk_flag *flagsp, int32_t *datap,
-											int32_t oneplushalf, uint32_t ciorig, uint32_t ci, uint32_t vsc);
+											int32_t oneplushalf, uint32_t ciorig, uint32_t ci,
+											uint32_t flags_stride, uint32_t vsc);
 static void 			t1_enc_clnpass(t1_info *t1, int32_t bpno, int32_t *nmsedec,
 										uint32_t cblksty);
 static bool 			t1_code_block_enc_allocate(tcd_cblk_enc_t *p_code_block);
@@ -231,7 +234,8 @@ static INLINE void t1_enc_sigpass_step(t1_info *t1, grk_flag *flagsp,
 }
 
 static INLINE void t1_dec_sigpass_step_raw(t1_info *t1, grk_flag *flagsp,
-		int32_t *datap, int32_t oneplushalf, uint32_t vsc, uint32_t ci) {
+		int32_t *datap, int32_t oneplushalf, uint32_t vsc, uint32_t ci,
+		uint32_t flags_stride) {
 	uint32_t v;
 	auto mqc = &(t1->mqc);
 	uint32_t const flags = *flagsp;
@@ -241,7 +245,7 @@ static INLINE void t1_dec_sigpass_step_raw(t1_info *t1, grk_flag *flagsp,
 		if (mqc_raw_decode(mqc)) {
 			v = mqc_raw_decode(mqc);
 			*datap = v ? -oneplushalf : oneplushalf;
-			t1_update_flags(flagsp, ci, v, t1->w + 2, vsc);
+			t1_update_flags(flagsp, ci, v, flags_stride, vsc);
 		}
 		*flagsp |= T1_PI_THIS << (ci);
 	}
@@ -337,42 +341,53 @@ static void t1_enc_sigpass(t1_info *t1, int32_t bpno, int32_t *nmsedec,
 	}
 }
 
-static void t1_dec_sigpass_raw(t1_info *t1, int32_t bpno, int32_t cblksty) {
+/*
+ Decoding passes are templated on code block width and height, so that
+ loop bounds and flag stride are compile time constants for the common
+ block sizes. A zero width or height selects the run time block size.
+ */
+template<uint32_t w, uint32_t h, bool vsc> void t1_dec_sigpass_raw(
+		t1_info *t1, int32_t bpno) {
 	int32_t one, half, oneplushalf;
 	uint32_t i, j, k;
+	const uint32_t l_w = w ? w : t1->w;
+	const uint32_t l_h = h ? h : t1->h;
+	const uint32_t flags_stride = l_w + 2U;
 	auto data = t1->data;
-	auto flagsp = &T1_FLAGS(0, 0);
-	const uint32_t l_w = t1->w;
+	auto flagsp = &t1->flags[flags_stride + 1];
+
+	auto mqc = &(t1->mqc);
 
 	one = 1 << bpno;
 	half = one >> 1;
 	oneplushalf = one | half;
 
-	for (k = 0; k < (t1->h & ~3U); k += 4, flagsp += 2, data += 3 * l_w) {
+	// a stripe column consumes at most two raw bits per sample,
+	// so the bit buffer is refilled at most once per column
+	for (k = 0; k < (l_h & ~3U); k += 4, flagsp += 2, data += 3 * l_w) {
 		for (i = 0; i < l_w; ++i, ++flagsp, ++data) {
 			grk_flag flags = *flagsp;
 			if (flags != 0) {
+				if (mqc->raw_bits < 8)
+					mqc_raw_fill_dec(mqc);
 				t1_dec_sigpass_step_raw(t1, flagsp, data, oneplushalf,
-						cblksty & GRK_CBLKSTY_VSC, /* vsc */
-						0U);
+						vsc, 0U, flags_stride);
 				t1_dec_sigpass_step_raw(t1, flagsp, data + l_w, oneplushalf,
-						false, /* vsc */
-						3U);
+						false, 3U, flags_stride);
 				t1_dec_sigpass_step_raw(t1, flagsp, data + 2 * l_w, oneplushalf,
-						false, /* vsc */
-						6U);
+						false, 6U, flags_stride);
 				t1_dec_sigpass_step_raw(t1, flagsp, data + 3 * l_w, oneplushalf,
-						false, /* vsc */
-						9U);
+						false, 9U, flags_stride);
 			}
 		}
 	}
-	if (k < t1->h) {
+	if (k < l_h) {
 		for (i = 0; i < l_w; ++i, ++flagsp, ++data) {
-			for (j = 0; j < t1->h - k; ++j) {
+			if (mqc->raw_bits < 8)
+				mqc_raw_fill_dec(mqc);
+			for (j = 0; j < l_h - k; ++j) {
 				t1_dec_sigpass_step_raw(t1, flagsp, data + j * l_w, oneplushalf,
-						cblksty & GRK_CBLKSTY_VSC, /* vsc */
-						3*j);
+						vsc, 3*j, flags_stride);
 			}
 		}
 	}
@@ -423,21 +438,12 @@ static void t1_dec_sigpass_raw(t1_info *t1, int32_t bpno, int32_t cblksty) {
         } \
 }
 
-static void t1_dec_sigpass_mqc(t1_info *t1, int32_t bpno, int32_t cblksty) {
-	if (t1->w == 64 && t1->h == 64) {
-		if (cblksty & GRK_CBLKSTY_VSC){
-			t1_dec_sigpass_mqc_internal(t1, bpno, true, 64, 64, 66);
-		}
-		else {
-			t1_dec_sigpass_mqc_internal(t1, bpno, false, 64, 64, 66);
-		}
-	} else {
-		if (cblksty & GRK_CBLKSTY_VSC) {
-			t1_dec_sigpass_mqc_internal(t1, bpno, true, t1->w, t1->h, t1->w + 2U);
-		} else {
-			t1_dec_sigpass_mqc_internal(t1, bpno, false, t1->w, t1->h, t1->w + 2U);
-		}
-	}
+template<uint32_t w, uint32_t h, bool vsc> void t1_dec_sigpass_mqc(
+		t1_info *t1, int32_t bpno) {
+	// the pass macros declare their own l_w
+	const uint32_t blk_w = w ? w : t1->w;
+	const uint32_t blk_h = h ? h : t1->h;
+	t1_dec_sigpass_mqc_internal(t1, bpno, vsc, blk_w, blk_h, blk_w + 2U);
 }
 
 static INLINE void t1_enc_refpass_step(t1_info *t1, grk_flag *flagsp,
@@ -462,16 +468,29 @@ static INLINE void t1_enc_refpass_step(t1_info *t1, grk_flag *flagsp,
 	}
 }
 
-static INLINE void t1_dec_refpass_step_raw(t1_info *t1, grk_flag *flagsp,
-		int32_t *datap, int32_t poshalf, uint32_t ci) {
+/*
+ Raw refinement of the first height samples of a stripe column. Refinement
+ only changes the column's own flags, so they are read and written once.
+ */
+template<uint32_t height> void t1_dec_refpass_col_raw(t1_info *t1,
+		grk_flag *flagsp, int32_t *datap, uint32_t data_stride,
+		int32_t poshalf) {
 	auto mqc = &(t1->mqc);
-
-	if ((*flagsp & ((T1_SIGMA_THIS | T1_PI_THIS) << (ci)))
-			== (T1_SIGMA_THIS << (ci))) {
-		uint32_t v = mqc_raw_decode(mqc);
-		*datap += (v ^ (*datap < 0)) ? poshalf : -poshalf;
-		*flagsp |= T1_MU_THIS << (ci);
+	grk_flag flags = *flagsp;
+	grk_flag mu = 0;
+
+	if (mqc->raw_bits < height)
+		mqc_raw_fill_dec(mqc);
+	for (uint32_t j = 0; j < height; ++j, datap += data_stride) {
+		uint32_t ci = 3 * j;
+		if ((flags & ((T1_SIGMA_THIS | T1_PI_THIS) << ci))
+				== (T1_SIGMA_THIS << ci)) {
+			uint32_t v = mqc_raw_decode(mqc);
+			*datap += (v ^ (*datap < 0)) ? poshalf : -poshalf;
+			mu |= T1_MU_THIS << ci;
+		}
 	}
+	*flagsp = flags | mu;
 }
 
 #define t1_dec_refpass_step_mqc_macro(flags, data, data_stride, ciorig, ci, \
@@ -554,32 +573,36 @@ static void t1_enc_refpass(t1_info *t1, int32_t bpno, int32_t *nmsedec,
 	}
 }
 
-static void t1_dec_refpass_raw(t1_info *t1, int32_t bpno) {
+template<uint32_t w, uint32_t h> void t1_dec_refpass_raw(t1_info *t1,
+		int32_t bpno) {
 	int32_t one, poshalf;
-	uint32_t i, j, k;
+	uint32_t i, k;
+	const uint32_t l_w = w ? w : t1->w;
+	const uint32_t l_h = h ? h : t1->h;
 	auto data = t1->data;
-	auto flagsp = &T1_FLAGS(0, 0);
-	const uint32_t l_w = t1->w;
+	auto flagsp = &t1->flags[l_w + 3U];
 
 	one = 1 << bpno;
 	poshalf = one >> 1;
-	for (k = 0; k < (t1->h & ~3U); k += 4, flagsp += 2, data += 3 * l_w) {
+	for (k = 0; k < (l_h & ~3U); k += 4, flagsp += 2, data += 3 * l_w) {
 		for (i = 0; i < l_w; ++i, ++flagsp, ++data) {
-			grk_flag flags = *flagsp;
-			if (flags != 0) {
-				t1_dec_refpass_step_raw(t1, flagsp, data, poshalf, 0U);
-				t1_dec_refpass_step_raw(t1, flagsp, data + l_w, poshalf, 3U);
-				t1_dec_refpass_step_raw(t1, flagsp, data + 2 * l_w, poshalf,
-						6U);
-				t1_dec_refpass_step_raw(t1, flagsp, data + 3 * l_w, poshalf,
-						9U);
-			}
+			// skip columns with no significant sample
+			if (*flagsp & (T1_SIGMA_4 | T1_SIGMA_7 | T1_SIGMA_10 | T1_SIGMA_13))
+				t1_dec_refpass_col_raw<4>(t1, flagsp, data, l_w, poshalf);
 		}
 	}
-	if (k < t1->h) {
+	if (k < l_h) {
 		for (i = 0; i < l_w; ++i, ++flagsp, ++data) {
-			for (j = 0; j < t1->h - k; ++j) {
-				t1_dec_refpass_step_raw(t1, flagsp, data + j * l_w, poshalf, 3*j);
+			switch (l_h - k) {
+			case 1:
+				t1_dec_refpass_col_raw<1>(t1, flagsp, data, l_w, poshalf);
+				break;
+			case 2:
+				t1_dec_refpass_col_raw<2>(t1, flagsp, data, l_w, poshalf);
+				break;
+			case 3:
+				t1_dec_refpass_col_raw<3>(t1, flagsp, data, l_w, poshalf);
+				break;
 			}
 		}
 	}
@@ -628,12 +651,11 @@ static void t1_dec_refpass_raw(t1_info *t1, int32_t bpno) {
         } \
 }
 
-static void t1_dec_refpass_mqc(t1_info *t1, int32_t bpno) {
-	if (t1->w == 64 && t1->h == 64) {
-		t1_dec_refpass_mqc_internal(t1, bpno, 64, 64, 66);
-	} else {
-		t1_dec_refpass_mqc_internal(t1, bpno, t1->w, t1->h, t1->w + 2U);
-	}
+template<uint32_t w, uint32_t h> void t1_dec_refpass_mqc(t1_info *t1,
+		int32_t bpno) {
+	const uint32_t blk_w = w ? w : t1->w;
+	const uint32_t blk_h = h ? h : t1->h;
+	t1_dec_refpass_mqc_internal(t1, bpno, blk_w, blk_h, blk_w + 2U);
 }
 
 static void t1_enc_clnpass_step(t1_info *t1, grk_flag *flagsp, int32_t *datap,
@@ -727,11 +749,12 @@ static void t1_enc_clnpass_step(t1_info *t1, grk_flag *flagsp, int32_t *datap,
 }
 
 static void t1_dec_clnpass_step(t1_info *t1, grk_flag *flagsp, int32_t *datap,
-		int32_t oneplushalf, uint32_t ciorig, uint32_t ci, uint32_t vsc) {
+		int32_t oneplushalf, uint32_t ciorig, uint32_t ci, uint32_t flags_stride,
+		uint32_t vsc) {
 	uint32_t v;
 	auto mqc = &(t1->mqc);
 
-	t1_dec_clnpass_step_macro(true, false, *flagsp, flagsp, t1->w + 2U, datap,
+	t1_dec_clnpass_step_macro(true, false, *flagsp, flagsp, flags_stride, datap,
 			0, ciorig, ci, mqc, mqc->curctx, v, mqc->a, mqc->c, mqc->ct, oneplushalf,
 			vsc);
 }
@@ -863,7 +886,8 @@ static void t1_enc_clnpass(t1_info *t1, int32_t bpno, int32_t *nmsedec,	uint32_t
     if( k < h ) { \
         for (i = 0; i < l_w; ++i, ++flagsp, ++data) { \
             for (j = 0; j < h - k; ++j) \
-                t1_dec_clnpass_step(t1, flagsp, data + j * l_w, oneplushalf, j, 3*j, vsc); \
+                t1_dec_clnpass_step(t1, flagsp, data + j * l_w, oneplushalf, j, 3*j, \
+                                    flags_stride, vsc); \
             *flagsp &= ~(T1_PI_0 | T1_PI_1 | T1_PI_2 | T1_PI_3); \
         } \
     } \
@@ -888,24 +912,11 @@ static void t1_dec_clnpass_check_segsym(t1_info *t1, int32_t cblksty) {
 	}
 }
 
-template <uint32_t w, uint32_t h, bool vsc> void t1_dec_clnpass(t1_info *t1, int32_t bpno) {
-	t1_dec_clnpass_internal(t1, bpno, vsc, w, h, w+2);
-}
-
-static void t1_dec_clnpass(t1_info *t1, int32_t bpno, int32_t cblksty) {
-	if (t1->w == 64 && t1->h == 64) {
-		if (cblksty & GRK_CBLKSTY_VSC)
-			t1_dec_clnpass<64,64,true>(t1, bpno);
-		else
-			t1_dec_clnpass<64,64,false>(t1, bpno);
-	} else {
-		if (cblksty & GRK_CBLKSTY_VSC){
-			t1_dec_clnpass_internal(t1, bpno, true,t1->w,t1->h,t1->w+2);
-		}
-		else {
-			t1_dec_clnpass_internal(t1, bpno, false,t1->w,t1->h,t1->w+2);
-		}
-	}
+template<uint32_t w, uint32_t h, bool vsc> void t1_dec_clnpass(t1_info *t1,
+		int32_t bpno, int32_t cblksty) {
+	const uint32_t blk_w = w ? w : t1->w;
+	const uint32_t blk_h = h ? h : t1->h;
+	t1_dec_clnpass_internal(t1, bpno, vsc, blk_w, blk_h, blk_w + 2U);
 	t1_dec_clnpass_check_segsym(t1, cblksty);
 }
 
@@ -1035,35 +1046,18 @@ void t1_destroy(t1_info *p_t1) {
 	grk::grok_free(p_t1);
 }
 
-bool t1_decode_cblk(t1_info *t1, tcd_cblk_dec_t *cblk, uint32_t orient,
-		uint32_t roishift, uint32_t cblksty, bool check_pterm) {
+/*
+ Decode all segments of a code block
+ */
+template<uint32_t w, uint32_t h, bool vsc> void t1_dec_passes(t1_info *t1,
+		tcd_cblk_dec_t *cblk, uint32_t cblksty, int32_t bpno_plus_one) {
 	auto mqc = &(t1->mqc);
-	int32_t bpno_plus_one;
-	uint32_t passtype;
-	uint32_t segno, passno;
-	uint8_t *cblkdata = nullptr;
+	uint32_t passtype = 2;
+	uint8_t *cblkdata = cblk->chunks[0].data;
 	uint32_t cblkdataindex = 0;
 	uint8_t type = T1_TYPE_MQ;
 
-	mqc->lut_ctxno_zc_orient = lut_ctxno_zc + (orient << 9);
-
-	if (!t1_allocate_buffers(t1, (uint32_t) (cblk->x1 - cblk->x0),
-							(uint32_t) (cblk->y1 - cblk->y0)))
-		return false;
-
-
-	bpno_plus_one = (int32_t) (roishift + cblk->numbps);
-	if (bpno_plus_one >= 31) {
-		grk::GROK_ERROR("unsupported bpno_plus_one = %d >= 31",
-				bpno_plus_one);
-		return false;
-	}
-	passtype = 2;
-
-	mqc_resetstates(mqc);
-	cblkdata = cblk->chunks[0].data;
-
-	for (segno = 0; segno < cblk->real_num_segs; ++segno) {
+	for (uint32_t segno = 0; segno < cblk->real_num_segs; ++segno) {
 		auto seg = cblk->segs + segno;
 
 		/* BYPASS mode */
@@ -1080,24 +1074,24 @@ bool t1_decode_cblk(t1_info *t1, tcd_cblk_dec_t *cblk, uint32_t orient,
 		}
 		cblkdataindex += seg->len;
 
-		for (passno = 0;
+		for (uint32_t passno = 0;
 				(passno < seg->real_num_passes) && (bpno_plus_one >= 1);
 				++passno) {
 			switch (passtype) {
 			case 0:
 				if (type == T1_TYPE_RAW)
-					t1_dec_sigpass_raw(t1, bpno_plus_one, (int32_t) cblksty);
+					t1_dec_sigpass_raw<w, h, vsc>(t1, bpno_plus_one);
 				else
-					t1_dec_sigpass_mqc(t1, bpno_plus_one, (int32_t) cblksty);
+					t1_dec_sigpass_mqc<w, h, vsc>(t1, bpno_plus_one);
 				break;
 			case 1:
 				if (type == T1_TYPE_RAW)
-					t1_dec_refpass_raw(t1, bpno_plus_one);
+					t1_dec_refpass_raw<w, h>(t1, bpno_plus_one);
 				else
-					t1_dec_refpass_mqc(t1, bpno_plus_one);
+					t1_dec_refpass_mqc<w, h>(t1, bpno_plus_one);
 				break;
 			case 2:
-				t1_dec_clnpass(t1, bpno_plus_one, (int32_t) cblksty);
+				t1_dec_clnpass<w, h, vsc>(t1, bpno_plus_one, (int32_t) cblksty);
 				break;
 			}
 
@@ -1111,6 +1105,48 @@ bool t1_decode_cblk(t1_info *t1, tcd_cblk_dec_t *cblk, uint32_t orient,
 
 		opq_mqc_finish_dec(mqc);
 	}
+}
+
+template<uint32_t w, uint32_t h> void t1_dec_passes(t1_info *t1,
+		tcd_cblk_dec_t *cblk, uint32_t cblksty, int32_t bpno_plus_one) {
+	if (cblksty & GRK_CBLKSTY_VSC)
+		t1_dec_passes<w, h, true>(t1, cblk, cblksty, bpno_plus_one);
+	else
+		t1_dec_passes<w, h, false>(t1, cblk, cblksty, bpno_plus_one);
+}
+
+bool t1_decode_cblk(t1_info *t1, tcd_cblk_dec_t *cblk, uint32_t orient,
+		uint32_t roishift, uint32_t cblksty, bool check_pterm) {
+	auto mqc = &(t1->mqc);
+	int32_t bpno_plus_one;
+
+	mqc->lut_ctxno_zc_orient = lut_ctxno_zc + (orient << 9);
+
+	if (!t1_allocate_buffers(t1, (uint32_t) (cblk->x1 - cblk->x0),
+							(uint32_t) (cblk->y1 - cblk->y0)))
+		return false;
+
+
+	bpno_plus_one = (int32_t) (roishift + cblk->numbps);
+	if (bpno_plus_one >= 31) {
+		grk::GROK_ERROR("unsupported bpno_plus_one = %d >= 31",
+				bpno_plus_one);
+		return false;
+	}
+
+	mqc_resetstates(mqc);
+
+	// select passes specialised for code block size
+	if (t1->w == 64 && t1->h == 64)
+		t1_dec_passes<64, 64>(t1, cblk, cblksty, bpno_plus_one);
+	else if (t1->w == 32 && t1->h == 32)
+		t1_dec_passes<32, 32>(t1, cblk, cblksty, bpno_plus_one);
+	else if (t1->w == 64 && t1->h == 32)
+		t1_dec_passes<64, 32>(t1, cblk, cblksty, bpno_plus_one);
+	else if (t1->w == 32 && t1->h == 64)
+		t1_dec_passes<32, 64>(t1, cblk, cblksty, bpno_plus_one);
+	else
+		t1_dec_passes<0, 0>(t1, cblk, cblksty, bpno_plus_one);
 
 	if (check_pterm) {
 		if (mqc->bp + 2 < mqc->end) {
@@ -1178,7 +1214,8 @@ static bool t1_code_block_enc_allocate(tcd_cblk_enc_t *p_code_block) {
 double t1_encode_cblk(t1_info *t1, tcd_cblk_enc_t *cblk, uint32_t max,
 					uint8_t orient, uint32_t compno, uint32_t level, uint32_t qmfbid,
 					double stepsize, uint32_t cblksty,
-					const double *mct_norms, uint32_t mct_numcomps, bool doRateControl) {
+					const double *mct_norms, uint32_t mct_numcomps, bool doRateControl,
+					double min_slope) {
 	if (!t1_code_block_enc_allocate(cblk))
 		return 0;
 
@@ -1214,6 +1251,23 @@ double t1_encode_cblk(t1_info *t1, tcd_cblk_enc_t *cblk, uint32_t max,
 	mqc_init_enc(mqc, cblk->data);
 
 	double cumwmsedec = 0.0;
+	/* early termination: coding stops at the end of a bit plane when
+	 * removing all of the distortion left in the block, at the cost of
+	 * that bit plane's bytes, would still give a slope below min_slope.
+	 * blockwmse is the weighted distortion of the uncoded block */
+	double blockwmse = 0.0;
+	int32_t plane_rate = 0;
+	if (doRateControl && min_slope > 0
+			&& t1->w * t1->h >= T1_EARLY_TERMINATION_MIN_AREA) {
+		double energy = 0;
+		for (uint32_t i = 0; i < t1->w * t1->h; ++i) {
+			double val = t1->data[i];
+			energy += val * val;
+		}
+		blockwmse = t1_getwmsedec(1, compno, level, orient, 0, qmfbid,
+				stepsize, mct_norms, mct_numcomps) * 8192.0 * energy
+				/ (double) (1 << (2 * T1_NMSEDEC_FRACBITS));
+	}
 	for (passno = 0; bpno >= 0; ++passno) {
 		tcd_pass_t *pass = &cblk->passes[passno];
 		type = ((bpno < ((int32_t) (cblk->numbps) - 4)) &&
@@ -1249,7 +1303,17 @@ double t1_encode_cblk(t1_info *t1, tcd_cblk_enc_t *cblk, uint32_t max,
 			pass->distortiondec = cumwmsedec;
 		}
 
-		if (t1_enc_is_term_pass(cblk, cblksty, bpno, passtype)) {
+		bool last_pass = false;
+		if (blockwmse > 0 && passtype == 2 && bpno > 0) {
+			auto rate = (int32_t) mqc_numbytes_enc(mqc);
+			if (rate > plane_rate) {
+				last_pass = (blockwmse - cumwmsedec) / (rate - plane_rate)
+						< min_slope;
+				plane_rate = rate;
+			}
+		}
+
+		if (last_pass || t1_enc_is_term_pass(cblk, cblksty, bpno, passtype)) {
 			/* If it is a terminated pass, terminate it */
 			if (type == T1_TYPE_RAW) {
 				mqc_bypass_flush_enc(mqc, cblksty & GRK_CBLKSTY_PTERM);
@@ -1288,6 +1352,8 @@ double t1_encode_cblk(t1_info *t1, tcd_cblk_enc_t *cblk, uint32_t max,
 			passtype = 0;
 			bpno--;
 		}
+		if (last_pass)
+			bpno = -1;
 
 		/* Code-switch "RESET" */
 		if (cblksty & GRK_CBLKSTY_RESET)
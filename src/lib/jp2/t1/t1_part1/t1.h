@@ -210,7 +210,7 @@ double t1_encode_cblk(t1_info *t1, tcd_cblk_enc_t *cblk,
 		uint8_t orient, uint32_t compno, uint32_t level,
 		uint32_t qmfbid, double stepsize, uint32_t cblksty,
 		const double *mct_norms,
-		uint32_t mct_numcomps, bool doRateControl);
+		uint32_t mct_numcomps, bool doRateControl, double min_slope);
 
 t1_info* t1_create(bool isEncoder);
 void t1_destroy(t1_info *p_t1);
@@ -0,0 +1,236 @@
+/*
+ *    Copyright (C) 2016-2020 Grok Image Compression Inc.
+ *
+ *    This source code is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This source code is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include "grok_includes.h"
+#include "PrecinctIndex.h"
+
+namespace grk {
+
+PrecinctIndex::PrecinctIndex(TileProcessor *tileProc) :
+		tileProcessor(tileProc), m_numcomps(0), m_numres(0), m_numlayers(0), m_direct(
+				false), m_num_packets(0) {
+}
+
+uint64_t PrecinctIndex::num_precincts(uint32_t compno, uint32_t resno) const {
+	auto tilec = tileProcessor->tile->comps + compno;
+	if (resno >= tilec->numresolutions)
+		return 0;
+	auto res = tilec->resolutions + resno;
+
+	return (uint64_t) res->pw * res->ph;
+}
+
+bool PrecinctIndex::uniform_components(TileCodingParams *tcp) const {
+	auto image = tileProcessor->image;
+	auto tile = tileProcessor->tile;
+	auto tccps = tcp->tccps;
+	for (uint32_t compno = 1; compno < m_numcomps; ++compno) {
+		if (image->comps[compno].dx != image->comps[0].dx
+				|| image->comps[compno].dy != image->comps[0].dy)
+			return false;
+		if (tile->comps[compno].numresolutions != tile->comps[0].numresolutions)
+			return false;
+		for (uint32_t resno = 0; resno < tile->comps[0].numresolutions;
+				++resno) {
+			if (tccps[compno].prcw[resno] != tccps[0].prcw[resno]
+					|| tccps[compno].prch[resno] != tccps[0].prch[resno])
+				return false;
+		}
+	}
+
+	return true;
+}
+
+bool PrecinctIndex::build(uint16_t tile_no, PacketLengthMarkers *markers) {
+	if (!markers)
+		return false;
+	auto cp = tileProcessor->m_cp;
+	auto tcp = cp->tcps + tile_no;
+
+	// packet headers stored in PPM/PPT markers must be read sequentially
+	if (cp->ppm || tcp->ppt)
+		return false;
+
+	m_numcomps = tileProcessor->image->numcomps;
+	m_numlayers = tcp->numlayers;
+	m_numres = 0;
+	for (uint32_t compno = 0; compno < m_numcomps; ++compno)
+		m_numres = std::max<uint32_t>(m_numres,
+				tileProcessor->tile->comps[compno].numresolutions);
+	if (!m_numcomps || !m_numres || !m_numlayers)
+		return false;
+
+	m_direct = !tcp->POC && tcp->numpocs == 0 && build_direct(tcp);
+	if (!m_direct && !build_from_iterator(tile_no))
+		return false;
+
+	// packet offsets
+	m_offsets.clear();
+	m_offsets.reserve(m_num_packets + 1);
+	m_offsets.push_back(0);
+	markers->getInit();
+	uint32_t len = 0;
+	while ((len = markers->getNext()) != 0)
+		m_offsets.push_back(m_offsets.back() + len);
+
+	if (m_offsets.size() - 1 != m_num_packets) {
+		GROK_WARN(
+				"Number of PLT packet lengths (%llu) does not match number of packets (%llu)."
+				" Disabling precinct random access.",
+				(unsigned long long) (m_offsets.size() - 1),
+				(unsigned long long) m_num_packets);
+		return false;
+	}
+
+	return true;
+}
+
+bool PrecinctIndex::build_direct(TileCodingParams *tcp) {
+	m_res_base.assign(m_numres, 0);
+	m_layer_stride.assign(m_numres, 0);
+	m_prec_stride.assign(m_numres, 1);
+	m_comp_offset.assign((size_t) m_numcomps * m_numres, 0);
+
+	// number of precincts of all components, per resolution
+	std::vector<uint64_t> res_precincts(m_numres, 0);
+	uint64_t total_precincts = 0;
+	for (uint32_t resno = 0; resno < m_numres; ++resno) {
+		for (uint32_t compno = 0; compno < m_numcomps; ++compno) {
+			m_comp_offset[(size_t) compno * m_numres + resno] =
+					res_precincts[resno];
+			res_precincts[resno] += num_precincts(compno, resno);
+		}
+		total_precincts += res_precincts[resno];
+	}
+	m_num_packets = total_precincts * m_numlayers;
+
+	uint64_t base = 0;
+	switch (tcp->prg) {
+	case GRK_LRCP:
+		for (uint32_t resno = 0; resno < m_numres; ++resno) {
+			m_res_base[resno] = base;
+			m_layer_stride[resno] = total_precincts;
+			base += res_precincts[resno];
+		}
+		break;
+	case GRK_RLCP:
+		for (uint32_t resno = 0; resno < m_numres; ++resno) {
+			m_res_base[resno] = base;
+			m_layer_stride[resno] = res_precincts[resno];
+			base += res_precincts[resno] * m_numlayers;
+		}
+		break;
+	case GRK_RPCL:
+		if (!uniform_components(tcp))
+			return false;
+		for (uint32_t resno = 0; resno < m_numres; ++resno) {
+			m_res_base[resno] = base;
+			m_layer_stride[resno] = 1;
+			m_prec_stride[resno] = (uint64_t) m_numcomps * m_numlayers;
+			for (uint32_t compno = 0; compno < m_numcomps; ++compno)
+				m_comp_offset[(size_t) compno * m_numres + resno] =
+						(uint64_t) compno * m_numlayers;
+			base += res_precincts[resno] * m_numlayers;
+		}
+		break;
+	default:
+		return false;
+	}
+
+	return true;
+}
+
+bool PrecinctIndex::build_from_iterator(uint16_t tile_no) {
+	auto tcp = tileProcessor->m_cp->tcps + tile_no;
+	uint32_t nb_pocs = tcp->numpocs + 1;
+
+	m_flat_base.assign((size_t) m_numcomps * m_numres, 0);
+	uint64_t total = 0;
+	for (uint32_t compno = 0; compno < m_numcomps; ++compno) {
+		for (uint32_t resno = 0; resno < m_numres; ++resno) {
+			m_flat_base[(size_t) compno * m_numres + resno] = total;
+			total += num_precincts(compno, resno) * m_numlayers;
+		}
+	}
+	m_sequence.assign(total, precinct_index_no_packet);
+
+	auto pi = pi_create_decode(tileProcessor->image, tileProcessor->m_cp,
+			tile_no);
+	if (!pi)
+		return false;
+	uint64_t seq = 0;
+	bool rc = true;
+	for (uint32_t pino = 0; pino <= tcp->numpocs && rc; ++pino) {
+		auto current_pi = pi + pino;
+		if (current_pi->poc.prg == GRK_PROG_UNKNOWN) {
+			rc = false;
+			break;
+		}
+		while (pi_next(current_pi)) {
+			if (current_pi->compno >= m_numcomps
+					|| current_pi->resno >= m_numres
+					|| current_pi->layno >= m_numlayers
+					|| current_pi->precno
+							>= num_precincts(current_pi->compno,
+									current_pi->resno)) {
+				rc = false;
+				break;
+			}
+			m_sequence[m_flat_base[(size_t) current_pi->compno * m_numres
+					+ current_pi->resno]
+					+ current_pi->precno * m_numlayers + current_pi->layno] =
+					seq++;
+		}
+	}
+	pi_destroy(pi, nb_pocs);
+	if (!rc) {
+		m_sequence.clear();
+		return false;
+	}
+	m_num_packets = seq;
+
+	return true;
+}
+
+uint64_t PrecinctIndex::num_packets(void) const {
+	return m_num_packets;
+}
+
+uint64_t PrecinctIndex::sequence(uint32_t compno, uint32_t resno,
+		uint64_t precno, uint32_t layno) const {
+	if (compno >= m_numcomps || resno >= m_numres || layno >= m_numlayers
+			|| precno >= num_precincts(compno, resno))
+		return precinct_index_no_packet;
+	if (m_direct)
+		return m_res_base[resno] + layno * m_layer_stride[resno]
+				+ m_comp_offset[(size_t) compno * m_numres + resno]
+				+ precno * m_prec_stride[resno];
+
+	return m_sequence[m_flat_base[(size_t) compno * m_numres + resno]
+			+ precno * m_numlayers + layno];
+}
+
+uint64_t PrecinctIndex::offset(uint64_t seq) const {
+	assert(seq < m_offsets.size());
+	return m_offsets[seq];
+}
+
+uint64_t PrecinctIndex::length(uint64_t seq) const {
+	assert(seq + 1 < m_offsets.size());
+	return m_offsets[seq + 1] - m_offsets[seq];
+}
+
+}
@@ -0,0 +1,99 @@
+/*
+ *    Copyright (C) 2016-2020 Grok Image Compression Inc.
+ *
+ *    This source code is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This source code is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+#include <vector>
+
+namespace grk {
+
+// sequence number returned for packets that are not present in the index
+const uint64_t precinct_index_no_packet = (uint64_t) -1;
+
+/*  PrecinctIndex
+
+ Random access table for the packets of a tile, built from PLT packet lengths.
+
+ For each packet (layer, resolution, component, precinct), the index stores
+ its position in the progression order, and the byte offset of the packet
+ relative to the beginning of the tile data.
+
+ For LRCP and RLCP progressions, and for RPCL progressions when all components
+ share the same sub-sampling, precinct partition and number of resolutions,
+ the packet sequence number is computed directly from the packet coordinates.
+ For all other progressions (including progression order changes),
+ the sequence is recorded in a single walk of the packet iterator.
+
+ */
+struct PrecinctIndex {
+	PrecinctIndex(TileProcessor *tileProc);
+
+	/*
+	 Build index for tile, using packet lengths from PLT markers.
+	 Returns false if index cannot be built, in which case the
+	 packets must be decoded sequentially.
+	 */
+	bool build(uint16_t tile_no, PacketLengthMarkers *markers);
+
+	/*
+	 Get sequence number of packet in progression order
+	 */
+	uint64_t sequence(uint32_t compno, uint32_t resno, uint64_t precno,
+			uint32_t layno) const;
+
+	/*
+	 Get byte offset of packet, relative to beginning of tile data
+	 */
+	uint64_t offset(uint64_t seq) const;
+
+	/*
+	 Get length of packet, in bytes
+	 */
+	uint64_t length(uint64_t seq) const;
+
+	uint64_t num_packets(void) const;
+
+private:
+	bool build_direct(TileCodingParams *tcp);
+	bool build_from_iterator(uint16_t tile_no);
+	uint64_t num_precincts(uint32_t compno, uint32_t resno) const;
+	bool uniform_components(TileCodingParams *tcp) const;
+
+	TileProcessor *tileProcessor;
+	uint32_t m_numcomps;
+	uint32_t m_numres;
+	uint32_t m_numlayers;
+	bool m_direct;
+	uint64_t m_num_packets;
+
+	// direct computation:
+	// seq = res_base[r] + l * layer_stride[r] + comp_offset[c,r] + p * prec_stride[r]
+	std::vector<uint64_t> m_res_base;
+	std::vector<uint64_t> m_layer_stride;
+	std::vector<uint64_t> m_prec_stride;
+	std::vector<uint64_t> m_comp_offset;
+
+	// recorded sequence:
+	// seq = m_sequence[m_flat_base[c,r] + p * num_layers + l]
+	std::vector<uint64_t> m_flat_base;
+	std::vector<uint64_t> m_sequence;
+
+	// offset of packet i is m_offsets[i], and m_offsets[num_packets]
+	// is the total length of all packets
+	std::vector<uint64_t> m_offsets;
+};
+
+}
@@ -57,6 +57,7 @@
 #include "grok_includes.h"
 #include "testing.h"
 #include <memory>
+#include <map>
 
 //#define DEBUG_ENCODE_PACKETS
 
@@ -90,8 +91,11 @@ bool T2::encode_packets(uint16_t tile_no, uint32_t max_layers,
 		if (current_pi->layno < max_layers) {
 			nb_bytes = 0;
 
-			if (!encode_packet(tile_no, tcp, current_pi, stream, &nb_bytes,
-					cstr_info)) {
+			bool rc = tileProcessor->m_packets ?
+					rewrite_packet(tcp, current_pi, stream, &nb_bytes) :
+					encode_packet(tile_no, tcp, current_pi, stream, &nb_bytes,
+							cstr_info);
+			if (!rc) {
 				pi_destroy(pi, nb_pocs);
 				return false;
 			}
@@ -195,6 +199,47 @@ bool T2::encode_packets_simulate(uint16_t tile_no, uint32_t max_layers,
 	pi_destroy(pi, nb_pocs);
 	return true;
 }
+/*
+ Segments of a code block before its first packet above the layer limit.
+ The headers of those packets are read, to find where the next packet
+ starts, and their passes are added to the segments. They have no data
+ to decode, so the segments are restored once all packets are read
+ */
+struct DecodedSegments {
+	uint32_t numSegments;
+	uint32_t numpasses; // passes in last segment
+};
+typedef std::map<grk_tcd_cblk_dec*, DecodedSegments> DecodedSegmentsMap;
+
+static void save_decoded_segments(grk_tcd_resolution *res, PacketIter *pi,
+		DecodedSegmentsMap *saved) {
+	for (uint32_t bandno = 0; bandno < res->numbands; ++bandno) {
+		auto band = res->bands + bandno;
+		if (band->isEmpty())
+			continue;
+		auto prc = band->precincts + pi->precno;
+		for (uint64_t cblkno = 0; cblkno < (uint64_t) prc->cw * prc->ch;
+				++cblkno) {
+			auto cblk = prc->cblks.dec + cblkno;
+			uint32_t numpasses =
+					cblk->numSegments ?
+							cblk->segs[cblk->numSegments - 1].numpasses : 0;
+			// only the first packet above the limit is saved
+			saved->emplace(cblk,
+					DecodedSegments { cblk->numSegments, numpasses });
+		}
+	}
+}
+
+static void restore_decoded_segments(const DecodedSegmentsMap &saved) {
+	for (auto &s : saved) {
+		auto cblk = s.first;
+		cblk->numSegments = s.second.numSegments;
+		if (cblk->numSegments)
+			cblk->segs[cblk->numSegments - 1].numpasses = s.second.numpasses;
+	}
+}
+
 bool T2::decode_packets(uint16_t tile_no, ChunkBuffer *src_buf,
 		uint64_t *p_data_read) {
 
@@ -203,17 +248,35 @@ bool T2::decode_packets(uint16_t tile_no, ChunkBuffer *src_buf,
 	auto tcp = cp->tcps + tile_no;
 	auto p_tile = tileProcessor->tile;
 	uint32_t nb_pocs = tcp->numpocs + 1;
-	auto pi = pi_create_decode(image, cp, tile_no);
-	if (!pi)
-		return false;
 
 	auto packetLengths = tileProcessor->plt_markers;
 	// we don't currently support PLM markers,
 	// so we disable packet length markers if we have both PLT and PLM
 	bool usePlt = packetLengths && !cp->plm_markers;
+
+	// with a byte budget, packets are decoded in progression order
+	// until the first packet that does not fit in the budget
+	uint64_t max_bytes = tileProcessor->m_max_bytes;
+	bool limited = max_bytes != UINT64_MAX;
+	uint64_t decoded_bytes = 0;
+	bool budget_reached = false;
+	DecodedSegmentsMap decoded_segments;
+
+	// for region decode, jump directly to the packets of the
+	// precincts that intersect the region
+	if (usePlt && !tileProcessor->whole_tile_decoding && !limited) {
+		PrecinctIndex index(tileProcessor);
+		if (index.build(tile_no, packetLengths))
+			return decode_packets_random_access(tile_no, src_buf, p_data_read,
+					&index);
+	}
+
+	auto pi = pi_create_decode(image, cp, tile_no);
+	if (!pi)
+		return false;
 	if (usePlt)
 		packetLengths->getInit();
-	for (uint32_t pino = 0; pino <= tcp->numpocs; ++pino) {
+	for (uint32_t pino = 0; pino <= tcp->numpocs && !budget_reached; ++pino) {
 		/* if the resolution needed is too low, one dim of the tilec could be equal to zero
 		 * and no packets are used to decode this resolution and
 		 * l_current_pi->resno is always >= p_tile->comps[l_current_pi->compno].minimum_num_resolutions
@@ -241,6 +304,18 @@ bool T2::decode_packets(uint16_t tile_no, ChunkBuffer *src_buf,
 			if (usePlt)
 				pltMarkerLen = packetLengths->getNext();
 
+			if (tileProcessor->m_packets) {
+				uint64_t nb_bytes_read = 0;
+				if (!copy_packet(tcp, current_pi, src_buf, pltMarkerLen,
+						&nb_bytes_read)) {
+					pi_destroy(pi, nb_pocs);
+					delete[] first_pass_failed;
+					return false;
+				}
+				*p_data_read += nb_bytes_read;
+				continue;
+			}
+
 			/*
 			 GROK_INFO(
 			 "packet prg=%d cmptno=%02d rlvlno=%02d prcno=%03d layrno=%02d\n",
@@ -271,13 +346,31 @@ bool T2::decode_packets(uint16_t tile_no, ChunkBuffer *src_buf,
 				 current_pi->compno, current_pi->resno,
 				 current_pi->precno, current_pi->layno, skip_the_packet ? "skipped" : "kept");
 				 */
-				first_pass_failed[current_pi->compno] = false;
-
-				if (!decode_packet(tcp, current_pi, src_buf, &nb_bytes_read)) {
+				uint64_t remaining = max_bytes - decoded_bytes;
+				bool decoded = true;
+				if (limited && !pltMarkerLen) {
+					size_t offset = src_buf->get_global_offset();
+					if (!decode_packet_if_complete(tcp, current_pi, src_buf,
+							false, remaining, &decoded)) {
+						pi_destroy(pi, nb_pocs);
+						delete[] first_pass_failed;
+						return false;
+					}
+					nb_bytes_read = src_buf->get_global_offset() - offset;
+				} else if (pltMarkerLen > remaining) {
+					decoded = false;
+				} else if (!decode_packet(tcp, current_pi, src_buf,
+						&nb_bytes_read)) {
 					pi_destroy(pi, nb_pocs);
 					delete[] first_pass_failed;
 					return false;
 				}
+				if (!decoded) {
+					budget_reached = true;
+					break;
+				}
+				decoded_bytes += nb_bytes_read;
+				first_pass_failed[current_pi->compno] = false;
 
 				img_comp->resno_decoded = std::max<uint32_t>(current_pi->resno,
 						img_comp->resno_decoded);
@@ -286,11 +379,18 @@ bool T2::decode_packets(uint16_t tile_no, ChunkBuffer *src_buf,
 				if (pltMarkerLen) {
 					nb_bytes_read = pltMarkerLen;
 					src_buf->incr_cur_chunk_offset(nb_bytes_read);
-				} else if (!skip_packet(tcp, current_pi, src_buf,
-						&nb_bytes_read)) {
-					pi_destroy(pi, nb_pocs);
-					delete[] first_pass_failed;
-					return false;
+				} else {
+					if (current_pi->layno >= tcp->num_layers_to_decode
+							&& current_pi->resno < tilec->minimum_num_resolutions)
+						save_decoded_segments(
+								tilec->resolutions + current_pi->resno,
+								current_pi, &decoded_segments);
+					if (!skip_packet(tcp, current_pi, src_buf,
+							&nb_bytes_read)) {
+						pi_destroy(pi, nb_pocs);
+						delete[] first_pass_failed;
+						return false;
+					}
 				}
 			}
 
@@ -309,11 +409,119 @@ bool T2::decode_packets(uint16_t tile_no, ChunkBuffer *src_buf,
 		delete[] first_pass_failed;
 	}
 	pi_destroy(pi, nb_pocs);
+	restore_decoded_segments(decoded_segments);
+
+	// packets that did not fit in the budget are treated as empty,
+	// so the image is still reconstructed at the requested resolution
+	if (budget_reached) {
+		for (uint32_t compno = 0; compno < image->numcomps; ++compno)
+			image->comps[compno].resno_decoded =
+					p_tile->comps[compno].minimum_num_resolutions - 1;
+	}
+
+	return true;
+}
+
+bool T2::decode_packets_random_access(uint16_t tile_no, ChunkBuffer *src_buf,
+		uint64_t *p_data_read, PrecinctIndex *index) {
+	auto cp = tileProcessor->m_cp;
+	auto image = tileProcessor->image;
+	auto tcp = cp->tcps + tile_no;
+	auto p_tile = tileProcessor->tile;
+	uint32_t num_layers = std::min<uint32_t>(tcp->num_layers_to_decode,
+			tcp->numlayers);
+
+	PacketIter pi;
+	memset(&pi, 0, sizeof(PacketIter));
+	pi.poc.prg1 = tcp->prg;
+	for (uint32_t compno = 0; compno < image->numcomps; ++compno) {
+		auto tilec = p_tile->comps + compno;
+		auto img_comp = image->comps + compno;
+		bool decoded = false;
+		pi.compno = compno;
+		for (uint32_t resno = 0; resno < tilec->minimum_num_resolutions;
+				++resno) {
+			auto res = tilec->resolutions + resno;
+			if (!res->pw || !res->ph)
+				continue;
+			pi.resno = resno;
+
+			// Precincts form a grid, so the x extent of a precinct only depends
+			// on its column, and the y extent only depends on its row. We first find
+			// the bounding range of candidate columns and rows, and then
+			// test each candidate precinct against the window of interest.
+			uint32_t prc_x0 = res->pw, prc_x1 = 0;
+			uint32_t prc_y0 = res->ph, prc_y1 = 0;
+			for (uint32_t bandno = 0; bandno < res->numbands; ++bandno) {
+				auto band = res->bands + bandno;
+				if (band->isEmpty())
+					continue;
+				for (uint32_t px = 0; px < res->pw; ++px) {
+					auto prec = band->precincts + px;
+					if (tilec->is_subband_area_of_interest(resno, band->bandno,
+							prec->x0, 0, prec->x1, UINT_MAX)) {
+						prc_x0 = std::min<uint32_t>(prc_x0, px);
+						prc_x1 = std::max<uint32_t>(prc_x1, px + 1);
+					}
+				}
+				for (uint32_t py = 0; py < res->ph; ++py) {
+					auto prec = band->precincts + (uint64_t) py * res->pw;
+					if (tilec->is_subband_area_of_interest(resno, band->bandno,
+							0, prec->y0, UINT_MAX, prec->y1)) {
+						prc_y0 = std::min<uint32_t>(prc_y0, py);
+						prc_y1 = std::max<uint32_t>(prc_y1, py + 1);
+					}
+				}
+			}
+			for (uint32_t py = prc_y0; py < prc_y1; ++py) {
+				for (uint32_t px = prc_x0; px < prc_x1; ++px) {
+					uint64_t precno = px + (uint64_t) py * res->pw;
+					bool skip_the_precinct = true;
+					for (uint32_t bandno = 0; bandno < res->numbands; ++bandno) {
+						auto band = res->bands + bandno;
+						auto prec = band->precincts + precno;
+						if (tilec->is_subband_area_of_interest(resno,
+								band->bandno, prec->x0, prec->y0, prec->x1,
+								prec->y1)) {
+							skip_the_precinct = false;
+							break;
+						}
+					}
+					if (skip_the_precinct)
+						continue;
+					pi.precno = precno;
+					// packets of a precinct must be decoded in layer order
+					for (uint32_t layno = 0; layno < num_layers; ++layno) {
+						auto seq = index->sequence(compno, resno, precno,
+								layno);
+						if (seq == precinct_index_no_packet
+								|| index->offset(seq) >= src_buf->data_len)
+							break;
+						if (!src_buf->seek((size_t) index->offset(seq)))
+							break;
+						// SOP marker counter must match sequence number
+						p_tile->packno = seq;
+						pi.layno = layno;
+						uint64_t nb_bytes_read = 0;
+						if (!decode_packet(tcp, &pi, src_buf, &nb_bytes_read))
+							return false;
+						decoded = true;
+						img_comp->resno_decoded = std::max<uint32_t>(resno,
+								img_comp->resno_decoded);
+						*p_data_read += nb_bytes_read;
+					}
+				}
+			}
+		}
+		if (!decoded && img_comp->resno_decoded == 0)
+			img_comp->resno_decoded = tilec->minimum_num_resolutions - 1;
+	}
+
 	return true;
 }
 
 T2::T2(TileProcessor *tileProc) :
-		tileProcessor(tileProc) {
+		tileProcessor(tileProc), m_probe(false), m_truncated(false) {
 }
 
 bool T2::decode_packet(TileCodingParams *p_tcp, PacketIter *p_pi, ChunkBuffer *src_buf,
@@ -351,6 +559,165 @@ bool T2::decode_packet(TileCodingParams *p_tcp, PacketIter *p_pi, ChunkBuffer *s
 	return true;
 }
 
+/*
+ State of a precinct that is modified by reading a packet header
+ */
+struct PacketHeaderState {
+	struct BlockState {
+		uint32_t numbps;
+		uint32_t numlenbits;
+		uint32_t numSegments;
+	};
+	std::vector<std::vector<TagTreeNode>> incltrees;
+	std::vector<std::vector<TagTreeNode>> imsbtrees;
+	std::vector<BlockState> blocks;
+	uint64_t packno;
+};
+
+static void save_packet_header_state(grk_tcd_tile *tile, PacketIter *pi,
+		PacketHeaderState *state) {
+	auto res = tile->comps[pi->compno].resolutions + pi->resno;
+	state->incltrees.resize(res->numbands);
+	state->imsbtrees.resize(res->numbands);
+	state->blocks.clear();
+	for (uint32_t bandno = 0; bandno < res->numbands; ++bandno) {
+		auto band = res->bands + bandno;
+		if (band->isEmpty() || pi->precno >= band->numPrecincts)
+			continue;
+		auto prc = band->precincts + pi->precno;
+		if (prc->incltree)
+			prc->incltree->save_state(state->incltrees.data() + bandno);
+		if (prc->imsbtree)
+			prc->imsbtree->save_state(state->imsbtrees.data() + bandno);
+		for (uint64_t cblkno = 0; cblkno < (uint64_t) prc->cw * prc->ch;
+				++cblkno) {
+			auto cblk = prc->cblks.dec + cblkno;
+			state->blocks.push_back( { cblk->numbps, cblk->numlenbits,
+					cblk->numSegments });
+		}
+	}
+	state->packno = tile->packno;
+}
+
+static void restore_packet_header_state(grk_tcd_tile *tile, PacketIter *pi,
+		const PacketHeaderState &state) {
+	auto res = tile->comps[pi->compno].resolutions + pi->resno;
+	size_t blockno = 0;
+	for (uint32_t bandno = 0; bandno < res->numbands; ++bandno) {
+		auto band = res->bands + bandno;
+		if (band->isEmpty() || pi->precno >= band->numPrecincts)
+			continue;
+		auto prc = band->precincts + pi->precno;
+		if (prc->incltree)
+			prc->incltree->restore_state(state.incltrees[bandno]);
+		if (prc->imsbtree)
+			prc->imsbtree->restore_state(state.imsbtrees[bandno]);
+		for (uint64_t cblkno = 0; cblkno < (uint64_t) prc->cw * prc->ch;
+				++cblkno) {
+			auto cblk = prc->cblks.dec + cblkno;
+			auto block = state.blocks[blockno++];
+			cblk->numbps = block.numbps;
+			cblk->numlenbits = block.numlenbits;
+			cblk->numSegments = block.numSegments;
+			cblk->numPassesInPacket = 0;
+		}
+	}
+	tile->packno = state.packno;
+}
+
+/*
+ Total length of packet body, once packet header has been read
+ */
+static uint64_t packet_body_length(grk_tcd_resolution *res, PacketIter *pi) {
+	uint64_t len = 0;
+	for (uint32_t bandno = 0; bandno < res->numbands; ++bandno) {
+		auto band = res->bands + bandno;
+		if (band->isEmpty())
+			continue;
+		auto prc = band->precincts + pi->precno;
+		for (uint64_t cblkno = 0; cblkno < (uint64_t) prc->cw * prc->ch;
+				++cblkno) {
+			auto cblk = prc->cblks.dec + cblkno;
+			if (!cblk->numPassesInPacket)
+				continue;
+			uint32_t segno = 0;
+			if (cblk->numSegments) {
+				segno = cblk->numSegments - 1;
+				if (cblk->segs[segno].numpasses == cblk->segs[segno].maxpasses)
+					++segno;
+			}
+			auto passes = (int64_t) cblk->numPassesInPacket;
+			while (passes > 0) {
+				auto seg = cblk->segs + segno++;
+				if (!seg->numPassesInPacket)
+					break;
+				len += seg->numBytesInPacket;
+				passes -= seg->numPassesInPacket;
+			}
+		}
+	}
+	return len;
+}
+
+bool T2::decode_packet_if_complete(TileCodingParams *p_tcp, PacketIter *p_pi,
+		ChunkBuffer *src_buf, bool skip, uint64_t max_length,
+		bool *complete) {
+	*complete = false;
+	uint64_t nb_bytes_read = 0;
+	if (max_length == UINT64_MAX) {
+		*complete = true;
+		return skip ?
+				skip_packet(p_tcp, p_pi, src_buf, &nb_bytes_read) :
+				decode_packet(p_tcp, p_pi, src_buf, &nb_bytes_read);
+	}
+	size_t offset = src_buf->get_global_offset();
+	uint64_t available = std::min<uint64_t>(max_length,
+			src_buf->data_len - offset);
+	if (!available)
+		return true;
+
+	auto p_tile = tileProcessor->tile;
+	auto res = p_tile->comps[p_pi->compno].resolutions + p_pi->resno;
+	PacketHeaderState state;
+	save_packet_header_state(p_tile, p_pi, &state);
+
+	bool present = false;
+	m_probe = true;
+	m_truncated = false;
+	bool rc = read_packet_header(p_tcp, p_pi, &present, src_buf,
+			&nb_bytes_read);
+	m_probe = false;
+	if (!rc && !m_truncated) {
+		GROK_ERROR(
+				"Corrupt packet header: layer %u, resolution %u, component %u, precinct %llu",
+				p_pi->layno, p_pi->resno, p_pi->compno,
+				(unsigned long long) p_pi->precno);
+		return false;
+	}
+	if (rc) {
+		uint64_t body_len = present ? packet_body_length(res, p_pi) : 0;
+		if (nb_bytes_read + body_len <= available) {
+			if (present) {
+				uint64_t body_read = 0;
+				if (skip) {
+					if (!skip_packet_data(res, p_pi, &body_read, body_len))
+						return false;
+					src_buf->incr_cur_chunk_offset(body_read);
+				} else if (!read_packet_data(res, p_pi, src_buf, &body_read)) {
+					return false;
+				}
+			}
+			*complete = true;
+			return true;
+		}
+	}
+	// packet is incomplete: roll back, and wait for more data
+	restore_packet_header_state(p_tile, p_pi, state);
+	src_buf->seek(offset);
+
+	return true;
+}
+
 bool T2::read_packet_header(TileCodingParams *p_tcp, PacketIter *p_pi,
 		bool *p_is_data_present, ChunkBuffer *src_buf, uint64_t *p_data_read) {
 	auto p_tile = tileProcessor->tile;
@@ -386,6 +753,10 @@ bool T2::read_packet_header(TileCodingParams *p_tcp, PacketIter *p_pi,
 	/* SOP markers */
 	if (p_tcp->csty & J2K_CP_CSTY_SOP) {
 		if (max_length < 6) {
+			if (m_probe) {
+				m_truncated = true;
+				return false;
+			}
 			GROK_WARN("Not enough space for expected SOP marker");
 		} else if ((*active_src) != 0xff || (*(active_src + 1) != 0x91)) {
 			GROK_WARN("Expected SOP marker");
@@ -435,20 +806,30 @@ bool T2::read_packet_header(TileCodingParams *p_tcp, PacketIter *p_pi,
 			new BitIO(header_data, *modified_length_ptr, false));
 	if (*modified_length_ptr) {
 		if (!bio->read(&present, 1)) {
-			GROK_ERROR("read_packet_header: failed to read `present` bit ");
+			if (m_probe)
+				m_truncated = true;
+			else
+				GROK_ERROR("read_packet_header: failed to read `present` bit ");
 			return false;
 		}
 	}
 	//GROK_INFO("present=%d ", present);
 	if (!present) {
-		if (!bio->inalign())
+		if (!bio->inalign()) {
+			if (m_probe)
+				m_truncated = true;
 			return false;
+		}
 		header_data += bio->numbytes();
 
 		/* EPH markers */
 		if (p_tcp->csty & J2K_CP_CSTY_EPH) {
 			if ((*modified_length_ptr
 					- (size_t) (header_data - *header_data_start)) < 2U) {
+				if (m_probe) {
+					m_truncated = true;
+					return false;
+				}
 				GROK_WARN("Not enough space for expected EPH marker");
 			} else if ((*header_data) != 0xff || (*(header_data + 1) != 0x92)) {
 				GROK_WARN("Expected EPH marker");
@@ -483,7 +864,10 @@ bool T2::read_packet_header(TileCodingParams *p_tcp, PacketIter *p_pi,
 				uint64_t value;
 				if (!prc->incltree->decodeValue(bio.get(), cblkno,
 						p_pi->layno + 1, &value)) {
-					GROK_ERROR(
+					if (m_probe)
+						m_truncated = true;
+					else
+						GROK_ERROR(
 							"read_packet_header: failed to read `inclusion` bit ");
 					return false;
 				}
@@ -513,7 +897,10 @@ bool T2::read_packet_header(TileCodingParams *p_tcp, PacketIter *p_pi,
 			/* else one bit */
 			else {
 				if (!bio->read(&included, 1)) {
-					GROK_ERROR(
+					if (m_probe)
+						m_truncated = true;
+					else
+						GROK_ERROR(
 							"read_packet_header: failed to read `inclusion` bit ");
 					return false;
 				}
@@ -542,13 +929,15 @@ bool T2::read_packet_header(TileCodingParams *p_tcp, PacketIter *p_pi,
 						K_msbs, &value)) && !value) {
 					++K_msbs;
 				}
-				assert(K_msbs >= 1);
-				K_msbs--;
-
 				if (!rc) {
-					GROK_ERROR("Failed to decompress zero-bitplane tag tree ");
+					if (m_probe)
+						m_truncated = true;
+					else
+						GROK_ERROR("Failed to decompress zero-bitplane tag tree ");
 					return false;
 				}
+				assert(K_msbs >= 1);
+				K_msbs--;
 
 				if (K_msbs > band->numbps) {
 					GROK_WARN(
@@ -570,11 +959,17 @@ bool T2::read_packet_header(TileCodingParams *p_tcp, PacketIter *p_pi,
 
 			/* number of coding passes */
 			if (!bio->getnumpasses(&cblk->numPassesInPacket)) {
-				GROK_ERROR("read_packet_header: failed to read numpasses.");
+				if (m_probe)
+					m_truncated = true;
+				else
+					GROK_ERROR("read_packet_header: failed to read numpasses.");
 				return false;
 			}
 			if (!bio->getcommacode(&increment)) {
-				GROK_ERROR(
+				if (m_probe)
+					m_truncated = true;
+				else
+					GROK_ERROR(
 						"read_packet_header: failed to read length indicator increment.");
 				return false;
 			}
@@ -631,6 +1026,10 @@ bool T2::read_packet_header(TileCodingParams *p_tcp, PacketIter *p_pi,
 					return false;
 				}
 				if (!bio->read(&seg->numBytesInPacket, bits_to_read)) {
+					if (m_probe) {
+						m_truncated = true;
+						return false;
+					}
 					GROK_WARN(
 							"read_packet_header: failed to read segment length ");
 				}
@@ -657,7 +1056,10 @@ bool T2::read_packet_header(TileCodingParams *p_tcp, PacketIter *p_pi,
 	}
 
 	if (!bio->inalign()) {
-		GROK_ERROR("Unable to read packet header");
+		if (m_probe)
+			m_truncated = true;
+		else
+			GROK_ERROR("Unable to read packet header");
 		return false;
 	}
 
@@ -667,6 +1069,10 @@ bool T2::read_packet_header(TileCodingParams *p_tcp, PacketIter *p_pi,
 	if (p_tcp->csty & J2K_CP_CSTY_EPH) {
 		if ((*modified_length_ptr
 				- (uint32_t) (header_data - *header_data_start)) < 2U) {
+			if (m_probe) {
+				m_truncated = true;
+				return false;
+			}
 			GROK_WARN("Not enough space for expected EPH marker");
 		} else if ((*header_data) != 0xff || (*(header_data + 1) != 0x92)) {
 			GROK_WARN("Expected EPH marker");
@@ -794,6 +1200,54 @@ bool T2::skip_packet(TileCodingParams *p_tcp, PacketIter *p_pi, ChunkBuffer *src
 	return true;
 }
 
+bool T2::copy_packet(TileCodingParams *p_tcp, PacketIter *p_pi,
+		ChunkBuffer *src_buf, uint32_t plt_len, uint64_t *p_data_read) {
+	*p_data_read = 0;
+	// packets at the end of a truncated tile are missing
+	if (src_buf->get_global_offset() >= src_buf->data_len)
+		return true;
+
+	// a packet never straddles two tile parts, so it is contiguous
+	auto packet_data = src_buf->get_global_ptr();
+	uint64_t max_length = (uint64_t) src_buf->get_cur_chunk_len();
+	uint64_t packet_len = plt_len;
+	uint64_t header_len = 0;
+	if (!plt_len) {
+		bool read_data;
+		if (!read_packet_header(p_tcp, p_pi, &read_data, src_buf,
+				&header_len))
+			return false;
+		packet_len = header_len;
+		if (read_data) {
+			uint64_t body_len = 0;
+			auto res = tileProcessor->tile->comps[p_pi->compno].resolutions
+					+ p_pi->resno;
+			if (!skip_packet_data(res, p_pi, &body_len, UINT64_MAX))
+				return false;
+			packet_len += body_len;
+		}
+	}
+	// a packet cut short by truncation can't be copied: it is
+	// replaced by an empty packet, as are all following packets
+	if (packet_len > max_length) {
+		GROK_WARN("copy_packet: truncated packet replaced by empty packet"
+				" (cmptno=%02d reslvlno=%02d prcno=%03d layrno=%02d)",
+				p_pi->compno, p_pi->resno, p_pi->precno, p_pi->layno);
+		src_buf->incr_cur_chunk_offset(max_length - header_len);
+		*p_data_read = max_length;
+		return true;
+	}
+	src_buf->incr_cur_chunk_offset(packet_len - header_len);
+	*p_data_read = packet_len;
+
+	auto packets = tileProcessor->m_packets;
+	if (packets->select(p_pi->compno, p_pi->resno, p_pi->layno))
+		packets->push(p_pi->compno, p_pi->resno, p_pi->precno, p_pi->layno,
+				packet_data, (size_t) packet_len);
+
+	return true;
+}
+
 bool T2::skip_packet_data(grk_tcd_resolution *res, PacketIter *p_pi,
 		uint64_t *p_data_read, uint64_t max_length) {
 	uint32_t bandno;
@@ -1328,6 +1782,107 @@ bool T2::encode_packet(uint16_t tileno, TileCodingParams *tcp, PacketIter *pi,
 	return true;
 }
 
+uint32_t T2::rewrite_packet_length(TileCodingParams *tcp, PacketIter *pi) {
+	const uint8_t *data = nullptr;
+	size_t len = 0;
+	if (tileProcessor->m_packets->get(pi->compno, pi->resno, pi->precno,
+			pi->layno, &data, &len))
+		return (uint32_t) len;
+
+	// empty packet: optional SOP, zero bit padded to one byte, and optional EPH
+	uint32_t empty_len = 1;
+	if (tcp->csty & J2K_CP_CSTY_SOP)
+		empty_len += 6;
+	if (tcp->csty & J2K_CP_CSTY_EPH)
+		empty_len += 2;
+
+	return empty_len;
+}
+
+bool T2::rewrite_packet(TileCodingParams *tcp, PacketIter *pi,
+		BufferedStream *stream, uint32_t *packet_bytes_written) {
+	auto tile = tileProcessor->tile;
+	if (tileProcessor->m_packetTracker.is_packet_encoded(pi->compno, pi->resno,
+			pi->precno, pi->layno))
+		return true;
+	tileProcessor->m_packetTracker.packet_encoded(pi->compno, pi->resno,
+			pi->precno, pi->layno);
+
+	const uint8_t *data = nullptr;
+	size_t len = 0;
+	bool present = tileProcessor->m_packets->get(pi->compno, pi->resno,
+			pi->precno, pi->layno, &data, &len);
+	bool sop = tcp->csty & J2K_CP_CSTY_SOP;
+	size_t stream_start = stream->tell();
+
+	// SOP marker, renumbered with packet index in destination tile
+	if (sop && (!present || (len >= 6 && data[0] == 0xff && data[1] == 0x91))) {
+		uint16_t packno = (uint16_t) (tile->packno % 0x10000);
+		if (!stream->write_short(J2K_MS_SOP) || !stream->write_short(4)
+				|| !stream->write_short(packno))
+			return false;
+		if (present) {
+			data += 6;
+			len -= 6;
+		}
+	}
+	if (present) {
+		if (len && stream->write_bytes(data, len) != len)
+			return false;
+	} else {
+		if (!stream->write_byte(0))
+			return false;
+		if ((tcp->csty & J2K_CP_CSTY_EPH) && !stream->write_short(J2K_MS_EPH))
+			return false;
+	}
+	*packet_bytes_written = (uint32_t) (stream->tell() - stream_start);
+
+	return true;
+}
+
+bool T2::rewrite_packets_simulate(uint16_t tile_no,
+		PacketLengthMarkers *markers) {
+	auto cp = tileProcessor->m_cp;
+	auto image = tileProcessor->image;
+	auto tcp = cp->tcps + tile_no;
+	uint32_t nb_pocs = tcp->numpocs + 1;
+
+	// visit packets exactly as encode_packets does for each tile part
+	tileProcessor->m_packetTracker.clear();
+	for (uint32_t pino = 0; pino <= tcp->numpocs; ++pino) {
+		uint8_t tot_num_tp = j2k_get_num_tp(cp, pino, tile_no);
+		for (uint8_t tp_num = 0; tp_num < tot_num_tp; ++tp_num) {
+			auto pi = pi_initialise_encode(image, cp, tile_no, FINAL_PASS);
+			if (!pi)
+				return false;
+			pi_init_encode(pi, cp, tile_no, pino, tp_num,
+					tileProcessor->tp_pos, FINAL_PASS);
+			auto current_pi = pi + pino;
+			if (current_pi->poc.prg == GRK_PROG_UNKNOWN) {
+				pi_destroy(pi, nb_pocs);
+				GROK_ERROR("rewrite_packets_simulate: Unknown progression order");
+				return false;
+			}
+			while (pi_next(current_pi)) {
+				if (current_pi->layno >= tcp->numlayers)
+					continue;
+				if (tileProcessor->m_packetTracker.is_packet_encoded(
+						current_pi->compno, current_pi->resno,
+						current_pi->precno, current_pi->layno))
+					continue;
+				tileProcessor->m_packetTracker.packet_encoded(
+						current_pi->compno, current_pi->resno,
+						current_pi->precno, current_pi->layno);
+				markers->writeNext(rewrite_packet_length(tcp, current_pi));
+			}
+			pi_destroy(pi, nb_pocs);
+		}
+	}
+	tileProcessor->m_packetTracker.clear();
+
+	return true;
+}
+
 bool T2::encode_packet_simulate(TileCodingParams *tcp, PacketIter *pi,
 		uint32_t *packet_bytes_written, uint32_t max_bytes_available,
 		PacketLengthMarkers *markers) {
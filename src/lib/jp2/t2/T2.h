@@ -59,6 +59,7 @@
 namespace grk {
 
 struct TileProcessor;
+struct PrecinctIndex;
 
 /**
  @file T2.h
@@ -113,9 +114,57 @@ struct T2 {
 	bool decode_packets(uint16_t tileno, ChunkBuffer *src_buf,
 			uint64_t *data_read);
 
+	/**
+	 Decode (or skip) a single packet, but only if all of its bytes are
+	 available in the source buffer. If the packet is incomplete, the state
+	 of its precinct and the source buffer offset are restored, so that the
+	 packet can be decoded again once more data has been received.
+	 @param tcp 		tile coding parameters
+	 @param pi			packet iterator, positioned at the packet
+	 @param src_buf     source buffer
+	 @param skip        true if packet data should be skipped rather than read
+	 @param max_length	maximum number of bytes available to the packet,
+	 					or UINT64_MAX if the source buffer is complete
+	 @param complete    set to true if the packet was decoded
+	 @return false if the packet is corrupt, i.e. its header cannot be read
+	 	 	 for any reason other than missing data
+	 */
+	bool decode_packet_if_complete(TileCodingParams *tcp, PacketIter *pi,
+			ChunkBuffer *src_buf, bool skip, uint64_t max_length,
+			bool *complete);
+
+	/**
+	 Compute the lengths of the rewritten packets of a tile, in the order
+	 in which they will be written, and store them in packet length markers
+	 @param tileno 		number of the tile being rewritten
+	 @param markers		packet length markers
+	 @return true if successful
+	 */
+	bool rewrite_packets_simulate(uint16_t tileno,
+			PacketLengthMarkers *markers);
+
 private:
+	/**
+	 Decode only the packets of precincts that intersect the window of interest,
+	 seeking directly to each packet using a PLT-based precinct index
+	 @param tileno 		number that identifies the tile for which to decompress the packets
+	 @param src_buf     source buffer
+	 @param data_read   number of bytes read
+	 @param index       precinct index
+	 @return true if successful
+	 */
+	bool decode_packets_random_access(uint16_t tileno, ChunkBuffer *src_buf,
+			uint64_t *data_read, PrecinctIndex *index);
+
 	TileProcessor *tileProcessor;
 
+	// true while reading a packet header that may be truncated:
+	// running out of data is then expected, and not reported
+	bool m_probe;
+	// set while probing if the packet header ran out of data;
+	// any other failure means that the header is corrupt
+	bool m_truncated;
+
 	/**
 	 Encode a packet of a tile to a destination buffer
 	 @param tileno Number of the tile encoded
@@ -156,6 +205,37 @@ private:
 	bool skip_packet(TileCodingParams *p_tcp, PacketIter *p_pi, ChunkBuffer *src_buf,
 			uint64_t *p_data_read);
 
+	/**
+	 Skip a packet of the source code stream, keeping a copy of it
+	 if it is selected for rewriting
+	 @param tcp 		tile coding parameters
+	 @param pi			packet iterator, positioned at the packet
+	 @param src_buf     source buffer
+	 @param plt_len		packet length from PLT marker, or zero if unknown
+	 @param data_read   number of bytes read
+	 @return true if successful
+	 */
+	bool copy_packet(TileCodingParams *tcp, PacketIter *pi,
+			ChunkBuffer *src_buf, uint32_t plt_len, uint64_t *data_read);
+
+	/**
+	 Write a packet copied from the source code stream, renumbering its
+	 SOP marker. An empty packet is written if the packet is missing
+	 from the source.
+	 @param tcp 		tile coding parameters
+	 @param pi			packet iterator, positioned at the packet
+	 @param stream		stream
+	 @param packet_bytes_written	number of bytes written
+	 @return true if successful
+	 */
+	bool rewrite_packet(TileCodingParams *tcp, PacketIter *pi,
+			BufferedStream *stream, uint32_t *packet_bytes_written);
+
+	/**
+	 Get length of rewritten packet
+	 */
+	uint32_t rewrite_packet_length(TileCodingParams *tcp, PacketIter *pi);
+
 	bool read_packet_header(TileCodingParams *p_tcp, PacketIter *p_pi,
 			bool *p_is_data_present, ChunkBuffer *src_buf,
 			uint64_t *p_data_read);
@@ -0,0 +1,75 @@
+/*
+ *    Copyright (C) 2016-2020 Grok Image Compression Inc.
+ *
+ *    This source code is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This source code is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include "grok_includes.h"
+#include "TilePackets.h"
+
+namespace grk {
+
+TilePackets::TilePackets(uint32_t numlayers, uint32_t numresolutions,
+		const std::vector<uint32_t> &comp_map) :
+		m_numlayers(numlayers), m_numres(numresolutions), m_numcomps(0), m_comp_map(
+				comp_map) {
+	for (auto dest : m_comp_map) {
+		if (dest != tile_packets_no_component)
+			m_numcomps = std::max<uint32_t>(m_numcomps, dest + 1);
+	}
+}
+
+void TilePackets::clear(void) {
+	m_data.clear();
+	m_packets.clear();
+}
+
+uint32_t TilePackets::dest_component(uint32_t compno) const {
+	if (compno >= m_comp_map.size())
+		return tile_packets_no_component;
+
+	return m_comp_map[compno];
+}
+
+bool TilePackets::select(uint32_t compno, uint32_t resno,
+		uint32_t layno) const {
+	return layno < m_numlayers && resno < m_numres
+			&& dest_component(compno) != tile_packets_no_component;
+}
+
+uint64_t TilePackets::key(uint32_t compno, uint32_t resno, uint64_t precno,
+		uint32_t layno) const {
+	return ((precno * m_numres + resno) * m_numcomps + compno) * m_numlayers
+			+ layno;
+}
+
+void TilePackets::push(uint32_t compno, uint32_t resno, uint64_t precno,
+		uint32_t layno, const uint8_t *data, size_t len) {
+	size_t offset = m_data.size();
+	m_data.insert(m_data.end(), data, data + len);
+	m_packets[key(dest_component(compno), resno, precno, layno)] =
+			std::make_pair(offset, len);
+}
+
+bool TilePackets::get(uint32_t compno, uint32_t resno, uint64_t precno,
+		uint32_t layno, const uint8_t **data, size_t *len) const {
+	auto it = m_packets.find(key(compno, resno, precno, layno));
+	if (it == m_packets.end())
+		return false;
+	*data = m_data.data() + it->second.first;
+	*len = it->second.second;
+
+	return true;
+}
+
+}
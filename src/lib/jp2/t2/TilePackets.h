@@ -0,0 +1,88 @@
+/*
+ *    Copyright (C) 2016-2020 Grok Image Compression Inc.
+ *
+ *    This source code is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This source code is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+#include <vector>
+#include <unordered_map>
+
+namespace grk {
+
+// destination component of a source component that is not kept
+const uint32_t tile_packets_no_component = (uint32_t) -1;
+
+/*  TilePackets
+
+ Packets of a tile, copied verbatim from a source code stream while T2
+ parses the packet headers, so that they can be written to a destination
+ code stream without decoding any code blocks.
+
+ Packets are selected by layer, resolution and component: only the first
+ numlayers layers and the first numresolutions resolutions are kept, and
+ source components are mapped to destination components. Precinct numbers
+ are unchanged, since precinct partitions of the kept resolutions are
+ the same in source and destination.
+
+ */
+struct TilePackets {
+	TilePackets(uint32_t numlayers, uint32_t numresolutions,
+			const std::vector<uint32_t> &comp_map);
+
+	/*
+	 Discard packets of previous tile
+	 */
+	void clear(void);
+
+	/*
+	 Get destination component of source component,
+	 or tile_packets_no_component if component is not kept
+	 */
+	uint32_t dest_component(uint32_t compno) const;
+
+	/*
+	 Return true if packet of source component should be kept
+	 */
+	bool select(uint32_t compno, uint32_t resno, uint32_t layno) const;
+
+	/*
+	 Store packet of source component
+	 */
+	void push(uint32_t compno, uint32_t resno, uint64_t precno, uint32_t layno,
+			const uint8_t *data, size_t len);
+
+	/*
+	 Get packet of destination component. Returns false if packet was not
+	 found in source, which happens when the source is truncated.
+	 */
+	bool get(uint32_t compno, uint32_t resno, uint64_t precno, uint32_t layno,
+			const uint8_t **data, size_t *len) const;
+
+private:
+	uint64_t key(uint32_t compno, uint32_t resno, uint64_t precno,
+			uint32_t layno) const;
+
+	uint32_t m_numlayers;
+	uint32_t m_numres;
+	uint32_t m_numcomps;
+	std::vector<uint32_t> m_comp_map;
+
+	// packet data is stored contiguously, in source order,
+	// and located by (offset, length)
+	std::vector<uint8_t> m_data;
+	std::unordered_map<uint64_t, std::pair<size_t, size_t>> m_packets;
+};
+
+}
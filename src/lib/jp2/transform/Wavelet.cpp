@@ -18,12 +18,6 @@
 
 #include "grok_includes.h"
 
-#include "dwt_utils.h"
-#include "dwt53.h"
-#include "dwt97.h"
-#include "WaveletForward.h"
-#include "dwt.h"
-
 namespace grk {
 
 Wavelet::Wavelet() {
@@ -34,11 +28,9 @@ Wavelet::~Wavelet() {
 
 bool Wavelet::compress(TileComponent *tile_comp, uint8_t qmfbid){
 	if (qmfbid == 1) {
-		WaveletForward<dwt53> dwt;
-		return dwt.run(tile_comp);
+		return simd_kernels().dwt_encode_53(tile_comp);
 	} else if (qmfbid == 0) {
-		WaveletForward<dwt97> dwt;
-		return dwt.run(tile_comp);
+		return simd_kernels().dwt_encode_97(tile_comp);
 	}
 	return false;
 }
@@ -46,12 +38,49 @@ bool Wavelet::compress(TileComponent *tile_comp, uint8_t qmfbid){
 bool Wavelet::decompress(TileProcessor *p_tcd,  TileComponent* tilec,
                              uint32_t numres, uint8_t qmfbid){
 
-	if (qmfbid == 1) {
-		return decode_53(p_tcd,tilec,numres);
-	} else if (qmfbid == 0) {
-		return decode_97(p_tcd,tilec,numres);
-	}
-	return false;
+	return decompress(simd_kernels(), p_tcd, tilec, numres, qmfbid);
+}
+
+bool Wavelet::decompress(const SimdKernels &kernels, TileProcessor *p_tcd,
+		TileComponent* tilec, uint32_t numres, uint8_t qmfbid){
+	if (qmfbid > 1)
+		return false;
+	if (decompress_by_lines(p_tcd, tilec, numres, 1) &&
+			(qmfbid == 1 || !decompress_fixed_97(p_tcd, tilec)))
+		return kernels.dwt_decode_lines(tilec, numres, qmfbid);
+	if (qmfbid == 1)
+		return kernels.dwt_decode_53(p_tcd,tilec,numres);
+
+	return kernels.dwt_decode_97(p_tcd,tilec,numres);
+}
+
+bool Wavelet::decompress_by_lines(TileProcessor *p_tcd,  TileComponent* tilec,
+                             uint32_t numres, uint32_t num_comps){
+	/* stream the whole tile through the line-based transform,
+	 * in one band of rows per worker thread, unless its output buffers
+	 * would take too much memory on top of the tile buffers */
+	if (!p_tcd->whole_tile_decoding ||
+			numres != tilec->minimum_num_resolutions)
+		return false;
+	auto tr_max = tilec->resolutions + numres - 1;
+	uint64_t area = (uint64_t) (tr_max->x1 - tr_max->x0) *
+			(tr_max->y1 - tr_max->y0);
+
+	return area * num_comps <= dwt_line_max_samples;
+}
+
+bool Wavelet::decompress_fixed_97(TileProcessor *p_tcd,  TileComponent* tilec){
+	auto img_comp = p_tcd->image->comps + (tilec - p_tcd->tile->comps);
+	return p_tcd->whole_tile_decoding &&
+			p_tcd->m_cp->m_coding_params.m_dec.m_fast_preview &&
+			img_comp->prec <= 8;
+}
+
+bool Wavelet::decompress_mct(TileComponent* tilec, uint32_t numres,
+							uint8_t qmfbid, const DcShiftParams *params){
+	if (qmfbid > 1)
+		return false;
+	return simd_kernels().dwt_decode_mct_lines(tilec, numres, qmfbid, params);
 }
 
 }
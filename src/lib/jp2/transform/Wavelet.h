@@ -30,6 +30,26 @@ public:
 	static bool decompress(TileProcessor *p_tcd,  TileComponent* tilec,
 	                             uint32_t numres, uint8_t qmfbid);
 
+	/* decompress with the kernels of a given SIMD level */
+	static bool decompress(const SimdKernels &kernels, TileProcessor *p_tcd,
+			TileComponent* tilec, uint32_t numres, uint8_t qmfbid);
+
+	/* true if decompress streams the rows of tilec, or of num_comps
+	 * components like it decompressed together, through the line-based
+	 * inverse transform */
+	static bool decompress_by_lines(TileProcessor *p_tcd,  TileComponent* tilec,
+	                             uint32_t numres, uint32_t num_comps);
+
+	/* true if the inverse 9-7 transform of tilec runs in 16 bit fixed point:
+	 * fast preview decoding of a whole tile, for a component
+	 * of 8 bits precision or less */
+	static bool decompress_fixed_97(TileProcessor *p_tcd,  TileComponent* tilec);
+
+	/* line-based decompress of the first three components of a tile,
+	 * followed by the inverse MCT and the DC level shift */
+	static bool decompress_mct(TileComponent* tilec, uint32_t numres,
+								uint8_t qmfbid, const DcShiftParams *params);
+
 };
 
 }
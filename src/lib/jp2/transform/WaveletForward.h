@@ -21,6 +21,208 @@
 
 namespace grk {
 
+/*
+ Line-based forward wavelet transform
+
+ Rather than running the vertical pass over all columns of a resolution,
+ and then the horizontal pass over all of its rows, each decomposition
+ level keeps a ring of dwt_forward_ring_rows rows. Input rows are read
+ from the tile buffer (first level) or from the level above (low pass
+ rows), and lifted vertically as soon as their neighbours are available.
+ Once a row is final, and no longer read by lifting, it is transformed
+ horizontally while it is still in cache: its low pass samples feed the
+ next level, and the rest is written out. Every resolution is therefore
+ read and written once, rather than twice.
+
+ Sub-bands are written to a new buffer, which then replaces the tile
+ buffer, since the high pass rows of a level belong below input rows
+ that have not been read yet. So that this doesn't double the memory
+ of large tiles, tile components of more than dwt_line_max_samples
+ samples are transformed one level at a time, in place: a vertical pass
+ over columns, then a horizontal pass over rows.
+
+ With worker threads, rows of each level are split into one band per
+ thread. A band starts num_steps rows above its first row, which is all
+ that lifting reaches, so that results don't depend on the number of
+ threads. Lifting steps are numbered from 1: odd steps update high pass
+ rows, and even steps update low pass rows. Results are identical to
+ the column then row transform of each resolution.
+ */
+
+/* a row, with the num_steps rows on either side that lifting reaches */
+const uint32_t dwt_forward_ring_rows = 16;
+
+template <typename DWT> class LineLevelForward
+{
+public:
+	LineLevelForward() :
+			m_prev(nullptr), m_tiledp(nullptr), m_stride(0), m_out(nullptr),
+			m_rw(0), m_rh(0), m_sw(0), m_sh(0), m_cas_h(0), m_cas_v(0),
+			m_last(false), m_own0(0), m_own1(0), m_ring(nullptr),
+			m_tmp(nullptr), m_fetched(0), m_emitted(0) {
+		for (uint32_t i = 0; i < dwt_forward_ring_rows; ++i) {
+			m_rows[i] = 0;
+			m_steps[i] = 0;
+		}
+	}
+	~LineLevelForward() {
+		grk_aligned_free(m_ring);
+		grk_aligned_free(m_tmp);
+	}
+	LineLevelForward(const LineLevelForward&) = delete;
+	LineLevelForward& operator=(const LineLevelForward&) = delete;
+
+	/*
+	 prev: level producing the input rows, or nullptr if they are read
+	 from the tile buffer
+	 hi, lo: resolutions on either side of this level
+	 out: buffer receiving the sub-bands, with the tile buffer stride
+	 last: true for the last level, which also writes out its low pass band
+	 */
+	bool init(LineLevelForward *prev, const int32_t *tiledp, size_t stride,
+			const grk_tcd_resolution *hi, const grk_tcd_resolution *lo,
+			int32_t *out, bool last) {
+		m_prev = prev;
+		m_tiledp = tiledp;
+		m_stride = stride;
+		m_out = out;
+		m_rw = hi->x1 - hi->x0;
+		m_rh = hi->y1 - hi->y0;
+		m_sw = lo->x1 - lo->x0;
+		m_sh = lo->y1 - lo->y0;
+		m_cas_h = (uint8_t) (hi->x0 & 1);
+		m_cas_v = (uint8_t) (hi->y0 & 1);
+		m_last = last;
+		/* a level can be empty, in tiny tiles */
+		m_ring = (int32_t*) grk_aligned_malloc(
+				(size_t) dwt_forward_ring_rows * std::max<uint32_t>(m_rw, 1)
+						* sizeof(int32_t));
+		m_tmp = (int32_t*) grk_aligned_malloc(
+				((size_t) m_rw + 4) * sizeof(int32_t));
+
+		return m_ring && m_tmp;
+	}
+	uint32_t height() const {
+		return m_rh;
+	}
+	uint32_t low_row_pos(uint32_t n) const {
+		return (n << 1) + m_cas_v;
+	}
+	/* Emit rows from row first, and only write out rows in [own0, own1) */
+	void start(uint32_t first, uint32_t own0, uint32_t own1) {
+		m_emitted = first;
+		m_fetched = first > DWT::num_steps ? first - DWT::num_steps : 0;
+		m_own0 = own0;
+		m_own1 = own1;
+	}
+	/* First input row that is read */
+	uint32_t first_fetched() const {
+		return m_fetched;
+	}
+	/* Get the low pass samples of low pass row n. Rows must be requested
+	 * in increasing order, and the row is only valid until the next request */
+	const int32_t* low_row(uint32_t n) {
+		uint32_t p = low_row_pos(n);
+		emit_until(p + 1);
+
+		return slot(p);
+	}
+	/* emit all rows before row end */
+	void emit_until(uint32_t end) {
+		while (m_emitted < end)
+			emit(m_emitted++);
+	}
+private:
+	bool low(uint32_t p) const {
+		return ((p ^ m_cas_v) & 1) == 0;
+	}
+	/* last lifting step of row p */
+	uint32_t final_step(uint32_t p) const {
+		return low(p) ? DWT::num_steps : DWT::num_steps - 1;
+	}
+	int32_t* slot(uint32_t p) {
+		return m_ring + (size_t) (p % dwt_forward_ring_rows) * m_rw;
+	}
+	/* read input row p */
+	void fetch(uint32_t p) {
+		auto dest = slot(p);
+		const int32_t *src =
+				m_prev ? m_prev->low_row(p) : m_tiledp + (size_t) p * m_stride;
+		memcpy(dest, src, m_rw * sizeof(int32_t));
+		if (m_rh > 1)
+			m_wavelet.encode_v_fetch(dest, m_rw);
+		m_rows[p % dwt_forward_ring_rows] = p;
+		m_steps[p % dwt_forward_ring_rows] = 0;
+	}
+	/* apply lifting steps to row p until it reaches step */
+	void ensure(uint32_t p, uint32_t step) {
+		while (m_fetched <= p)
+			fetch(m_fetched++);
+		uint32_t s = p % dwt_forward_ring_rows;
+		assert(m_rows[s] == p);
+		while (m_steps[s] < step) {
+			uint32_t t = m_steps[s] + 1;
+			if (low(p) == ((t & 1) == 0)) {
+				uint32_t prev = p ? p - 1 : p + 1;
+				uint32_t next = p + 1 < m_rh ? p + 1 : p - 1;
+				ensure(prev, t - 1);
+				ensure(next, t - 1);
+				m_wavelet.encode_v_lift(t, slot(p), slot(prev), slot(next),
+						m_rw);
+			}
+			m_steps[s] = t;
+		}
+	}
+	/* finish row p, once neither it nor its neighbours
+	 * will be lifted again, and write it out */
+	void emit(uint32_t p) {
+		auto row = slot(p);
+		if (m_rh == 1) {
+			fetch(0);
+			m_wavelet.encode_v_single(row, m_rw, m_cas_v);
+		} else {
+			ensure(p, final_step(p));
+			if (p + 1 < m_rh)
+				ensure(p + 1, final_step(p + 1));
+			m_wavelet.encode_v_finish(row, m_rw, low(p));
+		}
+		m_wavelet.encode_and_deinterleave_h(row, m_tmp, m_rw - m_sw, m_sw,
+				m_cas_h);
+		if (p < m_own0 || p >= m_own1)
+			return;
+		uint32_t n = p >> 1;
+		if (low(p)) {
+			uint32_t x0 = m_last ? 0 : m_sw;
+			memcpy(m_out + (size_t) n * m_stride + x0, row + x0,
+					(m_rw - x0) * sizeof(int32_t));
+		} else {
+			memcpy(m_out + (size_t) (m_sh + n) * m_stride, row,
+					m_rw * sizeof(int32_t));
+		}
+	}
+
+	DWT m_wavelet;
+	LineLevelForward *m_prev;
+	const int32_t *m_tiledp;
+	size_t m_stride;
+	int32_t *m_out;
+	uint32_t m_rw;
+	uint32_t m_rh;
+	uint32_t m_sw;
+	uint32_t m_sh;
+	uint8_t m_cas_h;
+	uint8_t m_cas_v;
+	bool m_last;
+	uint32_t m_own0;
+	uint32_t m_own1;
+	int32_t *m_ring;
+	int32_t *m_tmp;
+	uint32_t m_fetched;
+	uint32_t m_emitted;
+	uint32_t m_rows[dwt_forward_ring_rows];
+	uint32_t m_steps[dwt_forward_ring_rows];
+};
+
 template <typename DWT> class WaveletForward
 {
 
@@ -30,17 +232,66 @@ public:
 	 @param tilec Tile component information (current tile)
 	 */
 	bool run(TileComponent *tilec);
+private:
+	/**
+	 Transform band j of num_jobs of every level into out
+	 */
+	bool run_band(TileComponent *tilec, int32_t *out, uint32_t j,
+			uint32_t num_jobs);
+	/**
+	 Transform one level at a time, in place
+	 */
+	bool run_levels(TileComponent *tilec);
 };
 
+/* rows [y0, y1) of the h rows of a level that band j of num_jobs writes out */
+static inline void dwt_forward_band_rows(uint32_t h, uint32_t j,
+		uint32_t num_jobs, uint32_t *y0, uint32_t *y1) {
+	uint32_t step_j = h / num_jobs;
+	*y0 = j * step_j;
+	*y1 = j < (num_jobs - 1U) ? (j + 1U) * step_j : h;
+}
 
-/**
- Forward wavelet transform in 2-D.
- @param tilec Tile component information (current tile)
- */
-template <typename DWT> bool WaveletForward<DWT>::run(TileComponent *tilec){
-	if (tilec->numresolutions == 1U)
-		return true;
+template <typename DWT> bool WaveletForward<DWT>::run_band(
+		TileComponent *tilec, int32_t *out, uint32_t j, uint32_t num_jobs) {
+	uint32_t num_decomps = tilec->numresolutions - 1;
+	uint32_t stride = tilec->width();
+	auto tiledp = tilec->buf->get_ptr(0, 0, 0, 0);
+	std::unique_ptr<LineLevelForward<DWT>[]> levels(
+			new LineLevelForward<DWT>[num_decomps]);
+	/* level k transforms resolution num_decomps - k */
+	for (uint32_t k = 0; k < num_decomps; ++k) {
+		auto hi = tilec->resolutions + num_decomps - k;
+		if (!levels[k].init(k ? &levels[k - 1] : nullptr, tiledp, stride,
+				hi, hi - 1, out, k == num_decomps - 1)) {
+			GROK_ERROR("Out of memory");
+			return false;
+		}
+	}
+	/* each level starts early enough for the first row
+	 * that the next level reads */
+	uint32_t y0, y1;
+	for (uint32_t k = num_decomps; k-- > 0;) {
+		auto level = &levels[k];
+		dwt_forward_band_rows(level->height(), j, num_jobs, &y0, &y1);
+		uint32_t first = y0;
+		if (k + 1 < num_decomps) {
+			auto next = &levels[k + 1];
+			if (next->height())
+				first = std::min<uint32_t>(first,
+						level->low_row_pos(next->first_fetched()));
+		}
+		level->start(first, y0, y1);
+	}
+	for (uint32_t k = num_decomps; k-- > 0;) {
+		dwt_forward_band_rows(levels[k].height(), j, num_jobs, &y0, &y1);
+		levels[k].emit_until(y1);
+	}
 
+	return true;
+}
+
+template <typename DWT> bool WaveletForward<DWT>::run_levels(TileComponent *tilec){
 	size_t l_data_size = dwt_utils::max_resolution(tilec->resolutions,
 			tilec->numresolutions) * sizeof(int32_t);
 	/* overflow check */
@@ -60,12 +311,14 @@ template <typename DWT> bool WaveletForward<DWT>::run(TileComponent *tilec){
 	grk_tcd_resolution *cur_res = tilec->resolutions + num_decomps;
 	grk_tcd_resolution *next_res = cur_res - 1;
 
-	int32_t **bj_array = new int32_t*[ThreadPool::hardware_concurrency()];
-	for (uint32_t i = 0; i < ThreadPool::hardware_concurrency(); ++i){
+	const uint32_t num_jobs = (uint32_t) ThreadPool::get()->num_jobs();
+	int32_t **bj_array = new int32_t*[num_jobs];
+	for (uint32_t i = 0; i < num_jobs; ++i){
 		bj_array[i] = nullptr;
 	}
-	for (uint32_t i = 0; i < ThreadPool::hardware_concurrency(); ++i){
-		bj_array[i] = (int32_t*)grk_aligned_malloc(l_data_size);
+	// buffers also hold dwt_forward_mcols columns for the vertical pass
+	for (uint32_t i = 0; i < num_jobs; ++i){
+		bj_array[i] = (int32_t*)grk_aligned_malloc(l_data_size * dwt_forward_mcols);
 		if (!bj_array[i]){
 			rc = false;
 			goto cleanup;
@@ -88,13 +341,14 @@ template <typename DWT> bool WaveletForward<DWT>::run(TileComponent *tilec){
 		/* 0 = non inversion on vertical filtering 1 = inversion between low-pass and high-pass filtering   */
 		cas_col = cur_res->y0 & 1;
 
-		// transform vertical
+		// transform vertical, dwt_forward_mcols columns at a time
 		if (rw) {
-			const uint32_t linesPerThreadV = static_cast<uint32_t>(std::ceil((float)rw / (float)ThreadPool::hardware_concurrency()));
+			uint32_t linesPerThreadV = static_cast<uint32_t>(std::ceil((float)rw / (float)num_jobs));
+			linesPerThreadV = ((linesPerThreadV + dwt_forward_mcols - 1) / dwt_forward_mcols) * dwt_forward_mcols;
 			const uint32_t s_n = rh_next;
 			const uint32_t d_n = rh - rh_next;
 			std::vector< std::future<int> > results;
-			for(uint32_t i = 0; i < ThreadPool::hardware_concurrency(); ++i) {
+			for(uint32_t i = 0; i < num_jobs; ++i) {
 				uint32_t index = i;
 				results.emplace_back(
 					ThreadPool::get()->enqueue([index, bj_array,a,
@@ -102,14 +356,14 @@ template <typename DWT> bool WaveletForward<DWT>::run(TileComponent *tilec){
 												 d_n, s_n, cas_col,
 												 linesPerThreadV] {
 						DWT wavelet;
-						for (uint32_t m = index * linesPerThreadV;
-								m < std::min<uint32_t>((index+1)*linesPerThreadV, rw); ++m) {
+						uint32_t end = std::min<uint32_t>((index+1)*linesPerThreadV, rw);
+						for (uint32_t m = index * linesPerThreadV; m < end; m += dwt_forward_mcols) {
+							uint32_t cols = std::min<uint32_t>(dwt_forward_mcols, end - m);
 							int32_t *bj = bj_array[index];
 							int32_t *aj = a + m;
-							for (uint32_t k = 0; k < rh; ++k)
-								bj[k] = aj[k * stride];
-							wavelet.encode_line(bj, (int32_t)d_n, (int32_t)s_n, cas_col);
-							dwt_utils::deinterleave_v(bj, aj, d_n, s_n, stride, cas_col);
+							dwt_utils::interleave_v_mcols(aj, bj, rh, stride, cols);
+							wavelet.encode_v_mcols(bj, (int32_t)d_n, (int32_t)s_n, cas_col);
+							dwt_utils::deinterleave_v_mcols(bj, aj, d_n, s_n, stride, cas_col, cols);
 						}
 						return 0;
 					})
@@ -124,9 +378,9 @@ template <typename DWT> bool WaveletForward<DWT>::run(TileComponent *tilec){
 		if (rh){
 			const uint32_t s_n = rw_next;
 			const uint32_t d_n = rw - rw_next;
-			const uint32_t linesPerThreadH = static_cast<uint32_t>(std::ceil((float)rh / (float)ThreadPool::hardware_concurrency()));
+			const uint32_t linesPerThreadH = static_cast<uint32_t>(std::ceil((float)rh / (float)num_jobs));
 			std::vector< std::future<int> > results;
-			for(uint32_t i = 0; i < ThreadPool::hardware_concurrency(); ++i) {
+			for(uint32_t i = 0; i < num_jobs; ++i) {
 				uint32_t index = i;
 				results.emplace_back(
 					ThreadPool::get()->enqueue([index, bj_array,a,
@@ -138,9 +392,7 @@ template <typename DWT> bool WaveletForward<DWT>::run(TileComponent *tilec){
 								m < std::min<uint32_t>((index+1)*linesPerThreadH, rh); ++m) {
 							int32_t *bj = bj_array[index];
 							int32_t *aj = a + m * stride;
-							memcpy(bj,aj,rw << 2);
-							wavelet.encode_line(bj, (int32_t)d_n, (int32_t)s_n, cas_row);
-							dwt_utils::deinterleave_h(bj, aj, d_n, s_n, cas_row);
+							wavelet.encode_and_deinterleave_h(aj, bj, d_n, s_n, cas_row);
 						}
 						return 0;
 					})
@@ -154,10 +406,63 @@ template <typename DWT> bool WaveletForward<DWT>::run(TileComponent *tilec){
 		next_res--;
 	}
 cleanup:
-	for (uint32_t i = 0; i < ThreadPool::hardware_concurrency(); ++i)
+	for (uint32_t i = 0; i < num_jobs; ++i)
 		grk_aligned_free(bj_array[i]);
 	delete[] bj_array;
 	return rc;
 }
 
+/**
+ Forward wavelet transform in 2-D.
+ @param tilec Tile component information (current tile)
+ */
+template <typename DWT> bool WaveletForward<DWT>::run(TileComponent *tilec){
+	if (tilec->numresolutions == 1U)
+		return true;
+
+	auto tr_max = tilec->resolutions + tilec->numresolutions - 1;
+	uint32_t stride = tilec->width();
+	uint32_t rh = tr_max->y1 - tr_max->y0;
+	if ((uint64_t) stride * rh > dwt_line_max_samples)
+		return run_levels(tilec);
+	auto out = (int32_t*) grk_aligned_malloc(
+			std::max<size_t>((size_t) stride * rh, 1) * sizeof(int32_t));
+	if (!out) {
+		GROK_ERROR("Out of memory");
+		return false;
+	}
+	uint32_t num_jobs = (uint32_t) std::min<size_t>(
+			ThreadPool::get()->num_jobs(), rh);
+	bool rc = true;
+	if (num_jobs <= 1) {
+		rc = run_band(tilec, out, 0, 1);
+	} else {
+		std::vector<std::future<bool> > results;
+		for (uint32_t j = 0; j < num_jobs; ++j) {
+			results.emplace_back(
+					ThreadPool::get()->enqueue([this, tilec, out, j, num_jobs] {
+						return run_band(tilec, out, j, num_jobs);
+					}));
+		}
+		for (auto &&result : results) {
+			if (!result.get())
+				rc = false;
+		}
+	}
+	if (!rc) {
+		grk_aligned_free(out);
+		return false;
+	}
+	auto buf = tilec->buf;
+	if (buf->owns_data) {
+		grk_aligned_free(buf->data);
+		buf->data = out;
+	} else {
+		memcpy(buf->data, out, (size_t) stride * rh * sizeof(int32_t));
+		grk_aligned_free(out);
+	}
+
+	return true;
+}
+
 }
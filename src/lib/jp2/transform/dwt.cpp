@@ -61,10 +61,12 @@
 #include "grok_includes.h"
 #include "dwt.h"
 #include <algorithm>
+#include <vector>
 
 using namespace std;
 
 namespace grk {
+namespace GRK_SIMD_NS {
 
 
 #define GRK_WS(i) v->mem[(i)*2]
@@ -133,23 +135,35 @@ template <typename T> struct dwt_data {
 };
 
 
-struct  v4_data {
-	v4_data() {
-		f[0]=0;
-		f[1]=0;
-		f[2]=0;
-		f[3]=0;
+/** Number of rows (horizontal pass) or columns (vertical pass) */
+/** that are lifted together in the 9x7 transform: one SIMD register */
+#define NB_ELTS_97     VREG_INT_COUNT
+
+/* One sample from each of NB_ELTS_97 rows or columns */
+struct  vec_data {
+	vec_data() : vec_data(0) {
 	}
-	v4_data(float m){
-		f[0]=m;
-		f[1]=m;
-		f[2]=m;
-		f[3]=m;
+	vec_data(float m){
+		for (uint32_t i = 0; i < NB_ELTS_97; ++i)
+			f[i] = m;
 	}
-    float f[4];
+    float f[NB_ELTS_97];
 };
 
 
+/* One sample from each of PLL_COLS_53 rows (horizontal pass) */
+/* or columns (vertical pass), lifted together in the partial */
+/* 5x3 transform */
+struct  mcols_data_53 {
+	mcols_data_53() : mcols_data_53(0) {
+	}
+	mcols_data_53(int32_t m){
+		for (uint32_t i = 0; i < PLL_COLS_53; ++i)
+			v[i] = m;
+	}
+    int32_t v[PLL_COLS_53];
+};
+
 template <typename T, typename S> struct decode_job{
 	decode_job( S data,
 				uint32_t w,
@@ -190,36 +204,36 @@ static bool decode_tile_53(TileComponent* tilec, uint32_t i);
 /* <summary>                             */
 /* Inverse 9-7 wavelet transform in 1-D. */
 /* </summary>                            */
-static void decode_step_97(dwt_data<v4_data>* GRK_RESTRICT dwt);
+static void decode_step_97(dwt_data<vec_data>* GRK_RESTRICT dwt);
 
-static void interleave_h_97(dwt_data<v4_data>* GRK_RESTRICT dwt,
+static void interleave_h_97(dwt_data<vec_data>* GRK_RESTRICT dwt,
                                    float* GRK_RESTRICT a,
                                    uint32_t width,
                                    uint32_t remaining_height);
 
-static void interleave_v_97(dwt_data<v4_data>* GRK_RESTRICT dwt,
+static void interleave_v_97(dwt_data<vec_data>* GRK_RESTRICT dwt,
                                    float* GRK_RESTRICT a,
                                    uint32_t width,
                                    uint32_t nb_elts_read);
 
-#ifdef __SSE__
-static void decode_step1_sse_97(v4_data* w,
+#if (defined(__SSE2__) || defined(__AVX2__))
+static void decode_step1_simd_97(vec_data* w,
                                        uint32_t start,
                                        uint32_t end,
-                                       const __m128 c);
+                                       const VREGF c);
 
-static void decode_step2_sse_97(v4_data* l, v4_data* w,
+static void decode_step2_simd_97(vec_data* l, vec_data* w,
                                        uint32_t start,
                                        uint32_t end,
-                                       uint32_t m, __m128 c);
+                                       uint32_t m, VREGF c);
 
 #else
-static void decode_step1_97(v4_data* w,
+static void decode_step1_97(vec_data* w,
                                    uint32_t start,
                                    uint32_t end,
                                    const float c);
 
-static void decode_step2_97(v4_data* l, v4_data* w,
+static void decode_step2_97(vec_data* l, vec_data* w,
                                    uint32_t start,
                                    uint32_t end,
                                    uint32_t m,
@@ -238,14 +252,6 @@ template <typename T, uint32_t HORIZ_STEP, uint32_t VERT_STEP, uint32_t FILTER_W
 
 /*@}*/
 
-#define GRK_S(i) a[(i)*2]
-#define GRK_D(i) a[(1+(i)*2)]
-#define GRK_S_(i) ((i)<0?GRK_S(0):((i)>=sn?GRK_S(sn-1):GRK_S(i)))
-#define GRK_D_(i) ((i)<0?GRK_D(0):((i)>=dn?GRK_D(dn-1):GRK_D(i)))
-/* new */
-#define GRK_SS_(i) ((i)<0?GRK_S(0):((i)>=dn?GRK_S(dn-1):GRK_S(i)))
-#define GRK_DD_(i) ((i)<0?GRK_D(0):((i)>=sn?GRK_D(sn-1):GRK_D(i)))
-
 
 /*
 ==========================================================
@@ -254,16 +260,14 @@ template <typename T, uint32_t HORIZ_STEP, uint32_t VERT_STEP, uint32_t FILTER_W
 */
 
 static void  decode_h_cas0_53(int32_t* tmp,
-                               const int32_t sn,
-                               const int32_t len,
-                               int32_t* tiledp){
+                               const int32_t* in_even,
+                               const int32_t* in_odd,
+                               const int32_t len){
     assert(len > 1);
 
     /* Improved version of the TWO_PASS_VERSION: */
     /* Performs lifting in one single iteration. Saves memory */
     /* accesses and explicit interleaving. */
-    const int32_t* in_even = tiledp;
-    const int32_t* in_odd = tiledp + sn;
     int32_t s1n = in_even[0];
     int32_t d1n = in_odd[0];
     int32_t s0n = s1n - ((d1n + 1) >> 1);
@@ -290,20 +294,17 @@ static void  decode_h_cas0_53(int32_t* tmp,
     } else {
         tmp[len - 1] = d1n + s0n;
     }
-    memcpy(tiledp, tmp, (uint32_t)len * sizeof(int32_t));
 }
 
 static void  decode_h_cas1_53(int32_t* tmp,
-                               const int32_t sn,
-                               const int32_t len,
-                               int32_t* tiledp){
+                               const int32_t* in_even,
+                               const int32_t* in_odd,
+                               const int32_t len){
     assert(len > 2);
 
     /* Improved version of the TWO_PASS_VERSION:
        Performs lifting in one single iteration. Saves memory
        accesses and explicit interleaving. */
-    const int32_t* in_even = tiledp + sn;
-    const int32_t* in_odd = tiledp;
     int32_t s1 = in_even[1];
     int32_t dc = in_odd[0] - ((in_even[0] + s1 + 2) >> 2);
     tmp[0] = in_even[0] + dc;
@@ -328,40 +329,49 @@ static void  decode_h_cas1_53(int32_t* tmp,
     } else {
         tmp[len - 1] = s1 + dc;
     }
-    memcpy(tiledp, tmp, (uint32_t)len * sizeof(int32_t));
 }
 
 /* <summary>                            */
 /* Inverse 5-3 wavelet transform in 1-D for one row. */
 /* </summary>                           */
-/* Performs interleave, inverse wavelet transform and copy back to buffer */
-static void decode_h_53(const dwt_data<int32_t> *dwt,
-                         int32_t* tiledp)
+/* Performs interleave and inverse wavelet transform of low pass samples */
+/* in_l and high pass samples in_h into out */
+static void decode_h_53(const int32_t* in_l,
+                         const int32_t* in_h,
+                         int32_t* out,
+                         const int32_t sn,
+                         const int32_t dn,
+                         const int32_t cas)
 {
-    const int32_t sn = dwt->sn;
-    const int32_t len = sn + dwt->dn;
-    if (dwt->cas == 0) { /* Left-most sample is on even coordinate */
+    const int32_t len = sn + dn;
+    if (cas == 0) { /* Left-most sample is on even coordinate */
         if (len > 1) {
-            decode_h_cas0_53(dwt->mem, sn, len, tiledp);
-        } else {
+            decode_h_cas0_53(out, in_l, in_h, len);
+        } else if (len == 1) {
             /* Unmodified value */
+            out[0] = in_l[0];
         }
     } else { /* Left-most sample is on odd coordinate */
         if (len == 1) {
-            tiledp[0] /= 2;
+            out[0] = in_h[0] / 2;
         } else if (len == 2) {
-            int32_t* out = dwt->mem;
-            const int32_t* in_even = &tiledp[sn];
-            const int32_t* in_odd = &tiledp[0];
-            out[1] = in_odd[0] - ((in_even[0] + 1) >> 1);
-            out[0] = in_even[0] + out[1];
-            memcpy(tiledp, dwt->mem, (uint32_t)len * sizeof(int32_t));
+            out[1] = in_l[0] - ((in_h[0] + 1) >> 1);
+            out[0] = in_h[0] + out[1];
         } else if (len > 2) {
-            decode_h_cas1_53(dwt->mem, sn, len, tiledp);
+            decode_h_cas1_53(out, in_h, in_l, len);
         }
     }
 }
 
+/* Performs interleave, inverse wavelet transform and copy back to buffer */
+static void decode_h_53(const dwt_data<int32_t> *dwt,
+                         int32_t* tiledp)
+{
+    const int32_t len = dwt->sn + dwt->dn;
+    decode_h_53(tiledp, tiledp + dwt->sn, dwt->mem, dwt->sn, dwt->dn, dwt->cas);
+    memcpy(tiledp, dwt->mem, (uint32_t)len * sizeof(int32_t));
+}
+
 #if (defined(__SSE2__) || defined(__AVX2__))
 
 #define ADD3(x,y,z) ADD(ADD(x,y),z)
@@ -383,8 +393,8 @@ void decode_v_final_memcpy_53(int32_t* tiledp_col,
     }
 }
 
-/** Vertical inverse 5x3 wavelet transform for 8 columns in SSE2, or
- * 16 in AVX2, when top-most pixel is on even coordinate */
+/** Vertical inverse 5x3 wavelet transform for 8 columns in SSE2, 16 in AVX2
+ * or 32 in AVX-512, when top-most pixel is on even coordinate */
 static void decode_v_cas0_mcols_SSE2_OR_AVX2_53(int32_t* tmp,
 												const int32_t sn,
 												const int32_t len,
@@ -395,13 +405,8 @@ static void decode_v_cas0_mcols_SSE2_OR_AVX2_53(int32_t* tmp,
     const VREG two = LOAD_CST(2);
 
     assert(len > 1);
-#if __AVX2__
-    assert(PLL_COLS_53 == 16);
-    assert(VREG_INT_COUNT == 8);
-#else
-    assert(PLL_COLS_53 == 8);
-    assert(VREG_INT_COUNT == 4);
-#endif
+    /* each row of tmp holds two registers */
+    assert(PLL_COLS_53 == 2 * VREG_INT_COUNT);
 
     /* Note: loads of input even/odd values must be done in a unaligned */
     /* fashion. But stores in tmp can be done with aligned store, since */
@@ -470,8 +475,8 @@ static void decode_v_cas0_mcols_SSE2_OR_AVX2_53(int32_t* tmp,
 }
 
 
-/** Vertical inverse 5x3 wavelet transform for 8 columns in SSE2, or
- * 16 in AVX2, when top-most pixel is on odd coordinate */
+/** Vertical inverse 5x3 wavelet transform for 8 columns in SSE2, 16 in AVX2
+ * or 32 in AVX-512, when top-most pixel is on odd coordinate */
 static void decode_v_cas1_mcols_SSE2_OR_AVX2_53(int32_t* tmp,
 												const int32_t sn,
 												const int32_t len,
@@ -483,13 +488,8 @@ static void decode_v_cas1_mcols_SSE2_OR_AVX2_53(int32_t* tmp,
     const VREG two = LOAD_CST(2);
 
     assert(len > 2);
-#if __AVX2__
-    assert(PLL_COLS_53 == 16);
-    assert(VREG_INT_COUNT == 8);
-#else
-    assert(PLL_COLS_53 == 8);
-    assert(VREG_INT_COUNT == 4);
-#endif
+    /* each row of tmp holds two registers */
+    assert(PLL_COLS_53 == 2 * VREG_INT_COUNT);
 
     /* Note: loads of input even/odd values must be done in a unaligned */
     /* fashion. But stores in tmp can be done with aligned store, since */
@@ -550,6 +550,73 @@ static void decode_v_cas1_mcols_SSE2_OR_AVX2_53(int32_t* tmp,
     decode_v_final_memcpy_53(tiledp_col, tmp, len, stride);
 }
 
+/** l -= (h0 + h1 + 2) >> 2, for PLL_COLS_53 columns */
+static inline void decode_partial_lift_l_mcols_53(int32_t* l,
+												 const int32_t* h0,
+												 const int32_t* h1){
+    const VREG two = LOAD_CST(2);
+    for (uint32_t k = 0; k < PLL_COLS_53; k += VREG_INT_COUNT)
+        STORE(l + k, SUB(LOAD(l + k), SAR(ADD3(LOAD(h0 + k), LOAD(h1 + k), two), 2)));
+}
+
+/** h += (l0 + l1) >> 1, for PLL_COLS_53 columns */
+static inline void decode_partial_lift_h_mcols_53(int32_t* h,
+												 const int32_t* l0,
+												 const int32_t* l1){
+    for (uint32_t k = 0; k < PLL_COLS_53; k += VREG_INT_COUNT)
+        STORE(h + k, ADD(LOAD(h + k), SAR(ADD(LOAD(l0 + k), LOAD(l1 + k)), 1)));
+}
+
+/** l[i] -= (h[i] + h[i + 1] + 2) >> 2, for i in [i0, i1) */
+static void decode_partial_lift_l_row_53(int32_t* l,
+										const int32_t* h,
+										int32_t i0,
+										int32_t i1){
+    const VREG two = LOAD_CST(2);
+    int32_t i = i0;
+    for (; i + VREG_INT_COUNT <= i1; i += VREG_INT_COUNT)
+        STOREU(l + i, SUB(LOADU(l + i), SAR(ADD3(LOADU(h + i), LOADU(h + i + 1), two), 2)));
+    for (; i < i1; ++i)
+        l[i] -= (h[i] + h[i + 1] + 2) >> 2;
+}
+
+/** h[i] += (l[i] + l[i + 1]) >> 1, for i in [i0, i1) */
+static void decode_partial_lift_h_row_53(int32_t* h,
+										const int32_t* l,
+										int32_t i0,
+										int32_t i1){
+    int32_t i = i0;
+    for (; i + VREG_INT_COUNT <= i1; i += VREG_INT_COUNT)
+        STOREU(h + i, ADD(LOADU(h + i), SAR(ADD(LOADU(l + i), LOADU(l + i + 1)), 1)));
+    for (; i < i1; ++i)
+        h[i] += (l[i] + l[i + 1]) >> 1;
+}
+
+/** l[i] -= (h0[i] + h1[i] + 2) >> 2, for i in [0, len) */
+static void decode_line_lift_l_53(int32_t* l,
+								 const int32_t* h0,
+								 const int32_t* h1,
+								 uint32_t len){
+    const VREG two = LOAD_CST(2);
+    uint32_t i = 0;
+    for (; i + VREG_INT_COUNT <= len; i += VREG_INT_COUNT)
+        STOREU(l + i, SUB(LOADU(l + i), SAR(ADD3(LOADU(h0 + i), LOADU(h1 + i), two), 2)));
+    for (; i < len; ++i)
+        l[i] -= (h0[i] + h1[i] + 2) >> 2;
+}
+
+/** h[i] += (l0[i] + l1[i]) >> 1, for i in [0, len) */
+static void decode_line_lift_h_53(int32_t* h,
+								 const int32_t* l0,
+								 const int32_t* l1,
+								 uint32_t len){
+    uint32_t i = 0;
+    for (; i + VREG_INT_COUNT <= len; i += VREG_INT_COUNT)
+        STOREU(h + i, ADD(LOADU(h + i), SAR(ADD(LOADU(l0 + i), LOADU(l1 + i)), 1)));
+    for (; i < len; ++i)
+        h[i] += (l0[i] + l1[i]) >> 1;
+}
+
 #undef VREG
 #undef LOAD_CST
 #undef LOADU
@@ -561,6 +628,54 @@ static void decode_v_cas1_mcols_SSE2_OR_AVX2_53(int32_t* tmp,
 #undef SUB
 #undef SAR
 
+#else
+
+static inline void decode_partial_lift_l_mcols_53(int32_t* l,
+												 const int32_t* h0,
+												 const int32_t* h1){
+    for (uint32_t k = 0; k < PLL_COLS_53; ++k)
+        l[k] -= (h0[k] + h1[k] + 2) >> 2;
+}
+
+static inline void decode_partial_lift_h_mcols_53(int32_t* h,
+												 const int32_t* l0,
+												 const int32_t* l1){
+    for (uint32_t k = 0; k < PLL_COLS_53; ++k)
+        h[k] += (l0[k] + l1[k]) >> 1;
+}
+
+static void decode_partial_lift_l_row_53(int32_t* l,
+										const int32_t* h,
+										int32_t i0,
+										int32_t i1){
+    for (int32_t i = i0; i < i1; ++i)
+        l[i] -= (h[i] + h[i + 1] + 2) >> 2;
+}
+
+static void decode_partial_lift_h_row_53(int32_t* h,
+										const int32_t* l,
+										int32_t i0,
+										int32_t i1){
+    for (int32_t i = i0; i < i1; ++i)
+        h[i] += (l[i] + l[i + 1]) >> 1;
+}
+
+static void decode_line_lift_l_53(int32_t* l,
+								 const int32_t* h0,
+								 const int32_t* h1,
+								 uint32_t len){
+    for (uint32_t i = 0; i < len; ++i)
+        l[i] -= (h0[i] + h1[i] + 2) >> 2;
+}
+
+static void decode_line_lift_h_53(int32_t* h,
+								 const int32_t* l0,
+								 const int32_t* l1,
+								 uint32_t len){
+    for (uint32_t i = 0; i < len; ++i)
+        h[i] += (l0[i] + l1[i]) >> 1;
+}
+
 #endif /* (defined(__SSE2__) || defined(__AVX2__)) */
 
 /** Vertical inverse 5x3 wavelet transform for one column, when top-most
@@ -735,7 +850,7 @@ static bool decode_tile_53( TileComponent* tilec, uint32_t numres){
     uint32_t w = (uint32_t)(tilec->resolutions[tilec->minimum_num_resolutions - 1].x1 -
                                 tilec->resolutions[tilec->minimum_num_resolutions - 1].x0);
 
-    size_t num_threads = ThreadPool::get()->num_threads();
+    size_t num_threads = ThreadPool::get()->num_jobs();
     size_t h_mem_size = dwt_utils::max_resolution(tr, numres);
     /* overflow check */
     if (h_mem_size > (SIZE_MAX / PLL_COLS_53 / sizeof(int32_t))) {
@@ -857,275 +972,179 @@ static bool decode_tile_53( TileComponent* tilec, uint32_t numres){
     return rc;
 }
 
-static void interleave_partial_h_53(dwt_data<int32_t> *dwt,
-									sparse_array* sa,
-									uint32_t sa_line)	{
+/*
+ The horizontal pass of the partial 5/3 transform works on PLL_COLS_53 rows,
+ stored one after the other with a pitch of partial_h_pitch_53() samples.
+ Each row holds its low band and its high band, each padded by one sample
+ on either side for symmetric extension, and then the interleaved output.
+ Bands are lifted in place, one SIMD register of samples at a time, so
+ that rows are read from and written to the sparse array without any
+ transposition.
+ */
+static uint32_t partial_h_pitch_53(const dwt_data<mcols_data_53> *dwt){
+	uint32_t len = (uint32_t)(dwt->sn + dwt->dn);
+	return (2 * len + 4 + PLL_COLS_53 - 1) & ~(PLL_COLS_53 - 1);
+}
+static int32_t* partial_h_low_53(const dwt_data<mcols_data_53> *dwt){
+	return (int32_t*)dwt->mem + 1;
+}
+static int32_t* partial_h_high_53(const dwt_data<mcols_data_53> *dwt){
+	return partial_h_low_53(dwt) + dwt->sn + 2;
+}
+static int32_t* partial_h_out_53(const dwt_data<mcols_data_53> *dwt){
+	return partial_h_high_53(dwt) + dwt->dn + 1;
+}
 
-	int32_t *dest = dwt->mem;
-	int32_t cas = dwt->cas;
+static void interleave_partial_h_53(dwt_data<mcols_data_53> *dwt,
+									sparse_array* sa,
+									uint32_t sa_line,
+									uint32_t num_rows)	{
+	uint32_t pitch = partial_h_pitch_53(dwt);
 	uint32_t sn = (uint32_t)dwt->sn;
-	uint32_t win_l_x0 = dwt->win_l_x0;
-	uint32_t win_l_x1 = dwt->win_l_x1;
-	uint32_t win_h_x0 = dwt->win_h_x0;
-	uint32_t win_h_x1 = dwt->win_h_x1;
-
-    bool ret = sa->read( win_l_x0, sa_line,
-					  win_l_x1, sa_line + 1,
-					  dest + cas + 2 * win_l_x0,
-					  2, 0, true);
+
+    bool ret = sa->read( dwt->win_l_x0, sa_line,
+					  dwt->win_l_x1, sa_line + num_rows,
+					  partial_h_low_53(dwt) + dwt->win_l_x0,
+					  1, pitch, true);
     assert(ret);
-    ret = sa->read(sn + win_h_x0, sa_line,
-				  sn + win_h_x1, sa_line + 1,
-				  dest + 1 - cas + 2 * win_h_x0,
-				  2, 0, true);
+    ret = sa->read(sn + dwt->win_h_x0, sa_line,
+				  sn + dwt->win_h_x1, sa_line + num_rows,
+				  partial_h_high_53(dwt) + dwt->win_h_x0,
+				  1, pitch, true);
     assert(ret);
     GRK_UNUSED(ret);
 }
 
+static void decode_partial_h_53(dwt_data<mcols_data_53> *dwt){
+	const int32_t dn = dwt->dn;
+	const int32_t sn = dwt->sn;
+	const int32_t cas = dwt->cas;
+	const uint32_t pitch = partial_h_pitch_53(dwt);
+	/* offset of the left neighbour of a low (resp. high) sample */
+	/* in the high (resp. low) band */
+	const int32_t ol = cas ? 0 : -1;
+	const int32_t oh = cas ? -1 : 0;
+
+	for (uint32_t r = 0; r < PLL_COLS_53; ++r) {
+		int32_t* l = partial_h_low_53(dwt) + (size_t)r * pitch;
+		int32_t* h = partial_h_high_53(dwt) + (size_t)r * pitch;
+
+		if (sn + dn <= 1) { /* NEW :  CASE ONE ELEMENT */
+			if (cas && dn == 1)
+				h[0] /= 2;
+			continue;
+		}
+		h[-1] = h[0];
+		h[dn] = h[dn - 1];
+		decode_partial_lift_l_row_53(l, h + ol,
+				(int32_t)dwt->win_l_x0, (int32_t)dwt->win_l_x1);
+		l[-1] = l[0];
+		l[sn] = l[sn - 1];
+		decode_partial_lift_h_row_53(h, l + oh,
+				(int32_t)dwt->win_h_x0, (int32_t)dwt->win_h_x1);
+	}
+}
+
+/* interleave bands of the output window, and write them */
+static bool write_partial_h_53(dwt_data<mcols_data_53> *dwt,
+								sparse_array* sa,
+								uint32_t win_tr_x0,
+								uint32_t win_tr_x1,
+								uint32_t sa_line,
+								uint32_t num_rows){
+	const int32_t dn = dwt->dn;
+	const int32_t sn = dwt->sn;
+	const int32_t cas = dwt->cas;
+	const uint32_t pitch = partial_h_pitch_53(dwt);
+	/* band indices covering the output window */
+	const int32_t i0 = (int32_t)(win_tr_x0 >> 1);
+	const int32_t il1 = std::min<int32_t>((int32_t)((win_tr_x1 + 1) >> 1), sn);
+	const int32_t ih1 = std::min<int32_t>((int32_t)((win_tr_x1 + 1) >> 1), dn);
+
+	for (uint32_t r = 0; r < num_rows; ++r) {
+		const int32_t* l = partial_h_low_53(dwt) + (size_t)r * pitch;
+		const int32_t* h = partial_h_high_53(dwt) + (size_t)r * pitch;
+		int32_t* out = partial_h_out_53(dwt) + (size_t)r * pitch;
+		for (int32_t i = i0; i < il1; ++i)
+			out[cas + 2 * i] = l[i];
+		for (int32_t i = i0; i < ih1; ++i)
+			out[1 - cas + 2 * i] = h[i];
+	}
+	return sa->write(win_tr_x0,
+					  sa_line,
+					  win_tr_x1,
+					  sa_line + num_rows,
+					  partial_h_out_53(dwt) + win_tr_x0,
+					  1,
+					  pitch,
+					  true);
+}
 
-static void interleave_partial_v_53(dwt_data<int32_t> *vert,
+static void interleave_partial_v_53(dwt_data<mcols_data_53> *vert,
 									sparse_array* sa,
 									uint32_t sa_col,
 									uint32_t nb_cols){
-	int32_t *dest = vert->mem;
-	int32_t cas = vert->cas;
+	auto dest = (int32_t*)vert->mem;
+	uint32_t cas = (uint32_t)vert->cas;
 	uint32_t sn = (uint32_t)vert->sn;
-	uint32_t win_l_y0 = vert->win_l_x0;
-	uint32_t win_l_y1 = vert->win_l_x1;
-	uint32_t win_h_y0 = vert->win_h_x0;
-	uint32_t win_h_y1 = vert->win_h_x1;
-
-    bool ret = sa->read(sa_col, win_l_y0,
-					   sa_col + nb_cols, win_l_y1,
-					   dest + cas * 4 + 2 * 4 * win_l_y0,
-					   1, 2 * 4, true);
+
+	/* column i of the batch goes to lane i */
+    bool ret = sa->read(sa_col, vert->win_l_x0,
+					   sa_col + nb_cols, vert->win_l_x1,
+					   dest + (cas + 2 * vert->win_l_x0) * PLL_COLS_53,
+					   1, 2 * PLL_COLS_53, true);
     assert(ret);
-    ret = sa->read( sa_col, sn + win_h_y0,
-					  sa_col + nb_cols, sn + win_h_y1,
-					  dest + (1 - cas) * 4 + 2 * 4 * win_h_y0,
-					  1, 2 * 4, true);
+    ret = sa->read( sa_col, sn + vert->win_h_x0,
+					  sa_col + nb_cols, sn + vert->win_h_x1,
+					  dest + (1 - cas + 2 * vert->win_h_x0) * PLL_COLS_53,
+					  1, 2 * PLL_COLS_53, true);
     assert(ret);
     GRK_UNUSED(ret);
 }
 
-static void decode_partial_h_53(dwt_data<int32_t> *horiz){
-    int32_t i;
-    int32_t *a = horiz->mem;
-	int32_t dn = horiz->dn;
-	int32_t sn = horiz->sn;
-	 int32_t cas = horiz->cas;
-	 int32_t win_l_x0 = (int32_t)horiz->win_l_x0;
-	 int32_t win_l_x1 = (int32_t)horiz->win_l_x1;
-	 int32_t win_h_x0 = (int32_t)horiz->win_h_x0;
-	 int32_t win_h_x1 = (int32_t)horiz->win_h_x1;
-
-    if (!cas) {
-        if ((dn > 0) || (sn > 1)) { /* NEW :  CASE ONE ELEMENT */
-
-            /* Naive version is :
-            for (i = win_l_x0; i < i_max; i++) {
-                GRK_S(i) -= (GRK_D_(i - 1) + GRK_D_(i) + 2) >> 2;
-            }
-            for (i = win_h_x0; i < win_h_x1; i++) {
-                GRK_D(i) += (GRK_S_(i) + GRK_S_(i + 1)) >> 1;
-            }
-            but the compiler doesn't manage to unroll it to avoid bound
-            checking in GRK_S_ and GRK_D_ macros
-            */
-
-            i = win_l_x0;
-            if (i < win_l_x1) {
-                int32_t i_max;
-
-                /* Left-most case */
-                GRK_S(i) -= (GRK_D_(i - 1) + GRK_D_(i) + 2) >> 2;
-                i ++;
-
-                i_max = win_l_x1;
-                if (i_max > dn) {
-                    i_max = dn;
-                }
-                for (; i < i_max; i++) {
-                    /* No bound checking */
-                    GRK_S(i) -= (GRK_D(i - 1) + GRK_D(i) + 2) >> 2;
-                }
-                for (; i < win_l_x1; i++) {
-                    /* Right-most case */
-                    GRK_S(i) -= (GRK_D_(i - 1) + GRK_D_(i) + 2) >> 2;
-                }
-            }
-
-            i = win_h_x0;
-            if (i < win_h_x1) {
-                int32_t i_max = win_h_x1;
-                if (i_max >= sn) {
-                    i_max = sn - 1;
-                }
-                for (; i < i_max; i++) {
-                    /* No bound checking */
-                    GRK_D(i) += (GRK_S(i) + GRK_S(i + 1)) >> 1;
-                }
-                for (; i < win_h_x1; i++) {
-                    /* Right-most case */
-                    GRK_D(i) += (GRK_S_(i) + GRK_S_(i + 1)) >> 1;
-                }
-            }
-        }
-    } else {
-        if (!sn  && dn == 1) {        /* NEW :  CASE ONE ELEMENT */
-            GRK_S(0) /= 2;
-        } else {
-            for (i = win_l_x0; i < win_l_x1; i++) {
-                GRK_D(i) -= (GRK_SS_(i) + GRK_SS_(i + 1) + 2) >> 2;
-            }
-            for (i = win_h_x0; i < win_h_x1; i++) {
-                GRK_S(i) += (GRK_DD_(i) + GRK_DD_(i - 1)) >> 1;
-            }
-        }
-    }
+/* clamp band index i to [0, n-1] */
+static inline int32_t clamp_band_index_53(int32_t i, int32_t n){
+	return i < 0 ? 0 : (i >= n ? n - 1 : i);
 }
 
-#define GRK_S_off(i,off) a[(uint32_t)(i)*2*4+off]
-#define GRK_D_off(i,off) a[(1+(uint32_t)(i)*2)*4+off]
-#define GRK_S__off(i,off) ((i)<0?GRK_S_off(0,off):((i)>=sn?GRK_S_off(sn-1,off):GRK_S_off(i,off)))
-#define GRK_D__off(i,off) ((i)<0?GRK_D_off(0,off):((i)>=dn?GRK_D_off(dn-1,off):GRK_D_off(i,off)))
-#define GRK_SS__off(i,off) ((i)<0?GRK_S_off(0,off):((i)>=dn?GRK_S_off(dn-1,off):GRK_S_off(i,off)))
-#define GRK_DD__off(i,off) ((i)<0?GRK_D_off(0,off):((i)>=sn?GRK_D_off(sn-1,off):GRK_D_off(i,off)))
-
-static void decode_partial_v_53(dwt_data<int32_t> *vert){
-    int32_t i;
-    uint32_t off;
-    int32_t *a = vert->mem;
-	int32_t dn = vert->dn;
-	int32_t sn = vert->sn;
-	int32_t cas = vert->cas;
-	int32_t win_l_x0 = (int32_t)vert->win_l_x0;
-	int32_t win_l_x1 = (int32_t)vert->win_l_x1;
-	int32_t win_h_x0 = (int32_t)vert->win_h_x0;
-	int32_t win_h_x1 = (int32_t)vert->win_h_x1;
-
-
-    if (!cas) {
-        if ((dn > 0) || (sn > 1)) { /* NEW :  CASE ONE ELEMENT */
-
-            /* Naive version is :
-            for (i = win_l_x0; i < i_max; i++) {
-                GRK_S(i) -= (GRK_D_(i - 1) + GRK_D_(i) + 2) >> 2;
-            }
-            for (i = win_h_x0; i < win_h_x1; i++) {
-                GRK_D(i) += (GRK_S_(i) + GRK_S_(i + 1)) >> 1;
-            }
-            but the compiler doesn't manage to unroll it to avoid bound
-            checking in GRK_S_ and GRK_D_ macros
-            */
-
-            i = win_l_x0;
-            if (i < win_l_x1) {
-                int32_t i_max;
-
-                /* Left-most case */
-                for (off = 0; off < 4; off++) {
-                    GRK_S_off(i, off) -= (GRK_D__off(i - 1, off) + GRK_D__off(i, off) + 2) >> 2;
-                }
-                i ++;
-
-                i_max = win_l_x1;
-                if (i_max > dn) {
-                    i_max = dn;
-                }
-
-#ifdef __SSE2__
-                if (i + 1 < i_max) {
-                    const __m128i two = _mm_set1_epi32(2);
-                    __m128i Dm1 = _mm_load_si128((__m128i *)(a + 4 + (i - 1) * 8));
-                    for (; i + 1 < i_max; i += 2) {
-                        /* No bound checking */
-                        __m128i S = _mm_load_si128((__m128i *)(a + i * 8));
-                        __m128i D = _mm_load_si128((__m128i *)(a + 4 + i * 8));
-                        __m128i S1 = _mm_load_si128((__m128i *)(a + (i + 1) * 8));
-                        __m128i D1 = _mm_load_si128((__m128i *)(a + 4 + (i + 1) * 8));
-                        S = _mm_sub_epi32(S,
-                                          _mm_srai_epi32(_mm_add_epi32(_mm_add_epi32(Dm1, D), two), 2));
-                        S1 = _mm_sub_epi32(S1,
-                                           _mm_srai_epi32(_mm_add_epi32(_mm_add_epi32(D, D1), two), 2));
-                        _mm_store_si128((__m128i*)(a + i * 8), S);
-                        _mm_store_si128((__m128i*)(a + (i + 1) * 8), S1);
-                        Dm1 = D1;
-                    }
-                }
-#endif
-
-                for (; i < i_max; i++) {
-                    /* No bound checking */
-                    for (off = 0; off < 4; off++) {
-                        GRK_S_off(i, off) -= (GRK_D_off(i - 1, off) + GRK_D_off(i, off) + 2) >> 2;
-                    }
-                }
-                for (; i < win_l_x1; i++) {
-                    /* Right-most case */
-                    for (off = 0; off < 4; off++) {
-                        GRK_S_off(i, off) -= (GRK_D__off(i - 1, off) + GRK_D__off(i, off) + 2) >> 2;
-                    }
-                }
-            }
-
-            i = win_h_x0;
-            if (i < win_h_x1) {
-                int32_t i_max = win_h_x1;
-                if (i_max >= sn) {
-                    i_max = sn - 1;
-                }
-
-#ifdef __SSE2__
-                if (i + 1 < i_max) {
-                    __m128i S =  _mm_load_si128((__m128i *)(a + i * 8));
-                    for (; i + 1 < i_max; i += 2) {
-                        /* No bound checking */
-                        __m128i D = _mm_load_si128((__m128i *)(a + 4 + i * 8));
-                        __m128i S1 = _mm_load_si128((__m128i *)(a + (i + 1) * 8));
-                        __m128i D1 = _mm_load_si128((__m128i *)(a + 4 + (i + 1) * 8));
-                        __m128i S2 = _mm_load_si128((__m128i *)(a + (i + 2) * 8));
-                        D = _mm_add_epi32(D, _mm_srai_epi32(_mm_add_epi32(S, S1), 1));
-                        D1 = _mm_add_epi32(D1, _mm_srai_epi32(_mm_add_epi32(S1, S2), 1));
-                        _mm_store_si128((__m128i*)(a + 4 + i * 8), D);
-                        _mm_store_si128((__m128i*)(a + 4 + (i + 1) * 8), D1);
-                        S = S2;
-                    }
-                }
-#endif
+/* <summary>                                            */
+/* Inverse 5-3 wavelet transform in 1-D of PLL_COLS_53  */
+/* rows or columns, restricted to the window of interest */
+/* </summary>                                           */
+static void decode_partial_mcols_53(dwt_data<mcols_data_53> *dwt){
+    auto a = (int32_t*)dwt->mem;
+	const int32_t dn = dwt->dn;
+	const int32_t sn = dwt->sn;
+	const int32_t cas = dwt->cas;
+
+	if (sn + dn <= 1) { /* NEW :  CASE ONE ELEMENT */
+		if (cas && dn == 1) {
+			for (uint32_t k = 0; k < PLL_COLS_53; ++k)
+				a[k] /= 2;
+		}
+		return;
+	}
 
-                for (; i < i_max; i++) {
-                    /* No bound checking */
-                    for (off = 0; off < 4; off++) {
-                        GRK_D_off(i, off) += (GRK_S_off(i, off) + GRK_S_off(i + 1, off)) >> 1;
-                    }
-                }
-                for (; i < win_h_x1; i++) {
-                    /* Right-most case */
-                    for (off = 0; off < 4; off++) {
-                        GRK_D_off(i, off) += (GRK_S__off(i, off) + GRK_S__off(i + 1, off)) >> 1;
-                    }
-                }
-            }
-        }
-    } else {
-        if (!sn  && dn == 1) {        /* NEW :  CASE ONE ELEMENT */
-            for (off = 0; off < 4; off++) {
-                GRK_S_off(0, off) /= 2;
-            }
-        } else {
-            for (i = win_l_x0; i < win_l_x1; i++) {
-                for (off = 0; off < 4; off++) {
-                    GRK_D_off(i, off) -= (GRK_SS__off(i, off) + GRK_SS__off(i + 1, off) + 2) >> 2;
-                }
-            }
-            for (i = win_h_x0; i < win_h_x1; i++) {
-                for (off = 0; off < 4; off++) {
-                    GRK_S_off(i, off) += (GRK_DD__off(i, off) + GRK_DD__off(i - 1, off)) >> 1;
-                }
-            }
-        }
-    }
+	/* low sample i sits at cas + 2i, and high sample i at 1 - cas + 2i. */
+	/* ol (resp. oh) is the offset of the left neighbour of a low */
+	/* (resp. high) sample in the high (resp. low) band */
+	auto low = [a, cas](int32_t i){
+		return a + (size_t)(cas + 2 * i) * PLL_COLS_53;
+	};
+	auto high = [a, cas](int32_t i){
+		return a + (size_t)(1 - cas + 2 * i) * PLL_COLS_53;
+	};
+	const int32_t ol = cas ? 0 : -1;
+	const int32_t oh = cas ? -1 : 0;
+
+	for (int32_t i = (int32_t)dwt->win_l_x0; i < (int32_t)dwt->win_l_x1; i++)
+		decode_partial_lift_l_mcols_53(low(i),
+									high(clamp_band_index_53(i + ol, dn)),
+									high(clamp_band_index_53(i + ol + 1, dn)));
+	for (int32_t i = (int32_t)dwt->win_h_x0; i < (int32_t)dwt->win_h_x1; i++)
+		decode_partial_lift_h_mcols_53(high(i),
+									low(clamp_band_index_53(i + oh, sn)),
+									low(clamp_band_index_53(i + oh + 1, sn)));
 }
 
 static void get_band_coordinates(TileComponent* tilec,
@@ -1181,27 +1200,770 @@ static void segment_grow(uint32_t filter_width,
 
 class Partial53 {
 public:
-	void interleave_partial_h(dwt_data<int32_t>* dwt,
+	void interleave_partial_h(dwt_data<mcols_data_53>* dwt,
 								sparse_array* sa,
 								uint32_t sa_line,
 								uint32_t num_rows){
-		(void)num_rows;
-		interleave_partial_h_53(dwt,sa,sa_line);
+		interleave_partial_h_53(dwt,sa,sa_line,num_rows);
 	}
-	void decode_h(dwt_data<int32_t>* dwt){
+	void decode_h(dwt_data<mcols_data_53>* dwt){
 		decode_partial_h_53(dwt);
 	}
-	void interleave_partial_v(dwt_data<int32_t>* GRK_RESTRICT dwt,
+	bool write_partial_h(dwt_data<mcols_data_53>* dwt,
+								sparse_array* sa,
+								uint32_t win_tr_x0,
+								uint32_t win_tr_x1,
+								uint32_t sa_line,
+								uint32_t num_rows){
+		return write_partial_h_53(dwt, sa, win_tr_x0, win_tr_x1, sa_line, num_rows);
+	}
+	void interleave_partial_v(dwt_data<mcols_data_53>* GRK_RESTRICT dwt,
 								sparse_array* sa,
 								uint32_t sa_col,
 								uint32_t nb_elts_read){
 		interleave_partial_v_53(dwt,sa,sa_col,nb_elts_read);
 	}
-	void decode_v(dwt_data<int32_t>* dwt){
-		decode_partial_v_53(dwt);
+	void decode_v(dwt_data<mcols_data_53>* dwt){
+		decode_partial_mcols_53(dwt);
+	}
+	/* number of elements of scratch memory */
+	static size_t data_size(uint32_t max_resolution){
+		/* PLL_COLS_53 rows of partial_h_pitch_53() samples */
+		return 2 * (size_t)max_resolution + PLL_COLS_53 + 4;
 	}
 };
 
+/*
+ Line-based inverse transform for whole-tile decoding
+
+ Rather than transforming the whole tile component in place, one resolution
+ at a time, each resolution level keeps a ring of dwt_line_ring_rows rows.
+ A level produces its output rows on demand, top to bottom: an input row
+ is read from the level below (low pass columns) and from the tile
+ buffer (high pass columns), transformed horizontally, and then lifted
+ vertically as soon as its neighbours are available. All intermediate
+ resolutions therefore stay in cache, and every coefficient is read once.
+
+ Final rows can't be written back over the tile buffer, since the
+ coefficients below them are still needed, so the last level keeps its
+ rows in a new buffer, which then replaces the tile buffer.
+
+ With worker threads, final rows are split into one band per thread
+ (see LineBand). A level can start at any row: it first fetches the
+ num_steps rows above it, which is all that lifting reaches, so every
+ band computes exactly the rows a single pass would.
+
+ Lifting steps are numbered from 1: odd steps update low pass rows,
+ and even steps update high pass rows. Results are identical to
+ decode_tile_53 and decode_tile_97.
+ */
+
+/* a row, with the num_steps rows on either side that lifting reaches */
+const uint32_t dwt_line_ring_rows = 16;
+
+struct dwt_line_53 {
+	typedef int32_t T;
+	static const uint32_t num_steps = 2;
+
+	static void decode_h(const int32_t *in_l, const int32_t *in_h,
+			int32_t *out, int32_t *tmp, uint32_t sn, uint32_t dn,
+			uint32_t cas) {
+		GRK_UNUSED(tmp);
+		decode_h_53(in_l, in_h, out, (int32_t) sn, (int32_t) dn,
+				(int32_t) cas);
+	}
+	static void scale(int32_t *row, uint32_t len, bool low) {
+		GRK_UNUSED(row);
+		GRK_UNUSED(len);
+		GRK_UNUSED(low);
+	}
+	/* vertical transform of a single row */
+	static void decode_v_single(int32_t *row, uint32_t len, uint32_t cas) {
+		if (cas) {
+			for (uint32_t i = 0; i < len; ++i)
+				row[i] /= 2;
+		}
+	}
+	static void lift(uint32_t step, int32_t *GRK_RESTRICT dst,
+			const int32_t *GRK_RESTRICT a, const int32_t *GRK_RESTRICT b,
+			uint32_t len) {
+		if (step == 1)
+			decode_line_lift_l_53(dst, a, b, len);
+		else
+			decode_line_lift_h_53(dst, a, b, len);
+	}
+};
+
+/* dst[i] += c * (a[i] + b[i]), one SIMD register of samples at a time */
+static void decode_line_lift_97(float *GRK_RESTRICT dst, const float *a,
+		const float *b, uint32_t len, float c) {
+	uint32_t i = 0;
+#if (defined(__SSE2__) || defined(__AVX2__))
+	const VREGF vc = LOAD_CST_F(c);
+	for (; i + VREG_INT_COUNT <= len; i += VREG_INT_COUNT) {
+		VREGF s = ADDF(LOADUF(a + i), LOADUF(b + i));
+		STOREUF(dst + i, ADDF(LOADUF(dst + i), MULF(s, vc)));
+	}
+#endif
+	for (; i < len; ++i)
+		dst[i] = dst[i] + ((a[i] + b[i]) * c);
+}
+
+/* d[i] += c * (s[i+off] + s[i+off+1]), with symmetric extension of s */
+static void decode_lift_line_97(float *GRK_RESTRICT d, uint32_t dn,
+		float *GRK_RESTRICT s, uint32_t sn, int32_t off, float c) {
+	s[-1] = s[0];
+	s[sn] = s[sn - 1];
+	s += off;
+	decode_line_lift_97(d, s, s + 1, dn, c);
+}
+
+struct dwt_line_97 {
+	typedef float T;
+	static const uint32_t num_steps = 4;
+
+	/* tmp must hold sn + dn + 4 samples */
+	static void decode_h(const float *in_l, const float *in_h, float *out,
+			float *tmp, uint32_t sn, uint32_t dn, uint32_t cas) {
+		if (sn + dn < 2) {
+			if (sn + dn == 1)
+				out[0] = sn ? in_l[0] : in_h[0];
+			return;
+		}
+		float *l = tmp + 1;
+		float *h = l + sn + 2;
+		memcpy(l, in_l, sn * sizeof(float));
+		memcpy(h, in_h, dn * sizeof(float));
+		scale(l, sn, true);
+		scale(h, dn, false);
+		/* offset of left neighbour of a low (resp. high) sample
+		 * in high (resp. low) band */
+		int32_t ol = cas ? 0 : -1;
+		int32_t oh = cas ? -1 : 0;
+		decode_lift_line_97(l, sn, h, dn, ol, dwt_delta);
+		decode_lift_line_97(h, dn, l, sn, oh, dwt_gamma);
+		decode_lift_line_97(l, sn, h, dn, ol, dwt_beta);
+		decode_lift_line_97(h, dn, l, sn, oh, dwt_alpha);
+		float *row_l = out + cas;
+		float *row_h = out + 1 - cas;
+		for (uint32_t i = 0; i < sn; ++i)
+			row_l[2 * i] = l[i];
+		for (uint32_t i = 0; i < dn; ++i)
+			row_h[2 * i] = h[i];
+	}
+	static void scale(float *row, uint32_t len, bool low) {
+		const float c = low ? K : c13318;
+		for (uint32_t i = 0; i < len; ++i)
+			row[i] *= c;
+	}
+	static void decode_v_single(float *row, uint32_t len, uint32_t cas) {
+		GRK_UNUSED(row);
+		GRK_UNUSED(len);
+		GRK_UNUSED(cas);
+	}
+	static void lift(uint32_t step, float *GRK_RESTRICT dst,
+			const float *GRK_RESTRICT a, const float *GRK_RESTRICT b,
+			uint32_t len) {
+		static const float coeffs[] = { dwt_delta, dwt_gamma, dwt_beta,
+				dwt_alpha };
+		decode_line_lift_97(dst, a, b, len, coeffs[step - 1]);
+	}
+};
+
+/*
+ Inverse 9-7 transform in 16 bit fixed point, for fast previews of
+ components of 8 bits precision or less (see Wavelet::decompress_fixed_97).
+
+ Samples have dwt_fixed_frac_bits fractional bits, which leaves a range
+ of +/-2048: several times the largest coefficient of an 8 bit component.
+ All arithmetic saturates. A lifting coefficient c is split into an
+ integer n and a fraction f / 2^15 in [-1/2, 1/2], so that c * x is
+ n * x + ((f * x + 2^14) >> 15): one rounding 16 bit multiply per sample,
+ with twice as many lanes per register as the floating point transform.
+ Products are rounded to nearest: truncation biases every lifting step,
+ and the inverse irreversible MCT amplifies the bias of the chroma.
+ */
+const uint32_t dwt_fixed_frac_bits = 4;
+
+struct dwt_fixed_coeff {
+	int16_t n;
+	int16_t f;
+};
+
+static const dwt_fixed_coeff dwt_fixed_alpha = { 2, -13562 };
+static const dwt_fixed_coeff dwt_fixed_beta = { 0, 1736 };
+static const dwt_fixed_coeff dwt_fixed_gamma = { -1, 3837 };
+static const dwt_fixed_coeff dwt_fixed_delta = { 0, -14533 };
+static const dwt_fixed_coeff dwt_fixed_K = { 1, 7542 };
+static const dwt_fixed_coeff dwt_fixed_c13318 = { 2, -12264 };
+
+static inline int16_t fixed_sat(int32_t v) {
+	return (int16_t) std::min<int32_t>(std::max<int32_t>(v, INT16_MIN),
+			INT16_MAX);
+}
+
+static inline int16_t fixed_mul(int16_t x, dwt_fixed_coeff c) {
+	int32_t nx = 0;
+	switch (c.n) {
+	case 0:
+		break;
+	case 1:
+		nx = x;
+		break;
+	case 2:
+		nx = fixed_sat(x + x);
+		break;
+	default:
+		nx = fixed_sat(-x);
+		break;
+	}
+
+	return fixed_sat(nx + ((x * c.f + 0x4000) >> 15));
+}
+
+#if (defined(__SSE2__) || defined(__AVX2__))
+/* vector form of fixed_mul, with the same results */
+static inline VREG16 fixed_mul(VREG16 x, VREG16 f, int16_t n) {
+	VREG16 p = MULHRS16(x, f);
+	switch (n) {
+	case 0:
+		return p;
+	case 1:
+		return ADDS16(x, p);
+	case 2:
+		return ADDS16(ADDS16(x, x), p);
+	default:
+		return ADDS16(SUBS16(LOAD_CST16(0), x), p);
+	}
+}
+#endif
+
+/* d[i] += c * (a[i] + b[i]) */
+static void lift_fixed(int16_t *d, const int16_t *a, const int16_t *b,
+		uint32_t len, dwt_fixed_coeff c) {
+	uint32_t i = 0;
+#if (defined(__SSE2__) || defined(__AVX2__))
+	const VREG16 f = LOAD_CST16(c.f);
+	for (; i + VREG_INT16_COUNT <= len; i += VREG_INT16_COUNT) {
+		VREG16 t = fixed_mul(ADDS16(LOADU16(a + i), LOADU16(b + i)), f, c.n);
+		STOREU16(d + i, ADDS16(LOADU16(d + i), t));
+	}
+#endif
+	for (; i < len; ++i)
+		d[i] = fixed_sat(d[i] + fixed_mul(fixed_sat(a[i] + b[i]), c));
+}
+
+static void scale_fixed(int16_t *row, uint32_t len, dwt_fixed_coeff c) {
+	uint32_t i = 0;
+#if (defined(__SSE2__) || defined(__AVX2__))
+	const VREG16 f = LOAD_CST16(c.f);
+	for (; i + VREG_INT16_COUNT <= len; i += VREG_INT16_COUNT)
+		STOREU16(row + i, fixed_mul(LOADU16(row + i), f, c.n));
+#endif
+	for (; i < len; ++i)
+		row[i] = fixed_mul(row[i], c);
+}
+
+struct dwt_line_97_fixed {
+	typedef int16_t T;
+	static const uint32_t num_steps = 4;
+
+	/* tmp must hold sn + dn + 4 samples */
+	static void decode_h(const int16_t *in_l, const int16_t *in_h,
+			int16_t *out, int16_t *tmp, uint32_t sn, uint32_t dn,
+			uint32_t cas) {
+		if (sn + dn < 2) {
+			if (sn + dn == 1)
+				out[0] = sn ? in_l[0] : in_h[0];
+			return;
+		}
+		int16_t *l = tmp + 1;
+		int16_t *h = l + sn + 2;
+		memcpy(l, in_l, sn * sizeof(int16_t));
+		memcpy(h, in_h, dn * sizeof(int16_t));
+		scale(l, sn, true);
+		scale(h, dn, false);
+		int32_t ol = cas ? 0 : -1;
+		int32_t oh = cas ? -1 : 0;
+		lift_line(l, sn, h, dn, ol, dwt_fixed_delta);
+		lift_line(h, dn, l, sn, oh, dwt_fixed_gamma);
+		lift_line(l, sn, h, dn, ol, dwt_fixed_beta);
+		lift_line(h, dn, l, sn, oh, dwt_fixed_alpha);
+		int16_t *row_l = out + cas;
+		int16_t *row_h = out + 1 - cas;
+		for (uint32_t i = 0; i < sn; ++i)
+			row_l[2 * i] = l[i];
+		for (uint32_t i = 0; i < dn; ++i)
+			row_h[2 * i] = h[i];
+	}
+	static void scale(int16_t *row, uint32_t len, bool low) {
+		scale_fixed(row, len, low ? dwt_fixed_K : dwt_fixed_c13318);
+	}
+	static void decode_v_single(int16_t *row, uint32_t len, uint32_t cas) {
+		GRK_UNUSED(row);
+		GRK_UNUSED(len);
+		GRK_UNUSED(cas);
+	}
+	static void lift(uint32_t step, int16_t *GRK_RESTRICT dst,
+			const int16_t *GRK_RESTRICT a, const int16_t *GRK_RESTRICT b,
+			uint32_t len) {
+		static const dwt_fixed_coeff coeffs[] = { dwt_fixed_delta,
+				dwt_fixed_gamma, dwt_fixed_beta, dwt_fixed_alpha };
+		lift_fixed(dst, a, b, len, coeffs[step - 1]);
+	}
+private:
+	/* d[i] += c * (s[i+off] + s[i+off+1]), with symmetric extension of s */
+	static void lift_line(int16_t *d, uint32_t dn, int16_t *s, uint32_t sn,
+			int32_t off, dwt_fixed_coeff c) {
+		s[-1] = s[0];
+		s[sn] = s[sn - 1];
+		lift_fixed(d, s + off, s + off + 1, dn, c);
+	}
+};
+
+template<typename F> class LineLevel {
+	typedef typename F::T T;
+public:
+	LineLevel() :
+			m_prev(nullptr), m_tiledp(nullptr), m_stride(0), m_rw(0), m_rh(0),
+			m_sw(0), m_sh(0), m_cas_h(0), m_cas_v(0), m_out(nullptr),
+			m_ring(nullptr), m_tmp(nullptr), m_started(false), m_fetched(0) {
+		for (uint32_t i = 0; i < dwt_line_ring_rows; ++i) {
+			m_rows[i] = 0;
+			m_steps[i] = 0;
+		}
+	}
+	~LineLevel() {
+		grk_aligned_free(m_ring);
+		grk_aligned_free(m_tmp);
+	}
+	LineLevel(const LineLevel&) = delete;
+	LineLevel& operator=(const LineLevel&) = delete;
+
+	/*
+	 prev: level producing the low pass rows, or nullptr if they are read
+	 from the tile buffer
+	 lo, hi: resolutions on either side of this level
+	 out: if not null, rows are kept in out, with the tile buffer stride,
+	 rather than in a ring
+	 */
+	bool init(LineLevel *prev, T *tiledp, size_t stride,
+			const grk_tcd_resolution *lo, const grk_tcd_resolution *hi,
+			T *out) {
+		m_prev = prev;
+		m_tiledp = tiledp;
+		m_stride = stride;
+		m_sw = lo->x1 - lo->x0;
+		m_sh = lo->y1 - lo->y0;
+		m_rw = hi->x1 - hi->x0;
+		m_rh = hi->y1 - hi->y0;
+		m_cas_h = hi->x0 & 1;
+		m_cas_v = hi->y0 & 1;
+		m_out = out;
+		if (!m_out) {
+			/* a level can be empty, in tiny tiles */
+			m_ring = (T*) grk_aligned_malloc(
+					(size_t) dwt_line_ring_rows * std::max<uint32_t>(m_rw, 1)
+							* sizeof(T));
+			if (!m_ring)
+				return false;
+		}
+		m_tmp = (T*) grk_aligned_malloc(((size_t) m_rw + 4) * sizeof(T));
+
+		return m_tmp != nullptr;
+	}
+
+	/* Get output row y. Rows must be requested in increasing order,
+	 * and the row is only valid until the next request */
+	const T* row(uint32_t y) {
+		if (!m_started) {
+			m_started = true;
+			m_fetched = y > F::num_steps ? y - F::num_steps : 0;
+		}
+		if (m_rh == 1) {
+			fetch(0);
+			F::decode_v_single(slot(0), m_rw, m_cas_v);
+			return slot(0);
+		}
+		ensure(y, low(y) ? F::num_steps - 1 : F::num_steps);
+
+		return slot(y);
+	}
+private:
+	bool low(uint32_t p) const {
+		return ((p ^ m_cas_v) & 1) == 0;
+	}
+	T* slot(uint32_t p) {
+		if (m_out)
+			return m_out + (size_t) p * m_stride;
+		return m_ring + (size_t) (p % dwt_line_ring_rows) * m_rw;
+	}
+	/* read input row p and transform it horizontally */
+	void fetch(uint32_t p) {
+		uint32_t n = p >> 1;
+		auto dest = slot(p);
+		const T *src;
+		const T *src_l;
+		if (low(p)) {
+			src = m_tiledp + (size_t) n * m_stride;
+			src_l = m_prev ? m_prev->row(n) : src;
+		} else {
+			src = m_tiledp + (size_t) (m_sh + n) * m_stride;
+			src_l = src;
+		}
+		F::decode_h(src_l, src + m_sw, dest, m_tmp, m_sw, m_rw - m_sw,
+				m_cas_h);
+		if (m_rh > 1)
+			F::scale(dest, m_rw, low(p));
+		m_rows[p % dwt_line_ring_rows] = p;
+		m_steps[p % dwt_line_ring_rows] = 0;
+	}
+	/* apply lifting steps to row p until it reaches step */
+	void ensure(uint32_t p, uint32_t step) {
+		while (m_fetched <= p)
+			fetch(m_fetched++);
+		uint32_t s = p % dwt_line_ring_rows;
+		assert(m_rows[s] == p);
+		while (m_steps[s] < step) {
+			uint32_t t = m_steps[s] + 1;
+			if (low(p) == ((t & 1) == 1)) {
+				uint32_t prev = p ? p - 1 : p + 1;
+				uint32_t next = p + 1 < m_rh ? p + 1 : p - 1;
+				ensure(prev, t - 1);
+				ensure(next, t - 1);
+				F::lift(t, slot(p), slot(prev), slot(next), m_rw);
+			}
+			m_steps[s] = t;
+		}
+	}
+
+	LineLevel *m_prev;
+	T *m_tiledp;
+	size_t m_stride;
+	uint32_t m_rw;
+	uint32_t m_rh;
+	uint32_t m_sw;
+	uint32_t m_sh;
+	uint32_t m_cas_h;
+	uint32_t m_cas_v;
+	T *m_out;
+	T *m_ring;
+	T *m_tmp;
+	bool m_started;
+	uint32_t m_fetched;
+	uint32_t m_rows[dwt_line_ring_rows];
+	uint32_t m_steps[dwt_line_ring_rows];
+};
+
+/*
+ Line-based inverse wavelet transform of a tile component:
+ final rows are produced by one or more bands (see LineBand)
+ into a new buffer, which then replaces the tile buffer. Final rows
+ can't go to the tile buffer itself, since coefficients of every
+ sub-band are read until the last rows, so this path is only taken
+ for tile components of up to dwt_line_max_samples samples
+ (see Wavelet::decompress_by_lines)
+ */
+template<typename F> class LineTransform {
+	typedef typename F::T T;
+public:
+	LineTransform() :
+			m_tilec(nullptr), m_numres(0), m_w(0), m_h(0), m_out(nullptr) {
+	}
+	~LineTransform() {
+		grk_aligned_free(m_out);
+	}
+	LineTransform(const LineTransform&) = delete;
+	LineTransform& operator=(const LineTransform&) = delete;
+
+	/* numres must be greater than 1 */
+	bool init(TileComponent *tilec, uint32_t numres) {
+		auto tr_max = tilec->resolutions + numres - 1;
+
+		m_tilec = tilec;
+		m_numres = numres;
+		m_w = tr_max->x1 - tr_max->x0;
+		m_h = tr_max->y1 - tr_max->y0;
+		m_out = (T*) grk_aligned_malloc(
+				std::max<size_t>((size_t) m_w * m_h, 1) * sizeof(T));
+		if (!m_out) {
+			GROK_ERROR("Out of memory");
+			return false;
+		}
+
+		return true;
+	}
+	TileComponent* tilec() const {
+		return m_tilec;
+	}
+	uint32_t numres() const {
+		return m_numres;
+	}
+	uint32_t width() const {
+		return m_w;
+	}
+	uint32_t height() const {
+		return m_h;
+	}
+	T* out_row(uint32_t y) const {
+		return m_out + (size_t) y * m_w;
+	}
+	/* Replace the tile buffer with the final rows */
+	void finish() {
+		auto buf = m_tilec->buf;
+		if (buf->owns_data) {
+			grk_aligned_free(buf->data);
+			buf->data = (int32_t*) m_out;
+		} else {
+			memcpy(buf->data, m_out, (size_t) m_w * m_h * sizeof(T));
+			grk_aligned_free(m_out);
+		}
+		m_out = nullptr;
+	}
+private:
+	TileComponent *m_tilec;
+	uint32_t m_numres;
+	uint32_t m_w;
+	uint32_t m_h;
+	T *m_out;
+};
+
+/*
+ A band of final rows of a LineTransform, decoded by one job with its
+ own levels. The top level of the only band keeps its rows in the
+ output buffer. Otherwise, it would overwrite the rows of neighbouring
+ bands when it reaches beyond its own, so it keeps its rows in a ring,
+ and final rows are copied to the output buffer.
+ */
+template<typename F> class LineBand {
+	typedef typename F::T T;
+public:
+	LineBand() :
+			m_lines(nullptr), m_top(nullptr) {
+	}
+	LineBand(const LineBand&) = delete;
+	LineBand& operator=(const LineBand&) = delete;
+
+	bool init(LineTransform<F> *lines, bool single) {
+		auto tilec = lines->tilec();
+		auto tr = tilec->resolutions;
+		uint32_t numres = lines->numres();
+		T *tiledp = (T*) tilec->buf->get_ptr(0, 0, 0, 0);
+
+		m_lines = lines;
+		m_levels.reset(new LineLevel<F>[numres - 1]);
+		m_top = m_levels.get() + numres - 2;
+		for (uint32_t k = 0; k < numres - 1; ++k) {
+			bool top = k == numres - 2;
+			if (!m_levels[k].init(k ? &m_levels[k - 1] : nullptr, tiledp,
+					lines->width(), tr + k, tr + k + 1,
+					top && single ? lines->out_row(0) : nullptr)) {
+				GROK_ERROR("Out of memory");
+				return false;
+			}
+		}
+
+		return true;
+	}
+	/* Get final row y. Rows must be requested in increasing order */
+	T* row(uint32_t y) {
+		auto src = m_top->row(y);
+		auto dest = m_lines->out_row(y);
+		if (src != dest)
+			memcpy(dest, src, m_lines->width() * sizeof(T));
+
+		return dest;
+	}
+private:
+	LineTransform<F> *m_lines;
+	std::unique_ptr<LineLevel<F>[]> m_levels;
+	LineLevel<F> *m_top;
+};
+
+/*
+ Run job(y0, y1, single) over bands [y0, y1) of h rows,
+ one band per worker thread. single is true if there is only one band.
+ */
+template<typename J> static bool decode_line_bands(uint32_t h, J job) {
+	uint32_t num_jobs = (uint32_t) std::min<size_t>(
+			ThreadPool::get()->num_jobs(), h);
+	if (num_jobs <= 1)
+		return job(0, h, true);
+	uint32_t step_j = h / num_jobs;
+	std::vector<std::future<bool> > results;
+	for (uint32_t j = 0; j < num_jobs; ++j) {
+		uint32_t y0 = j * step_j;
+		uint32_t y1 = j < (num_jobs - 1U) ? (j + 1U) * step_j : h;
+		results.emplace_back(ThreadPool::get()->enqueue([job, y0, y1] {
+			return job(y0, y1, false);
+		}));
+	}
+	bool rc = true;
+	for (auto &&result : results) {
+		if (!result.get())
+			rc = false;
+	}
+
+	return rc;
+}
+
+/* <summary>                                  */
+/* Line-based inverse wavelet transform in 2-D. */
+/* </summary>                                 */
+template<typename F> static bool decode_tile_lines(TileComponent *tilec,
+		uint32_t numres) {
+	if (numres == 1U)
+		return true;
+
+	LineTransform<F> lines;
+	if (!lines.init(tilec, numres))
+		return false;
+	if (!decode_line_bands(lines.height(),
+			[&lines](uint32_t y0, uint32_t y1, bool single) {
+				LineBand<F> band;
+				if (!band.init(&lines, single))
+					return false;
+				for (uint32_t y = y0; y < y1; ++y)
+					band.row(y);
+				return true;
+			}))
+		return false;
+	lines.finish();
+
+	return true;
+}
+
+/* <summary>                                                            */
+/* Line-based inverse wavelet transform in 2-D of three tile components, */
+/* with the inverse MCT, DC level shift and clamp applied to each final  */
+/* row while it is still in cache.                                      */
+/* </summary>                                                           */
+template<typename F, typename K> static bool decode_tile_lines_mct(
+		TileComponent *tilec, uint32_t numres, const DcShiftParams *params,
+		K kernel) {
+	typedef typename F::T T;
+	if (numres == 1U) {
+		kernel((T*) tilec[0].buf->get_ptr(0, 0, 0, 0),
+				(T*) tilec[1].buf->get_ptr(0, 0, 0, 0),
+				(T*) tilec[2].buf->get_ptr(0, 0, 0, 0),
+				tilec->buf->reduced_region_dim.area(), params);
+		return true;
+	}
+	LineTransform<F> lines[3];
+	for (uint32_t c = 0; c < 3; ++c) {
+		if (!lines[c].init(tilec + c, numres))
+			return false;
+	}
+	uint32_t w = lines[0].width();
+	if (!decode_line_bands(lines[0].height(),
+			[&lines, w, params, kernel](uint32_t y0, uint32_t y1, bool single) {
+				LineBand<F> bands[3];
+				for (uint32_t c = 0; c < 3; ++c) {
+					if (!bands[c].init(lines + c, single))
+						return false;
+				}
+				/* final row y is still read by the last lifting step
+				 * of row y + 1, so it is transformed one row behind */
+				T *prev[3] = { nullptr, nullptr, nullptr };
+				for (uint32_t y = y0; y < y1; ++y) {
+					T *cur[3];
+					for (uint32_t c = 0; c < 3; ++c)
+						cur[c] = bands[c].row(y);
+					if (y > y0)
+						kernel(prev[0], prev[1], prev[2], w, params);
+					for (uint32_t c = 0; c < 3; ++c)
+						prev[c] = cur[c];
+				}
+				if (y1 > y0)
+					kernel(prev[0], prev[1], prev[2], w, params);
+				return true;
+			}))
+		return false;
+	for (uint32_t c = 0; c < 3; ++c)
+		lines[c].finish();
+
+	return true;
+}
+
+/* <summary>                                                   */
+/* Line-based inverse 9-7 wavelet transform in 2-D, in 16 bit  */
+/* fixed point. Coefficients are converted from floating point */
+/* up front, and final rows are converted back to the tile.    */
+/* </summary>                                                  */
+static bool decode_tile_97_fixed(TileComponent *tilec, uint32_t numres) {
+	if (numres == 1U)
+		return true;
+
+	auto tr = tilec->resolutions;
+	auto tr_max = tr + numres - 1;
+	uint32_t rw = tr_max->x1 - tr_max->x0;
+	uint32_t rh = tr_max->y1 - tr_max->y0;
+	uint32_t w = (uint32_t) (tilec->resolutions[tilec->minimum_num_resolutions
+			- 1].x1 - tilec->resolutions[tilec->minimum_num_resolutions - 1].x0);
+	float *tiledp = (float*) tilec->buf->get_ptr(0, 0, 0, 0);
+	size_t n = (size_t) w * rh;
+	auto coeffs = (int16_t*) grk_aligned_malloc(
+			std::max<size_t>(n, 1) * sizeof(int16_t));
+	if (!coeffs) {
+		GROK_ERROR("Out of memory");
+		return false;
+	}
+	const float to_fixed = (float) (1 << dwt_fixed_frac_bits);
+	size_t i = 0;
+#if (defined(__SSE2__) || defined(__AVX2__))
+	for (; i + VREG_INT16_COUNT <= n; i += VREG_INT16_COUNT)
+		STOREU16(coeffs + i, LOADU_F2I16(tiledp + i, to_fixed));
+#endif
+	for (; i < n; ++i) {
+		float v = std::min<float>(std::max<float>(tiledp[i] * to_fixed,
+				INT16_MIN), INT16_MAX);
+		coeffs[i] = (int16_t) grok_lrintf(v);
+	}
+	bool rc = true;
+	{
+		std::unique_ptr<LineLevel<dwt_line_97_fixed>[]> levels(
+				new LineLevel<dwt_line_97_fixed>[numres - 1]);
+		for (uint32_t k = 0; k < numres - 1 && rc; ++k)
+			rc = levels[k].init(k ? &levels[k - 1] : nullptr, coeffs, w,
+					tr + k, tr + k + 1, nullptr);
+		if (rc) {
+			auto top = &levels[numres - 2];
+			const float to_float = 1.0f / to_fixed;
+			for (uint32_t y = 0; y < rh; ++y) {
+				auto row = top->row(y);
+				float *dest = tiledp + (size_t) y * w;
+				uint32_t x = 0;
+#if (defined(__SSE2__) || defined(__AVX2__))
+				for (; x + VREG_INT16_COUNT <= rw; x += VREG_INT16_COUNT)
+					STOREU_I162F(dest + x, LOADU16(row + x), to_float);
+#endif
+				for (; x < rw; ++x)
+					dest[x] = (float) row[x] * to_float;
+			}
+		} else {
+			GROK_ERROR("Out of memory");
+		}
+	}
+	grk_aligned_free(coeffs);
+
+	return rc;
+}
+
+bool decode_lines(TileComponent *tilec, uint32_t numres, uint8_t qmfbid) {
+	if (qmfbid == 1)
+		return decode_tile_lines<dwt_line_53>(tilec, numres);
+	return decode_tile_lines<dwt_line_97>(tilec, numres);
+}
+
+bool decode_mct_lines(TileComponent *tilec, uint32_t numres, uint8_t qmfbid,
+		const DcShiftParams *params) {
+	if (qmfbid == 1)
+		return decode_tile_lines_mct<dwt_line_53>(tilec, numres, params,
+				mct_decode_rev_shift);
+	return decode_tile_lines_mct<dwt_line_97>(tilec, numres, params,
+			mct_decode_irrev_shift);
+}
+
 /* <summary>                            */
 /* Inverse 5-3 wavelet transform in 2-D. */
 /* </summary>                           */
@@ -1211,12 +1973,12 @@ bool decode_53(TileProcessor *p_tcd, TileComponent* tilec,
     if (p_tcd->whole_tile_decoding) {
         return decode_tile_53(tilec,numres);
     } else {
-        return decode_partial_tile<int32_t, 1, 4,2, Partial53>(tilec, numres, tilec->m_sa);
+        return decode_partial_tile<mcols_data_53, PLL_COLS_53, PLL_COLS_53, 2, Partial53>(tilec, numres, tilec->m_sa);
     }
 }
 
 
-static void interleave_h_97(dwt_data<v4_data>* GRK_RESTRICT dwt,
+static void interleave_h_97(dwt_data<vec_data>* GRK_RESTRICT dwt,
                                    float* GRK_RESTRICT a,
                                    uint32_t width,
                                    uint32_t remaining_height){
@@ -1224,41 +1986,20 @@ static void interleave_h_97(dwt_data<v4_data>* GRK_RESTRICT dwt,
     uint32_t i, k;
     uint32_t x0 = dwt->win_l_x0;
     uint32_t x1 = dwt->win_l_x1;
+    const uint32_t nb_rows = min<uint32_t>(remaining_height, NB_ELTS_97);
 
     for (k = 0; k < 2; ++k) {
-        if (remaining_height >= 4 && ((size_t) a & 0x0f) == 0 &&
-                ((size_t) bi & 0x0f) == 0 && (width & 0x0f) == 0) {
+        if (nb_rows == NB_ELTS_97) {
             /* Fast code path */
             for (i = x0; i < x1; ++i) {
-                uint32_t j = i;
-                bi[i * 8    ] = a[j];
-                j += width;
-                bi[i * 8 + 1] = a[j];
-                j += width;
-                bi[i * 8 + 2] = a[j];
-                j += width;
-                bi[i * 8 + 3] = a[j];
+                for (uint32_t r = 0; r < NB_ELTS_97; ++r)
+                    bi[i * 2 * NB_ELTS_97 + r] = a[i + (size_t)r * width];
             }
         } else {
             /* Slow code path */
             for (i = x0; i < x1; ++i) {
-                uint32_t j = i;
-                bi[i * 8    ] = a[j];
-                j += width;
-                if (remaining_height == 1) {
-                    continue;
-                }
-                bi[i * 8 + 1] = a[j];
-                j += width;
-                if (remaining_height == 2) {
-                    continue;
-                }
-                bi[i * 8 + 2] = a[j];
-                j += width;
-                if (remaining_height == 3) {
-                    continue;
-                }
-                bi[i * 8 + 3] = a[j]; /* This one*/
+                for (uint32_t r = 0; r < nb_rows; ++r)
+                    bi[i * 2 * NB_ELTS_97 + r] = a[i + (size_t)r * width];
             }
         }
 
@@ -1268,38 +2009,35 @@ static void interleave_h_97(dwt_data<v4_data>* GRK_RESTRICT dwt,
         x1 = dwt->win_h_x1;
     }
 }
-static void interleave_partial_h_97(dwt_data<v4_data>* dwt,
+static void interleave_partial_h_97(dwt_data<vec_data>* dwt,
 									sparse_array* sa,
 									uint32_t sa_line,
 									uint32_t num_rows){
-    uint32_t i;
-    for (i = 0; i < num_rows; i++) {
-        bool ret;
-        ret = sa->read(dwt->win_l_x0,
-					  sa_line + i,
-					  dwt->win_l_x1,
-					  sa_line + i + 1,
-					  /* Nasty cast from float* to int32* */
-					  (int32_t*)(dwt->mem + dwt->cas + 2 * dwt->win_l_x0) + i,
-					  8, 0, true);
-        assert(ret);
-        ret = sa->read((uint32_t)dwt->sn + dwt->win_h_x0,
-					  sa_line + i,
-					  (uint32_t)dwt->sn + dwt->win_h_x1,
-					  sa_line + i + 1,
-					  /* Nasty cast from float* to int32* */
-					  (int32_t*)(dwt->mem + 1 - dwt->cas + 2 * dwt->win_h_x0) + i,
-					  8, 0, true);
-        assert(ret);
-        GRK_UNUSED(ret);
-    }
+    /* all rows are read at once: row i goes to lane i */
+    bool ret = sa->read(dwt->win_l_x0,
+				  sa_line,
+				  dwt->win_l_x1,
+				  sa_line + num_rows,
+				  /* Nasty cast from float* to int32* */
+				  (int32_t*)(dwt->mem + dwt->cas + 2 * dwt->win_l_x0),
+				  2 * NB_ELTS_97, 1, true);
+    assert(ret);
+    ret = sa->read((uint32_t)dwt->sn + dwt->win_h_x0,
+				  sa_line,
+				  (uint32_t)dwt->sn + dwt->win_h_x1,
+				  sa_line + num_rows,
+				  /* Nasty cast from float* to int32* */
+				  (int32_t*)(dwt->mem + 1 - dwt->cas + 2 * dwt->win_h_x0),
+				  2 * NB_ELTS_97, 1, true);
+    assert(ret);
+    GRK_UNUSED(ret);
 }
 
-static void interleave_v_97(dwt_data<v4_data>* GRK_RESTRICT dwt,
+static void interleave_v_97(dwt_data<vec_data>* GRK_RESTRICT dwt,
                                    float* GRK_RESTRICT a,
                                    uint32_t width,
                                    uint32_t nb_elts_read){
-    v4_data* GRK_RESTRICT bi = dwt->mem + dwt->cas;
+    vec_data* GRK_RESTRICT bi = dwt->mem + dwt->cas;
 
     for (uint32_t i = dwt->win_l_x0; i < dwt->win_l_x1; ++i) {
         memcpy((float*)&bi[i * 2], &a[i * (size_t)width],
@@ -1315,7 +2053,7 @@ static void interleave_v_97(dwt_data<v4_data>* GRK_RESTRICT dwt,
     }
 }
 
-static void interleave_partial_v_97(dwt_data<v4_data>* GRK_RESTRICT dwt,
+static void interleave_partial_v_97(dwt_data<vec_data>* GRK_RESTRICT dwt,
 									sparse_array* sa,
 									uint32_t sa_col,
 									uint32_t nb_elts_read){
@@ -1323,50 +2061,50 @@ static void interleave_partial_v_97(dwt_data<v4_data>* GRK_RESTRICT dwt,
     ret = sa->read(sa_col, dwt->win_l_x0,
 				  sa_col + nb_elts_read, dwt->win_l_x1,
 				  (int32_t*)(dwt->mem + dwt->cas + 2 * dwt->win_l_x0),
-				  1, 8, true);
+				  1, 2 * NB_ELTS_97, true);
     assert(ret);
     ret = sa->read(sa_col, (uint32_t)dwt->sn + dwt->win_h_x0,
 				  sa_col + nb_elts_read, (uint32_t)dwt->sn + dwt->win_h_x1,
 				  (int32_t*)(dwt->mem + 1 - dwt->cas + 2 * dwt->win_h_x0),
-				  1, 8, true);
+				  1, 2 * NB_ELTS_97, true);
     assert(ret);
     GRK_UNUSED(ret);
 }
 
-#ifdef __SSE__
-static void decode_step1_sse_97(v4_data* w,
+#if (defined(__SSE2__) || defined(__AVX2__))
+static void decode_step1_simd_97(vec_data* w,
                                        uint32_t start,
                                        uint32_t end,
-                                       const __m128 c){
-    __m128* GRK_RESTRICT vw = (__m128*) w;
+                                       const VREGF c){
+    VREGF* GRK_RESTRICT vw = (VREGF*) w;
     uint32_t i;
     /* 4x unrolled loop */
     vw += 2 * start;
     for (i = start; i + 3 < end; i += 4, vw += 8) {
-        __m128 xmm0 = _mm_mul_ps(vw[0], c);
-        __m128 xmm2 = _mm_mul_ps(vw[2], c);
-        __m128 xmm4 = _mm_mul_ps(vw[4], c);
-        __m128 xmm6 = _mm_mul_ps(vw[6], c);
+        VREGF xmm0 = MULF(vw[0], c);
+        VREGF xmm2 = MULF(vw[2], c);
+        VREGF xmm4 = MULF(vw[4], c);
+        VREGF xmm6 = MULF(vw[6], c);
         vw[0] = xmm0;
         vw[2] = xmm2;
         vw[4] = xmm4;
         vw[6] = xmm6;
     }
     for (; i < end; ++i, vw += 2) {
-        vw[0] = _mm_mul_ps(vw[0], c);
+        vw[0] = MULF(vw[0], c);
     }
 }
 
-static void decode_step2_sse_97(v4_data* l, v4_data* w,
+static void decode_step2_simd_97(vec_data* l, vec_data* w,
                                        uint32_t start,
                                        uint32_t end,
                                        uint32_t m,
-                                       __m128 c){
-    __m128* GRK_RESTRICT vl = (__m128*) l;
-    __m128* GRK_RESTRICT vw = (__m128*) w;
+                                       VREGF c){
+    VREGF* GRK_RESTRICT vl = (VREGF*) l;
+    VREGF* GRK_RESTRICT vw = (VREGF*) w;
     uint32_t i;
     uint32_t imax = min<uint32_t>(end, m);
-    __m128 tmp1, tmp2, tmp3;
+    VREGF tmp1, tmp2, tmp3;
     if (start == 0) {
         tmp1 = vl[0];
     } else {
@@ -1378,7 +2116,7 @@ static void decode_step2_sse_97(v4_data* l, v4_data* w,
 
     /* 4x loop unrolling */
     for (; i + 3 < imax; i += 4) {
-        __m128 tmp4, tmp5, tmp6, tmp7, tmp8, tmp9;
+        VREGF tmp4, tmp5, tmp6, tmp7, tmp8, tmp9;
         tmp2 = vw[-1];
         tmp3 = vw[ 0];
         tmp4 = vw[ 1];
@@ -1387,10 +2125,10 @@ static void decode_step2_sse_97(v4_data* l, v4_data* w,
         tmp7 = vw[ 4];
         tmp8 = vw[ 5];
         tmp9 = vw[ 6];
-        vw[-1] = _mm_add_ps(tmp2, _mm_mul_ps(_mm_add_ps(tmp1, tmp3), c));
-        vw[ 1] = _mm_add_ps(tmp4, _mm_mul_ps(_mm_add_ps(tmp3, tmp5), c));
-        vw[ 3] = _mm_add_ps(tmp6, _mm_mul_ps(_mm_add_ps(tmp5, tmp7), c));
-        vw[ 5] = _mm_add_ps(tmp8, _mm_mul_ps(_mm_add_ps(tmp7, tmp9), c));
+        vw[-1] = ADDF(tmp2, MULF(ADDF(tmp1, tmp3), c));
+        vw[ 1] = ADDF(tmp4, MULF(ADDF(tmp3, tmp5), c));
+        vw[ 3] = ADDF(tmp6, MULF(ADDF(tmp5, tmp7), c));
+        vw[ 5] = ADDF(tmp8, MULF(ADDF(tmp7, tmp9), c));
         tmp1 = tmp9;
         vw += 8;
     }
@@ -1398,36 +2136,30 @@ static void decode_step2_sse_97(v4_data* l, v4_data* w,
     for (; i < imax; ++i) {
         tmp2 = vw[-1];
         tmp3 = vw[ 0];
-        vw[-1] = _mm_add_ps(tmp2, _mm_mul_ps(_mm_add_ps(tmp1, tmp3), c));
+        vw[-1] = ADDF(tmp2, MULF(ADDF(tmp1, tmp3), c));
         tmp1 = tmp3;
         vw += 2;
     }
     if (m < end) {
         assert(m + 1 == end);
-        c = _mm_add_ps(c, c);
-        c = _mm_mul_ps(c, vw[-2]);
-        vw[-1] = _mm_add_ps(vw[-1], c);
+        c = ADDF(c, c);
+        c = MULF(c, vw[-2]);
+        vw[-1] = ADDF(vw[-1], c);
     }
 }
 #else
-static void decode_step1_97(v4_data* w,
+static void decode_step1_97(vec_data* w,
                                    uint32_t start,
                                    uint32_t end,
                                    const float c){
     float* GRK_RESTRICT fw = (float*) w;
     uint32_t i;
     for (i = start; i < end; ++i) {
-        float tmp1 = fw[i * 8    ];
-        float tmp2 = fw[i * 8 + 1];
-        float tmp3 = fw[i * 8 + 2];
-        float tmp4 = fw[i * 8 + 3];
-        fw[i * 8    ] = tmp1 * c;
-        fw[i * 8 + 1] = tmp2 * c;
-        fw[i * 8 + 2] = tmp3 * c;
-        fw[i * 8 + 3] = tmp4 * c;
+        for (uint32_t k = 0; k < NB_ELTS_97; ++k)
+            fw[i * 2 * NB_ELTS_97 + k] *= c;
     }
 }
-static void decode_step2_97(v4_data* l, v4_data* w,
+static void decode_step2_97(vec_data* l, vec_data* w,
                                    uint32_t start,
                                    uint32_t end,
                                    uint32_t m,
@@ -1437,36 +2169,22 @@ static void decode_step2_97(v4_data* l, v4_data* w,
     uint32_t i;
     uint32_t imax = min<uint32_t>(end, m);
     if (start > 0) {
-        fw += 8 * start;
-        fl = fw - 8;
+        fw += 2 * NB_ELTS_97 * start;
+        fl = fw - 2 * NB_ELTS_97;
     }
     for (i = start; i < imax; ++i) {
-        float tmp1_1 = fl[0];
-        float tmp1_2 = fl[1];
-        float tmp1_3 = fl[2];
-        float tmp1_4 = fl[3];
-        float tmp2_1 = fw[-4];
-        float tmp2_2 = fw[-3];
-        float tmp2_3 = fw[-2];
-        float tmp2_4 = fw[-1];
-        float tmp3_1 = fw[0];
-        float tmp3_2 = fw[1];
-        float tmp3_3 = fw[2];
-        float tmp3_4 = fw[3];
-        fw[-4] = tmp2_1 + ((tmp1_1 + tmp3_1) * c);
-        fw[-3] = tmp2_2 + ((tmp1_2 + tmp3_2) * c);
-        fw[-2] = tmp2_3 + ((tmp1_3 + tmp3_3) * c);
-        fw[-1] = tmp2_4 + ((tmp1_4 + tmp3_4) * c);
+        float* fh = fw - NB_ELTS_97;
+        for (uint32_t k = 0; k < NB_ELTS_97; ++k)
+            fh[k] = fh[k] + ((fl[k] + fw[k]) * c);
         fl = fw;
-        fw += 8;
+        fw += 2 * NB_ELTS_97;
     }
     if (m < end) {
         assert(m + 1 == end);
         c += c;
-        fw[-4] = fw[-4] + fl[0] * c;
-        fw[-3] = fw[-3] + fl[1] * c;
-        fw[-2] = fw[-2] + fl[2] * c;
-        fw[-1] = fw[-1] + fl[3] * c;
+        float* fh = fw - NB_ELTS_97;
+        for (uint32_t k = 0; k < NB_ELTS_97; ++k)
+            fh[k] = fh[k] + fl[k] * c;
     }
 }
 #endif
@@ -1474,7 +2192,7 @@ static void decode_step2_97(v4_data* l, v4_data* w,
 /* <summary>                             */
 /* Inverse 9-7 wavelet transform in 1-D. */
 /* </summary>                            */
-static void decode_step_97(dwt_data<v4_data>* GRK_RESTRICT dwt)
+static void decode_step_97(dwt_data<vec_data>* GRK_RESTRICT dwt)
 {
     int32_t a, b;
 
@@ -1491,27 +2209,27 @@ static void decode_step_97(dwt_data<v4_data>* GRK_RESTRICT dwt)
         a = 1;
         b = 0;
     }
-#ifdef __SSE__
-    decode_step1_sse_97(dwt->mem + a, dwt->win_l_x0, dwt->win_l_x1,
-                               _mm_set1_ps(K));
-    decode_step1_sse_97(dwt->mem + b, dwt->win_h_x0, dwt->win_h_x1,
-                               _mm_set1_ps(c13318));
-    decode_step2_sse_97(dwt->mem + b, dwt->mem + a + 1,
+#if (defined(__SSE2__) || defined(__AVX2__))
+    decode_step1_simd_97(dwt->mem + a, dwt->win_l_x0, dwt->win_l_x1,
+                               LOAD_CST_F(K));
+    decode_step1_simd_97(dwt->mem + b, dwt->win_h_x0, dwt->win_h_x1,
+                               LOAD_CST_F(c13318));
+    decode_step2_simd_97(dwt->mem + b, dwt->mem + a + 1,
                                dwt->win_l_x0, dwt->win_l_x1,
                                (uint32_t)min<int32_t>(dwt->sn, dwt->dn - a),
-                               _mm_set1_ps(dwt_delta));
-    decode_step2_sse_97(dwt->mem + a, dwt->mem + b + 1,
+                               LOAD_CST_F(dwt_delta));
+    decode_step2_simd_97(dwt->mem + a, dwt->mem + b + 1,
                                dwt->win_h_x0, dwt->win_h_x1,
                                (uint32_t)min<int32_t>(dwt->dn, dwt->sn - b),
-                               _mm_set1_ps(dwt_gamma));
-    decode_step2_sse_97(dwt->mem + b, dwt->mem + a + 1,
+                               LOAD_CST_F(dwt_gamma));
+    decode_step2_simd_97(dwt->mem + b, dwt->mem + a + 1,
                                dwt->win_l_x0, dwt->win_l_x1,
                                (uint32_t)min<int32_t>(dwt->sn, dwt->dn - a),
-                               _mm_set1_ps(dwt_beta));
-    decode_step2_sse_97(dwt->mem + a, dwt->mem + b + 1,
+                               LOAD_CST_F(dwt_beta));
+    decode_step2_simd_97(dwt->mem + a, dwt->mem + b + 1,
                                dwt->win_h_x0, dwt->win_h_x1,
                                (uint32_t)min<int32_t>(dwt->dn, dwt->sn - b),
-                               _mm_set1_ps(dwt_alpha));
+                               LOAD_CST_F(dwt_alpha));
 #else
     decode_step1_97(dwt->mem + a, dwt->win_l_x0, dwt->win_l_x1,
                            K);
@@ -1537,6 +2255,20 @@ static void decode_step_97(dwt_data<v4_data>* GRK_RESTRICT dwt)
 }
 
 
+/* Write rw samples of the first nb_rows lanes of dwt back to */
+/* consecutive rows of the tile */
+static void write_h_97(const dwt_data<vec_data>* GRK_RESTRICT dwt,
+                       float* GRK_RESTRICT tiledp,
+                       uint32_t w,
+                       uint32_t rw,
+                       uint32_t nb_rows){
+    for (uint32_t r = 0; r < nb_rows; ++r) {
+        float* GRK_RESTRICT row = tiledp + (size_t)w * r;
+        for (uint32_t k = 0; k < rw; k++)
+            row[k] = dwt->mem[k].f[r];
+    }
+}
+
 /* <summary>                             */
 /* Inverse 9-7 wavelet transform in 2-D. */
 /* </summary>                            */
@@ -1554,14 +2286,14 @@ bool decode_tile_97(TileComponent* GRK_RESTRICT tilec,uint32_t numres){
                             tilec->resolutions[tilec->minimum_num_resolutions - 1].x0);
 
     size_t data_size = dwt_utils::max_resolution(res, numres);
-    dwt_data<v4_data> horiz;
-    dwt_data<v4_data> vert;
+    dwt_data<vec_data> horiz;
+    dwt_data<vec_data> vert;
     if (!horiz.alloc(data_size)) {
         GROK_ERROR("Out of memory");
         return false;
     }
     vert.mem = horiz.mem;
-    size_t num_threads = ThreadPool::get()->num_threads();
+    size_t num_threads = ThreadPool::get()->num_jobs();
     while (--numres) {
         horiz.sn = (int32_t)rw;
         vert.sn = (int32_t)rh;
@@ -1582,38 +2314,22 @@ bool decode_tile_97(TileComponent* GRK_RESTRICT tilec,uint32_t numres){
         if (rh < num_jobs)
             num_jobs = rh;
         uint32_t step_j = num_jobs ? (rh / num_jobs) : 0;
-        if (step_j < 4) {
-			for (j = 0; j + 3 < rh; j += 4) {
+        if (step_j < NB_ELTS_97) {
+			for (j = 0; j + NB_ELTS_97 <= rh; j += NB_ELTS_97) {
 				interleave_h_97(&horiz, tiledp, w, rh - j);
 				decode_step_97(&horiz);
-				for (uint32_t k = 0; k < rw; k++) {
-					tiledp[k      ] 			= horiz.mem[k].f[0];
-					tiledp[k + (size_t)w  ] 	= horiz.mem[k].f[1];
-					tiledp[k + (size_t)w * 2] 	= horiz.mem[k].f[2];
-					tiledp[k + (size_t)w * 3] 	= horiz.mem[k].f[3];
-				}
-				tiledp += w * 4;
+				write_h_97(&horiz, tiledp, w, rw, NB_ELTS_97);
+				tiledp += w * NB_ELTS_97;
 			}
 			if (j < rh) {
 				interleave_h_97(&horiz, tiledp, w, rh - j);
 				decode_step_97(&horiz);
-				for (uint32_t k = 0; k < rw; k++) {
-					switch (rh - j) {
-					case 3:
-						tiledp[k + (size_t)w * 2] = horiz.mem[k].f[2];
-					/* FALLTHRU */
-					case 2:
-						tiledp[k + (size_t)w  ] = horiz.mem[k].f[1];
-					/* FALLTHRU */
-					case 1:
-						tiledp[k] = horiz.mem[k].f[0];
-					}
-				}
+				write_h_97(&horiz, tiledp, w, rw, rh - j);
 			}
         } else {
 			std::vector< std::future<int> > results;
 			for(uint32_t j = 0; j < num_jobs; ++j) {
-			   auto job = new decode_job<float, dwt_data<v4_data>>(horiz,
+			   auto job = new decode_job<float, dwt_data<vec_data>>(horiz,
 											w,
 											tiledp,
 											j * step_j,
@@ -1627,33 +2343,17 @@ bool decode_tile_97(TileComponent* GRK_RESTRICT tilec,uint32_t numres){
 					ThreadPool::get()->enqueue([job,w,rw] {
 					    float* tdp = nullptr;
 					    uint32_t j;
-						for (j = job->min_j; j + 3 < job->max_j; j+=4){
-							tdp = &job->tiledp[j * job->w];
+						for (j = job->min_j; j + NB_ELTS_97 <= job->max_j; j += NB_ELTS_97){
+							tdp = &job->tiledp[(size_t)j * job->w];
 							interleave_h_97(&job->data, tdp, w, job->max_j - j);
 							decode_step_97(&job->data);
-							for (uint32_t k = 0; k < rw; k++) {
-								tdp[k      ] 			= job->data.mem[k].f[0];
-								tdp[k + (size_t)w  ] 	= job->data.mem[k].f[1];
-								tdp[k + (size_t)w * 2] 	= job->data.mem[k].f[2];
-								tdp[k + (size_t)w * 3] 	= job->data.mem[k].f[3];
-							}
+							write_h_97(&job->data, tdp, w, rw, NB_ELTS_97);
 						}
 						if (j < job->max_j) {
-							tdp += 4 * job->w;
+							tdp = &job->tiledp[(size_t)j * job->w];
 							interleave_h_97(&job->data, tdp, w, job->max_j - j);
 							decode_step_97(&job->data);
-							for (uint32_t k = 0; k < rw; k++) {
-								switch (job->max_j - j) {
-								case 3:
-									tdp[k + (size_t)w * 2] = job->data.mem[k].f[2];
-								/* FALLTHRU */
-								case 2:
-									tdp[k + (size_t)w  ] = job->data.mem[k].f[1];
-								/* FALLTHRU */
-								case 1:
-									tdp[k] = job->data.mem[k].f[0];
-								}
-							}
+							write_h_97(&job->data, tdp, w, rw, job->max_j - j);
 						}
 						job->data.release();
 						delete job;
@@ -1675,16 +2375,16 @@ bool decode_tile_97(TileComponent* GRK_RESTRICT tilec,uint32_t numres){
         if (rw < num_jobs)
             num_jobs = rw;
         step_j = num_jobs ? (rw / num_jobs) : 0;
-        if (step_j < 4) {
-			for (j = 0; j + 3 < rw; j += 4) {
-				interleave_v_97(&vert, tiledp, w, 4);
+        if (step_j < NB_ELTS_97) {
+			for (j = 0; j + NB_ELTS_97 <= rw; j += NB_ELTS_97) {
+				interleave_v_97(&vert, tiledp, w, NB_ELTS_97);
 				decode_step_97(&vert);
 				for (uint32_t k = 0; k < rh; ++k)
-					memcpy(&tiledp[k * (size_t)w], &vert.mem[k], 4 * sizeof(float));
-				 tiledp += 4;
+					memcpy(&tiledp[k * (size_t)w], &vert.mem[k], NB_ELTS_97 * sizeof(float));
+				 tiledp += NB_ELTS_97;
 			}
 			if (j < rw) {
-				j = rw & 0x03;
+				j = rw - j;
 				interleave_v_97(&vert, tiledp, w, j);
 				decode_step_97(&vert);
 				for (uint32_t k = 0; k < rh; ++k)
@@ -1693,7 +2393,7 @@ bool decode_tile_97(TileComponent* GRK_RESTRICT tilec,uint32_t numres){
         } else {
 			std::vector< std::future<int> > results;
             for (uint32_t j = 0; j < num_jobs; j++) {
-            	auto job = new decode_job<float, dwt_data<v4_data>>(vert,
+            	auto job = new decode_job<float, dwt_data<vec_data>>(vert,
             												w,
             												tiledp,
             												j * step_j,
@@ -1708,12 +2408,12 @@ bool decode_tile_97(TileComponent* GRK_RESTRICT tilec,uint32_t numres){
 						float* tdp = job->tiledp + job->min_j;
 						uint32_t w = job->w;
 						uint32_t j;
-						for (j = job->min_j; j + 3 < job->max_j; j+=4){
-							interleave_v_97(&job->data, tdp, w, 4);
+						for (j = job->min_j; j + NB_ELTS_97 <= job->max_j; j += NB_ELTS_97){
+							interleave_v_97(&job->data, tdp, w, NB_ELTS_97);
 							decode_step_97(&job->data);
 							for (uint32_t k = 0; k < rh; ++k)
-								memcpy(&tdp[k * (size_t)job->w], &job->data.mem[k], 4 * sizeof(float));
-							tdp += 4;
+								memcpy(&tdp[k * (size_t)job->w], &job->data.mem[k], NB_ELTS_97 * sizeof(float));
+							tdp += NB_ELTS_97;
 						}
 						if (j < job->max_j) {
 							j = job->max_j - j;
@@ -1739,24 +2439,43 @@ bool decode_tile_97(TileComponent* GRK_RESTRICT tilec,uint32_t numres){
 
 class Partial97 {
 public:
-	void interleave_partial_h(dwt_data<v4_data>* dwt,
+	void interleave_partial_h(dwt_data<vec_data>* dwt,
 								sparse_array* sa,
 								uint32_t sa_line,
 								uint32_t num_rows){
 		interleave_partial_h_97(dwt,sa,sa_line,num_rows);
 	}
-	void decode_h(dwt_data<v4_data>* dwt){
+	void decode_h(dwt_data<vec_data>* dwt){
 		decode_step_97(dwt);
 	}
-	void interleave_partial_v(dwt_data<v4_data>* GRK_RESTRICT dwt,
+	bool write_partial_h(dwt_data<vec_data>* dwt,
+								sparse_array* sa,
+								uint32_t win_tr_x0,
+								uint32_t win_tr_x1,
+								uint32_t sa_line,
+								uint32_t num_rows){
+		return sa->write(win_tr_x0,
+						  sa_line,
+						  win_tr_x1,
+						  sa_line + num_rows,
+						  (int32_t*)(dwt->mem + win_tr_x0),
+						  NB_ELTS_97,
+						  1,
+						  true);
+	}
+	void interleave_partial_v(dwt_data<vec_data>* GRK_RESTRICT dwt,
 								sparse_array* sa,
 								uint32_t sa_col,
 								uint32_t nb_elts_read){
 		interleave_partial_v_97(dwt,sa,sa_col,nb_elts_read);
 	}
-	void decode_v(dwt_data<v4_data>* dwt){
+	void decode_v(dwt_data<vec_data>* dwt){
 		decode_step_97(dwt);
 	}
+	/* number of elements of scratch memory */
+	static size_t data_size(uint32_t max_resolution){
+		return max_resolution;
+	}
 };
 
 
@@ -1803,16 +2522,14 @@ template <typename T, uint32_t HORIZ_STEP, uint32_t VERT_STEP, uint32_t FILTER_W
         return true;
     }
 
-    // in 53 vertical pass, we process 4 vertical columns at a time
-    const uint32_t data_multiplier = (sizeof(T) == 4) ? 4 : 1;
-    size_t data_size = dwt_utils::max_resolution(tr, numres) * data_multiplier;
+    size_t data_size = D::data_size(dwt_utils::max_resolution(tr, numres));
     if (!horiz.alloc(data_size)) {
         GROK_ERROR("Out of memory");
         return false;
     }
     vert.mem = horiz.mem;
     D decoder;
-    size_t num_threads = ThreadPool::get()->num_threads();
+    size_t num_threads = ThreadPool::get()->num_jobs();
 
     for (resno = 1; resno < numres; resno ++) {
         uint32_t j;
@@ -1944,14 +2661,7 @@ template <typename T, uint32_t HORIZ_STEP, uint32_t VERT_STEP, uint32_t FILTER_W
 			 for (j = bounds[k][0]; j + HORIZ_STEP-1 < bounds[k][1]; j += HORIZ_STEP) {
 				 decoder.interleave_partial_h(&horiz, sa, j,HORIZ_STEP);
 				 decoder.decode_h(&horiz);
-				 if (!sa->write( win_tr_x0,
-								  j,
-								  win_tr_x1,
-								  j + HORIZ_STEP,
-								  (int32_t*)(horiz.mem + win_tr_x0),
-								  HORIZ_STEP,
-								  1,
-								  true)) {
+				 if (!decoder.write_partial_h(&horiz, sa, win_tr_x0, win_tr_x1, j, HORIZ_STEP)) {
 					 GROK_ERROR("sparse array write failure");
 					 horiz.release();
 					 return false;
@@ -1960,14 +2670,7 @@ template <typename T, uint32_t HORIZ_STEP, uint32_t VERT_STEP, uint32_t FILTER_W
 			 if (j < bounds[k][1] ) {
 				 decoder.interleave_partial_h(&horiz, sa, j, bounds[k][1] - j);
 				 decoder.decode_h(&horiz);
-				 if (!sa->write( win_tr_x0,
-								  j,
-								  win_tr_x1,
-								  bounds[k][1],
-								  (int32_t*)(horiz.mem + win_tr_x0),
-								  HORIZ_STEP,
-								  1,
-								  true)) {
+				 if (!decoder.write_partial_h(&horiz, sa, win_tr_x0, win_tr_x1, j, bounds[k][1] - j)) {
 					 GROK_ERROR("Sparse array write failure");
 					 horiz.release();
 					 return false;
@@ -1992,14 +2695,7 @@ template <typename T, uint32_t HORIZ_STEP, uint32_t VERT_STEP, uint32_t FILTER_W
 					 for (j = job->min_j; j + HORIZ_STEP-1 < job->max_j; j += HORIZ_STEP) {
 						 decoder.interleave_partial_h(&job->data, sa, j,HORIZ_STEP);
 						 decoder.decode_h(&job->data);
-						 if (!sa->write( win_tr_x0,
-										  j,
-										  win_tr_x1,
-										  j + HORIZ_STEP,
-										  (int32_t*)(job->data.mem + win_tr_x0),
-										  HORIZ_STEP,
-										  1,
-										  true)) {
+						 if (!decoder.write_partial_h(&job->data, sa, win_tr_x0, win_tr_x1, j, HORIZ_STEP)) {
 							 GROK_ERROR("sparse array write failure");
 							 job->data.release();
 							 return 0;
@@ -2008,14 +2704,7 @@ template <typename T, uint32_t HORIZ_STEP, uint32_t VERT_STEP, uint32_t FILTER_W
 					 if (j < job->max_j ) {
 						 decoder.interleave_partial_h(&job->data, sa, j, job->max_j - j);
 						 decoder.decode_h(&job->data);
-						 if (!sa->write( win_tr_x0,
-										  j,
-										  win_tr_x1,
-										  job->max_j,
-										  (int32_t*)(job->data.mem + win_tr_x0),
-										  HORIZ_STEP,
-										  1,
-										  true)) {
+						 if (!decoder.write_partial_h(&job->data, sa, win_tr_x0, win_tr_x1, j, job->max_j - j)) {
 							 GROK_ERROR("Sparse array write failure");
 							 job->data.release();
 							 return 0;
@@ -2155,10 +2844,13 @@ bool decode_97(TileProcessor *p_tcd,
                 TileComponent* GRK_RESTRICT tilec,
                 uint32_t numres){
     if (p_tcd->whole_tile_decoding) {
+        if (Wavelet::decompress_fixed_97(p_tcd, tilec))
+            return decode_tile_97_fixed(tilec,numres);
         return decode_tile_97(tilec, numres);
     } else {
-        return decode_partial_tile<v4_data,4,4,4, Partial97>(tilec, numres, tilec->m_sa);
+        return decode_partial_tile<vec_data,NB_ELTS_97,NB_ELTS_97,4, Partial97>(tilec, numres, tilec->m_sa);
     }
 }
 
 }
+}
@@ -55,7 +55,24 @@
 
 #pragma once
 
+#include "simd_kernels.h"
+
 namespace grk {
+namespace GRK_SIMD_NS {
+
+/**
+Forward 5-3 wavelet transform in 2-D.
+Apply a reversible DWT transform to a component of an image.
+@param tilec Tile component information (current tile)
+*/
+bool encode_53(TileComponent* tilec);
+
+/**
+Forward 9-7 wavelet transform in 2-D.
+Apply an irreversible DWT transform to a component of an image.
+@param tilec Tile component information (current tile)
+*/
+bool encode_97(TileComponent* tilec);
 
 /**
 Inverse 5-3 wavelet transform in 2-D.
@@ -79,4 +96,24 @@ bool decode_97(TileProcessor *p_tcd,
                              TileComponent* GRK_RESTRICT tilec,
 							 uint32_t numres);
 
+/**
+Line-based inverse wavelet transform in 2-D of a whole tile component.
+@param tilec Tile component information (current tile)
+@param numres Number of resolution levels to decompress
+@param qmfbid 1 for the 5-3 transform, 0 for 9-7
+*/
+bool decode_lines(TileComponent* tilec, uint32_t numres, uint8_t qmfbid);
+
+/**
+Line-based inverse wavelet transform in 2-D of the first three components
+of a tile, followed by the inverse MCT and the DC level shift.
+@param tilec First of three tile components with identical geometry
+@param numres Number of resolution levels to decompress
+@param qmfbid 1 for the 5-3 transform and reversible MCT, 0 for 9-7 and irreversible MCT
+@param params DC level shift and clamp of each component
+*/
+bool decode_mct_lines(TileComponent* tilec, uint32_t numres, uint8_t qmfbid,
+		const DcShiftParams *params);
+
+}
 }
@@ -97,14 +97,17 @@
 
  */
 
+#include "simd.h"
 #include "CPUArch.h"
 #include "grok_includes.h"
 #include "T1Decoder.h"
 #include <atomic>
 #include "testing.h"
 #include "dwt53.h"
+#include "WaveletForward.h"
 
 namespace grk {
+namespace GRK_SIMD_NS {
 
 #define GROK_S(i) a[(i)<<1]
 #define GROK_D(i) a[(1+((i)<<1))]
@@ -168,4 +171,107 @@ void dwt53::encode_line(int32_t *a, int32_t d_n, int32_t s_n, uint8_t cas) {
 	}
 }
 
+
+void dwt53::encode_and_deinterleave_h(int32_t *a, int32_t *tmp, uint32_t d_n,
+		uint32_t s_n, uint8_t cas) {
+	memcpy(tmp, a, (d_n + s_n) * sizeof(int32_t));
+	encode_line(tmp, (int32_t) d_n, (int32_t) s_n, cas);
+	dwt_utils::deinterleave_h(tmp, a, d_n, s_n, cas);
+}
+
+/* d -= (x + y) >> 1 */
+static void predict_row_53(int32_t *GRK_RESTRICT d, const int32_t *x,
+		const int32_t *y, uint32_t len) {
+	uint32_t i = 0;
+#if (defined(__SSE2__) || defined(__AVX2__))
+	for (; i + VREG_INT_COUNT <= len; i += VREG_INT_COUNT)
+		STOREU(d + i,
+				SUB(LOADU(d + i), SAR(ADD(LOADU(x + i), LOADU(y + i)), 1)));
+#endif
+	for (; i < len; ++i)
+		d[i] -= (x[i] + y[i]) >> 1;
+}
+
+/* d += (x + y + 2) >> 2 */
+static void update_row_53(int32_t *GRK_RESTRICT d, const int32_t *x,
+		const int32_t *y, uint32_t len) {
+	uint32_t i = 0;
+#if (defined(__SSE2__) || defined(__AVX2__))
+	const VREG two = LOAD_CST(2);
+	for (; i + VREG_INT_COUNT <= len; i += VREG_INT_COUNT)
+		STOREU(d + i,
+				ADD(LOADU(d + i), SAR(ADD(ADD(LOADU(x + i), LOADU(y + i)), two), 2)));
+#endif
+	for (; i < len; ++i)
+		d[i] += (x[i] + y[i] + 2) >> 2;
+}
+
+/* Rows of dwt_forward_mcols coefficients, for the multi-column transform */
+#define GROK_ROW_S(i) (a + ((size_t)(i) << 1) * dwt_forward_mcols)
+#define GROK_ROW_D(i) (a + (1 + ((size_t)(i) << 1)) * dwt_forward_mcols)
+#define GROK_CLAMP(i, n) ((i) < 0 ? 0 : ((i) >= (n) ? (n) - 1 : (i)))
+
+/* <summary>                                          */
+/* Forward 5-3 wavelet transform in 1-D, over columns. */
+/* </summary>                                         */
+void dwt53::encode_v_mcols(int32_t *a, int32_t d_n, int32_t s_n, uint8_t cas) {
+	const uint32_t m = dwt_forward_mcols;
+	if (!cas) {
+		if ((d_n > 0) || (s_n > 1)) {
+			for (int32_t i = 0; i < d_n; i++)
+				predict_row_53(GROK_ROW_D(i), GROK_ROW_S(GROK_CLAMP(i, s_n)),
+						GROK_ROW_S(GROK_CLAMP(i + 1, s_n)), m);
+			for (int32_t i = 0; i < s_n; i++)
+				update_row_53(GROK_ROW_S(i), GROK_ROW_D(GROK_CLAMP(i - 1, d_n)),
+						GROK_ROW_D(GROK_CLAMP(i, d_n)), m);
+		}
+	}
+	else {
+		if (!s_n && d_n == 1) { /* NEW :  CASE ONE ELEMENT */
+			for (uint32_t c = 0; c < m; ++c)
+				a[c] <<= 1;
+		} else {
+			for (int32_t i = 0; i < d_n; i++)
+				predict_row_53(GROK_ROW_S(i), GROK_ROW_D(GROK_CLAMP(i, s_n)),
+						GROK_ROW_D(GROK_CLAMP(i - 1, s_n)), m);
+			for (int32_t i = 0; i < s_n; i++)
+				update_row_53(GROK_ROW_D(i), GROK_ROW_S(GROK_CLAMP(i, d_n)),
+						GROK_ROW_S(GROK_CLAMP(i + 1, d_n)), m);
+		}
+	}
+}
+
+void dwt53::encode_v_fetch(int32_t *row, uint32_t len) {
+	GRK_UNUSED(row);
+	GRK_UNUSED(len);
+}
+
+void dwt53::encode_v_lift(uint32_t step, int32_t *row, const int32_t *a,
+		const int32_t *b, uint32_t len) {
+	if (step == 1)
+		predict_row_53(row, a, b, len);
+	else
+		update_row_53(row, a, b, len);
+}
+
+void dwt53::encode_v_finish(int32_t *row, uint32_t len, bool low) {
+	GRK_UNUSED(row);
+	GRK_UNUSED(len);
+	GRK_UNUSED(low);
+}
+
+void dwt53::encode_v_single(int32_t *row, uint32_t len, uint8_t cas) {
+	/* NEW :  CASE ONE ELEMENT */
+	if (cas) {
+		for (uint32_t i = 0; i < len; ++i)
+			row[i] <<= 1;
+	}
+}
+
+bool encode_53(TileComponent* tilec){
+	WaveletForward<dwt53> dwt;
+	return dwt.run(tilec);
+}
+
+}
 }
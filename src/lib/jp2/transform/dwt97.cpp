@@ -55,72 +55,221 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include "simd.h"
 #include "CPUArch.h"
 #include "T1Decoder.h"
 #include <atomic>
 #include "testing.h"
 #include "dwt97.h"
+#include "WaveletForward.h"
 
 namespace grk {
+namespace GRK_SIMD_NS {
 
-#define GROK_S(i) a[(i)<<1]
-#define GROK_D(i) a[(1+((i)<<1))]
-#define GROK_S_(i) ((i)<0?GROK_S(0):((i)>=s_n?GROK_S(s_n-1):GROK_S(i)))
-#define GROK_D_(i) ((i)<0?GROK_D(0):((i)>=d_n?GROK_D(d_n-1):GROK_D(i)))
-#define GROK_SS_(i) ((i)<0?GROK_S(0):((i)>=d_n?GROK_S(d_n-1):GROK_S(i)))
-#define GROK_DD_(i) ((i)<0?GROK_D(0):((i)>=s_n?GROK_D(s_n-1):GROK_D(i)))
-
-#if 0
 static const float dwt_alpha = 1.586134342f; /*  12994 */
 static const float dwt_beta = 0.052980118f; /*    434 */
 static const float dwt_gamma = -0.882911075f; /*  -7233 */
 static const float dwt_delta = -0.443506852f; /*  -3633 */
 static const float dwt_K = 1.230174105f; /*  10078 */
-static const float dwt_c13318 = 1.625732422f;
-#endif
+
+/* high pass and low pass gains of the forward transform */
+static const float dwt_gain_high = dwt_K / 2;
+static const float dwt_gain_low = 1 / dwt_K;
 
 /***************************************************************************************
 
- 9/7 Synthesis Wavelet Transform
+ 9/7 Analysis Wavelet Transform
+
+ Lifting is performed in single precision floating point, on separate low pass and
+ high pass arrays (horizontal) or on whole rows (vertical, see LineLevelForward)
+ or rows of dwt_forward_mcols columns (vertical, per level transform),
+ so that each lifting step is a vector operation over contiguous data.
+ Coefficients are rounded to the nearest integer once the transform is complete.
 
  *****************************************************************************************/
-/* <summary>                             */
-/* Forward 9-7 wavelet transform in 1-D. */
-/* </summary>                            */
-void dwt97::encode_line(int32_t* GRK_RESTRICT a, int32_t d_n, int32_t s_n, uint8_t cas) {
+
+/* convert n integers to floats, in place */
+static void dwt97_to_float(int32_t *a, size_t n) {
+	auto f = (float*) a;
+	size_t i = 0;
+#if (defined(__SSE2__) || defined(__AVX2__))
+	for (; i + VREG_INT_COUNT <= n; i += VREG_INT_COUNT)
+		STOREUF(f + i, CVT_I2F(LOADU(a + i)));
+#endif
+	for (; i < n; ++i)
+		f[i] = (float) a[i];
+}
+
+/* round n floats to the nearest integer, in place */
+static void dwt97_to_int(float *f, size_t n) {
+	auto a = (int32_t*) f;
+	size_t i = 0;
+#if (defined(__SSE2__) || defined(__AVX2__))
+	for (; i + VREG_INT_COUNT <= n; i += VREG_INT_COUNT)
+		STOREU(a + i, CVT_F2I(LOADUF(f + i)));
+#endif
+	for (; i < n; ++i)
+		a[i] = (int32_t) lrintf(f[i]);
+}
+
+/* d[i] -= c * (x[i] + y[i]) */
+static inline void dwt97_lift(float *GRK_RESTRICT d, const float *x,
+		const float *y, size_t n, float c) {
+	size_t i = 0;
+#if (defined(__SSE2__) || defined(__AVX2__))
+	const VREGF vc = LOAD_CST_F(c);
+	for (; i + VREG_INT_COUNT <= n; i += VREG_INT_COUNT)
+		STOREUF(d + i,
+				SUBF(LOADUF(d + i), MULF(vc, ADDF(LOADUF(x + i), LOADUF(y + i)))));
+#endif
+	for (; i < n; ++i)
+		d[i] -= c * (x[i] + y[i]);
+}
+
+/* d[i] *= c */
+static inline void dwt97_scale(float *GRK_RESTRICT d, size_t n, float c) {
+	size_t i = 0;
+#if (defined(__SSE2__) || defined(__AVX2__))
+	const VREGF vc = LOAD_CST_F(c);
+	for (; i + VREG_INT_COUNT <= n; i += VREG_INT_COUNT)
+		STOREUF(d + i, MULF(LOADUF(d + i), vc));
+#endif
+	for (; i < n; ++i)
+		d[i] *= c;
+}
+
+/* replicate first and last of n samples, so that lifting
+ at the boundaries needs no special case */
+static inline void dwt97_pad(float *a, uint32_t n) {
+	if (n) {
+		a[-1] = a[0];
+		a[n] = a[n - 1];
+	}
+}
+
+/* <summary>                                                 */
+/* Forward 9-7 wavelet transform in 1-D, followed by forward */
+/* lazy transform (horizontal).                              */
+/* </summary>                                                */
+void dwt97::encode_and_deinterleave_h(int32_t *a, int32_t *tmp, uint32_t d_n,
+		uint32_t s_n, uint8_t cas) {
+	/* NEW :  CASE ONE ELEMENT */
+	if (!cas ? (d_n == 0 && s_n <= 1) : (s_n == 0 && d_n <= 1))
+		return;
+
+	/* low pass and high pass samples, each with one sample of padding
+	 at both ends */
+	float *l = (float*) tmp + 1;
+	float *h = l + s_n + 2;
+	for (uint32_t i = 0; i < s_n; ++i)
+		l[i] = (float) a[cas + (i << 1)];
+	for (uint32_t i = 0; i < d_n; ++i)
+		h[i] = (float) a[1 - cas + (i << 1)];
+
+	/* offsets of the neighbours of high and low pass samples */
+	int32_t oh = cas ? -1 : 0;
+	int32_t ol = cas ? 0 : -1;
+	dwt97_pad(l, s_n);
+	dwt97_lift(h, l + oh, l + oh + 1, d_n, dwt_alpha);
+	dwt97_pad(h, d_n);
+	dwt97_lift(l, h + ol, h + ol + 1, s_n, dwt_beta);
+	dwt97_pad(l, s_n);
+	dwt97_lift(h, l + oh, l + oh + 1, d_n, dwt_gamma);
+	dwt97_pad(h, d_n);
+	dwt97_lift(l, h + ol, h + ol + 1, s_n, dwt_delta);
+	dwt97_scale(h, d_n, dwt_gain_high);
+	dwt97_scale(l, s_n, dwt_gain_low);
+
+	dwt97_to_int(l, s_n);
+	dwt97_to_int(h, d_n);
+	memcpy(a, l, s_n * sizeof(int32_t));
+	memcpy(a + s_n, h, d_n * sizeof(int32_t));
+}
+
+/* Rows of dwt_forward_mcols coefficients, for the multi-column transform */
+#define GROK_ROW_S(i) (f + ((size_t)(i) << 1) * dwt_forward_mcols)
+#define GROK_ROW_D(i) (f + (1 + ((size_t)(i) << 1)) * dwt_forward_mcols)
+#define GROK_CLAMP(i, n) ((i) < 0 ? 0 : ((i) >= (n) ? (n) - 1 : (i)))
+
+/* <summary>                                          */
+/* Forward 9-7 wavelet transform in 1-D, over columns. */
+/* </summary>                                         */
+void dwt97::encode_v_mcols(int32_t* GRK_RESTRICT a, int32_t d_n, int32_t s_n, uint8_t cas) {
+	/* NEW :  CASE ONE ELEMENT */
+	if (!cas ? (d_n == 0 && s_n <= 1) : (s_n == 0 && d_n <= 1))
+		return;
+
+	size_t n = (size_t) (d_n + s_n) * dwt_forward_mcols;
+	dwt97_to_float(a, n);
+	auto f = (float*) a;
+	const size_t m = dwt_forward_mcols;
 	if (!cas) {
-	  if ((d_n > 0) || (s_n > 1)) { /* NEW :  CASE ONE ELEMENT */
 		for (int32_t i = 0; i < d_n; i++)
-			GROK_D(i)-= int_fix_mul(GROK_S_(i) + GROK_S_(i + 1), 12994);
+			dwt97_lift(GROK_ROW_D(i), GROK_ROW_S(GROK_CLAMP(i, s_n)),
+					GROK_ROW_S(GROK_CLAMP(i + 1, s_n)), m, dwt_alpha);
 		for (int32_t i = 0; i < s_n; i++)
-			GROK_S(i) -= int_fix_mul(GROK_D_(i - 1) + GROK_D_(i), 434);
+			dwt97_lift(GROK_ROW_S(i), GROK_ROW_D(GROK_CLAMP(i - 1, d_n)),
+					GROK_ROW_D(GROK_CLAMP(i, d_n)), m, dwt_beta);
 		for (int32_t i = 0; i < d_n; i++)
-			GROK_D(i) += int_fix_mul(GROK_S_(i) + GROK_S_(i + 1), 7233);
+			dwt97_lift(GROK_ROW_D(i), GROK_ROW_S(GROK_CLAMP(i, s_n)),
+					GROK_ROW_S(GROK_CLAMP(i + 1, s_n)), m, dwt_gamma);
 		for (int32_t i = 0; i < s_n; i++)
-			GROK_S(i) += int_fix_mul(GROK_D_(i - 1) + GROK_D_(i), 3633);
+			dwt97_lift(GROK_ROW_S(i), GROK_ROW_D(GROK_CLAMP(i - 1, d_n)),
+					GROK_ROW_D(GROK_CLAMP(i, d_n)), m, dwt_delta);
 		for (int32_t i = 0; i < d_n; i++)
-			GROK_D(i) = int_fix_mul(GROK_D(i), 5039);
+			dwt97_scale(GROK_ROW_D(i), m, dwt_gain_high);
 		for (int32_t i = 0; i < s_n; i++)
-			GROK_S(i) = int_fix_mul(GROK_S(i), 6659);
-	  }
+			dwt97_scale(GROK_ROW_S(i), m, dwt_gain_low);
 	}
 	else {
-		if ((s_n > 0) || (d_n > 1)) { /* NEW :  CASE ONE ELEMENT */
-			for (int32_t i = 0; i < d_n; i++)
-				GROK_S(i) -= int_fix_mul(GROK_DD_(i) + GROK_DD_(i - 1), 12994);
-			for (int32_t i = 0; i < s_n; i++)
-				GROK_D(i) -= int_fix_mul(GROK_SS_(i) + GROK_SS_(i + 1), 434);
-			for (int32_t i = 0; i < d_n; i++)
-				GROK_S(i) += int_fix_mul(GROK_DD_(i) + GROK_DD_(i - 1), 7233);
-			for (int32_t i = 0; i < s_n; i++)
-				GROK_D(i) += int_fix_mul(GROK_SS_(i) + GROK_SS_(i + 1), 3633);
-			for (int32_t i = 0; i < d_n; i++)
-				GROK_S(i) = int_fix_mul(GROK_S(i), 5039);
-			for (int32_t i = 0; i < s_n; i++)
-				GROK_D(i) = int_fix_mul(GROK_D(i), 6659);
-		}
+		for (int32_t i = 0; i < d_n; i++)
+			dwt97_lift(GROK_ROW_S(i), GROK_ROW_D(GROK_CLAMP(i, s_n)),
+					GROK_ROW_D(GROK_CLAMP(i - 1, s_n)), m, dwt_alpha);
+		for (int32_t i = 0; i < s_n; i++)
+			dwt97_lift(GROK_ROW_D(i), GROK_ROW_S(GROK_CLAMP(i, d_n)),
+					GROK_ROW_S(GROK_CLAMP(i + 1, d_n)), m, dwt_beta);
+		for (int32_t i = 0; i < d_n; i++)
+			dwt97_lift(GROK_ROW_S(i), GROK_ROW_D(GROK_CLAMP(i, s_n)),
+					GROK_ROW_D(GROK_CLAMP(i - 1, s_n)), m, dwt_gamma);
+		for (int32_t i = 0; i < s_n; i++)
+			dwt97_lift(GROK_ROW_D(i), GROK_ROW_S(GROK_CLAMP(i, d_n)),
+					GROK_ROW_S(GROK_CLAMP(i + 1, d_n)), m, dwt_delta);
+		for (int32_t i = 0; i < d_n; i++)
+			dwt97_scale(GROK_ROW_S(i), m, dwt_gain_high);
+		for (int32_t i = 0; i < s_n; i++)
+			dwt97_scale(GROK_ROW_D(i), m, dwt_gain_low);
 	}
+	dwt97_to_int(f, n);
 }
 
+void dwt97::encode_v_fetch(int32_t *row, uint32_t len) {
+	dwt97_to_float(row, len);
+}
+
+void dwt97::encode_v_lift(uint32_t step, int32_t *row, const int32_t *a,
+		const int32_t *b, uint32_t len) {
+	static const float coeffs[] = { dwt_alpha, dwt_beta, dwt_gamma, dwt_delta };
+	dwt97_lift((float*) row, (const float*) a, (const float*) b, len,
+			coeffs[step - 1]);
+}
+
+void dwt97::encode_v_finish(int32_t *row, uint32_t len, bool low) {
+	auto f = (float*) row;
+	dwt97_scale(f, len, low ? dwt_gain_low : dwt_gain_high);
+	dwt97_to_int(f, len);
+}
 
+void dwt97::encode_v_single(int32_t *row, uint32_t len, uint8_t cas) {
+	/* NEW :  CASE ONE ELEMENT */
+	GRK_UNUSED(row);
+	GRK_UNUSED(len);
+	GRK_UNUSED(cas);
+}
+
+bool encode_97(TileComponent* tilec){
+	WaveletForward<dwt97> dwt;
+	return dwt.run(tilec);
+}
+
+}
 }
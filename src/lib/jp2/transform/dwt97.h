@@ -56,9 +56,14 @@
 #pragma once
 
 #include <stdint.h>
+#include "simd_kernels.h"
 
 namespace grk {
 
+struct TileComponent;
+
+namespace GRK_SIMD_NS {
+
 typedef union {
 	float f[4];
 } grk_dwt_4vec;
@@ -88,15 +93,46 @@ struct grk_dwt97 {
 	uint8_t odd_top_left_bit;
 };
 
-struct TileComponent;
-
 class dwt97 {
 public:
 
 	/**
-	 Forward 9-7 wavelet transform in 1-D
+	 Forward 9-7 wavelet transform in 1-D of a row, followed by forward
+	 lazy transform
+	 @param a 		row
+	 @param tmp		scratch buffer, at least d_n + s_n + 4 samples
 	 */
-	void encode_line(int32_t* GRK_RESTRICT a, int32_t d_n, int32_t s_n, uint8_t cas);
+	void encode_and_deinterleave_h(int32_t* GRK_RESTRICT a, int32_t* GRK_RESTRICT tmp,
+			uint32_t d_n, uint32_t s_n, uint8_t cas);
+
+	/**
+	 Forward 9-7 wavelet transform in 1-D of dwt_forward_mcols columns,
+	 interleaved with dwt_utils::interleave_v_mcols
+	 */
+	void encode_v_mcols(int32_t* GRK_RESTRICT a, int32_t d_n, int32_t s_n, uint8_t cas);
+	/** Number of vertical lifting steps (see LineLevelForward) */
+	static const uint32_t num_steps = 4;
+	/**
+	 Prepare a row of len samples for vertical lifting:
+	 samples are converted to floating point, in place
+	 */
+	void encode_v_fetch(int32_t* GRK_RESTRICT row, uint32_t len);
+	/**
+	 Vertical lifting step of a row, from the rows a and b on either side
+	 */
+	void encode_v_lift(uint32_t step, int32_t* GRK_RESTRICT row,
+			const int32_t* GRK_RESTRICT a, const int32_t* GRK_RESTRICT b,
+			uint32_t len);
+	/**
+	 Finish the vertical transform of a low or high pass row:
+	 samples are scaled, and rounded to the nearest integer
+	 */
+	void encode_v_finish(int32_t* GRK_RESTRICT row, uint32_t len, bool low);
+	/**
+	 Vertical transform of a resolution that is a single row high
+	 */
+	void encode_v_single(int32_t* GRK_RESTRICT row, uint32_t len, uint8_t cas);
 
 };
 }
+}
@@ -104,6 +104,32 @@ void dwt_utils::deinterleave_v(int32_t *a, int32_t *b, uint32_t d_n, uint32_t s_
 	}
 }
 
+void dwt_utils::interleave_v_mcols(const int32_t *a, int32_t *b, uint32_t h,
+		uint32_t stride, uint32_t cols) {
+	for (uint32_t k = 0; k < h; ++k) {
+		auto dest = b + (size_t) k * dwt_forward_mcols;
+		memcpy(dest, a + (size_t) k * stride, cols * sizeof(int32_t));
+		if (cols < dwt_forward_mcols)
+			memset(dest + cols, 0,
+					(dwt_forward_mcols - cols) * sizeof(int32_t));
+	}
+}
+
+void dwt_utils::deinterleave_v_mcols(const int32_t *a, int32_t *b,
+		uint32_t d_n, uint32_t s_n, uint32_t stride, int32_t cas,
+		uint32_t cols) {
+	auto src = a + (size_t) cas * dwt_forward_mcols;
+	for (uint32_t i = 0; i < s_n; ++i) {
+		memcpy(b + (size_t) i * stride, src, cols * sizeof(int32_t));
+		src += 2 * dwt_forward_mcols;
+	}
+	src = a + (size_t) (1 - cas) * dwt_forward_mcols;
+	for (uint32_t i = 0; i < d_n; ++i) {
+		memcpy(b + (size_t) (s_n + i) * stride, src, cols * sizeof(int32_t));
+		src += 2 * dwt_forward_mcols;
+	}
+}
+
 /* <summary>			                 */
 /* Forward lazy transform (horizontal).  */
 /* </summary>                            */
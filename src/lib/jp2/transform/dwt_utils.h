@@ -59,6 +59,18 @@ namespace grk {
 
 struct TileComponent;
 
+/** Number of adjacent columns transformed together in the forward vertical pass */
+const uint32_t dwt_forward_mcols = 16;
+
+/**
+ The line-based transforms write the final rows (forward: the sub-bands)
+ to a second buffer the size of the tile component, which then replaces
+ the tile buffer. Beyond this many samples in such buffers, the per level
+ transforms are used instead: they work in place, with scratch of a few
+ rows or columns of the largest resolution.
+ */
+const uint64_t dwt_line_max_samples = (uint64_t) 1 << 22;
+
 struct grk_dwt {
 	int32_t *mem;
 	uint32_t d_n;
@@ -90,6 +102,19 @@ public:
 			uint32_t stride, int32_t cas);
 	static void deinterleave_h(int32_t *a, int32_t *b, uint32_t d_n, uint32_t s_n,
 			int32_t cas);
+	/**
+	 Copy cols (at most dwt_forward_mcols) adjacent columns of height h into
+	 b, one row of dwt_forward_mcols coefficients per line. Unused lanes
+	 are cleared.
+	 */
+	static void interleave_v_mcols(const int32_t *a, int32_t *b, uint32_t h,
+			uint32_t stride, uint32_t cols);
+	/**
+	 Forward lazy transform (vertical) of cols adjacent columns
+	 previously copied with interleave_v_mcols
+	 */
+	static void deinterleave_v_mcols(const int32_t *a, int32_t *b, uint32_t d_n,
+			uint32_t s_n, uint32_t stride, int32_t cas, uint32_t cols);
 
 private:
 	static double getnorm(uint32_t level, uint8_t orient, bool reversible);
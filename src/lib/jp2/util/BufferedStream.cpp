@@ -335,7 +335,9 @@ bool BufferedStream::flush() {
 }
 
 void BufferedStream::invalidate_buffer() {
-	m_buf->offset = 0;
+	// the buffer of a memory stream is the stream itself,
+	// so its offset must stay in step with the stream offset
+	m_buf->offset = isMemStream() ? (size_t) m_stream_offset : 0;
 	m_buffered_bytes = 0;
 	if (m_status & GROK_STREAM_STATUS_INPUT)
 		m_read_bytes_seekable = 0;
@@ -252,15 +252,38 @@ const InstructionSet::InstructionSet_Internal InstructionSet::CPU_Rep;
 
 
 
+/*
+ With GCC and Clang on x86, features are queried at run time, so that
+ kernels built for a wider instruction set than the compiler target
+ can be selected on CPUs that support them.
+ */
+#if !defined(WIN32) && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define GRK_CPU_SUPPORTS(feature) __builtin_cpu_supports(feature)
+#endif
+
 namespace grk {
 
 
+bool CPUArch::AVX512F(){
+#ifdef __AVX512F__
+	return true;
+#else
+#ifdef WIN32
+	return InstructionSet::AVX512F();
+#elif defined(GRK_CPU_SUPPORTS)
+	return GRK_CPU_SUPPORTS("avx512f");
+#endif
+#endif
+	return false;
+}
 bool CPUArch::AVX2(){
 #ifdef __AVX2__
 	return true;
 #else
 #ifdef WIN32
 	return InstructionSet::AVX2();
+#elif defined(GRK_CPU_SUPPORTS)
+	return GRK_CPU_SUPPORTS("avx2");
 #endif
 #endif
 	return false;
@@ -271,6 +294,8 @@ bool CPUArch::AVX(){
 #else
 #ifdef WIN32
 	return InstructionSet::AVX();
+#elif defined(GRK_CPU_SUPPORTS)
+	return GRK_CPU_SUPPORTS("avx");
 #endif
 #endif
 	return false;
@@ -281,6 +306,8 @@ bool CPUArch::SSE4_1(){
 #else
 #ifdef WIN32
 	return InstructionSet::SSE41();
+#elif defined(GRK_CPU_SUPPORTS)
+	return GRK_CPU_SUPPORTS("sse4.1");
 #endif
 #endif
 	return false;
@@ -291,6 +318,8 @@ bool CPUArch::SSE3(){
 #else
 #ifdef WIN32
 	return InstructionSet::SSE3();
+#elif defined(GRK_CPU_SUPPORTS)
+	return GRK_CPU_SUPPORTS("sse3");
 #endif
 #endif
 	return false;
@@ -298,12 +327,16 @@ bool CPUArch::SSE3(){
 bool CPUArch::BMI1(){
 #ifdef WIN32
 	return InstructionSet::BMI1();
+#elif defined(GRK_CPU_SUPPORTS)
+	return GRK_CPU_SUPPORTS("bmi");
 #endif
 	return false;
 }
 bool CPUArch::BMI2(){
 #ifdef WIN32
 	return InstructionSet::BMI2();
+#elif defined(GRK_CPU_SUPPORTS)
+	return GRK_CPU_SUPPORTS("bmi2");
 #endif
 	return false;
 }
@@ -36,6 +36,7 @@ namespace grk {
 
 class CPUArch {
 public:
+	bool AVX512F();
 	bool AVX2();
 	bool AVX();
 	bool SSE4_1();
@@ -125,6 +125,13 @@ void ChunkBuffer::add_chunk(grk_buf *chunk) {
 	data_len += chunk->len;
 }
 
+void ChunkBuffer::extend_last_chunk(size_t len) {
+	if (chunks.empty())
+		return;
+	chunks.back()->len += len;
+	data_len += len;
+}
+
 void ChunkBuffer::cleanup(void) {
 	for (size_t i = 0; i < chunks.size(); ++i)
 		delete chunks[i];
@@ -139,6 +146,27 @@ void ChunkBuffer::rewind(void) {
 	}
 	cur_chunk_id = 0;
 }
+
+bool ChunkBuffer::seek(size_t offset) {
+	if (chunks.empty() || offset > data_len)
+		return false;
+	size_t chunk_start = 0;
+	for (size_t i = 0; i < chunks.size(); ++i) {
+		auto chunk = chunks[i];
+		if (offset < chunk_start + chunk->len || i == chunks.size() - 1) {
+			chunk->offset = offset - chunk_start;
+			cur_chunk_id = i;
+			for (size_t j = i + 1; j < chunks.size(); ++j)
+				chunks[j]->offset = 0;
+			return true;
+		}
+		chunk->offset = chunk->len;
+		chunk_start += chunk->len;
+	}
+
+	return false;
+}
+
 bool ChunkBuffer::push_back(uint8_t *buf, size_t len) {
 	if (!buf || !len)
 		return false;
@@ -70,6 +70,12 @@ struct ChunkBuffer {
 	 */
 	void rewind(void);
 
+	/*
+	 Treat segmented buffer as single contiguous buffer, and set current offset.
+	 Returns false if offset is beyond end of buffer
+	 */
+	bool seek(size_t offset);
+
 	size_t skip(size_t nb_bytes);
 
 	void increment(void);
@@ -79,6 +85,12 @@ struct ChunkBuffer {
 	grk_buf* add_chunk(uint8_t *buf, size_t len, bool ownsData);
 	void add_chunk(grk_buf *seg);
 
+	/*
+	 Extend last chunk by len bytes, for a chunk that is allocated
+	 ahead of time and filled as data arrives
+	 */
+	void extend_last_chunk(size_t len);
+
 	/*
 	 Copy all chunks, in sequence, into contiguous array
 	 */
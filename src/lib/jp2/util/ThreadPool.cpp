@@ -0,0 +1,79 @@
+/*
+ *    Copyright (C) 2016-2020 Grok Image Compression Inc.
+ *
+ *    This source code is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This source code is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ThreadPool.hpp"
+
+ThreadPool* ThreadPool::singleton = nullptr;
+std::mutex ThreadPool::singleton_mutex;
+thread_local uint32_t ThreadPool::job_limit = 0;
+
+// the constructor just launches some amount of workers
+ThreadPool::ThreadPool(size_t threads)
+    :   stop(false), thread_count(-1), m_num_threads(threads)
+{
+    for(size_t i = 0;i<threads;++i)
+        workers.emplace_back(
+            [this]
+            {
+    			{
+    			std::unique_lock<std::mutex> lock(this->queue_mutex);
+    			auto thread_num = ++thread_count;
+    			id_map[std::this_thread::get_id()] = thread_num;
+    			}
+                for(;;)
+                {
+                    std::function<void()> task;
+
+                    {
+                        std::unique_lock<std::mutex> lock(this->queue_mutex);
+                        this->condition.wait(lock,
+                            [this]{ return this->stop || !this->tasks.empty(); });
+                        if(this->stop && this->tasks.empty())
+                            return;
+                        task = std::move(this->tasks.front());
+                        this->tasks.pop();
+                    }
+
+                    task();
+                }
+            }
+        );
+}
+
+// the destructor joins all threads
+ThreadPool::~ThreadPool()
+{
+    {
+        std::unique_lock<std::mutex> lock(queue_mutex);
+        stop = true;
+    }
+    condition.notify_all();
+    for(std::thread &worker: workers)
+        worker.join();
+}
+
+ThreadPool* ThreadPool::instance(uint32_t numthreads){
+	std::unique_lock<std::mutex> lock(singleton_mutex);
+	if (!singleton)
+		singleton = new ThreadPool(numthreads ? numthreads : hardware_concurrency());
+	return singleton;
+}
+
+void ThreadPool::release(){
+	std::unique_lock<std::mutex> lock(singleton_mutex);
+	delete singleton;
+	singleton = nullptr;
+}
@@ -28,8 +28,15 @@
 #include <functional>
 #include <stdexcept>
 #include <map>
+#include <algorithm>
 
 
+/*
+ The constructor, destructor and singleton management are defined in
+ ThreadPool.cpp rather than inline: the SIMD kernel sources that include
+ this header are also built with AVX2 and AVX-512 flags, and must not emit
+ copies of functions that baseline code may end up calling
+ */
 class ThreadPool {
 public:
     ThreadPool(size_t);
@@ -43,21 +50,20 @@ public:
     	return -1;
     }
     size_t num_threads(){return m_num_threads;}
+    // number of jobs that the calling thread should split its work into:
+    // the number of threads, capped by the calling thread's job limit
+    size_t num_jobs(){
+    	return job_limit ? std::min<size_t>(job_limit, m_num_threads) : m_num_threads;
+    }
+    // maximum number of jobs for work submitted by the calling thread (0: no limit),
+    // so that codecs running concurrently on different threads share the pool
+    static thread_local uint32_t job_limit;
 
 	static ThreadPool* get(){
 		return instance(0);
 	}
-	static ThreadPool* instance(uint32_t numthreads){
-		std::unique_lock<std::mutex> lock(singleton_mutex);
-		if (!singleton)
-			singleton = new ThreadPool(numthreads ? numthreads : hardware_concurrency());
-		return singleton;
-	}
-	static void release(){
-		std::unique_lock<std::mutex> lock(singleton_mutex);
-		delete singleton;
-		singleton = nullptr;
-	}
+	static ThreadPool* instance(uint32_t numthreads);
+	static void release();
 	static uint32_t hardware_concurrency() {
 		uint32_t ret = 0;
 
@@ -92,39 +98,6 @@ private:
 
 };
  
-// the constructor just launches some amount of workers
-inline ThreadPool::ThreadPool(size_t threads)
-    :   stop(false), thread_count(-1), m_num_threads(threads)
-{
-    for(size_t i = 0;i<threads;++i)
-        workers.emplace_back(
-            [this]
-            {
-    			{
-    			std::unique_lock<std::mutex> lock(this->queue_mutex);
-    			auto thread_num = ++thread_count;
-    			id_map[std::this_thread::get_id()] = thread_num;
-    			}
-                for(;;)
-                {
-                    std::function<void()> task;
-
-                    {
-                        std::unique_lock<std::mutex> lock(this->queue_mutex);
-                        this->condition.wait(lock,
-                            [this]{ return this->stop || !this->tasks.empty(); });
-                        if(this->stop && this->tasks.empty())
-                            return;
-                        task = std::move(this->tasks.front());
-                        this->tasks.pop();
-                    }
-
-                    task();
-                }
-            }
-        );
-}
-
 // add new work item to the pool
 template<class F, class... Args>
 auto ThreadPool::enqueue(F&& f, Args&&... args) 
@@ -149,15 +122,3 @@ auto ThreadPool::enqueue(F&& f, Args&&... args)
     condition.notify_one();
     return res;
 }
-
-// the destructor joins all threads
-inline ThreadPool::~ThreadPool()
-{
-    {
-        std::unique_lock<std::mutex> lock(queue_mutex);
-        stop = true;
-    }
-    condition.notify_all();
-    for(std::thread &worker: workers)
-        worker.join();
-}
@@ -0,0 +1,123 @@
+/*
+ *    Copyright (C) 2016-2020 Grok Image Compression Inc.
+ *
+ *    This source code is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This source code is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "grok_includes.h"
+
+namespace grk {
+
+WriteChunkBuffer::WriteChunkBuffer(size_t chunk_size) :
+		m_chunk_size(chunk_size ? chunk_size : 1), m_offset(0), m_data_len(0) {
+}
+
+WriteChunkBuffer::~WriteChunkBuffer() {
+	for (auto &ch : m_chunks)
+		delete[] ch;
+}
+
+bool WriteChunkBuffer::grow(uint64_t len) {
+	while ((uint64_t) m_chunks.size() * m_chunk_size < len) {
+		auto chunk = new (std::nothrow) uint8_t[m_chunk_size];
+		if (!chunk) {
+			GROK_ERROR("Failed to allocate %llu bytes for write chunk buffer",
+					(unsigned long long) m_chunk_size);
+			return false;
+		}
+		m_chunks.push_back(chunk);
+	}
+
+	return true;
+}
+
+size_t WriteChunkBuffer::write(const uint8_t *buf, size_t len) {
+	if (!buf || !len)
+		return 0;
+	if (!grow(m_offset + len))
+		return 0;
+
+	// zero-fill gap left by seek past end of data
+	while (m_data_len < m_offset) {
+		size_t chunk_offset = (size_t) (m_data_len % m_chunk_size);
+		size_t to_fill = (size_t) std::min<uint64_t>(
+				m_chunk_size - chunk_offset, m_offset - m_data_len);
+		memset(m_chunks[(size_t) (m_data_len / m_chunk_size)] + chunk_offset,
+				0, to_fill);
+		m_data_len += to_fill;
+	}
+
+	size_t written = 0;
+	while (written < len) {
+		size_t chunk_offset = (size_t) (m_offset % m_chunk_size);
+		size_t to_write = std::min<size_t>(m_chunk_size - chunk_offset,
+				len - written);
+		memcpy(m_chunks[(size_t) (m_offset / m_chunk_size)] + chunk_offset,
+				buf + written, to_write);
+		written += to_write;
+		m_offset += to_write;
+	}
+	m_data_len = std::max<uint64_t>(m_data_len, m_offset);
+
+	return written;
+}
+
+bool WriteChunkBuffer::seek(uint64_t offset) {
+	m_offset = offset;
+
+	return true;
+}
+
+uint64_t WriteChunkBuffer::tell(void) const {
+	return m_offset;
+}
+
+uint64_t WriteChunkBuffer::length(void) const {
+	return m_data_len;
+}
+
+size_t WriteChunkBuffer::copy_to_contiguous_buffer(uint8_t *buffer,
+		size_t len) const {
+	if (!buffer)
+		return 0;
+	size_t copied = 0;
+	size_t total = (size_t) std::min<uint64_t>(m_data_len, len);
+	for (size_t i = 0; copied < total; ++i) {
+		size_t to_copy = std::min<size_t>(m_chunk_size, total - copied);
+		memcpy(buffer + copied, m_chunks[i], to_copy);
+		copied += to_copy;
+	}
+
+	return copied;
+}
+
+size_t WriteChunkBuffer::num_chunks(void) const {
+	return (size_t) ((m_data_len + m_chunk_size - 1) / m_chunk_size);
+}
+
+uint8_t* WriteChunkBuffer::get_chunk(size_t chunk_id, size_t *len) const {
+	if (chunk_id >= num_chunks()) {
+		if (len)
+			*len = 0;
+		return nullptr;
+	}
+	if (len) {
+		uint64_t begin = (uint64_t) chunk_id * m_chunk_size;
+		*len = (size_t) std::min<uint64_t>(m_chunk_size, m_data_len - begin);
+	}
+
+	return m_chunks[chunk_id];
+}
+
+}
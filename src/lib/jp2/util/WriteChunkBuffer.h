@@ -0,0 +1,80 @@
+/*
+ *    Copyright (C) 2016-2020 Grok Image Compression Inc.
+ *
+ *    This source code is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This source code is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include <vector>
+
+#pragma once
+namespace grk {
+
+/*  WriteChunkBuffer
+
+ Growable write buffer, stored as a list of fixed-size chunks.
+ The buffer grows by appending new chunks, so previously written
+ data is never moved or copied. Any offset may be revisited,
+ so that lengths written as place holders can be patched later on.
+
+ */
+struct WriteChunkBuffer {
+	WriteChunkBuffer(size_t chunk_size);
+	~WriteChunkBuffer();
+
+	/*
+	 Write bytes at current offset, growing the buffer as needed.
+	 Returns number of bytes written
+	 */
+	size_t write(const uint8_t *buf, size_t len);
+
+	/*
+	 Set current offset. Seeking beyond end of data is allowed;
+	 the gap will be zero-filled on the next write.
+	 */
+	bool seek(uint64_t offset);
+
+	uint64_t tell(void) const;
+
+	/*
+	 Total length of data written
+	 */
+	uint64_t length(void) const;
+
+	/*
+	 Copy all data, in sequence, into contiguous array.
+	 Returns number of bytes copied, which is at most len
+	 */
+	size_t copy_to_contiguous_buffer(uint8_t *buffer, size_t len) const;
+
+	/*
+	 Number of chunks holding data
+	 */
+	size_t num_chunks(void) const;
+
+	/*
+	 Get pointer to chunk, and length of data stored in chunk
+	 */
+	uint8_t* get_chunk(size_t chunk_id, size_t *len) const;
+
+private:
+	bool grow(uint64_t len);
+
+	size_t m_chunk_size;
+	uint64_t m_offset; /* current write offset */
+	uint64_t m_data_len; /* total length of data written */
+	std::vector<uint8_t*> m_chunks;
+};
+
+}
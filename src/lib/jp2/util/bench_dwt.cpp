@@ -47,234 +47,870 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
-#include "grok_includes.h"
+/*
+ Benchmark and validation harness for the wavelet transforms.
+
+ For every combination of thread count, tile size, number of resolutions,
+ filter (5/3, 9/7, and 9/7 in 16 bit fixed point for previews) and SIMD level,
+ a synthetic tile component is transformed forward, then back, with the
+ kernels of that level: inverse transforms are run on the whole tile
+ and on a window of it (region decompression, through the sparse array).
+ Each run is checked against the original samples, and a checksum of its
+ output is reported, so that results can be compared across SIMD levels,
+ thread counts and builds. Output is a text table, CSV or JSON.
+
+ With -counters, last level cache misses of each run are also read from
+ the hardware performance counters (Linux perf_event), as an estimate of
+ its DRAM traffic.
+ */
 
-#ifdef _WIN32
-#include <windows.h>
-#else
-#include <sys/time.h>
-#include <sys/resource.h>
-#include <sys/times.h>
-#endif /* _WIN32 */
+#include "grok_includes.h"
 
 #include <chrono>  // for high_resolution_clock
+#include <cmath>
+#include <string>
+#include <vector>
+#include <algorithm>
+#ifdef __linux__
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
 
 using namespace grk;
 
 namespace grk {
 
-int32_t getValue(uint32_t i)
-{
-    return ((int32_t)i % 511) - 256;
+enum BENCH_FILTER {
+	BENCH_FILTER_53,
+	BENCH_FILTER_97,
+	BENCH_FILTER_97_FIXED,
+	BENCH_NUM_FILTERS
+};
+
+static const char *bench_filter_names[BENCH_NUM_FILTERS] = { "53", "97", "97f" };
+
+
+enum BENCH_FORMAT {
+	BENCH_FORMAT_TEXT,
+	BENCH_FORMAT_CSV,
+	BENCH_FORMAT_JSON
+};
+
+struct BenchOptions {
+	BenchOptions() : sizes({ 256, 1023, 2048 }),
+					 resolutions({ 3, 6 }),
+					 filters({ BENCH_FILTER_53, BENCH_FILTER_97, BENCH_FILTER_97_FIXED }),
+					 forward(true),
+					 inverse(true),
+					 full(true),
+					 partial(true),
+					 has_window(false),
+					 offset_x(0),
+					 offset_y(0),
+					 repeat(3),
+					 format(BENCH_FORMAT_TEXT),
+					 counters(false),
+					 out(stdout)
+	{}
+	std::vector<uint32_t> sizes;
+	std::vector<uint32_t> resolutions;
+	std::vector<uint32_t> threads;
+	std::vector<uint32_t> filters;
+	std::vector<GRK_SIMD_LEVEL> levels;
+	bool forward;
+	bool inverse;
+	bool full;
+	bool partial;
+	/* window of partial decompression, relative to the tile origin */
+	bool has_window;
+	uint32_t window[4];
+	uint32_t offset_x;
+	uint32_t offset_y;
+	uint32_t repeat;
+	BENCH_FORMAT format;
+	bool counters;
+	FILE *out;
+};
+
+struct BenchResult {
+	const char *transform;
+	const char *filter;
+	const char *window;
+	uint32_t width;
+	uint32_t height;
+	uint32_t numres;
+	uint32_t threads;
+	const char *level;
+	double ms_min;
+	double ms_median;
+	uint32_t max_error;
+	uint32_t checksum;
+	bool pass;
+	/* DRAM traffic estimated from last level cache misses, in MB per run,
+	 * or negative if it wasn't measured */
+	double dram_mb;
+};
+
+/*
+ Last level cache misses of every thread of the process, counted in user
+ space by the hardware performance counters. Each miss moves a 64 byte
+ line between the cache and memory.
+ */
+class BenchCounters {
+public:
+	BenchCounters() = default;
+	~BenchCounters() {
+		close();
+	}
+	BenchCounters(const BenchCounters&) = delete;
+	BenchCounters& operator=(const BenchCounters&) = delete;
+
+	/* Open a counter for each thread: the thread pool must be started.
+	 * Return false if the counters are not available */
+	bool open() {
+		close();
+#ifdef __linux__
+		auto dir = opendir("/proc/self/task");
+		if (!dir)
+			return false;
+		struct dirent *entry;
+		bool rc = true;
+		while (rc && (entry = readdir(dir)) != nullptr) {
+			if (entry->d_name[0] == '.')
+				continue;
+			struct perf_event_attr attr;
+			memset(&attr, 0, sizeof(attr));
+			attr.size = sizeof(attr);
+			attr.type = PERF_TYPE_HARDWARE;
+			attr.config = PERF_COUNT_HW_CACHE_MISSES;
+			attr.exclude_kernel = 1;
+			attr.exclude_hv = 1;
+			int fd = (int) syscall(__NR_perf_event_open, &attr,
+					(pid_t) atoi(entry->d_name), -1, -1, 0);
+			if (fd < 0)
+				rc = false;
+			else
+				m_fds.push_back(fd);
+		}
+		closedir(dir);
+		if (!rc)
+			close();
+
+		return rc;
+#else
+		return false;
+#endif
+	}
+	void close() {
+#ifdef __linux__
+		for (auto fd : m_fds)
+			::close(fd);
+#endif
+		m_fds.clear();
+	}
+	bool is_open() const {
+		return !m_fds.empty();
+	}
+	/* Misses of all threads so far */
+	uint64_t misses() const {
+		uint64_t total = 0;
+#ifdef __linux__
+		for (auto fd : m_fds) {
+			uint64_t val = 0;
+			if (::read(fd, &val, sizeof(val)) == (ssize_t) sizeof(val))
+				total += val;
+		}
+#endif
+		return total;
+	}
+	static const uint32_t line_size = 64;
+private:
+	std::vector<int> m_fds;
+};
+
+/*
+ A single tile component, set up as TileProcessor sets it up
+ for decompression. TileProcessor owns the tile, and the tile component
+ owns its resolutions, buffer and sparse array.
+ */
+struct BenchTile {
+	BenchTile() : tcd(false),
+				  cp(),
+				  image(),
+				  image_comp(),
+				  tilec(nullptr)
+	{}
+	bool init(uint32_t x0, uint32_t y0, uint32_t x1, uint32_t y1,
+			uint32_t numres);
+	/* whole tile if win is null */
+	bool set_window(const grk_rect *win);
+
+	TileProcessor tcd;
+	CodingParams cp;
+	grk_image image;
+	grk_image_comp image_comp;
+	TileComponent *tilec;
+};
+
+/* 8 bit signed samples: gradients with some texture */
+static int32_t bench_sample(uint32_t x, uint32_t y) {
+	return (int32_t) ((3 * x + 5 * y + ((x * y) % 29)) % 256) - 128;
 }
 
-void init_tilec(TileComponent * l_tilec,
-                uint32_t x0,
-                uint32_t y0,
-                uint32_t x1,
-                uint32_t y1,
-                uint32_t numresolutions)
-{
-    grk_tcd_resolution* l_res;
-    uint32_t resno, l_level_no;
-    size_t i, nValues;
-
-    l_tilec->x0 = x0;
-    l_tilec->y0 = y0;
-    l_tilec->x1 = x1;
-    l_tilec->y1 = y1;
-    l_tilec->m_is_encoder = false;
-    l_tilec->create_buffer(nullptr,1,1);
-
-    nValues = (size_t)(l_tilec->x1 - l_tilec->x0) *
-              (size_t)(l_tilec->y1 - l_tilec->y0);
-    l_tilec->buf->data = (int32_t*) grk_malloc(sizeof(int32_t) * nValues);
-    for (i = 0; i < nValues; i++) {
-        l_tilec->buf->data[i] = getValue((uint32_t)i);
-    }
-    l_tilec->numresolutions = numresolutions;
-    l_tilec->minimum_num_resolutions = numresolutions;
-    l_tilec->resolutions = (grk_tcd_resolution*) grk_calloc(
-                               l_tilec->numresolutions,
-                               sizeof(grk_tcd_resolution));
-
-    l_level_no = l_tilec->numresolutions;
-    l_res = l_tilec->resolutions;
-
-    /* Adapted from grk_tcd_init_tile() */
-    for (resno = 0; resno < l_tilec->numresolutions; ++resno) {
-
-        --l_level_no;
-
-        /* border for each resolution level (global) */
-        l_res->x0 = uint_ceildivpow2(l_tilec->x0, l_level_no);
-        l_res->y0 = uint_ceildivpow2(l_tilec->y0, l_level_no);
-        l_res->x1 = uint_ceildivpow2(l_tilec->x1, l_level_no);
-        l_res->y1 = uint_ceildivpow2(l_tilec->y1, l_level_no);
-
-        ++l_res;
-    }
+/*
+ Largest difference with the original samples allowed after a round trip.
+ The forward 9/7 transform rounds coefficients to integers, an error
+ that the inverse transform amplifies a little more at each level.
+ */
+static uint32_t bench_tolerance(uint32_t filter, uint32_t numres) {
+	return filter == BENCH_FILTER_53 ? 0 : 2 * numres;
 }
 
-void free_tilec(TileComponent * l_tilec)
-{
-    grok_free(l_tilec->buf->data);
-    grok_free(l_tilec->resolutions);
+static uint32_t bench_checksum(uint32_t hash, int32_t val) {
+	/* FNV-1a */
+	auto v = (uint32_t) val;
+	for (uint32_t i = 0; i < 4; ++i) {
+		hash ^= (v >> (i * 8)) & 0xFF;
+		hash *= 16777619U;
+	}
+	return hash;
 }
 
-void usage(void)
-{
-    printf(
-        "bench_dwt [-size value] [-check] [-display] [-num_resolutions val] [-lossy]\n");
-    printf(
-        "          [-offset x y] [-num_threads val]\n");
+static bool bench_alloc(TileBuffer *buf, uint64_t num_samples) {
+	uint64_t size = max<uint64_t>(num_samples, 1) * sizeof(int32_t);
+	if (buf->data && buf->owns_data && buf->data_size >= size)
+		return true;
+	if (buf->owns_data)
+		grk_aligned_free(buf->data);
+	buf->data = (int32_t*) grk_aligned_malloc(size);
+	buf->owns_data = true;
+	buf->data_size = buf->data ? size : 0;
+
+	return buf->data != nullptr;
+}
+
+bool BenchTile::init(uint32_t x0, uint32_t y0, uint32_t x1, uint32_t y1,
+		uint32_t numres) {
+	auto tile = (grk_tcd_tile*) grk_calloc(1, sizeof(grk_tcd_tile));
+	if (!tile)
+		return false;
+	tile->x0 = x0;
+	tile->y0 = y0;
+	tile->x1 = x1;
+	tile->y1 = y1;
+	tile->numcomps = 1;
+	tile->comps = new TileComponent[1];
+	tcd.tile = tile;
+	tcd.image = &image;
+	tcd.m_cp = &cp;
+	image.numcomps = 1;
+	image.comps = &image_comp;
+	image_comp.dx = 1;
+	image_comp.dy = 1;
+	image_comp.prec = 8;
+	image_comp.sgnd = true;
+
+	tilec = tile->comps;
+	tilec->x0 = x0;
+	tilec->y0 = y0;
+	tilec->x1 = x1;
+	tilec->y1 = y1;
+	tilec->m_is_encoder = false;
+	tilec->numresolutions = numres;
+	tilec->minimum_num_resolutions = numres;
+	tilec->resolutions = new grk_tcd_resolution[numres];
+	tilec->numAllocatedResolutions = numres;
+
+	/* Adapted from TileComponent::init() */
+	for (uint32_t resno = 0; resno < numres; ++resno) {
+		auto res = tilec->resolutions + resno;
+		uint32_t leveno = numres - 1 - resno;
+
+		res->x0 = uint_ceildivpow2(x0, leveno);
+		res->y0 = uint_ceildivpow2(y0, leveno);
+		res->x1 = uint_ceildivpow2(x1, leveno);
+		res->y1 = uint_ceildivpow2(y1, leveno);
+		res->numbands = resno ? 3 : 1;
+		for (uint32_t bandno = 0; bandno < res->numbands; ++bandno) {
+			auto band = res->bands + bandno;
+			if (resno == 0) {
+				band->bandno = 0;
+				band->x0 = res->x0;
+				band->y0 = res->y0;
+				band->x1 = res->x1;
+				band->y1 = res->y1;
+			} else {
+				band->bandno = (uint8_t) (bandno + 1);
+				uint32_t x0b = band->bandno & 1;
+				uint32_t y0b = (uint32_t) (band->bandno >> 1);
+				band->x0 = uint64_ceildivpow2(x0 - ((uint64_t) x0b << leveno),
+						leveno + 1);
+				band->y0 = uint64_ceildivpow2(y0 - ((uint64_t) y0b << leveno),
+						leveno + 1);
+				band->x1 = uint64_ceildivpow2(x1 - ((uint64_t) x0b << leveno),
+						leveno + 1);
+				band->y1 = uint64_ceildivpow2(y1 - ((uint64_t) y0b << leveno),
+						leveno + 1);
+			}
+		}
+	}
+	tilec->unreduced_tile_dim = grk_rect(x0, y0, x1, y1);
+	if (!tilec->create_buffer(nullptr, 1, 1))
+		return false;
+
+	return set_window(nullptr);
 }
 
+bool BenchTile::set_window(const grk_rect *win) {
+	auto buf = tilec->buf;
+	grk_rect dim = grk_rect(tilec->x0, tilec->y0, tilec->x1, tilec->y1);
+	if (win)
+		dim = *win;
+	tcd.whole_tile_decoding = (win == nullptr);
+	tilec->whole_tile_decoding = tcd.whole_tile_decoding;
+	buf->reduced_region_dim = dim;
+	buf->unreduced_region_dim = dim;
+
+	/* Adapted from TileProcessor::decompress_tile() */
+	uint32_t numres = tilec->numresolutions;
+	for (uint32_t resno = 0; resno < numres; ++resno) {
+		auto res = tilec->resolutions + resno;
+		res->win_x0 = uint_ceildivpow2((uint32_t) dim.x0, numres - 1 - resno);
+		res->win_y0 = uint_ceildivpow2((uint32_t) dim.y0, numres - 1 - resno);
+		res->win_x1 = uint_ceildivpow2((uint32_t) dim.x1, numres - 1 - resno);
+		res->win_y1 = uint_ceildivpow2((uint32_t) dim.y1, numres - 1 - resno);
+	}
+
+	return bench_alloc(buf, (uint64_t) (dim.x1 - dim.x0) * (uint64_t) (dim.y1 - dim.y0));
 }
 
+/* fill the whole tile with the original samples */
+static void bench_fill(TileComponent *tilec) {
+	auto data = tilec->buf->data;
+	for (uint32_t y = tilec->y0; y < tilec->y1; ++y) {
+		for (uint32_t x = tilec->x0; x < tilec->x1; ++x)
+			*data++ = bench_sample(x, y);
+	}
+}
 
+/* compare the samples of window win of tilec with the original samples */
+static void bench_compare(TileComponent *tilec, const grk_rect &win,
+		bool is_float, BenchResult *result) {
+	auto data = tilec->buf->data;
+	uint32_t max_error = 0;
+	uint32_t checksum = 2166136261U;
+	for (uint32_t y = (uint32_t) win.y0; y < (uint32_t) win.y1; ++y) {
+		for (uint32_t x = (uint32_t) win.x0; x < (uint32_t) win.x1; ++x) {
+			int32_t val = *data++;
+			if (is_float) {
+				float f;
+				memcpy(&f, &val, sizeof(f));
+				val = (int32_t) lrintf(f);
+			}
+			max_error = max<uint32_t>(max_error,
+					(uint32_t) abs(val - bench_sample(x, y)));
+			checksum = bench_checksum(checksum, val);
+		}
+	}
+	result->max_error = max_error;
+	result->checksum = checksum;
+}
 
-int main(int argc, char** argv)
-{
-    uint32_t num_threads = 0;
-    TileProcessor tcd(true);
-    grk_image tcd_image;
-    grk_tcd_tile tcd_tile;
-    TileComponent tilec;
-    grk_image image;
-    grk_image_comp image_comp;
-    int32_t i, j, k;
-    bool display = false;
-    bool check = false;
-    bool lossy = false;
-    uint32_t size = 16384 - 1;
-    uint32_t offset_x = (uint32_t)((size + 1) / 2 - 1);
-    uint32_t offset_y = (uint32_t)((size + 1) / 2 - 1);
-    uint32_t num_resolutions = 6;
-
-    for (i = 1; i < argc; i++) {
-        if (strcmp(argv[i], "-display") == 0) {
-            display = true;
-            check = true;
-        } else if (strcmp(argv[i], "-check") == 0) {
-            check = true;
-        } else if (strcmp(argv[i], "-size") == 0 && i + 1 < argc) {
-            size = (uint32_t)atoi(argv[i + 1]);
-            i ++;
-        } else if (strcmp(argv[i], "-lossy") == 0) {
-            lossy = true;
-            i ++;
-        } else if (strcmp(argv[i], "-num_threads") == 0 && i + 1 < argc) {
-            num_threads = (uint32_t)atoi(argv[i + 1]);
-            i ++;
-        } else if (strcmp(argv[i], "-num_resolutions") == 0 && i + 1 < argc) {
-            num_resolutions = (uint32_t)atoi(argv[i + 1]);
-            if (num_resolutions == 0 || num_resolutions > 32) {
-                fprintf(stderr,
-                        "Invalid value for num_resolutions. Should be >= 1 and <= 32\n");
-                exit(1);
-            }
-            i ++;
-        } else if (strcmp(argv[i], "-offset") == 0 && i + 2 < argc) {
-            offset_x = (uint32_t)atoi(argv[i + 1]);
-            offset_y = (uint32_t)atoi(argv[i + 2]);
-            i += 2;
-        } else {
-            usage();
-            return 1;
-        }
-    }
-
-   grk_initialize(nullptr,num_threads);
-
-   init_tilec(&tilec, offset_x, offset_y,
-               offset_x + size, offset_y + size,
-               num_resolutions);
-
-    if (display) {
-        printf("Before\n");
-        k = 0;
-        for (j = 0; j < (int32_t)(tilec.y1 - tilec.y0); j++) {
-            for (i = 0; i < (int32_t)(tilec.x1 - tilec.x0); i++) {
-                printf("%d ", tilec.buf->data[k]);
-                k ++;
-            }
-            printf("\n");
-        }
-    }
-
-    tcd.image = &tcd_image;
-    memset(&tcd_image, 0, sizeof(tcd_image));
-    memset(&tcd_tile, 0, sizeof(tcd_tile));
-    tcd_tile.x0 = tilec.x0;
-    tcd_tile.y0 = tilec.y0;
-    tcd_tile.x1 = tilec.x1;
-    tcd_tile.y1 = tilec.y1;
-    tcd_tile.numcomps = 1;
-    tcd_tile.comps = &tilec;
-    tcd.image = &image;
-    memset(&image, 0, sizeof(image));
-    image.numcomps = 1;
-    image.comps = &image_comp;
-    memset(&image_comp, 0, sizeof(image_comp));
-    image_comp.dx = 1;
-    image_comp.dy = 1;
-
-
-	std::chrono::time_point<std::chrono::high_resolution_clock> start, finish;
-	std::chrono::duration<double> elapsed;
-
-	start = std::chrono::high_resolution_clock::now();
-	if (lossy)
-		decode_97(&tcd, &tilec, tilec.numresolutions);
-	else
-		decode_53(&tcd, &tilec, tilec.numresolutions);
-	finish = std::chrono::high_resolution_clock::now();
-	elapsed = finish - start;
-    printf("time for dwt_decode: %.03f ms\n", elapsed.count()*1000);
-
-    if (display || check) {
-        if (display) {
-            printf("After IDWT\n");
-            k = 0;
-            for (j = 0; j < (int32_t)(tilec.y1 - tilec.y0); j++) {
-                for (i = 0; i < (int32_t)(tilec.x1 - tilec.x0); i++) {
-                    printf("%d ", tilec.buf->data[k]);
-                    k ++;
-                }
-                printf("\n");
-            }
-        }
-
-        Wavelet::compress(&tilec, 1);
-        if (display) {
-            printf("After FDWT\n");
-            k = 0;
-            for (j = 0; j < (int32_t)(tilec.y1 - tilec.y0); j++) {
-                for (i = 0; i < (int32_t)(tilec.x1 - tilec.x0); i++) {
-                    printf("%d ", tilec.buf->data[k]);
-                    k ++;
-                }
-                printf("\n");
-            }
-        }
-
-        if (check) {
-            size_t idx;
-            size_t nValues = (size_t)(tilec.x1 - tilec.x0) *
-                             (size_t)(tilec.y1 - tilec.y0);
-            for (idx = 0; idx < nValues; idx++) {
-                if (tilec.buf->data[idx] != getValue((uint32_t)idx)) {
-                    printf("Difference found at idx = %u\n", (uint32_t)idx);
-                    return 1;
-                }
-            }
-        }
-    }
-    free_tilec(&tilec);
-    grk_deinitialize();
-
-    return 0;
+static void bench_times(std::vector<double> &times, BenchResult *result) {
+	std::sort(times.begin(), times.end());
+	result->ms_min = times.front();
+	result->ms_median = times[times.size() / 2];
 }
 
+/* DRAM traffic per run, from the misses of num_runs runs */
+static double bench_dram_mb(const BenchCounters *counters, uint64_t misses,
+		uint32_t num_runs) {
+	if (!counters)
+		return -1;
 
+	return (double) misses * BenchCounters::line_size / num_runs / 1e6;
+}
+
+static double bench_elapsed_ms(
+		std::chrono::time_point<std::chrono::high_resolution_clock> start) {
+	std::chrono::duration<double> elapsed =
+			std::chrono::high_resolution_clock::now() - start;
+	return elapsed.count() * 1000;
+}
+
+static void bench_print_header(const BenchOptions &opt) {
+	switch (opt.format) {
+	case BENCH_FORMAT_TEXT:
+		fprintf(opt.out,
+				"%-9s %-6s %-7s %6s %6s %4s %7s %-8s %10s %10s %9s %5s %-10s ",
+				"transform", "filter", "window", "width", "height", "res",
+				"threads", "isa", "ms_min", "ms_median", "Mpix/s", "error",
+				"checksum");
+		if (opt.counters)
+			fprintf(opt.out, "%-6s %10s\n", "status", "dram_MB");
+		else
+			fprintf(opt.out, "%s\n", "status");
+		break;
+	case BENCH_FORMAT_CSV:
+		fprintf(opt.out,
+				"transform,filter,window,width,height,resolutions,threads,isa,"
+				"ms_min,ms_median,mpix_per_s,max_error,checksum,status%s\n",
+				opt.counters ? ",dram_mb" : "");
+		break;
+	case BENCH_FORMAT_JSON:
+		fprintf(opt.out, "[");
+		break;
+	}
+}
+
+static void bench_print(const BenchOptions &opt, const BenchResult &r,
+		bool first) {
+	double mpix = (double) r.width * r.height
+			/ (max<double>(r.ms_min, 1e-6) * 1000.0);
+	const char *status = r.pass ? "pass" : "FAIL";
+	char dram[32] = "";
+	switch (opt.format) {
+	case BENCH_FORMAT_TEXT:
+		if (opt.counters) {
+			if (r.dram_mb < 0)
+				snprintf(dram, sizeof(dram), "%-6s %10s", status, "n/a");
+			else
+				snprintf(dram, sizeof(dram), "%-6s %10.1f", status, r.dram_mb);
+			status = "";
+		}
+		fprintf(opt.out,
+				"%-9s %-6s %-7s %6u %6u %4u %7u %-8s %10.3f %10.3f %9.1f %5u %08x   %s%s\n",
+				r.transform, r.filter, r.window, r.width, r.height, r.numres,
+				r.threads, r.level, r.ms_min, r.ms_median, mpix, r.max_error,
+				r.checksum, status, dram);
+		break;
+	case BENCH_FORMAT_CSV:
+		if (opt.counters) {
+			if (r.dram_mb < 0)
+				snprintf(dram, sizeof(dram), ",");
+			else
+				snprintf(dram, sizeof(dram), ",%.1f", r.dram_mb);
+		}
+		fprintf(opt.out, "%s,%s,%s,%u,%u,%u,%u,%s,%.3f,%.3f,%.1f,%u,%08x,%s%s\n",
+				r.transform, r.filter, r.window, r.width, r.height, r.numres,
+				r.threads, r.level, r.ms_min, r.ms_median, mpix, r.max_error,
+				r.checksum, status, dram);
+		break;
+	case BENCH_FORMAT_JSON:
+		if (opt.counters) {
+			if (r.dram_mb < 0)
+				snprintf(dram, sizeof(dram), ", \"dram_mb\": null");
+			else
+				snprintf(dram, sizeof(dram), ", \"dram_mb\": %.1f", r.dram_mb);
+		}
+		fprintf(opt.out,
+				"%s\n  {\"transform\": \"%s\", \"filter\": \"%s\", \"window\": \"%s\", "
+				"\"width\": %u, \"height\": %u, \"resolutions\": %u, "
+				"\"threads\": %u, \"isa\": \"%s\", \"ms_min\": %.3f, "
+				"\"ms_median\": %.3f, \"mpix_per_s\": %.1f, \"max_error\": %u, "
+				"\"checksum\": \"%08x\", \"status\": \"%s\"%s}",
+				first ? "" : ",", r.transform, r.filter, r.window, r.width,
+				r.height, r.numres, r.threads, r.level, r.ms_min, r.ms_median,
+				mpix, r.max_error, r.checksum, status, dram);
+		break;
+	}
+	fflush(opt.out);
+}
+
+static void bench_print_footer(const BenchOptions &opt) {
+	if (opt.format == BENCH_FORMAT_JSON)
+		fprintf(opt.out, "\n]\n");
+}
+
+/*
+ Run the transforms of filter with kernels, on tile bt of numres resolutions,
+ and print one result for each transform. Return false if a check failed.
+ counters is null if cache misses are not counted.
+ */
+static bool bench_run(const BenchOptions &opt, BenchTile *bt,
+		uint32_t filter, const SimdKernels &kernels, GRK_SIMD_LEVEL level,
+		uint32_t threads, const BenchCounters *counters, bool *first) {
+	auto tilec = bt->tilec;
+	uint32_t w = tilec->width();
+	uint32_t h = tilec->height();
+	uint32_t numres = tilec->numresolutions;
+	bool is_53 = (filter == BENCH_FILTER_53);
+	grk_rect whole = grk_rect(tilec->x0, tilec->y0, tilec->x1, tilec->y1);
+	std::vector<double> times;
+	uint64_t misses = 0;
+	bool pass = true;
+
+	BenchResult result;
+	result.filter = bench_filter_names[filter];
+	result.numres = numres;
+	result.threads = threads;
+	result.level = simd_level_name(level);
+	bt->cp.m_coding_params.m_dec.m_fast_preview =
+			(filter == BENCH_FILTER_97_FIXED);
+
+	/* forward transform: also computes the input of the inverse transforms */
+	if (!bt->set_window(nullptr))
+		return false;
+	for (uint32_t i = 0; i < opt.repeat; ++i) {
+		bench_fill(tilec);
+		uint64_t misses_start = counters ? counters->misses() : 0;
+		auto start = std::chrono::high_resolution_clock::now();
+		bool rc = is_53 ? kernels.dwt_encode_53(tilec) :
+							kernels.dwt_encode_97(tilec);
+		times.push_back(bench_elapsed_ms(start));
+		if (counters)
+			misses += counters->misses() - misses_start;
+		if (!rc) {
+			fprintf(stderr, "forward transform failed\n");
+			return false;
+		}
+	}
+	std::vector<int32_t> coeffs(tilec->buf->data,
+			tilec->buf->data + (uint64_t) w * h);
+	/* the inverse 9/7 transform works on floats */
+	if (!is_53) {
+		for (auto &c : coeffs) {
+			float f = (float) c;
+			memcpy(&c, &f, sizeof(c));
+		}
+	}
+	if (opt.forward && filter != BENCH_FILTER_97_FIXED) {
+		result.transform = "forward";
+		result.window = "full";
+		result.width = w;
+		result.height = h;
+		bench_times(times, &result);
+		result.dram_mb = bench_dram_mb(counters, misses, opt.repeat);
+		/* the round trip is checked by the inverse rows */
+		result.max_error = 0;
+		result.checksum = 2166136261U;
+		for (auto c : coeffs)
+			result.checksum = bench_checksum(result.checksum, c);
+		result.pass = true;
+		bench_print(opt, result, *first);
+		*first = false;
+	}
+	if (!opt.inverse)
+		return pass;
+
+	for (uint32_t k = 0; k < 2; ++k) {
+		bool partial = (k == 1);
+		if ((partial && !opt.partial) || (!partial && !opt.full))
+			continue;
+		/* fast preview is only used when decompressing whole tiles */
+		if (partial && filter == BENCH_FILTER_97_FIXED)
+			continue;
+		grk_rect win = whole;
+		if (partial) {
+			if (opt.has_window) {
+				win = grk_rect(tilec->x0 + opt.window[0], tilec->y0 + opt.window[1],
+						tilec->x0 + opt.window[2], tilec->y0 + opt.window[3]);
+				whole.clip(win, &win);
+			} else {
+				win = grk_rect(tilec->x0 + w / 4, tilec->y0 + h / 4,
+						tilec->x0 + w / 4 + max<uint32_t>(w / 2, 1),
+						tilec->y0 + h / 4 + max<uint32_t>(h / 2, 1));
+			}
+			if (win.x1 <= win.x0 || win.y1 <= win.y0)
+				continue;
+		}
+		if (!bt->set_window(partial ? &win : nullptr))
+			return false;
+
+		times.clear();
+		misses = 0;
+		bool rc = true;
+		for (uint32_t i = 0; i < opt.repeat && rc; ++i) {
+			if (partial) {
+				/* region decompression reads the bands from,
+				 * and writes intermediate resolutions to, the sparse array */
+				auto sa = new sparse_array(w, h, min<uint32_t>(w, 64),
+						min<uint32_t>(h, 64));
+				if (!sa->alloc(0, 0, w, h)
+						|| !sa->write(0, 0, w, h, coeffs.data(), 1, w, true)) {
+					delete sa;
+					fprintf(stderr, "sparse array allocation failed\n");
+					return false;
+				}
+				delete tilec->m_sa;
+				tilec->m_sa = sa;
+			} else {
+				memcpy(tilec->buf->data, coeffs.data(),
+						coeffs.size() * sizeof(int32_t));
+			}
+			uint64_t misses_start = counters ? counters->misses() : 0;
+			auto start = std::chrono::high_resolution_clock::now();
+			rc = Wavelet::decompress(kernels, &bt->tcd, tilec, numres,
+					is_53 ? 1 : 0);
+			times.push_back(bench_elapsed_ms(start));
+			if (counters)
+				misses += counters->misses() - misses_start;
+		}
+		delete tilec->m_sa;
+		tilec->m_sa = nullptr;
+
+		result.transform = "inverse";
+		result.window = partial ? "partial" : "full";
+		result.width = (uint32_t) (win.x1 - win.x0);
+		result.height = (uint32_t) (win.y1 - win.y0);
+		bench_times(times, &result);
+		result.dram_mb = bench_dram_mb(counters, misses, (uint32_t) times.size());
+		bench_compare(tilec, win, !is_53, &result);
+		result.pass = rc && result.max_error <= bench_tolerance(filter, numres);
+		pass = pass && result.pass;
+		bench_print(opt, result, *first);
+		*first = false;
+	}
+
+	return pass;
+}
+
+static bool bench_parse_list(const char *arg, std::vector<std::string> &list) {
+	list.clear();
+	std::string s(arg);
+	size_t pos = 0;
+	while (pos <= s.size()) {
+		size_t end = s.find(',', pos);
+		if (end == std::string::npos)
+			end = s.size();
+		if (end == pos)
+			return false;
+		list.push_back(s.substr(pos, end - pos));
+		pos = end + 1;
+	}
+
+	return !list.empty();
+}
+
+static bool bench_parse_list(const char *arg, std::vector<uint32_t> &list) {
+	std::vector<std::string> items;
+	if (!bench_parse_list(arg, items))
+		return false;
+	list.clear();
+	for (auto &item : items) {
+		char *end = nullptr;
+		auto val = strtoul(item.c_str(), &end, 10);
+		if (*end || val > UINT32_MAX)
+			return false;
+		list.push_back((uint32_t) val);
+	}
+
+	return true;
+}
+
+static void usage(void) {
+	printf("bench_dwt [-size n,...] [-num_resolutions n,...] [-num_threads n,...]\n"
+		   "          [-filter 53|97|97f,...] [-lossy] [-isa all|baseline|avx2|avx512,...]\n"
+		   "          [-transform forward|inverse,...] [-window full|partial,...]\n"
+		   "          [-region x0,y0,x1,y1] [-offset x y] [-repeat n]\n"
+		   "          [-format text|csv|json] [-counters] [-o file]\n"
+		   "\n"
+		   "  -size             widths (and heights) of the tile (default 256,1023,2048)\n"
+		   "  -num_resolutions  numbers of resolutions, 1 to 32 (default 3,6)\n"
+		   "  -num_threads      numbers of threads (default 1 and all cores)\n"
+		   "  -filter           5/3, 9/7 or fixed point 9/7 (fast preview) filters (default all)\n"
+		   "  -lossy            same as -filter 97\n"
+		   "  -isa              SIMD levels (default all levels supported by the CPU)\n"
+		   "  -transform        forward and/or inverse transform (default both)\n"
+		   "  -window           inverse transform of the whole tile and/or\n"
+		   "                    of a window of it (default both)\n"
+		   "  -region           window, relative to the tile origin\n"
+		   "                    (default: the central half of the tile)\n"
+		   "  -offset           tile origin (default 0 0)\n"
+		   "  -repeat           runs of each transform: minimum and median times\n"
+		   "                    are reported (default 3)\n"
+		   "  -format           output format (default text)\n"
+		   "  -counters         estimate DRAM traffic per run from the last level\n"
+		   "                    cache misses of all threads, read from the hardware\n"
+		   "                    performance counters (Linux perf_event; reported as\n"
+		   "                    n/a where they are not available)\n"
+		   "  -o                output file (default standard output)\n"
+		   "\n"
+		   "Return 1 if a round trip is not exact (5/3), or has an error larger than\n"
+		   "twice the number of resolutions (9/7).\n");
+}
+
+}
+
+int main(int argc, char** argv)
+{
+	BenchOptions opt;
+	std::vector<std::string> items;
+	const char *out_file = nullptr;
+
+	for (int i = 1; i < argc; i++) {
+		bool has_arg = i + 1 < argc;
+		bool ok = true;
+		if (strcmp(argv[i], "-size") == 0 && has_arg) {
+			ok = bench_parse_list(argv[++i], opt.sizes);
+		} else if (strcmp(argv[i], "-num_resolutions") == 0 && has_arg) {
+			ok = bench_parse_list(argv[++i], opt.resolutions);
+			for (auto numres : opt.resolutions) {
+				if (numres == 0 || numres > 32) {
+					fprintf(stderr,
+							"Invalid value for num_resolutions. Should be >= 1 and <= 32\n");
+					return 1;
+				}
+			}
+		} else if (strcmp(argv[i], "-num_threads") == 0 && has_arg) {
+			ok = bench_parse_list(argv[++i], opt.threads);
+		} else if (strcmp(argv[i], "-filter") == 0 && has_arg) {
+			ok = bench_parse_list(argv[++i], items);
+			opt.filters.clear();
+			for (auto &item : items) {
+				uint32_t filter = 0;
+				while (filter < BENCH_NUM_FILTERS && item != bench_filter_names[filter])
+					filter++;
+				ok = ok && filter < BENCH_NUM_FILTERS;
+				opt.filters.push_back(filter);
+			}
+		} else if (strcmp(argv[i], "-lossy") == 0) {
+			opt.filters = { BENCH_FILTER_97 };
+		} else if (strcmp(argv[i], "-isa") == 0 && has_arg) {
+			ok = bench_parse_list(argv[++i], items);
+			opt.levels.clear();
+			for (auto &item : items) {
+				if (item == "all") {
+					opt.levels.clear();
+					break;
+				}
+				uint32_t level = 0;
+				while (level < GRK_SIMD_NUM_LEVELS &&
+						item != simd_level_name((GRK_SIMD_LEVEL) level))
+					level++;
+				ok = ok && level < GRK_SIMD_NUM_LEVELS;
+				opt.levels.push_back((GRK_SIMD_LEVEL) level);
+			}
+		} else if (strcmp(argv[i], "-transform") == 0 && has_arg) {
+			ok = bench_parse_list(argv[++i], items);
+			opt.forward = opt.inverse = false;
+			for (auto &item : items) {
+				opt.forward = opt.forward || item == "forward";
+				opt.inverse = opt.inverse || item == "inverse";
+				ok = ok && (item == "forward" || item == "inverse");
+			}
+		} else if (strcmp(argv[i], "-window") == 0 && has_arg) {
+			ok = bench_parse_list(argv[++i], items);
+			opt.full = opt.partial = false;
+			for (auto &item : items) {
+				opt.full = opt.full || item == "full";
+				opt.partial = opt.partial || item == "partial";
+				ok = ok && (item == "full" || item == "partial");
+			}
+		} else if (strcmp(argv[i], "-region") == 0 && has_arg) {
+			std::vector<uint32_t> region;
+			ok = bench_parse_list(argv[++i], region) && region.size() == 4 &&
+					region[0] < region[2] && region[1] < region[3];
+			if (ok) {
+				std::copy(region.begin(), region.end(), opt.window);
+				opt.has_window = true;
+			}
+		} else if (strcmp(argv[i], "-offset") == 0 && i + 2 < argc) {
+			opt.offset_x = (uint32_t)atoi(argv[i + 1]);
+			opt.offset_y = (uint32_t)atoi(argv[i + 2]);
+			i += 2;
+		} else if (strcmp(argv[i], "-repeat") == 0 && has_arg) {
+			opt.repeat = (uint32_t)atoi(argv[++i]);
+			ok = opt.repeat > 0;
+		} else if (strcmp(argv[i], "-format") == 0 && has_arg) {
+			i++;
+			if (strcmp(argv[i], "text") == 0)
+				opt.format = BENCH_FORMAT_TEXT;
+			else if (strcmp(argv[i], "csv") == 0)
+				opt.format = BENCH_FORMAT_CSV;
+			else if (strcmp(argv[i], "json") == 0)
+				opt.format = BENCH_FORMAT_JSON;
+			else
+				ok = false;
+		} else if (strcmp(argv[i], "-counters") == 0) {
+			opt.counters = true;
+		} else if (strcmp(argv[i], "-o") == 0 && has_arg) {
+			out_file = argv[++i];
+		} else {
+			ok = false;
+		}
+		if (!ok) {
+			usage();
+			return 1;
+		}
+	}
+
+	if (opt.threads.empty()) {
+		opt.threads.push_back(1);
+		uint32_t cores = ThreadPool::hardware_concurrency();
+		if (cores > 1)
+			opt.threads.push_back(cores);
+	}
+
+	std::vector<SimdKernels> kernels;
+	std::vector<GRK_SIMD_LEVEL> levels;
+	if (opt.levels.empty()) {
+		for (uint32_t level = 0; level < GRK_SIMD_NUM_LEVELS; ++level)
+			opt.levels.push_back((GRK_SIMD_LEVEL) level);
+	}
+	for (auto level : opt.levels) {
+		SimdKernels k;
+		if (!simd_level_kernels(level, &k)) {
+			fprintf(stderr, "%s kernels are not supported on this CPU, "
+					"or were not built: skipped\n", simd_level_name(level));
+			continue;
+		}
+		kernels.push_back(k);
+		levels.push_back(level);
+	}
+
+	if (out_file) {
+		opt.out = fopen(out_file, "w");
+		if (!opt.out) {
+			fprintf(stderr, "Unable to open %s\n", out_file);
+			return 1;
+		}
+	}
+
+	grk_initialize(nullptr, opt.threads.front());
+
+	bool pass = true;
+	bool first = true;
+	bool warned = false;
+	bench_print_header(opt);
+	for (auto threads : opt.threads) {
+		/* restart the thread pool with this number of threads */
+		ThreadPool::release();
+		ThreadPool::instance(threads);
+		/* count the cache misses of the new pool threads */
+		BenchCounters counters;
+		if (opt.counters && !counters.open() && !warned) {
+			fprintf(stderr, "Hardware performance counters are not available: "
+					"DRAM traffic is not reported\n");
+			warned = true;
+		}
+		for (auto size : opt.sizes) {
+			for (auto numres : opt.resolutions) {
+				BenchTile bt;
+				if (!bt.init(opt.offset_x, opt.offset_y,
+						opt.offset_x + size, opt.offset_y + size, numres)) {
+					fprintf(stderr, "Out of memory\n");
+					pass = false;
+					continue;
+				}
+				for (auto filter : opt.filters) {
+					for (size_t k = 0; k < kernels.size(); ++k) {
+						if (!bench_run(opt, &bt, filter, kernels[k], levels[k],
+								threads, counters.is_open() ? &counters : nullptr,
+								&first))
+							pass = false;
+					}
+				}
+			}
+		}
+	}
+	bench_print_footer(opt);
+
+	if (out_file)
+		fclose(opt.out);
+	grk_deinitialize();
+
+	return pass ? 0 : 1;
+}
@@ -0,0 +1,204 @@
+/*
+ *    Copyright (C) 2016-2020 Grok Image Compression Inc.
+ *
+ *    This source code is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This source code is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+/*
+ Micro benchmark for the HTJ2K block decoder.
+
+ Times each MagSgn kernel supported by the CPU on synthetic quad pairs,
+ checking that all kernels produce the same samples, and then times the
+ complete cleanup pass decode of random code blocks with each kernel.
+ */
+
+#include <chrono>
+#include <random>
+#include <vector>
+
+#include "ojph_block_decoder.h"
+#include "ojph_block_encoder.h"
+#include "ojph_mem.h"
+#include "grok_includes.h"
+
+using namespace ojph;
+using namespace ojph::local;
+
+namespace grk {
+
+struct QuadPair {
+	uint32_t qinf[2];
+	uint32_t U[2];
+	uint32_t locs;
+};
+
+static const char *kernel_names[] = { "scalar", "sse4.1", "avx2" };
+
+void usage(void) {
+	printf("bench_ht_block_decoder [-pairs val] [-blocks val] [-size val]\n");
+	printf("                       [-density val] [-bits val]\n");
+}
+
+}
+
+using namespace grk;
+
+int main(int argc, char **argv) {
+	uint32_t num_pairs = 1 << 20;
+	uint32_t num_blocks = 256;
+	uint32_t size = 64;
+	double density = 0.5;
+	uint32_t max_bits = 10;
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-pairs") == 0 && i + 1 < argc) {
+			num_pairs = (uint32_t) atoi(argv[++i]);
+		} else if (strcmp(argv[i], "-blocks") == 0 && i + 1 < argc) {
+			num_blocks = (uint32_t) atoi(argv[++i]);
+		} else if (strcmp(argv[i], "-size") == 0 && i + 1 < argc) {
+			size = (uint32_t) atoi(argv[++i]);
+		} else if (strcmp(argv[i], "-density") == 0 && i + 1 < argc) {
+			density = atof(argv[++i]);
+		} else if (strcmp(argv[i], "-bits") == 0 && i + 1 < argc) {
+			max_bits = (uint32_t) atoi(argv[++i]);
+		} else {
+			usage();
+			return 1;
+		}
+	}
+	if (!num_pairs || !num_blocks || size < 4 || size > 64 || !max_bits
+			|| max_bits > 24 || density <= 0.0 || density > 1.0) {
+		usage();
+		return 1;
+	}
+
+	std::mt19937 gen(1234);
+	std::bernoulli_distribution significant(density);
+	std::uniform_int_distribution<uint32_t> bits(1, max_bits);
+	std::uniform_int_distribution<uint32_t> byte(0, 255);
+
+	// synthetic quad pairs, with a MagSgn buffer holding all of their bits
+	std::vector<QuadPair> pairs(num_pairs);
+	uint64_t total_bits = 0;
+	for (auto &pair : pairs) {
+		for (uint32_t q = 0; q < 2; ++q) {
+			uint32_t qinf = 0;
+			for (uint32_t j = 0; j < 4; ++j) {
+				if (significant(gen))
+					qinf |= (0x10U << j) | ((byte(gen) & 1) << (8 + j))
+							| ((byte(gen) & 1) << (12 + j));
+			}
+			pair.qinf[q] = qinf;
+			pair.U[q] = bits(gen) + 1;
+			total_bits += 4 * pair.U[q];
+		}
+		pair.locs = 0xFF;
+	}
+	int ms_size = (int) (total_bits >> 3) + 8;
+	std::vector<uint8_t> ms_data((size_t) ms_size);
+	for (auto &b : ms_data)
+		b = (uint8_t) byte(gen);
+	std::vector<uint8_t> ms_buf((size_t) ms_size + 32);
+	ui32 lim = magsgn_unstuff(ms_data.data(), ms_size, ms_buf.data());
+
+	auto start = std::chrono::high_resolution_clock::now();
+	for (uint32_t k = 0; k < 16; ++k)
+		lim = magsgn_unstuff(ms_data.data(), ms_size, ms_buf.data());
+	std::chrono::duration<double> elapsed =
+			std::chrono::high_resolution_clock::now() - start;
+	printf("unstuff: %.1f MB/s\n", 16.0 * ms_size / elapsed.count() / 1e6);
+
+	// MagSgn kernels
+	int stride = 8;
+	std::vector<int32_t> ref((size_t) num_pairs * 8);
+	magsgn_pair_fn previous = nullptr;
+	for (int level = 0; level <= 2; ++level) {
+		auto kernel = get_magsgn_pair_kernel(level);
+		if (kernel == previous)
+			continue;
+		previous = kernel;
+		std::vector<int32_t> out((size_t) num_pairs * 8);
+		ui32 v_n[8];
+		start = std::chrono::high_resolution_clock::now();
+		ui32 pos = 0;
+		int32_t *sp = out.data();
+		for (auto &pair : pairs) {
+			kernel(ms_buf.data(), lim, pos, pair.qinf[0], pair.qinf[1],
+					pair.U[0], pair.U[1], pair.locs, 20, sp, 4, v_n);
+			sp += stride;
+		}
+		elapsed = std::chrono::high_resolution_clock::now() - start;
+		printf("magsgn %-7s: %.1f Mpairs/s\n", kernel_names[level],
+				num_pairs / elapsed.count() / 1e6);
+		if (level == 0) {
+			ref = out;
+		} else if (out != ref) {
+			printf("magsgn %s: output differs from scalar kernel\n",
+					kernel_names[level]);
+			return 1;
+		}
+	}
+
+	// complete code blocks, in sign-magnitude form
+	int missing_msbs = 16;
+	std::uniform_int_distribution<int32_t> magnitude(0, (1 << max_bits) - 1);
+	std::vector<std::vector<uint8_t> > coded(num_blocks);
+	std::vector<int> lengths(num_blocks);
+	std::vector<int32_t> block((size_t) size * size);
+	mem_elastic_allocator elastic(1048576);
+	uint32_t max_len = 0;
+	for (uint32_t b = 0; b < num_blocks; ++b) {
+		for (auto &s : block) {
+			int32_t mag = significant(gen) ? magnitude(gen) : 0;
+			s = (mag << (31 - (missing_msbs + 1)))
+					| (int32_t) ((byte(gen) & 1) << 31);
+		}
+		int pass_length[2] = { 0, 0 };
+		coded_lists *next_coded = nullptr;
+		ojph_encode_codeblock(block.data(), missing_msbs, 1, (int) size,
+				(int) size, (int) size, pass_length, &elastic, next_coded);
+		lengths[b] = pass_length[0];
+		coded[b].assign(next_coded->buf, next_coded->buf + pass_length[0]);
+		coded[b].resize((size_t) pass_length[0] + 8);
+		max_len = std::max<uint32_t>(max_len, (uint32_t) pass_length[0]);
+	}
+	std::vector<uint8_t> scratch((size_t) max_len + 32);
+	std::vector<int32_t> ref_blocks, out_blocks((size_t) num_blocks * size * size);
+	previous = nullptr;
+	for (int level = 0; level <= 2; ++level) {
+		auto kernel = get_magsgn_pair_kernel(level);
+		if (kernel == previous)
+			continue;
+		previous = kernel;
+		start = std::chrono::high_resolution_clock::now();
+		for (uint32_t b = 0; b < num_blocks; ++b)
+			ojph_decode_codeblock(coded[b].data(),
+					out_blocks.data() + (size_t) b * size * size,
+					missing_msbs, 1, lengths[b], 0, (int) size, (int) size,
+					(int) size, scratch.data(), kernel);
+		elapsed = std::chrono::high_resolution_clock::now() - start;
+		printf("cleanup %-7s: %.1f Msamples/s\n", kernel_names[level],
+				(double) num_blocks * size * size / elapsed.count() / 1e6);
+		if (level == 0) {
+			ref_blocks = out_blocks;
+		} else if (out_blocks != ref_blocks) {
+			printf("cleanup %s: output differs from scalar kernel\n",
+					kernel_names[level]);
+			return 1;
+		}
+	}
+
+	return 0;
+}
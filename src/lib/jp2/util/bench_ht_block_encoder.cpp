@@ -0,0 +1,146 @@
+/*
+ *    Copyright (C) 2016-2020 Grok Image Compression Inc.
+ *
+ *    This source code is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This source code is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+/*
+ Micro benchmark for the HTJ2K block encoder.
+
+ Encodes random code blocks with the kernels of each SIMD level supported
+ by the CPU, on a single thread, checking that all kernels produce the
+ same code stream bytes.
+ */
+
+#include <chrono>
+#include <random>
+#include <vector>
+
+#include "ojph_block_encoder.h"
+#include "ojph_mem.h"
+#include "grok_includes.h"
+
+using namespace ojph;
+using namespace ojph::local;
+
+namespace grk {
+
+static const char *kernel_names[] = { "scalar", "sse4.1", "avx2" };
+
+void usage(void) {
+	printf("bench_ht_block_encoder [-blocks val] [-width val] [-height val]\n");
+	printf("                       [-density val] [-bits val] [-repeat val]\n");
+}
+
+}
+
+using namespace grk;
+
+int main(int argc, char **argv) {
+	uint32_t num_blocks = 256;
+	uint32_t width = 64;
+	uint32_t height = 64;
+	double density = 0.5;
+	uint32_t max_bits = 10;
+	uint32_t repeat = 8;
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-blocks") == 0 && i + 1 < argc) {
+			num_blocks = (uint32_t) atoi(argv[++i]);
+		} else if (strcmp(argv[i], "-width") == 0 && i + 1 < argc) {
+			width = (uint32_t) atoi(argv[++i]);
+		} else if (strcmp(argv[i], "-height") == 0 && i + 1 < argc) {
+			height = (uint32_t) atoi(argv[++i]);
+		} else if (strcmp(argv[i], "-density") == 0 && i + 1 < argc) {
+			density = atof(argv[++i]);
+		} else if (strcmp(argv[i], "-bits") == 0 && i + 1 < argc) {
+			max_bits = (uint32_t) atoi(argv[++i]);
+		} else if (strcmp(argv[i], "-repeat") == 0 && i + 1 < argc) {
+			repeat = (uint32_t) atoi(argv[++i]);
+		} else {
+			usage();
+			return 1;
+		}
+	}
+	if (!num_blocks || !width || !height || width > 1024 || height > 1024
+			|| width * height > 4096 || !max_bits || max_bits > 30
+			|| density <= 0.0 || density > 1.0 || !repeat) {
+		usage();
+		return 1;
+	}
+
+	std::mt19937 gen(1234);
+	std::bernoulli_distribution significant(density);
+	std::uniform_int_distribution<uint32_t> bits(1, max_bits);
+	std::uniform_int_distribution<uint32_t> byte(0, 255);
+
+	// code blocks in sign-magnitude form, with the least significant
+	// coded bit at bit p; each block has its own number of magnitude bits,
+	// to cover all exponents
+	int p = 31 - (int) max_bits;
+	int missing_msbs = 30 - p;
+	size_t block_size = (size_t) width * height;
+	std::vector<int32_t> blocks(num_blocks * block_size);
+	for (uint32_t b = 0; b < num_blocks; ++b) {
+		uint32_t block_bits = bits(gen);
+		std::uniform_int_distribution<uint32_t> magnitude(0,
+				(1U << block_bits) - 1);
+		for (size_t i = 0; i < block_size; ++i) {
+			uint32_t mag = significant(gen) ? magnitude(gen) : 0;
+			blocks[b * block_size + i] = (int32_t) ((mag << p)
+					| ((byte(gen) & 1U) << 31));
+		}
+	}
+
+	std::vector<uint8_t> ref, out;
+	encoder_kernels previous = { nullptr, nullptr };
+	for (int level = 0; level <= 2; ++level) {
+		auto kernels = get_encoder_kernels(level);
+		if (kernels.quad_pair == previous.quad_pair)
+			continue;
+		previous = kernels;
+		out.clear();
+		double best = 0;
+		for (uint32_t r = 0; r < repeat; ++r) {
+			mem_elastic_allocator elastic(1048576);
+			auto start = std::chrono::high_resolution_clock::now();
+			for (uint32_t b = 0; b < num_blocks; ++b) {
+				int pass_length[2] = { 0, 0 };
+				coded_lists *next_coded = nullptr;
+				ojph_encode_codeblock(blocks.data() + b * block_size,
+						missing_msbs, 1, (int) width, (int) height, (int) width,
+						pass_length, &elastic, next_coded, &kernels);
+				if (r == 0)
+					out.insert(out.end(), next_coded->buf,
+							next_coded->buf + pass_length[0]);
+			}
+			std::chrono::duration<double> elapsed =
+					std::chrono::high_resolution_clock::now() - start;
+			double rate = (double) num_blocks * block_size / elapsed.count()
+					/ 1e6;
+			best = std::max(best, rate);
+		}
+		printf("encode %-7s: %.1f Msamples/s\n", kernel_names[level], best);
+		if (level == 0) {
+			ref = out;
+		} else if (out != ref) {
+			printf("encode %s: output differs from scalar kernels\n",
+					kernel_names[level]);
+			return 1;
+		}
+	}
+
+	return 0;
+}
@@ -34,6 +34,8 @@
 
 namespace grk {
 
+static WriteChunkBuffer* get_write_chunk_buffer(grk_stream *stream);
+
 static void free_mem(void *user_data) {
 	auto data = (buf_info*) user_data;
 	if (data)
@@ -121,6 +123,9 @@ size_t get_mem_stream_offset(grk_stream *stream) {
 	auto private_stream = (BufferedStream*) stream;
 	if (!private_stream->m_user_data)
 		return 0;
+	auto chunks = get_write_chunk_buffer(stream);
+	if (chunks)
+		return (size_t) chunks->length();
 	auto buf = (buf_info*) private_stream->m_user_data;
 	return buf->off;
 }
@@ -139,6 +144,143 @@ grk_stream* create_mem_stream(uint8_t *buf, size_t len, bool ownsBuffer,
 	return (grk_stream*) l_stream;
 }
 
+/* chunked write stream */
+
+// size of stream's double buffer, which is flushed to chunks
+const size_t chunked_stream_buffer_size = 1024 * 1024;
+
+static void free_chunks(void *user_data) {
+	auto chunks = (WriteChunkBuffer*) user_data;
+	if (chunks)
+		delete chunks;
+}
+
+static size_t write_to_chunks(void *src, size_t nb_bytes,
+		WriteChunkBuffer *dest) {
+	return dest->write((const uint8_t*) src, nb_bytes);
+}
+
+static bool seek_in_chunks(uint64_t offset, WriteChunkBuffer *dest) {
+	return dest->seek(offset);
+}
+
+/*
+ Get chunk buffer of chunked write stream, after flushing stream.
+ Returns nullptr if stream is not a chunked write stream.
+ */
+static WriteChunkBuffer* get_write_chunk_buffer(grk_stream *stream) {
+	auto private_stream = (BufferedStream*) stream;
+	if (!private_stream || !private_stream->m_user_data
+			|| private_stream->m_free_user_data_fn != free_chunks)
+		return nullptr;
+	if (!private_stream->flush())
+		return nullptr;
+
+	return (WriteChunkBuffer*) private_stream->m_user_data;
+}
+
+grk_stream* create_chunked_mem_write_stream(size_t chunk_size) {
+	if (!chunk_size)
+		chunk_size = chunked_stream_buffer_size;
+	auto l_stream = new BufferedStream(nullptr,
+			std::min<size_t>(chunk_size, chunked_stream_buffer_size), false);
+	auto chunks = new WriteChunkBuffer(chunk_size);
+	grk_stream_set_user_data((grk_stream*) l_stream, chunks, free_chunks);
+	grk_stream_set_write_function((grk_stream*) l_stream,
+			(grk_stream_write_fn) write_to_chunks);
+	grk_stream_set_seek_function((grk_stream*) l_stream,
+			(grk_stream_seek_fn) seek_in_chunks);
+
+	return (grk_stream*) l_stream;
+}
+
+size_t copy_chunked_mem_stream(grk_stream *stream, uint8_t *buf, size_t len) {
+	auto chunks = get_write_chunk_buffer(stream);
+	if (!chunks)
+		return 0;
+
+	return chunks->copy_to_contiguous_buffer(buf, len);
+}
+
+size_t get_chunked_mem_stream_chunks(grk_stream *stream,
+		grk_stream_chunk *chunk_array, size_t max_chunks) {
+	auto chunks = get_write_chunk_buffer(stream);
+	if (!chunks)
+		return 0;
+	size_t num_chunks = chunks->num_chunks();
+	if (chunk_array) {
+		for (size_t i = 0; i < std::min<size_t>(num_chunks, max_chunks); ++i)
+			chunk_array[i].data = chunks->get_chunk(i, &chunk_array[i].len);
+	}
+
+	return num_chunks;
+}
+
+/* growable read stream */
+
+// size of stream's read buffer
+const size_t growable_stream_buffer_size = 1024 * 1024;
+
+struct growable_buf_info: buf_info {
+	growable_buf_info(size_t initial_capacity) :
+			buf_info(new uint8_t[initial_capacity], 0, 0, true), capacity(
+					initial_capacity) {
+	}
+	size_t capacity;
+};
+
+static void free_growable_mem(void *user_data) {
+	auto data = (growable_buf_info*) user_data;
+	if (data)
+		delete data;
+}
+
+grk_stream* create_growable_mem_read_stream(size_t initial_capacity) {
+	if (!initial_capacity)
+		initial_capacity = growable_stream_buffer_size;
+	auto l_stream = new BufferedStream(nullptr, growable_stream_buffer_size,
+			true);
+	auto p_source_buffer = new growable_buf_info(initial_capacity);
+	grk_stream_set_user_data((grk_stream*) l_stream, p_source_buffer,
+			free_growable_mem);
+	grk_stream_set_user_data_length((grk_stream*) l_stream, 0);
+	grk_stream_set_read_function((grk_stream*) l_stream,
+			(grk_stream_read_fn) read_from_mem);
+	grk_stream_set_seek_function((grk_stream*) l_stream,
+			(grk_stream_seek_fn) seek_from_mem);
+
+	return (grk_stream*) l_stream;
+}
+
+bool append_to_growable_mem_stream(grk_stream *stream, const uint8_t *buf,
+		size_t len) {
+	auto private_stream = (BufferedStream*) stream;
+	if (!private_stream || !private_stream->m_user_data
+			|| private_stream->m_free_user_data_fn != free_growable_mem) {
+		GROK_ERROR("Data can only be appended to a growable memory stream");
+		return false;
+	}
+	if (!buf || !len)
+		return true;
+	auto src = (growable_buf_info*) private_stream->m_user_data;
+	if (src->len + len > src->capacity) {
+		size_t new_capacity = std::max<size_t>(src->capacity * 2,
+				src->len + len);
+		auto new_buf = new uint8_t[new_capacity];
+		memcpy(new_buf, src->buf, src->len);
+		delete[] src->buf;
+		src->buf = new_buf;
+		src->capacity = new_capacity;
+	}
+	memcpy(src->buf + src->len, buf, len);
+	src->len += len;
+	private_stream->m_user_data_length = src->len;
+	// stream may have hit the end of the previously available data
+	private_stream->m_status &= (uint32_t) (~GROK_STREAM_STATUS_END);
+
+	return true;
+}
+
 static int32_t get_file_open_mode(const char *mode) {
 	int32_t m = -1;
 	switch (mode[0]) {
@@ -48,4 +48,13 @@ size_t get_mem_stream_offset( grk_stream  *stream);
 
  grk_stream  *  create_mapped_file_read_stream(const char *fname);
 
+grk_stream* create_chunked_mem_write_stream(size_t chunk_size);
+size_t copy_chunked_mem_stream(grk_stream *stream, uint8_t *buf, size_t len);
+size_t get_chunked_mem_stream_chunks(grk_stream *stream,
+		grk_stream_chunk *chunks, size_t max_chunks);
+
+grk_stream* create_growable_mem_read_stream(size_t initial_capacity);
+bool append_to_growable_mem_stream(grk_stream *stream, const uint8_t *buf,
+		size_t len);
+
 }
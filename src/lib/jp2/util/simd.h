@@ -68,12 +68,18 @@
 #ifdef __SSSE3__
 #include <tmmintrin.h>
 #endif
-#ifdef __AVX2__
+#ifdef __SSE4_1__
+#include <smmintrin.h>
+#endif
+#if defined(__AVX2__) || defined(__AVX512F__)
 #include <immintrin.h>
 #endif
 
 
-#ifdef __AVX2__
+#ifdef __AVX512F__
+/** Number of int32 values in a AVX-512 register */
+#define VREG_INT_COUNT       16
+#elif defined(__AVX2__)
 /** Number of int32 values in a AVX2 register */
 #define VREG_INT_COUNT       8
 #else
@@ -86,7 +92,33 @@
 #if (defined(__SSE2__) || defined(__AVX2__))
 
 /* Convenience macros to improve the readability of the formulas */
-#if __AVX2__
+#if __AVX512F__
+/* Shifts and conversions use the zero-masking forms, with all lanes */
+/* selected: the unmasked forms trip -Wuninitialized with some GCC versions */
+#define VREG        __m512i
+#define LOAD_CST(x) _mm512_set1_epi32(x)
+#define LOAD(x)     _mm512_load_si512((const VREG*)(x))
+#define LOADU(x)    _mm512_loadu_si512((const VREG*)(x))
+#define STORE(x,y)  _mm512_store_si512((VREG*)(x),(y))
+#define STOREU(x,y) _mm512_storeu_si512((VREG*)(x),(y))
+#define ADD(x,y)    _mm512_add_epi32((x),(y))
+#define SUB(x,y)    _mm512_sub_epi32((x),(y))
+#define SAR(x,y)    _mm512_maskz_srai_epi32(0xFFFF,(x),(y))
+#define MUL(x,y)    _mm512_mullo_epi32((x),(y))
+#define MAX(x,y)    _mm512_maskz_max_epi32(0xFFFF,(x),(y))
+#define MIN(x,y)    _mm512_maskz_min_epi32(0xFFFF,(x),(y))
+#define VREGF        __m512
+#define LOADF(x)     _mm512_load_ps((float const*)(x))
+#define LOAD_CST_F(x)_mm512_set1_ps(x)
+#define ADDF(x,y)    _mm512_add_ps((x),(y))
+#define MULF(x,y)    _mm512_mul_ps((x),(y))
+#define SUBF(x,y)    _mm512_sub_ps((x),(y))
+#define STOREF(x,y)  _mm512_store_ps((float*)(x),(y))
+#define LOADUF(x)    _mm512_loadu_ps((float const*)(x))
+#define STOREUF(x,y) _mm512_storeu_ps((float*)(x),(y))
+#define CVT_I2F(x)   _mm512_maskz_cvtepi32_ps(0xFFFF,(x))
+#define CVT_F2I(x)   _mm512_maskz_cvtps_epi32(0xFFFF,(x))
+#elif __AVX2__
 #define VREG        __m256i
 #define LOAD_CST(x) _mm256_set1_epi32(x)
 #define LOAD(x)     _mm256_load_si256((const VREG*)(x))
@@ -97,6 +129,8 @@
 #define SUB(x,y)    _mm256_sub_epi32((x),(y))
 #define SAR(x,y)    _mm256_srai_epi32((x),(y))
 #define MUL(x,y)    _mm256_mullo_epi32((x),(y))
+#define MAX(x,y)    _mm256_max_epi32((x),(y))
+#define MIN(x,y)    _mm256_min_epi32((x),(y))
 #define VREGF        __m256
 #define LOADF(x)     _mm256_load_ps((float const*)(x))
 #define LOAD_CST_F(x)_mm256_set1_ps(x)
@@ -104,6 +138,10 @@
 #define MULF(x,y)    _mm256_mul_ps((x),(y))
 #define SUBF(x,y)     _mm256_sub_ps((x),(y))
 #define STOREF(x,y)  _mm256_store_ps((float*)(x),(y))
+#define LOADUF(x)    _mm256_loadu_ps((float const*)(x))
+#define STOREUF(x,y) _mm256_storeu_ps((float*)(x),(y))
+#define CVT_I2F(x)   _mm256_cvtepi32_ps(x)
+#define CVT_F2I(x)   _mm256_cvtps_epi32(x)
 #else
 #define VREG        __m128i
 #define LOAD_CST(x) _mm_set1_epi32(x)
@@ -116,6 +154,21 @@
 // MUL is actually only valid for SSE 4.1
 #define MUL(x,y)    _mm_mullo_epi32((x),(y))
 #define SAR(x,y)    _mm_srai_epi32((x),(y))
+#ifdef __SSE4_1__
+#define MAX(x,y)    _mm_max_epi32((x),(y))
+#define MIN(x,y)    _mm_min_epi32((x),(y))
+#else
+static inline __m128i grk_sse2_max_epi32(__m128i x, __m128i y) {
+	__m128i gt = _mm_cmpgt_epi32(x, y);
+	return _mm_or_si128(_mm_and_si128(gt, x), _mm_andnot_si128(gt, y));
+}
+static inline __m128i grk_sse2_min_epi32(__m128i x, __m128i y) {
+	__m128i gt = _mm_cmpgt_epi32(x, y);
+	return _mm_or_si128(_mm_and_si128(gt, y), _mm_andnot_si128(gt, x));
+}
+#define MAX(x,y)    grk_sse2_max_epi32((x),(y))
+#define MIN(x,y)    grk_sse2_min_epi32((x),(y))
+#endif
 #define VREGF        __m128
 #define LOADF(x)     _mm_load_ps((float const*)(x))
 #define LOAD_CST_F(x)      _mm_set1_ps(x)
@@ -123,6 +176,107 @@
 #define MULF(x,y)    _mm_mul_ps((x),(y))
 #define SUBF(x,y)    _mm_sub_ps((x),(y))
 #define STOREF(x,y)  _mm_store_ps((float*)(x),(y))
+#define LOADUF(x)    _mm_loadu_ps((float const*)(x))
+#define STOREUF(x,y) _mm_storeu_ps((float*)(x),(y))
+#define CVT_I2F(x)   _mm_cvtepi32_ps(x)
+#define CVT_F2I(x)   _mm_cvtps_epi32(x)
+#endif
+
+/* Saturated 16 bit arithmetic. AVX-512F has no 16 bit instructions, */
+/* so the AVX2 forms are used at that level */
+/* LOADU_F2I16(x,s): load VREG_INT16_COUNT floats, multiply them by s */
+/* and convert them to int16, rounding to nearest, with saturation */
+/* STOREU_I162F(x,y,s): convert y to floats, multiply them by s and store them */
+#if __AVX512F__
+static inline __m256i grk_loadu_f2i16(const float *x, float s) {
+	__m512 v = _mm512_mul_ps(_mm512_loadu_ps(x), _mm512_set1_ps(s));
+	v = _mm512_maskz_min_ps(0xFFFF,
+			_mm512_maskz_max_ps(0xFFFF, v, _mm512_set1_ps(-32768.0f)),
+			_mm512_set1_ps(32767.0f));
+	return _mm512_maskz_cvtsepi32_epi16(0xFFFF,
+			_mm512_maskz_cvtps_epi32(0xFFFF, v));
+}
+static inline void grk_storeu_i162f(float *x, __m256i y, float s) {
+	__m512 v = _mm512_maskz_cvtepi32_ps(0xFFFF,
+			_mm512_maskz_cvtepi16_epi32(0xFFFF, y));
+	_mm512_storeu_ps(x, _mm512_mul_ps(v, _mm512_set1_ps(s)));
+}
+#elif __AVX2__
+static inline __m256i grk_loadu_f2i16(const float *x, float s) {
+	const __m256 vs = _mm256_set1_ps(s);
+	const __m256 lo = _mm256_set1_ps(-32768.0f);
+	const __m256 hi = _mm256_set1_ps(32767.0f);
+	__m256 a = _mm256_mul_ps(_mm256_loadu_ps(x), vs);
+	__m256 b = _mm256_mul_ps(_mm256_loadu_ps(x + 8), vs);
+	a = _mm256_min_ps(_mm256_max_ps(a, lo), hi);
+	b = _mm256_min_ps(_mm256_max_ps(b, lo), hi);
+	__m256i p = _mm256_packs_epi32(_mm256_cvtps_epi32(a),
+			_mm256_cvtps_epi32(b));
+	/* packs works within 128 bit lanes */
+	return _mm256_permute4x64_epi64(p, 0xD8);
+}
+static inline void grk_storeu_i162f(float *x, __m256i y, float s) {
+	const __m256 vs = _mm256_set1_ps(s);
+	__m256i a = _mm256_cvtepi16_epi32(_mm256_castsi256_si128(y));
+	__m256i b = _mm256_cvtepi16_epi32(_mm256_extracti128_si256(y, 1));
+	_mm256_storeu_ps(x, _mm256_mul_ps(_mm256_cvtepi32_ps(a), vs));
+	_mm256_storeu_ps(x + 8, _mm256_mul_ps(_mm256_cvtepi32_ps(b), vs));
+}
+#else
+static inline __m128i grk_loadu_f2i16(const float *x, float s) {
+	const __m128 vs = _mm_set1_ps(s);
+	const __m128 lo = _mm_set1_ps(-32768.0f);
+	const __m128 hi = _mm_set1_ps(32767.0f);
+	__m128 a = _mm_mul_ps(_mm_loadu_ps(x), vs);
+	__m128 b = _mm_mul_ps(_mm_loadu_ps(x + 4), vs);
+	a = _mm_min_ps(_mm_max_ps(a, lo), hi);
+	b = _mm_min_ps(_mm_max_ps(b, lo), hi);
+	return _mm_packs_epi32(_mm_cvtps_epi32(a), _mm_cvtps_epi32(b));
+}
+static inline void grk_storeu_i162f(float *x, __m128i y, float s) {
+	const __m128 vs = _mm_set1_ps(s);
+	__m128i a = _mm_srai_epi32(_mm_unpacklo_epi16(y, y), 16);
+	__m128i b = _mm_srai_epi32(_mm_unpackhi_epi16(y, y), 16);
+	_mm_storeu_ps(x, _mm_mul_ps(_mm_cvtepi32_ps(a), vs));
+	_mm_storeu_ps(x + 4, _mm_mul_ps(_mm_cvtepi32_ps(b), vs));
+}
+#endif
+#define LOADU_F2I16(x,s)    grk_loadu_f2i16((x),(s))
+#define STOREU_I162F(x,y,s) grk_storeu_i162f((x),(y),(s))
+#if __AVX2__
+/** Number of int16 values in a 16 bit register */
+#define VREG_INT16_COUNT  16
+#define VREG16            __m256i
+#define LOAD_CST16(x)     _mm256_set1_epi16(x)
+#define LOADU16(x)        _mm256_loadu_si256((const VREG16*)(x))
+#define STOREU16(x,y)     _mm256_storeu_si256((VREG16*)(x),(y))
+#define ADDS16(x,y)       _mm256_adds_epi16((x),(y))
+#define SUBS16(x,y)       _mm256_subs_epi16((x),(y))
+/* (x * y + 2^14) >> 15 */
+#define MULHRS16(x,y)     _mm256_mulhrs_epi16((x),(y))
+#else
+/** Number of int16 values in a 16 bit register */
+#define VREG_INT16_COUNT  8
+#define VREG16            __m128i
+#define LOAD_CST16(x)     _mm_set1_epi16(x)
+#define LOADU16(x)        _mm_loadu_si128((const VREG16*)(x))
+#define STOREU16(x,y)     _mm_storeu_si128((VREG16*)(x),(y))
+#define ADDS16(x,y)       _mm_adds_epi16((x),(y))
+#define SUBS16(x,y)       _mm_subs_epi16((x),(y))
+/* (x * y + 2^14) >> 15 */
+#ifdef __SSSE3__
+#define MULHRS16(x,y)     _mm_mulhrs_epi16((x),(y))
+#else
+/* with x * y = hi * 2^16 + lo, the result is 2 * hi plus bits 15 and 14 of lo */
+static inline __m128i grk_sse2_mulhrs_epi16(__m128i x, __m128i y) {
+	__m128i hi = _mm_mulhi_epi16(x, y);
+	__m128i lo = _mm_mullo_epi16(x, y);
+	__m128i r = _mm_add_epi16(_mm_srli_epi16(lo, 15),
+			_mm_and_si128(_mm_srli_epi16(lo, 14), _mm_set1_epi16(1)));
+	return _mm_add_epi16(_mm_add_epi16(hi, hi), r);
+}
+#define MULHRS16(x,y)     grk_sse2_mulhrs_epi16((x),(y))
+#endif
 #endif
 
 #endif
@@ -0,0 +1,125 @@
+/*
+ *    Copyright (C) 2016-2020 Grok Image Compression Inc.
+ *
+ *    This source code is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This source code is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstdlib>
+#include <cstring>
+#include "CPUArch.h"
+#include "Dequantizer.h"
+
+namespace grk {
+
+static const char *simd_level_names[GRK_SIMD_NUM_LEVELS] = { "baseline",
+		"avx2", "avx512" };
+
+/*
+ Highest level that is both built and supported by the CPU
+ */
+static GRK_SIMD_LEVEL simd_best_level(void) {
+#if defined(GROK_HAVE_SIMD_AVX2) || defined(GROK_HAVE_SIMD_AVX512)
+	CPUArch arch;
+#endif
+#ifdef GROK_HAVE_SIMD_AVX512
+	if (arch.AVX512F() && arch.BMI2())
+		return GRK_SIMD_AVX512;
+#endif
+#ifdef GROK_HAVE_SIMD_AVX2
+	if (arch.AVX2() && arch.BMI2())
+		return GRK_SIMD_AVX2;
+#endif
+	return GRK_SIMD_BASELINE;
+}
+
+/*
+ Level chosen from the CPU features, unless the GRK_SIMD environment
+ variable names a supported level
+ */
+static GRK_SIMD_LEVEL simd_select_level(void) {
+	auto best = simd_best_level();
+	const char *forced = getenv("GRK_SIMD");
+	if (!forced || !forced[0])
+		return best;
+	for (uint32_t i = 0; i < GRK_SIMD_NUM_LEVELS; ++i) {
+		if (strcmp(forced, simd_level_names[i]) != 0)
+			continue;
+		auto level = (GRK_SIMD_LEVEL) i;
+		if (level > best) {
+			GROK_WARN("GRK_SIMD: %s kernels are not supported on this CPU, "
+					"or were not built. Using %s kernels.", forced,
+					simd_level_names[best]);
+			return best;
+		}
+		return level;
+	}
+	GROK_WARN("GRK_SIMD: unknown level %s. Using %s kernels.", forced,
+			simd_level_names[best]);
+
+	return best;
+}
+
+static GRK_SIMD_LEVEL simd_selected_level = GRK_SIMD_BASELINE;
+
+bool simd_level_kernels(GRK_SIMD_LEVEL level, SimdKernels *kernels) {
+	if (level > simd_best_level())
+		return false;
+	switch (level) {
+#ifdef GROK_HAVE_SIMD_AVX2
+	case GRK_SIMD_AVX2:
+		avx2::get_simd_kernels(kernels);
+		break;
+#endif
+#ifdef GROK_HAVE_SIMD_AVX512
+	case GRK_SIMD_AVX512:
+		avx512::get_simd_kernels(kernels);
+		break;
+#endif
+	default:
+		baseline::get_simd_kernels(kernels);
+		break;
+	}
+
+	return true;
+}
+
+static SimdKernels simd_select_kernels(void) {
+	SimdKernels kernels;
+	simd_selected_level = simd_select_level();
+	simd_level_kernels(simd_selected_level, &kernels);
+
+	return kernels;
+}
+
+const SimdKernels& simd_kernels(void) {
+	static const SimdKernels kernels = simd_select_kernels();
+
+	return kernels;
+}
+
+GRK_SIMD_LEVEL simd_level(void) {
+	simd_kernels();
+
+	return simd_selected_level;
+}
+
+const char* simd_level_name(GRK_SIMD_LEVEL level) {
+	return level < GRK_SIMD_NUM_LEVELS ? simd_level_names[level] : "unknown";
+}
+
+void dequantize_cblk(const int32_t *src, uint32_t w, uint32_t h,
+		int32_t *dest, uint32_t dest_stride, const DequantizeParams &params) {
+	simd_kernels().dequantize_cblk(src, w, h, dest, dest_stride, params);
+}
+
+}
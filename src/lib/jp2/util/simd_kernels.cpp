@@ -0,0 +1,40 @@
+/*
+ *    Copyright (C) 2016-2020 Grok Image Compression Inc.
+ *
+ *    This source code is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This source code is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "grok_includes.h"
+#include "Dequantizer.h"
+
+namespace grk {
+namespace GRK_SIMD_NS {
+
+void get_simd_kernels(SimdKernels *kernels){
+	kernels->dwt_encode_53 = encode_53;
+	kernels->dwt_encode_97 = encode_97;
+	kernels->dwt_decode_53 = decode_53;
+	kernels->dwt_decode_97 = decode_97;
+	kernels->dwt_decode_lines = decode_lines;
+	kernels->dwt_decode_mct_lines = decode_mct_lines;
+	kernels->mct_encode_rev = mct_encode_rev;
+	kernels->mct_decode_rev = mct_decode_rev;
+	kernels->mct_encode_irrev = mct_encode_irrev;
+	kernels->mct_decode_irrev = mct_decode_irrev;
+	kernels->mct_decode_rev_shift = mct_decode_rev_shift;
+	kernels->mct_decode_irrev_shift = mct_decode_irrev_shift;
+	kernels->dequantize_cblk = dequantize_cblk;
+}
+
+}
+}
@@ -0,0 +1,119 @@
+/*
+ *    Copyright (C) 2016-2020 Grok Image Compression Inc.
+ *
+ *    This source code is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This source code is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstdint>
+
+/*
+ SIMD kernels (wavelet transforms, multi-component transforms and
+ dequantization) are compiled once for each instruction set level, in a
+ namespace named after the level. Kernel sources are always compiled for
+ the baseline level, with the compiler's default target; other levels are
+ compiled with the matching target flags (see src/lib/jp2/CMakeLists.txt),
+ which set GRK_SIMD_NS.
+
+ The level to run is chosen once, from the features of the CPU,
+ and can be forced with the GRK_SIMD environment variable,
+ set to one of the level names below. Every kernel, including the
+ line-based inverse wavelet transforms, runs at the chosen level.
+ */
+#ifndef GRK_SIMD_NS
+#define GRK_SIMD_NS baseline
+#endif
+
+namespace grk {
+
+struct TileProcessor;
+struct TileComponent;
+struct DequantizeParams;
+struct DcShiftParams;
+
+enum GRK_SIMD_LEVEL {
+	GRK_SIMD_BASELINE,	// "baseline": compiler default target (SSE2 on x86-64)
+	GRK_SIMD_AVX2,		// "avx2": AVX2 and BMI2
+	GRK_SIMD_AVX512,	// "avx512": AVX-512F and BMI2
+	GRK_SIMD_NUM_LEVELS
+};
+
+/*
+ Entry points of the kernels of one level
+ */
+struct SimdKernels {
+	bool (*dwt_encode_53)(TileComponent *tilec);
+	bool (*dwt_encode_97)(TileComponent *tilec);
+	bool (*dwt_decode_53)(TileProcessor *p_tcd, TileComponent *tilec,
+			uint32_t numres);
+	bool (*dwt_decode_97)(TileProcessor *p_tcd, TileComponent *tilec,
+			uint32_t numres);
+	bool (*dwt_decode_lines)(TileComponent *tilec, uint32_t numres,
+			uint8_t qmfbid);
+	bool (*dwt_decode_mct_lines)(TileComponent *tilec, uint32_t numres,
+			uint8_t qmfbid, const DcShiftParams *params);
+	void (*mct_encode_rev)(int32_t *c0, int32_t *c1, int32_t *c2, uint64_t n);
+	void (*mct_decode_rev)(int32_t *c0, int32_t *c1, int32_t *c2, uint64_t n);
+	void (*mct_encode_irrev)(int32_t *c0, int32_t *c1, int32_t *c2,
+			uint64_t n);
+	void (*mct_decode_irrev)(float *c0, float *c1, float *c2, uint64_t n);
+	void (*mct_decode_rev_shift)(int32_t *c0, int32_t *c1, int32_t *c2,
+			uint64_t n, const DcShiftParams *params);
+	void (*mct_decode_irrev_shift)(float *c0, float *c1, float *c2,
+			uint64_t n, const DcShiftParams *params);
+	void (*dequantize_cblk)(const int32_t *src, uint32_t w, uint32_t h,
+			int32_t *dest, uint32_t dest_stride,
+			const DequantizeParams &params);
+};
+
+/*
+ Fill kernels with the entry points of each level
+ */
+namespace baseline {
+void get_simd_kernels(SimdKernels *kernels);
+}
+#ifdef GROK_HAVE_SIMD_AVX2
+namespace avx2 {
+void get_simd_kernels(SimdKernels *kernels);
+}
+#endif
+#ifdef GROK_HAVE_SIMD_AVX512
+namespace avx512 {
+void get_simd_kernels(SimdKernels *kernels);
+}
+#endif
+
+/*
+ Level of the kernels that are run
+ */
+GRK_SIMD_LEVEL simd_level(void);
+
+/*
+ Name of level
+ */
+const char* simd_level_name(GRK_SIMD_LEVEL level);
+
+/*
+ Fill kernels with the entry points of level, regardless of the
+ level that is run (for benchmarks and tests).
+ Return false if level is not built or not supported by the CPU.
+ */
+bool simd_level_kernels(GRK_SIMD_LEVEL level, SimdKernels *kernels);
+
+/*
+ Kernels that are run. The level is chosen on first call.
+ */
+const SimdKernels& simd_kernels(void);
+
+}
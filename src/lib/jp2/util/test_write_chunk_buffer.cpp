@@ -0,0 +1,149 @@
+/*
+ *    Copyright (C) 2016-2020 Grok Image Compression Inc.
+ *
+ *    This source code is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This source code is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#undef NDEBUG
+
+#include "grok_includes.h"
+
+using namespace grk;
+
+// small chunk size, so that every write crosses chunk boundaries
+const size_t chunk_size = 7;
+
+static void test_chunk_buffer(void) {
+	uint8_t data[50];
+	for (size_t i = 0; i < sizeof(data); ++i)
+		data[i] = (uint8_t) (i + 1);
+
+	WriteChunkBuffer chunks(chunk_size);
+	assert(chunks.length() == 0);
+	assert(chunks.num_chunks() == 0);
+	size_t len = 1;
+	assert(chunks.get_chunk(0, &len) == nullptr);
+	assert(len == 0);
+
+	// sequential write across chunk boundaries
+	assert(chunks.write(data, 20) == 20);
+	assert(chunks.tell() == 20);
+	assert(chunks.length() == 20);
+	assert(chunks.num_chunks() == 3);
+
+	// seek back and patch, as the codec does for marker lengths
+	uint8_t patch[] = { 0xAA, 0xBB, 0xCC, 0xDD };
+	assert(chunks.seek(5));
+	assert(chunks.write(patch, sizeof(patch)) == sizeof(patch));
+	assert(chunks.tell() == 9);
+	assert(chunks.length() == 20);
+
+	// seek past the end: the gap must read back as zeros
+	assert(chunks.seek(30));
+	assert(chunks.write(data, 3) == 3);
+	assert(chunks.length() == 33);
+	assert(chunks.num_chunks() == 5);
+
+	uint8_t expected[33];
+	memcpy(expected, data, 20);
+	memcpy(expected + 5, patch, sizeof(patch));
+	memset(expected + 20, 0, 10);
+	memcpy(expected + 30, data, 3);
+
+	uint8_t out[40];
+	memset(out, 0xFF, sizeof(out));
+	assert(chunks.copy_to_contiguous_buffer(out, sizeof(out)) == 33);
+	assert(memcmp(out, expected, 33) == 0);
+	assert(out[33] == 0xFF);
+
+	// short destination buffer
+	memset(out, 0xFF, sizeof(out));
+	assert(chunks.copy_to_contiguous_buffer(out, 10) == 10);
+	assert(memcmp(out, expected, 10) == 0);
+	assert(out[10] == 0xFF);
+	assert(chunks.copy_to_contiguous_buffer(nullptr, 10) == 0);
+
+	// chunks cover the data, with a short last chunk
+	size_t offset = 0;
+	for (size_t i = 0; i < chunks.num_chunks(); ++i) {
+		auto chunk = chunks.get_chunk(i, &len);
+		assert(chunk);
+		assert(len == std::min<size_t>(chunk_size, 33 - offset));
+		assert(memcmp(chunk, expected + offset, len) == 0);
+		offset += len;
+	}
+	assert(offset == 33);
+	assert(chunks.get_chunk(chunks.num_chunks(), &len) == nullptr);
+}
+
+static void test_chunked_stream(void) {
+	uint8_t data[50];
+	for (size_t i = 0; i < sizeof(data); ++i)
+		data[i] = (uint8_t) (100 + i);
+
+	auto stream = grk_stream_create_chunked_mem_stream(chunk_size);
+	assert(stream);
+	auto buffered_stream = (BufferedStream*) stream;
+
+	// write more than the stream buffer, patch, then extend past the end
+	assert(buffered_stream->write_bytes(data, 40) == 40);
+	uint8_t patch[] = { 1, 2, 3 };
+	assert(buffered_stream->seek(12));
+	assert(buffered_stream->write_bytes(patch, sizeof(patch)) == sizeof(patch));
+	assert(buffered_stream->seek(45));
+	assert(buffered_stream->write_bytes(data, 2) == 2);
+
+	uint8_t expected[47];
+	memcpy(expected, data, 40);
+	memcpy(expected + 12, patch, sizeof(patch));
+	memset(expected + 40, 0, 5);
+	memcpy(expected + 45, data, 2);
+
+	// length and copy flush the stream buffer first
+	assert(grk_stream_get_write_mem_stream_length(stream) == 47);
+	uint8_t out[47];
+	assert(grk_stream_copy_chunked_mem_stream(stream, out, sizeof(out)) == 47);
+	assert(memcmp(out, expected, 47) == 0);
+
+	// gather the chunks
+	size_t num_chunks = grk_stream_get_chunked_mem_stream_chunks(stream,
+			nullptr, 0);
+	assert(num_chunks == 7);
+	grk_stream_chunk chunk_array[7];
+	assert(grk_stream_get_chunked_mem_stream_chunks(stream, chunk_array,
+			num_chunks) == num_chunks);
+	size_t offset = 0;
+	for (size_t i = 0; i < num_chunks; ++i) {
+		assert(chunk_array[i].len == std::min<size_t>(chunk_size, 47 - offset));
+		assert(memcmp(chunk_array[i].data, expected + offset,
+				chunk_array[i].len) == 0);
+		offset += chunk_array[i].len;
+	}
+	assert(offset == 47);
+	grk_stream_destroy(stream);
+
+	// not a chunked stream
+	uint8_t buf[16];
+	stream = grk_stream_create_mem_stream(buf, sizeof(buf), false, false);
+	assert(grk_stream_copy_chunked_mem_stream(stream, out, sizeof(out)) == 0);
+	assert(grk_stream_get_chunked_mem_stream_chunks(stream, nullptr, 0) == 0);
+	grk_stream_destroy(stream);
+}
+
+int main() {
+	test_chunk_buffer();
+	test_chunked_stream();
+
+	return 0;
+}
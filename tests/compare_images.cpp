@@ -139,6 +139,8 @@ static int get_decod_format_from_string(const char *filename) {
 		return GRK_TIF_FMT;
 	if (strcmp(ext, ".ppm") == 0)
 		return GRK_PXM_FMT;
+	if (strcmp(ext, ".pgm") == 0)
+		return GRK_PXM_FMT;
 	if (strcmp(ext, ".png") == 0)
 		return GRK_PNG_FMT;
 	return -1;
@@ -0,0 +1,103 @@
+#    Copyright (C) 2016-2020 Grok Image Compression Inc.
+#
+#    This source code is free software: you can redistribute it and/or  modify
+#    it under the terms of the GNU Affero General Public License, version 3,
+#    as published by the Free Software Foundation.
+#
+#    This source code is distributed in the hope that it will be useful,
+#    but WITHOUT ANY WARRANTY; without even the implied warranty of
+#    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#    GNU Affero General Public License for more details.
+#
+#    You should have received a copy of the GNU Affero General Public License
+#    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+# check byte budget
+#
+# Check that byte budgeted decompression (grk_decompress -T and -b) never
+# uses more packet data than its budget.
+#
+# INFILE is a single tile, LRCP code stream with several quality layers, and
+# REFFILE is the same image compressed with only the first of these layers,
+# so that the packets of REFFILE are exactly the first packets of INFILE.
+# Decompressing INFILE with a budget of the size of these packets must then
+# give the same image as decompressing REFFILE, and one byte less must not.
+#
+# This script expects the following inputs
+# GRK_DECOMPRESS: Path to grk_decompress
+# INFILE: Multiple layer J2K file
+# REFFILE: Single layer J2K file
+# OUTPREFIX: Prefix of decompressed images
+
+# read big endian unsigned integer of LEN bytes at byte offset POS of hex string
+macro(read_uint hex pos len var)
+  math(EXPR _hexpos "2 * (${pos})")
+  math(EXPR _hexlen "2 * ${len}")
+  string(SUBSTRING ${hex} ${_hexpos} ${_hexlen} _digits)
+  math(EXPR ${var} "0x${_digits}")
+endmacro()
+
+# find position of first SOT marker, and number of bytes of packet data
+# in the first tile-part
+function(tile_part_layout file sot_var packets_var)
+  file(READ ${file} hex HEX)
+  set(pos 2)
+  read_uint(${hex} ${pos} 2 marker)
+  while(NOT marker EQUAL 0xFF90)
+    read_uint(${hex} ${pos}+2 2 seglen)
+    math(EXPR pos "${pos} + 2 + ${seglen}")
+    read_uint(${hex} ${pos} 2 marker)
+  endwhile()
+  set(sot ${pos})
+  read_uint(${hex} ${sot}+6 4 psot)
+  while(NOT marker EQUAL 0xFF93)
+    read_uint(${hex} ${pos}+2 2 seglen)
+    math(EXPR pos "${pos} + 2 + ${seglen}")
+    read_uint(${hex} ${pos} 2 marker)
+  endwhile()
+  math(EXPR packets "${sot} + ${psot} - (${pos} + 2)")
+  set(${sot_var} ${sot} PARENT_SCOPE)
+  set(${packets_var} ${packets} PARENT_SCOPE)
+endfunction()
+
+function(decompress outfile)
+  execute_process(COMMAND ${GRK_DECOMPRESS} -i ${ARGN} -o ${outfile}
+    RESULT_VARIABLE result OUTPUT_QUIET ERROR_QUIET)
+  if(NOT result EQUAL 0)
+    message(FATAL_ERROR "grk_decompress -i ${ARGN} failed")
+  endif()
+endfunction()
+
+function(check_budget outfile expect_equal)
+  execute_process(COMMAND ${CMAKE_COMMAND} -E compare_files
+    ${OUTPREFIX}-ref.pgm ${outfile} RESULT_VARIABLE result)
+  if(expect_equal AND NOT result EQUAL 0)
+    message(SEND_ERROR "${outfile} differs from decompressed reference")
+  elseif(NOT expect_equal AND result EQUAL 0)
+    message(SEND_ERROR "${outfile} used more packet data than its budget")
+  endif()
+endfunction()
+
+tile_part_layout(${REFFILE} ref_sot ref_packets)
+tile_part_layout(${INFILE} sot packets)
+file(SIZE ${INFILE} size)
+message(STATUS "first layer: ${ref_packets} of ${packets} bytes of packet data")
+
+decompress(${OUTPREFIX}-ref.pgm ${REFFILE})
+
+# per tile budget
+math(EXPR budget_less "${ref_packets} - 1")
+decompress(${OUTPREFIX}-T.pgm ${INFILE} -T ${ref_packets})
+check_budget(${OUTPREFIX}-T.pgm TRUE)
+decompress(${OUTPREFIX}-T-less.pgm ${INFILE} -T ${budget_less})
+check_budget(${OUTPREFIX}-T-less.pgm FALSE)
+
+# global budget: a tile gets a share in proportion to its packet data
+# out of all the data following the main header
+math(EXPR total "${size} - ${sot} - 2")
+math(EXPR budget "(${ref_packets} * ${total} + ${packets} - 1) / ${packets}")
+math(EXPR budget_less "${budget} - 1")
+decompress(${OUTPREFIX}-b.pgm ${INFILE} -b ${budget})
+check_budget(${OUTPREFIX}-b.pgm TRUE)
+decompress(${OUTPREFIX}-b-less.pgm ${INFILE} -b ${budget_less})
+check_budget(${OUTPREFIX}-b-less.pgm FALSE)
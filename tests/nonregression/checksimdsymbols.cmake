@@ -0,0 +1,75 @@
+#    Copyright (C) 2016-2020 Grok Image Compression Inc.
+#
+#    This source code is free software: you can redistribute it and/or  modify
+#    it under the terms of the GNU Affero General Public License, version 3,
+#    as published by the Free Software Foundation.
+#
+#    This source code is distributed in the hope that it will be useful,
+#    but WITHOUT ANY WARRANTY; without even the implied warranty of
+#    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#    GNU Affero General Public License for more details.
+#
+#    You should have received a copy of the GNU Affero General Public License
+#    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+# check SIMD symbols
+#
+# Check that no AVX2 or AVX-512 code is reachable from the baseline code.
+#
+# The SIMD kernel sources are compiled once more for each instruction set,
+# with their own code in a namespace named after the instruction set.
+# Inline functions and templates outside of this namespace, such as standard
+# library templates, are also emitted by these objects as weak symbols, and
+# the linker keeps only one copy of each. If it kept an AVX2 or AVX-512 copy,
+# baseline code calling the function would crash on CPUs without these
+# instructions. So none of these functions may use ymm or zmm registers
+# in the linked binary.
+#
+# This script expects the following inputs
+# NM: Path to nm
+# OBJDUMP: Path to objdump
+# OBJECTS: SIMD kernel objects, separated by |
+# BINARY: Shared library or executable linked with these objects
+
+string(REPLACE "|" ";" objects "${OBJECTS}")
+list(REMOVE_ITEM objects "")
+execute_process(COMMAND ${NM} --defined-only ${objects}
+  OUTPUT_VARIABLE symbols RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+  message(FATAL_ERROR "nm failed on ${objects}")
+endif()
+
+# weak symbols that do not belong to the grk::avx2 or grk::avx512 namespace
+# (mangled as 3grk4avx2, or with a substitution such as S_4avx2 for grk)
+string(REGEX MATCHALL "[ \t][WVu] [^\n]+" weak "${symbols}")
+set(count 0)
+foreach(line ${weak})
+  string(REGEX REPLACE "^[ \t][WVu] " "" name "${line}")
+  if(NOT name MATCHES "(3grk|S[0-9A-Z]*_)(4avx2|6avx512)"
+      AND NOT shared_${name})
+    set(shared_${name} TRUE)
+    math(EXPR count "${count} + 1")
+  endif()
+endforeach()
+message(STATUS "${count} weak symbols outside of the SIMD namespaces")
+
+execute_process(COMMAND ${OBJDUMP} -d --no-show-raw-insn ${BINARY}
+  OUTPUT_FILE ${CMAKE_CURRENT_BINARY_DIR}/checksimdsymbols.dis
+  RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+  message(FATAL_ERROR "objdump failed on ${BINARY}")
+endif()
+file(STRINGS ${CMAKE_CURRENT_BINARY_DIR}/checksimdsymbols.dis lines
+  REGEX "^[0-9a-f]+ <[^>]+>:$|%[yz]mm")
+file(REMOVE ${CMAKE_CURRENT_BINARY_DIR}/checksimdsymbols.dis)
+
+set(function "")
+set(reported "")
+foreach(line ${lines})
+  if(line MATCHES "^[0-9a-f]+ <([^>]+)>:$")
+    set(function ${CMAKE_MATCH_1})
+  elseif(shared_${function} AND NOT function STREQUAL reported)
+    message(SEND_ERROR "${function} uses AVX2 or AVX-512 registers")
+    set(reported ${function})
+  endif()
+endforeach()
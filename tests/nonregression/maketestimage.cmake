@@ -0,0 +1,52 @@
+#    Copyright (C) 2016-2020 Grok Image Compression Inc.
+#
+#    This source code is free software: you can redistribute it and/or  modify
+#    it under the terms of the GNU Affero General Public License, version 3,
+#    as published by the Free Software Foundation.
+#
+#    This source code is distributed in the hope that it will be useful,
+#    but WITHOUT ANY WARRANTY; without even the implied warranty of
+#    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#    GNU Affero General Public License for more details.
+#
+#    You should have received a copy of the GNU Affero General Public License
+#    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+# make test image
+#
+# Write a synthetic 8 bit ASCII PNM image (P2 grey map or P3 pix map), so that
+# command line tests can run without GROK_DATA_ROOT. The image is a gradient
+# with some texture and pseudo random noise, so that every sub-band and every
+# quality layer carries data.
+#
+# This script expects the following inputs
+# OUTFILE: Path to the PGM or PPM file to write
+# WIDTH, HEIGHT: Image dimensions
+# NUMCOMPS: 1 for a PGM, 3 for a PPM file
+# SEED: (optional) Changes the pattern, to make several distinct images
+
+if(NOT SEED)
+  set(SEED 0)
+endif()
+if(NUMCOMPS EQUAL 3)
+  set(magic P3)
+  set(comps 0 1 2)
+else()
+  set(magic P2)
+  set(comps 0)
+endif()
+
+math(EXPR xmax "${WIDTH} - 1")
+math(EXPR ymax "${HEIGHT} - 1")
+set(image "${magic}\n${WIDTH} ${HEIGHT}\n255\n")
+foreach(y RANGE ${ymax})
+  set(row "")
+  foreach(x RANGE ${xmax})
+    foreach(c ${comps})
+      math(EXPR v "(${x} * 3 + ${y} * 5 + (${c} + ${SEED}) * 17 + ((${x} * ${y}) % 23) * 7 + (((${x} * 7919 + ${y} * 104729 + ${c} * 31 + ${SEED}) * 2654435761) >> 16) % 5) & 255")
+      string(APPEND row "${v} ")
+    endforeach()
+  endforeach()
+  string(APPEND image "${row}\n")
+endforeach()
+file(WRITE ${OUTFILE} "${image}")
@@ -0,0 +1,350 @@
+/*
+ *    Copyright (C) 2016-2020 Grok Image Compression Inc.
+ *
+ *    This source code is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This source code is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include "grk_config.h"
+#include "common.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <vector>
+
+/* -------------------------------------------------------------------------- */
+
+/**
+ sample error debug callback expecting no client object
+ */
+static void error_callback(const char *msg, void *client_data) {
+	(void) client_data;
+	spdlog::error("{}", msg);
+}
+/**
+ sample warning debug callback expecting no client object
+ */
+static void warning_callback(const char *msg, void *client_data) {
+	(void) client_data;
+	spdlog::warn("{}", msg);
+}
+/**
+ sample debug callback expecting no client object
+ */
+static void info_callback(const char *msg, void *client_data) {
+	(void) client_data;
+	spdlog::info("{}", msg);
+}
+
+/* -------------------------------------------------------------------------- */
+
+#define NUM_COMPS_MAX 4
+
+/*
+ Compress a synthetic image to a J2K code stream in memory
+ */
+static bool compress(uint32_t num_comps, uint32_t width, uint32_t height,
+		uint32_t tile_width, uint32_t tile_height, bool irreversible,
+		uint32_t num_layers, std::vector<uint8_t> *out) {
+	grk_cparameters param;
+	grk_image_cmptparm params[NUM_COMPS_MAX];
+	grk_codec *codec = nullptr;
+	grk_image *image = nullptr;
+	bool rc = false;
+	grk_stream *stream = grk_stream_create_chunked_mem_stream(0);
+	if (!stream)
+		return false;
+
+	grk_set_default_compress_params(&param);
+	param.tcp_numlayers = num_layers;
+	for (uint32_t i = 0; i < num_layers; ++i)
+		param.tcp_rates[i] = (double) ((num_layers - i) * 20);
+	param.tcp_rates[num_layers - 1] = 0;
+	param.cp_disto_alloc = true;
+	if (tile_width && tile_height) {
+		param.tile_size_on = true;
+		param.t_width = tile_width;
+		param.t_height = tile_height;
+	}
+	param.irreversible = irreversible;
+	param.numresolution = 4;
+	param.prog_order = GRK_LRCP;
+	for (uint32_t i = 0; i < num_comps; ++i) {
+		params[i].dx = 1;
+		params[i].dy = 1;
+		params[i].w = width;
+		params[i].h = height;
+		params[i].sgnd = false;
+		params[i].prec = 8;
+		params[i].x0 = 0;
+		params[i].y0 = 0;
+	}
+	codec = grk_create_compress(GRK_CODEC_J2K, stream);
+	if (!codec)
+		goto cleanup;
+	image = grk_image_create(num_comps, params, GRK_CLRSPC_SRGB);
+	if (!image)
+		goto cleanup;
+	image->x0 = 0;
+	image->y0 = 0;
+	image->x1 = width;
+	image->y1 = height;
+	for (uint32_t compno = 0; compno < num_comps; ++compno) {
+		auto data = image->comps[compno].data;
+		for (uint32_t y = 0; y < height; ++y)
+			for (uint32_t x = 0; x < width; ++x)
+				data[(uint64_t) y * width + x] = (int32_t) ((x * 3 + y * 5
+						+ compno * 17 + ((x * y) % 23) * 7) & 0xFF);
+	}
+	if (!grk_init_compress(codec, &param, image) || !grk_start_compress(codec)
+			|| !grk_compress(codec) || !grk_end_compress(codec)) {
+		spdlog::error("test_incremental_decoder: failed to compress");
+		goto cleanup;
+	}
+	out->resize(grk_stream_get_write_mem_stream_length(stream));
+	rc = grk_stream_copy_chunked_mem_stream(stream, out->data(), out->size())
+			== out->size();
+	cleanup: grk_destroy_codec(codec);
+	grk_stream_destroy(stream);
+	grk_image_destroy(image);
+
+	return rc;
+}
+
+/*
+ Length of main header, up to and including the first SOT marker
+ */
+static size_t main_header_length(const std::vector<uint8_t> &code_stream) {
+	size_t pos = 2;
+	while (pos + 4 <= code_stream.size()) {
+		uint32_t marker = (uint32_t) (code_stream[pos] << 8)
+				| code_stream[pos + 1];
+		if (marker == 0xFF90)
+			return pos + 2;
+		pos += 2 + ((uint32_t) (code_stream[pos + 2] << 8) | code_stream[pos + 3]);
+	}
+
+	return 0;
+}
+
+/*
+ Decompress whole code stream with grk_decompress
+ */
+static grk_image* decompress_full(std::vector<uint8_t> &code_stream) {
+	grk_dparameters param;
+	grk_image *image = nullptr;
+	grk_stream *stream = grk_stream_create_mem_stream(code_stream.data(),
+			code_stream.size(), false, true);
+	if (!stream)
+		return nullptr;
+	grk_codec *codec = grk_create_decompress(GRK_CODEC_J2K, stream);
+	grk_set_default_decompress_params(&param);
+	if (!codec || !grk_init_decompress(codec, &param)
+			|| !grk_read_header(codec, nullptr, &image)
+			|| !grk_decompress(codec, nullptr, image)
+			|| !grk_end_decompress(codec)) {
+		spdlog::error("test_incremental_decoder: full decompress failed");
+		grk_image_destroy(image);
+		image = nullptr;
+	}
+	grk_destroy_codec(codec);
+	grk_stream_destroy(stream);
+
+	return image;
+}
+
+/*
+ Decompress code stream with grk_decompress_incremental, appending
+ it to a growable memory stream in chunks of uneven size. The main header
+ is appended first, as grk_read_header needs the first SOT marker.
+ */
+static grk_image* decompress_incremental(
+		const std::vector<uint8_t> &code_stream) {
+	// deliberately uneven, from a single byte to several packets
+	const size_t chunk_sizes[] = { 1, 7, 333, 2, 4096, 61, 1500, 13, 9000 };
+	const size_t num_chunk_sizes = sizeof(chunk_sizes) / sizeof(chunk_sizes[0]);
+	grk_dparameters param;
+	grk_image *image = nullptr;
+	grk_codec *codec = nullptr;
+	bool complete = false;
+	bool rc = false;
+	size_t pos = main_header_length(code_stream);
+	uint32_t num_extra_calls = 0;
+	grk_stream *stream = grk_stream_create_growable_mem_stream(0);
+	if (!stream)
+		return nullptr;
+	if (!pos) {
+		spdlog::error("test_incremental_decoder: no SOT marker found");
+		goto cleanup;
+	}
+	if (!grk_stream_append(stream, code_stream.data(), pos))
+		goto cleanup;
+	codec = grk_create_decompress(GRK_CODEC_J2K, stream);
+	grk_set_default_decompress_params(&param);
+	if (!codec || !grk_init_decompress(codec, &param)
+			|| !grk_read_header(codec, nullptr, &image)) {
+		spdlog::error("test_incremental_decoder: failed to read the header");
+		goto cleanup;
+	}
+	for (size_t i = 0; !complete; ++i) {
+		if (pos < code_stream.size()) {
+			size_t len = std::min<size_t>(chunk_sizes[i % num_chunk_sizes],
+					code_stream.size() - pos);
+			if (!grk_stream_append(stream, code_stream.data() + pos, len))
+				goto cleanup;
+			pos += len;
+		} else if (num_extra_calls++) {
+			spdlog::error(
+					"test_incremental_decoder: not complete after all data was appended");
+			goto cleanup;
+		}
+		if (!grk_decompress_incremental(codec, image, &complete)) {
+			spdlog::error(
+					"test_incremental_decoder: incremental decompress failed at byte {}",
+					pos);
+			goto cleanup;
+		}
+	}
+	if (pos != code_stream.size()) {
+		spdlog::error(
+				"test_incremental_decoder: complete after {} of {} bytes",
+				pos, code_stream.size());
+		goto cleanup;
+	}
+	rc = true;
+	cleanup: grk_destroy_codec(codec);
+	grk_stream_destroy(stream);
+	if (!rc) {
+		grk_image_destroy(image);
+		image = nullptr;
+	}
+
+	return image;
+}
+
+static bool compare(grk_image *image, grk_image *ref) {
+	if (image->numcomps != ref->numcomps) {
+		spdlog::error("test_incremental_decoder: component count differs");
+		return false;
+	}
+	for (uint32_t compno = 0; compno < ref->numcomps; ++compno) {
+		auto comp = image->comps + compno;
+		auto ref_comp = ref->comps + compno;
+		if (comp->w != ref_comp->w || comp->h != ref_comp->h || !comp->data
+				|| !ref_comp->data) {
+			spdlog::error(
+					"test_incremental_decoder: component {} dimensions differ",
+					compno);
+			return false;
+		}
+		uint64_t len = (uint64_t) ref_comp->w * ref_comp->h;
+		for (uint64_t i = 0; i < len; ++i) {
+			if (comp->data[i] != ref_comp->data[i]) {
+				spdlog::error(
+						"test_incremental_decoder: component {} differs at sample {}: {} != {}",
+						compno, i, comp->data[i], ref_comp->data[i]);
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+/*
+ Decompress a synthetic code stream as it is received in uneven chunks,
+ and check that the image is identical to the one decompressed from the
+ complete code stream.
+
+ test_incremental_decoder num_comps width height tile_width tile_height irreversible num_layers
+
+ A tile width or height of zero compresses a single tile. Incremental
+ decompression only supports single-tile images, so a code stream with
+ several tiles must be rejected.
+ */
+int main(int argc, char *argv[]) {
+	std::vector<uint8_t> code_stream;
+	grk_image *ref = nullptr;
+	grk_image *image = nullptr;
+	int rc = 1;
+
+	uint32_t num_comps;
+	uint32_t image_width;
+	uint32_t image_height;
+	uint32_t tile_width;
+	uint32_t tile_height;
+	bool irreversible;
+	uint32_t num_layers;
+
+	grk_initialize(nullptr, 0);
+
+	/* should be test_incremental_decoder 3 300 200 0 0 0 3 */
+	if (argc == 8) {
+		num_comps = (uint32_t) atoi(argv[1]);
+		image_width = (uint32_t) atoi(argv[2]);
+		image_height = (uint32_t) atoi(argv[3]);
+		tile_width = (uint32_t) atoi(argv[4]);
+		tile_height = (uint32_t) atoi(argv[5]);
+		irreversible = atoi(argv[6]) ? true : false;
+		num_layers = (uint32_t) atoi(argv[7]);
+	} else {
+		num_comps = 3U;
+		image_width = 300U;
+		image_height = 200U;
+		tile_width = 0U;
+		tile_height = 0U;
+		irreversible = false;
+		num_layers = 3U;
+	}
+	if (!num_comps || num_comps > NUM_COMPS_MAX || !num_layers
+			|| num_layers > 10)
+		goto cleanup;
+
+	/* catch events using our callbacks and give a local context */
+	grk_set_info_handler(info_callback, nullptr);
+	grk_set_warning_handler(warning_callback, nullptr);
+	grk_set_error_handler(error_callback, nullptr);
+
+	if (!compress(num_comps, image_width, image_height, tile_width,
+			tile_height, irreversible, num_layers, &code_stream))
+		goto cleanup;
+	ref = decompress_full(code_stream);
+	if (!ref)
+		goto cleanup;
+	image = decompress_incremental(code_stream);
+	if (tile_width && tile_height
+			&& (tile_width < image_width || tile_height < image_height)) {
+		if (image) {
+			spdlog::error(
+					"test_incremental_decoder: code stream with several tiles was not rejected");
+			goto cleanup;
+		}
+		spdlog::info(
+				"test_incremental_decoder: code stream with several tiles rejected");
+		rc = 0;
+		goto cleanup;
+	}
+	if (!image)
+		goto cleanup;
+	if (!compare(image, ref))
+		goto cleanup;
+	spdlog::info(
+			"test_incremental_decoder: {} byte code stream decompressed incrementally",
+			code_stream.size());
+	rc = 0;
+
+	cleanup: grk_image_destroy(image);
+	grk_image_destroy(ref);
+	grk_deinitialize();
+
+	return rc;
+}
@@ -0,0 +1,260 @@
+/*
+ *    Copyright (C) 2016-2020 Grok Image Compression Inc.
+ *
+ *    This source code is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This source code is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include "grk_config.h"
+#include "common.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <vector>
+
+/* -------------------------------------------------------------------------- */
+
+/**
+ sample error debug callback expecting no client object
+ */
+static void error_callback(const char *msg, void *client_data) {
+	(void) client_data;
+	spdlog::error("{}", msg);
+}
+/**
+ sample warning debug callback expecting no client object
+ */
+static void warning_callback(const char *msg, void *client_data) {
+	(void) client_data;
+	spdlog::warn("{}", msg);
+}
+/**
+ sample debug callback expecting no client object
+ */
+static void info_callback(const char *msg, void *client_data) {
+	(void) client_data;
+	spdlog::info("{}", msg);
+}
+
+/* -------------------------------------------------------------------------- */
+
+#define NUM_COMPS_MAX 4
+
+/*
+ Synthetic sample value: a gradient plus some texture,
+ so that all sub-bands carry data
+ */
+static uint32_t sample(uint32_t compno, uint32_t x, uint32_t y,
+		uint32_t prec) {
+	uint32_t v = x * 3 + y * 5 + compno * 17 + ((x * y) % 23) * 7;
+
+	return v & ((1U << prec) - 1);
+}
+
+/*
+ Compress image to chunked memory stream, either pushing strips of
+ strip_rows rows with grk_compress_strip, or from the image
+ component data with grk_compress
+ */
+static bool compress(grk_cparameters *param, grk_image_cmptparm *params,
+		uint32_t num_comps, uint32_t strip_rows, std::vector<uint8_t> *out) {
+	bool rc = false;
+	uint32_t width = params[0].w;
+	uint32_t height = params[0].h;
+	uint32_t prec = params[0].prec;
+	uint32_t sample_size = prec > 8 ? 2 : 1;
+	grk_codec *codec = nullptr;
+	grk_image *image = nullptr;
+	grk_stream *stream = grk_stream_create_chunked_mem_stream(0);
+	if (!stream)
+		return false;
+	codec = grk_create_compress(GRK_CODEC_J2K, stream);
+	if (!codec)
+		goto cleanup;
+	image = grk_image_create(num_comps, params, GRK_CLRSPC_SRGB);
+	if (!image)
+		goto cleanup;
+	image->x0 = 0;
+	image->y0 = 0;
+	image->x1 = width;
+	image->y1 = height;
+	if (!strip_rows) {
+		for (uint32_t compno = 0; compno < num_comps; ++compno) {
+			auto data = image->comps[compno].data;
+			for (uint32_t y = 0; y < height; ++y)
+				for (uint32_t x = 0; x < width; ++x)
+					data[(uint64_t) y * width + x] = (int32_t) sample(compno,
+							x, y, prec);
+		}
+	}
+	if (!grk_init_compress(codec, param, image)) {
+		spdlog::error("test_strip_encoder: failed to setup the codec");
+		goto cleanup;
+	}
+	if (!grk_start_compress(codec)) {
+		spdlog::error("test_strip_encoder: failed to start compress");
+		goto cleanup;
+	}
+	if (strip_rows) {
+		std::vector<uint8_t> strip(
+				(size_t) strip_rows * width * num_comps * sample_size);
+		for (uint32_t y0 = 0; y0 < height; y0 += strip_rows) {
+			uint32_t rows = std::min<uint32_t>(strip_rows, height - y0);
+			auto ptr = strip.data();
+			for (uint32_t compno = 0; compno < num_comps; ++compno) {
+				for (uint32_t y = y0; y < y0 + rows; ++y) {
+					for (uint32_t x = 0; x < width; ++x) {
+						uint32_t v = sample(compno, x, y, prec);
+						if (sample_size == 2) {
+							uint16_t v16 = (uint16_t) v;
+							memcpy(ptr, &v16, sizeof(v16));
+						} else {
+							*ptr = (uint8_t) v;
+						}
+						ptr += sample_size;
+					}
+				}
+			}
+			if (!grk_compress_strip(codec, strip.data(), rows, sample_size)) {
+				spdlog::error(
+						"test_strip_encoder: failed to compress strip at row {}",
+						y0);
+				goto cleanup;
+			}
+		}
+	} else if (!grk_compress(codec)) {
+		spdlog::error("test_strip_encoder: failed to compress");
+		goto cleanup;
+	}
+	if (!grk_end_compress(codec)) {
+		spdlog::error("test_strip_encoder: failed to end compress");
+		goto cleanup;
+	}
+	out->resize(grk_stream_get_write_mem_stream_length(stream));
+	rc = grk_stream_copy_chunked_mem_stream(stream, out->data(), out->size())
+			== out->size();
+	cleanup: grk_destroy_codec(codec);
+	grk_stream_destroy(stream);
+	grk_image_destroy(image);
+
+	return rc;
+}
+
+/*
+ Compress a synthetic image by pushing strips with grk_compress_strip,
+ and check that the code stream is identical to the one produced
+ by grk_compress for the same image.
+
+ test_strip_encoder num_comps width height tile_width tile_height prec irreversible strip_rows
+
+ A tile width or height of zero compresses a single tile.
+ */
+int main(int argc, char *argv[]) {
+	grk_cparameters param;
+	grk_image_cmptparm params[NUM_COMPS_MAX];
+	std::vector<uint8_t> strip_out;
+	std::vector<uint8_t> full_out;
+	int rc = 0;
+
+	uint32_t num_comps;
+	uint32_t image_width;
+	uint32_t image_height;
+	uint32_t tile_width;
+	uint32_t tile_height;
+	uint32_t comp_prec;
+	bool irreversible;
+	uint32_t strip_rows;
+
+	grk_initialize(nullptr, 0);
+
+	/* should be test_strip_encoder 3 300 200 128 64 8 0 37 */
+	if (argc == 9) {
+		num_comps = (uint32_t) atoi(argv[1]);
+		image_width = (uint32_t) atoi(argv[2]);
+		image_height = (uint32_t) atoi(argv[3]);
+		tile_width = (uint32_t) atoi(argv[4]);
+		tile_height = (uint32_t) atoi(argv[5]);
+		comp_prec = (uint32_t) atoi(argv[6]);
+		irreversible = atoi(argv[7]) ? true : false;
+		strip_rows = (uint32_t) atoi(argv[8]);
+	} else {
+		num_comps = 3U;
+		image_width = 300U;
+		image_height = 200U;
+		tile_width = 128U;
+		tile_height = 64U;
+		comp_prec = 8U;
+		irreversible = false;
+		strip_rows = 37U;
+	}
+	if (!num_comps || num_comps > NUM_COMPS_MAX || !comp_prec
+			|| comp_prec > 16 || !strip_rows) {
+		rc = 1;
+		goto cleanup;
+	}
+
+	/* catch events using our callbacks and give a local context */
+	grk_set_info_handler(info_callback, nullptr);
+	grk_set_warning_handler(warning_callback, nullptr);
+	grk_set_error_handler(error_callback, nullptr);
+
+	grk_set_default_compress_params(&param);
+	param.tcp_numlayers = 1;
+	param.tcp_rates[0] = 0;
+	param.cp_disto_alloc = true;
+	param.tx0 = 0;
+	param.ty0 = 0;
+	if (tile_width && tile_height) {
+		param.tile_size_on = true;
+		param.t_width = tile_width;
+		param.t_height = tile_height;
+	}
+	param.irreversible = irreversible;
+	param.numresolution = 4;
+	param.prog_order = GRK_LRCP;
+	param.tcp_mct = num_comps >= 3 ? 1 : 0;
+
+	for (uint32_t i = 0; i < num_comps; ++i) {
+		params[i].dx = 1;
+		params[i].dy = 1;
+		params[i].w = image_width;
+		params[i].h = image_height;
+		params[i].sgnd = false;
+		params[i].prec = comp_prec;
+		params[i].x0 = 0;
+		params[i].y0 = 0;
+	}
+
+	if (!compress(&param, params, num_comps, strip_rows, &strip_out)) {
+		spdlog::error("test_strip_encoder: strip compress failed");
+		rc = 1;
+		goto cleanup;
+	}
+	if (!compress(&param, params, num_comps, 0, &full_out)) {
+		spdlog::error("test_strip_encoder: compress failed");
+		rc = 1;
+		goto cleanup;
+	}
+	if (strip_out != full_out) {
+		spdlog::error(
+				"test_strip_encoder: strip code stream ({} bytes) differs from full code stream ({} bytes)",
+				strip_out.size(), full_out.size());
+		rc = 1;
+		goto cleanup;
+	}
+	spdlog::info("test_strip_encoder: {} byte code streams are identical",
+			strip_out.size());
+
+	cleanup: grk_deinitialize();
+
+	return rc;
+}